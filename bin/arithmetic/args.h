@@ -83,6 +83,19 @@ struct argp_option program_options[] =
       GAL_OPTIONS_NOT_MANDATORY,
       GAL_OPTIONS_NOT_SET
     },
+    {
+      "prefetchmem",
+      UI_KEY_PREFETCHMEM,
+      "INT",
+      0,
+      "Max. bytes of inputs to read in advance (0: none).",
+      GAL_OPTIONS_GROUP_INPUT,
+      &p->prefetchmem,
+      GAL_TYPE_SIZE_T,
+      GAL_OPTIONS_RANGE_GE_0,
+      GAL_OPTIONS_NOT_MANDATORY,
+      GAL_OPTIONS_NOT_SET
+    },
 
 
 
@@ -1101,7 +1101,7 @@ arithmetic_tofile(struct arithmeticparams *p, char *token, int freeflag)
   popped->wcs=p->refdata.wcs;
   if(popped->ndim==1 && p->onedasimage==0)
     gal_table_write(popped, NULL, NULL, p->cp.tableformat, filename,
-                    "ARITHMETIC", 0);
+                    "ARITHMETIC", 0, p->cp.numthreads);
   else
     gal_fits_img_write(popped, filename, NULL, PROGRAM_NAME);
   if(!p->cp.quiet)
@@ -1595,9 +1595,7 @@ arithmetic_final_read_file(struct arithmeticparams *p,
   if( gal_fits_file_recognized(filename) )
     {
       /* Read the data, note that the WCS has already been set. */
-      out=gal_array_read_one_ch(filename, hdu, NULL,
-                                p->cp.minmapsize,
-                                p->cp.quietmmap);
+      out=operands_read(p, operand);
       out->ndim=gal_dimension_remove_extra(out->ndim, out->dsize,
                                             NULL);
       if(!p->cp.quiet) printf(" - %s (hdu %s) is read.\n", filename, hdu);
@@ -1667,6 +1665,9 @@ reversepolish(struct arithmeticparams *p)
   p->setprm.pop=operands_pop_wrapper_set;
   p->setprm.used_later=arithmetic_set_name_used_later;
 
+  /* Start reading the input files in the background. */
+  operands_prefetch_start(p);
+
   /* Go over each input token and do the work. */
   for(token=p->tokens;token!=NULL;token=token->next)
     {
@@ -1772,7 +1773,7 @@ reversepolish(struct arithmeticparams *p)
       if(data->ndim==1 && p->onedasimage==0)
         gal_table_write(data, NULL, NULL, p->cp.tableformat,
                         p->onedonstdout ? NULL : p->cp.output,
-                        "ARITHMETIC", 0);
+                        "ARITHMETIC", 0, p->cp.numthreads);
       else
         for(tmp=data; tmp!=NULL; tmp=tmp->next)
           gal_fits_img_write(tmp, p->cp.output, NULL, PROGRAM_NAME);
@@ -1787,6 +1788,7 @@ reversepolish(struct arithmeticparams *p)
      into 'data', so it is freed when freeing 'data'. */
   gal_data_free(data);
   free(p->refdata.dsize);
+  operands_prefetch_free(p);
   gal_list_data_free(p->setprm.named);
 
 
@@ -23,6 +23,8 @@ along with Gnuastro. If not, see <http://www.gnu.org/licenses/>.
 #ifndef MAIN_H
 #define MAIN_H
 
+#include <pthread.h>
+
 #include <gnuastro/fits.h>
 #include <gnuastro/list.h>
 
@@ -58,6 +60,7 @@ struct operand
   char       *filename;    /* !=NULL if the operand is a filename. */
   char            *hdu;    /* !=NULL if the operand is a filename. */
   gal_data_t     *data;    /* !=NULL if the operand is a dataset.  */
+  struct prefetch_file *prefetch; /* !=NULL if file is prefetched. */
   struct operand *next;    /* Pointer to next operand.             */
 };
 
@@ -65,6 +68,45 @@ struct operand
 
 
 
+/* Status of each file that may be read before it is popped. */
+enum prefetch_status
+{
+  PREFETCH_STATUS_PENDING,      /* Not yet read.                        */
+  PREFETCH_STATUS_READING,      /* Being read (by a reader or the main).*/
+  PREFETCH_STATUS_DONE,         /* Read, waiting to be popped.          */
+  PREFETCH_STATUS_TAKEN,        /* Popped (or read in the main thread). */
+};
+
+/* An input file (in the order of the tokens). */
+struct prefetch_file
+{
+  char       *filename;    /* Name of file (pointer to the token). */
+  char            *hdu;    /* HDU of the file (allocated).         */
+  gal_data_t     *data;    /* The read dataset (when DONE).        */
+  size_t          size;    /* Bytes reserved for 'data->array'.    */
+  int           status;    /* One of the 'PREFETCH_STATUS_*'.      */
+};
+
+/* Reading the input files on background threads. */
+struct prefetch_params
+{
+  size_t          numfiles;  /* Number of files in 'files'.            */
+  struct prefetch_file *files; /* All FITS inputs (in order of tokens). */
+  size_t          nextread;  /* Next file for the readers to read.     */
+  size_t          nextused;  /* Next file to be matched with operand.  */
+  size_t              used;  /* Bytes of read (but not popped) data.   */
+  size_t        numthreads;  /* Number of reader threads.              */
+  pthread_t       *threads;  /* The reader threads.                    */
+  pthread_mutex_t     lock;  /* Protect the status and counters.       */
+  pthread_cond_t      cond;  /* Signal a change in the status/counter. */
+  int               finish;  /* The readers should return.             */
+  struct arithmeticparams *p; /* Pointer to main program structure.    */
+};
+
+
+
+
+
 
 struct arithmeticparams
 {
@@ -86,6 +128,7 @@ struct arithmeticparams
   char           *metaunit;  /* FITS name (BUNIT keyword) of output.    */
   char        *metacomment;  /* FITS comment of output.                 */
   uint8_t         writeall;  /* Write all outputs.                      */
+  size_t       prefetchmem;  /* Max. bytes of inputs read in advance.   */
 
   /* Operating mode: */
   int        wcs_collapsed;  /* If the internal WCS is already collapsed.*/
@@ -93,6 +136,7 @@ struct arithmeticparams
   /* Internal: */
   uint8_t          envseed;  /* To setup the random number generator.   */
   struct operand *operands;  /* The operands linked list.               */
+  struct prefetch_params prefetch; /* Reading inputs in advance.       */
   int     outnamerequested;  /* ==1 if the user has given '--otuput'.   */
   time_t           rawtime;  /* Starting time of the program.           */
 };
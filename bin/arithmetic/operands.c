@@ -33,6 +33,7 @@ along with Gnuastro. If not, see <http://www.gnu.org/licenses/>.
 #include <gnuastro/fits.h>
 #include <gnuastro/tiff.h>
 #include <gnuastro/array.h>
+#include <gnuastro/arithmetic.h>
 #include <gnuastro-internal/checkset.h>
 #include <gnuastro-internal/arithmetic-set.h>
 
@@ -76,6 +77,362 @@ operands_num(struct arithmeticparams *p)
 
 
 
+/**********************************************************************/
+/************        Reading input files in advance     ***************/
+/**********************************************************************/
+/* Read one input file (in the main thread or a reader thread). While
+   files are read in advance, there are already many reader threads, so
+   each file is read with one thread. */
+static gal_data_t *
+operands_read_file(struct arithmeticparams *p, char *filename, char *hdu,
+                   size_t numthreads)
+{
+  return gal_array_read_one_ch(filename, hdu, NULL, numthreads,
+                               p->cp.minmapsize, p->cp.quietmmap);
+}
+
+
+
+
+
+/* Number of bytes that the dataset of a file will need when it is read
+   (with the type after applying 'BZERO' and 'BSCALE'). */
+static size_t
+operands_prefetch_size(char *filename, char *hdu)
+{
+  int type, status=0;
+  size_t i, ndim, *dsize, size=1;
+  fitsfile *fptr=gal_fits_hdu_open_format(filename, hdu, 0);
+
+  /* Read the basic information and close the file. */
+  gal_fits_img_info(fptr, &type, &ndim, &dsize, NULL, NULL);
+  fits_close_file(fptr, &status);
+  gal_fits_io_error(status, NULL);
+
+  /* Calculate the size. */
+  for(i=0;i<ndim;++i) size*=dsize[i];
+  free(dsize);
+  return size*gal_type_sizeof(type);
+}
+
+
+
+
+
+/* Each reader thread reads the next file (in the order of the tokens)
+   until all the files are read. To respect the memory budget, the size of
+   a file is reserved before it is read: a new file is only read when the
+   total size of the files that are being read or are read (but not yet
+   popped) stays within '--prefetchmem'. */
+static void *
+operands_prefetch_reader(void *in)
+{
+  struct prefetch_params *pf=(struct prefetch_params *)in;
+
+  gal_data_t *data;
+  struct prefetch_file *file;
+
+  pthread_mutex_lock(&pf->lock);
+  while(1)
+    {
+      /* The main thread may have needed some files before we got to them
+         (in that case, it has read them itself). */
+      while(pf->nextread<pf->numfiles
+            && pf->files[pf->nextread].status!=PREFETCH_STATUS_PENDING)
+        ++pf->nextread;
+
+      /* If all the files have been read, we are done. */
+      if(pf->finish || pf->nextread>=pf->numfiles) break;
+
+      /* If the next file doesn't fit in the remaining budget, wait until
+         the main thread takes some of the files that are already read. A
+         file that is larger than the full budget is only read when
+         nothing else is outstanding. */
+      file=&pf->files[pf->nextread];
+      if( pf->used && pf->used+file->size>pf->p->prefetchmem )
+        {
+          pthread_cond_wait(&pf->cond, &pf->lock);
+          continue;
+        }
+
+      /* Reserve the space of this file and read it (without holding the
+         lock). */
+      ++pf->nextread;
+      pf->used+=file->size;
+      file->status=PREFETCH_STATUS_READING;
+      pthread_mutex_unlock(&pf->lock);
+      data=operands_read_file(pf->p, file->filename, file->hdu, 1);
+      pthread_mutex_lock(&pf->lock);
+
+      /* Keep the dataset for the main thread. */
+      file->data=data;
+      file->status=PREFETCH_STATUS_DONE;
+      pthread_cond_broadcast(&pf->cond);
+    }
+  pthread_mutex_unlock(&pf->lock);
+  return NULL;
+}
+
+
+
+
+
+/* Find all the input FITS files (and their HDUs) before parsing the
+   tokens and start reading them on background threads, so the inputs are
+   read while the main thread is busy with the operators. The tokens are
+   checked in the same order as 'reversepolish' (and the HDUs are given
+   to them like 'operands_add'). */
+void
+operands_prefetch_start(struct arithmeticparams *p)
+{
+  int err;
+  size_t i;
+  char *hdu;
+  gal_list_str_t *token, *t, *nexthdu=p->hdus, *names=NULL, *written=NULL;
+  struct prefetch_params *pf=&p->prefetch;
+
+  /* Initialize the prefetching parameters (no prefetching). */
+  pf->p=p;
+  pf->used=0;
+  pf->finish=0;
+  pf->numfiles=0;
+  pf->nextread=0;
+  pf->nextused=0;
+  pf->files=NULL;
+  pf->threads=NULL;
+  pf->numthreads=0;
+
+  /* Reading in parallel is only possible when CFITSIO is thread-safe.
+     When the user has asked for a single thread (or no memory for the
+     prefetched files), don't start any reader. */
+#if GAL_CONFIG_HAVE_FITS_IS_REENTRANT == 1
+  if( p->prefetchmem==0 || p->cp.numthreads<2 || fits_is_reentrant()==0 )
+    return;
+#else
+  return;
+#endif
+
+  /* Allocate space for all the tokens (an upper limit). */
+  errno=0;
+  pf->files=calloc(gal_list_str_number(p->tokens), sizeof *pf->files);
+  if(pf->files==NULL)
+    error(EXIT_FAILURE, errno, "%s: couldn't allocate %zu bytes for "
+          "'pf->files'", __func__,
+          gal_list_str_number(p->tokens)*sizeof *pf->files);
+
+  /* Go over the tokens and find the input FITS files. */
+  for(token=p->tokens; token!=NULL; token=token->next)
+    {
+      /* Files that are written by the 'tofile-' operators (they may be
+         read by later tokens, so they shouldn't be read in advance). */
+      if( !strncmp(OPERATOR_PREFIX_TOFILEFREE, token->v,
+                   OPERATOR_PREFIX_LENGTH_TOFILEFREE) )
+        {
+          gal_list_str_add(&written,
+                           token->v+OPERATOR_PREFIX_LENGTH_TOFILEFREE, 0);
+          continue;
+        }
+      if( !strncmp(OPERATOR_PREFIX_TOFILE, token->v,
+                   OPERATOR_PREFIX_LENGTH_TOFILE) )
+        {
+          gal_list_str_add(&written,
+                           token->v+OPERATOR_PREFIX_LENGTH_TOFILE, 0);
+          continue;
+        }
+
+      /* Columns that are loaded with the 'load-col-' operator. */
+      if( !strncmp(token->v, GAL_ARITHMETIC_OPSTR_LOADCOL_PREFIX,
+                   GAL_ARITHMETIC_OPSTR_LOADCOL_PREFIX_LEN) )
+        continue;
+
+      /* Names that are defined with the 'set-' operator. */
+      if( !strncmp(token->v, GAL_ARITHMETIC_SET_PREFIX,
+                   GAL_ARITHMETIC_SET_PREFIX_LENGTH) )
+        {
+          gal_list_str_add(&names,
+                           token->v+GAL_ARITHMETIC_SET_PREFIX_LENGTH, 0);
+          continue;
+        }
+      for(t=names; t!=NULL; t=t->next)
+        if( !strcmp(t->v, token->v) ) break;
+      if(t) continue;
+
+      /* Files that need a HDU. */
+      if( gal_fits_file_recognized(token->v)
+          || gal_tiff_name_is_tiff(token->v) )
+        {
+          /* Set the HDU of this file. */
+          if(p->globalhdu) hdu=p->globalhdu;
+          else
+            {
+              hdu = nexthdu ? nexthdu->v : NULL;
+              if(nexthdu) nexthdu=nexthdu->next;
+            }
+
+          /* Only FITS files that aren't written by this command are read
+             in advance. */
+          for(t=written; t!=NULL; t=t->next)
+            if( !strcmp(t->v, token->v) ) break;
+          if( hdu && t==NULL && !gal_tiff_name_is_tiff(token->v) )
+            {
+              pf->files[pf->numfiles].filename=token->v;
+              gal_checkset_allocate_copy(hdu, &pf->files[pf->numfiles].hdu);
+              pf->files[pf->numfiles].status=PREFETCH_STATUS_PENDING;
+              ++pf->numfiles;
+            }
+        }
+    }
+  gal_list_str_free(written, 0);
+  gal_list_str_free(names, 0);
+
+  /* Start the reader threads (only when more than one file is read). */
+  if(pf->numfiles<2) return;
+  for(i=0;i<pf->numfiles;++i)
+    pf->files[i].size=operands_prefetch_size(pf->files[i].filename,
+                                             pf->files[i].hdu);
+  pf->numthreads = ( p->cp.numthreads<pf->numfiles
+                     ? p->cp.numthreads
+                     : pf->numfiles );
+  errno=0;
+  pf->threads=malloc(pf->numthreads*sizeof *pf->threads);
+  if(pf->threads==NULL)
+    error(EXIT_FAILURE, errno, "%s: couldn't allocate %zu bytes for "
+          "'pf->threads'", __func__, pf->numthreads*sizeof *pf->threads);
+  pthread_mutex_init(&pf->lock, NULL);
+  pthread_cond_init(&pf->cond, NULL);
+  for(i=0;i<pf->numthreads;++i)
+    {
+      err=pthread_create(&pf->threads[i], NULL, operands_prefetch_reader,
+                         pf);
+      if(err)
+        error(EXIT_FAILURE, err, "%s: couldn't create reader thread %zu",
+              __func__, i);
+    }
+}
+
+
+
+
+
+/* Stop the reader threads and free the prefetching parameters. */
+void
+operands_prefetch_free(struct arithmeticparams *p)
+{
+  size_t i;
+  struct prefetch_params *pf=&p->prefetch;
+
+  /* Let the readers know that they should finish and wait for them. */
+  if(pf->threads)
+    {
+      pthread_mutex_lock(&pf->lock);
+      pf->finish=1;
+      pthread_cond_broadcast(&pf->cond);
+      pthread_mutex_unlock(&pf->lock);
+      for(i=0;i<pf->numthreads;++i)
+        pthread_join(pf->threads[i], NULL);
+      pthread_mutex_destroy(&pf->lock);
+      pthread_cond_destroy(&pf->cond);
+      free(pf->threads);
+    }
+
+  /* Free the files (the datasets are only present when they were read
+     but never popped). */
+  for(i=0;i<pf->numfiles;++i)
+    {
+      free(pf->files[i].hdu);
+      if(pf->files[i].data) gal_data_free(pf->files[i].data);
+    }
+  if(pf->files) free(pf->files);
+}
+
+
+
+
+
+/* The operands are added in the same order as the tokens, so if a file
+   operand is the next prefetched file, return it. Otherwise (for example
+   prefetching is disabled), return NULL. */
+static struct prefetch_file *
+operands_prefetch_match(struct arithmeticparams *p, char *filename,
+                        char *hdu)
+{
+  struct prefetch_params *pf=&p->prefetch;
+  struct prefetch_file *file;
+
+  /* Prefetching is only active when there are reader threads. */
+  if(pf->threads==NULL || pf->nextused>=pf->numfiles) return NULL;
+
+  /* Check if this file is the next prefetched one. */
+  file=&pf->files[pf->nextused];
+  if( strcmp(file->filename, filename) || hdu==NULL
+      || strcmp(file->hdu, hdu) )
+    return NULL;
+
+  /* Use this file. */
+  ++pf->nextused;
+  return file;
+}
+
+
+
+
+
+/* Read the dataset of an operand that is a file: if it is being read in
+   advance, wait for the reader (or read it here if no reader has started
+   reading it yet). */
+gal_data_t *
+operands_read(struct arithmeticparams *p, struct operand *operand)
+{
+  gal_data_t *data;
+  struct prefetch_params *pf=&p->prefetch;
+  struct prefetch_file *file=operand->prefetch;
+
+  /* If the file isn't being read in advance, just read it. */
+  if(file==NULL)
+    return operands_read_file(p, operand->filename, operand->hdu,
+                              p->cp.numthreads);
+
+  /* If no reader has started reading this file, read it here. */
+  pthread_mutex_lock(&pf->lock);
+  if(file->status==PREFETCH_STATUS_PENDING)
+    {
+      file->status=PREFETCH_STATUS_TAKEN;
+      pthread_mutex_unlock(&pf->lock);
+      return operands_read_file(p, operand->filename, operand->hdu, 1);
+    }
+
+  /* Wait for the reader to finish, then take the dataset and let the
+     readers know that there is more space in the memory budget. */
+  while(file->status==PREFETCH_STATUS_READING)
+    pthread_cond_wait(&pf->cond, &pf->lock);
+  data=file->data;
+  file->data=NULL;
+  pf->used-=file->size;
+  file->status=PREFETCH_STATUS_TAKEN;
+  pthread_cond_broadcast(&pf->cond);
+  pthread_mutex_unlock(&pf->lock);
+  return data;
+}
+
+
+
+
+
+
+
+
+
+
+
+
+
+
+
+
+
+
+
+
 /**********************************************************************/
 /************      Adding to and popping from stack     ***************/
 /**********************************************************************/
@@ -109,6 +466,7 @@ operands_add_list(struct arithmeticparams *p, gal_data_t *data)
       newnode->data=tmp;
       newnode->hdu=NULL;
       newnode->filename=NULL;
+      newnode->prefetch=NULL;
       newnode->data->next=NULL;
 
       /* Add this dataset to the top of the stack. */
@@ -150,6 +508,7 @@ operands_add(struct arithmeticparams *p, char *filename, gal_data_t *data)
 
       /* If the 'filename' is the name of a dataset, then use a copy of it.
          otherwise, do the basic analysis. */
+      newnode->prefetch=NULL;
       if( filename
           && gal_arithmetic_set_is_name(p->setprm.named, filename) )
         {
@@ -206,6 +565,11 @@ operands_add(struct arithmeticparams *p, char *filename, gal_data_t *data)
                 }
             }
           else newnode->hdu=NULL;
+
+          /* See if this file is being read in advance. */
+          if(filename)
+            newnode->prefetch=operands_prefetch_match(p, filename,
+                                                      newnode->hdu);
         }
 
       /* Make the link to the previous list. */
@@ -241,8 +605,7 @@ operands_pop(struct arithmeticparams *p, char *operator)
       filename=operands->filename;
 
       /* Read the dataset and remove possibly extra dimensions. */
-      data=gal_array_read_one_ch(filename, hdu, NULL, p->cp.minmapsize,
-                                 p->cp.quietmmap);
+      data=operands_read(p, operands);
       data->ndim=gal_dimension_remove_extra(data->ndim, data->dsize, NULL);
 
       /* When the reference data structure's dimensionality is non-zero, it
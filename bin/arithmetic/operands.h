@@ -26,6 +26,15 @@ along with Gnuastro. If not, see <http://www.gnu.org/licenses/>.
 size_t
 operands_num(struct arithmeticparams *p);
 
+void
+operands_prefetch_start(struct arithmeticparams *p);
+
+void
+operands_prefetch_free(struct arithmeticparams *p);
+
+gal_data_t *
+operands_read(struct arithmeticparams *p, struct operand *operand);
+
 void
 operands_add(struct arithmeticparams *p, char *filename, gal_data_t *data);
 
@@ -26,6 +26,7 @@ along with Gnuastro. If not, see <http://www.gnu.org/licenses/>.
 #include <stdlib.h>
 
 #include <gnuastro-internal/timing.h>
+#include <gnuastro-internal/server.h>
 
 #include "main.h"
 
@@ -37,6 +38,9 @@ main(int argc, char *argv[])
 {
   struct converttparams p={{{0},0},0};
 
+  /* If a server is running for this program, let it do the job. */
+  gal_server_main(argc, argv, PROGRAM_EXEC, main);
+
   /* Set the starting time.*/
   time(&p.rawtime);
 
@@ -752,8 +752,8 @@ ui_make_channels_ll(struct converttparams *p)
             }
 
           /* Read in the array and its WCS information. */
-          data=gal_fits_img_read(name->v, hdu, p->cp.minmapsize,
-                                 p->cp.quietmmap);
+          data=gal_fits_img_read(name->v, hdu, p->cp.numthreads,
+                                 p->cp.minmapsize, p->cp.quietmmap);
           data->wcs=gal_wcs_read(name->v, hdu, p->cp.wcslinearmatrix,
                                  0, 0, &data->nwcs);
           data->ndim=gal_dimension_remove_extra(data->ndim, data->dsize,
@@ -882,7 +882,7 @@ ui_prepare_input_channels_check_wcs(struct converttparams *p)
             c2[0] = tmp->dsize[0] / 2 + 1;
 
             /* Get the RA/Dec. */
-            gal_wcs_img_to_world(coords, tmp->wcs, 1);
+            gal_wcs_img_to_world(coords, tmp->wcs, 1, 1);
 
             /* If the pixel scale hasn't been calculated yet, do it (we
                only need it once, should be similar in all). */
@@ -1382,7 +1382,7 @@ ui_marks_read_coords(struct converttparams *p, gal_data_t **coord1,
             /* Set the second one as the 'next' of the first and do the
                conversion. */
             c1->next=c2;
-            gal_wcs_world_to_img(c1, tmp->wcs, 1);
+            gal_wcs_world_to_img(c1, tmp->wcs, 1, 1);
             wcsfound=1;
             c1->next=NULL;
             break;
@@ -780,7 +780,17 @@ convolve(struct convolveparams *p)
 
 
   /* Do the convolution. */
-  if(p->domain==CONVOLVE_DOMAIN_SPATIAL)
+  if(p->kernel->ndim<p->input->ndim)
+    {
+      /* The kernel has fewer dimensions than the input: every slice/row of
+         the input (along its fastest dimensions) is an independent dataset
+         that should be convolved with the same kernel. */
+      out=gal_convolve_spatial_batch(p->input, p->kernel, cp->numthreads,
+                                     !p->noedgecorrection);
+      gal_data_free(p->input);
+      p->input=out;
+    }
+  else if(p->domain==CONVOLVE_DOMAIN_SPATIAL)
     {
       /* Prepare the mesh structure. */
       if(multidim) gal_tile_full_two_layers(p->input, &cp->tl);
@@ -814,7 +824,7 @@ convolve(struct convolveparams *p)
   /* Save the output (which is in p->input) array. */
   if(p->input->ndim==1)
     gal_table_write(p->input, NULL, NULL, p->cp.tableformat, p->cp.output,
-                    "CONVOLVED", 0);
+                    "CONVOLVED", 0, p->cp.numthreads);
   else
     gal_fits_img_write_to_type(p->input, cp->output, NULL, PROGRAM_NAME,
                                cp->type);
@@ -41,6 +41,7 @@ along with Gnuastro. If not, see <http://www.gnu.org/licenses/>.
 #include <gnuastro-internal/timing.h>
 #include <gnuastro-internal/options.h>
 #include <gnuastro-internal/checkset.h>
+#include <gnuastro-internal/server.h>
 #include <gnuastro-internal/fixedstringmacros.h>
 
 #include "main.h"
@@ -444,6 +445,7 @@ ui_read_input(struct convolveparams *p)
       {
         p->input=gal_array_read_one_ch_to_type(p->filename, p->cp.hdu, NULL,
                                                INPUT_USE_TYPE,
+                                               p->cp.numthreads,
                                                p->cp.minmapsize,
                                                p->cp.quietmmap);
         p->input->wcs=gal_wcs_read(p->filename, p->cp.hdu,
@@ -472,24 +474,58 @@ ui_read_kernel(struct convolveparams *p)
   /* Read the image into file. */
   if( p->kernelname
       && p->input->ndim>1
+      && p->kernelcolumn==NULL
       && gal_array_name_recognized(p->kernelname)  )
     {
-      p->kernel = gal_array_read_one_ch_to_type(p->kernelname, p->khdu,
-                                                NULL, INPUT_USE_TYPE,
-                                                p->cp.minmapsize,
-                                                p->cp.quietmmap);
-      p->kernel->ndim=gal_dimension_remove_extra(p->kernel->ndim,
-                                                 p->kernel->dsize,
-                                                 p->kernel->wcs);
+      /* When running under a server, the kernel may already be cached. */
+      p->kernel=gal_server_cache_find_data("convolve-kernel",
+                                           p->kernelname, p->khdu,
+                                           p->cp.minmapsize,
+                                           p->cp.quietmmap);
+      if(p->kernel==NULL)
+        {
+          p->kernel = gal_array_read_one_ch_to_type(p->kernelname, p->khdu,
+                                                    NULL, INPUT_USE_TYPE,
+                                                    p->cp.numthreads,
+                                                    p->cp.minmapsize,
+                                                    p->cp.quietmmap);
+          p->kernel->ndim=gal_dimension_remove_extra(p->kernel->ndim,
+                                                     p->kernel->dsize,
+                                                     p->kernel->wcs);
+          gal_server_cache_add_data("convolve-kernel", p->kernelname,
+                                    p->khdu, p->kernel);
+        }
     }
   else
     p->kernel=ui_read_column(p, 1);
 
-  /* Make sure that the kernel and input have the same number of
-     dimensions. */
-  if(p->kernel->ndim!=p->input->ndim)
-    error(EXIT_FAILURE, 0, "input datasets must have the same number of "
-          "dimensions");
+  /* The kernel can't have more dimensions than the input. */
+  if(p->kernel->ndim>p->input->ndim)
+    error(EXIT_FAILURE, 0, "%s: the kernel has %zu dimensions, but the "
+          "input has %zu. The kernel can't have more dimensions than the "
+          "input", gal_checkset_dataset_name(p->kernelname, p->khdu),
+          p->kernel->ndim, p->input->ndim);
+
+  /* When the kernel has fewer dimensions than the input, each slice/row
+     of the input (along its fastest dimensions) will be convolved
+     independently with the same kernel. This is only done in the spatial
+     domain. */
+  if(p->kernel->ndim<p->input->ndim)
+    {
+      if(p->makekernel)
+        error(EXIT_FAILURE, 0, "with '--makekernel', the input datasets "
+              "must have the same number of dimensions");
+      if(p->domain==CONVOLVE_DOMAIN_FREQUENCY && p->cp.quiet==0)
+        error(EXIT_SUCCESS, 0, "WARNING: the kernel (%s) has %zu "
+              "dimension(s), but the input has %zu, so every %s of the "
+              "input will be convolved independently. This is only "
+              "implemented in the spatial domain, so '--domain=frequency' "
+              "is ignored and the spatial domain is used",
+              gal_checkset_dataset_name(p->kernelname, p->khdu),
+              p->kernel->ndim, p->input->ndim,
+              p->kernel->ndim==1 ? "row" : "slice");
+      p->domain=CONVOLVE_DOMAIN_SPATIAL;
+    }
 }
 
 
@@ -520,42 +556,6 @@ ui_preparations(struct convolveparams *p)
           p->input->ndim);
 
 
-  /* Domain-specific checks. */
-  if(p->domain==CONVOLVE_DOMAIN_FREQUENCY)
-    {
-      /* Check the dimensionality. */
-      if(p->input->ndim!=2)
-        error(EXIT_FAILURE, 0, "%s (hdu %s) has %zu dimensions. Frequency "
-              "domain convolution currently only operates on 2D images",
-              p->filename, cp->hdu, p->input->ndim);
-
-      /* Blank values. */
-      if( gal_blank_present(p->input, 1) )
-        fprintf(stderr, "\n----------------------------------------\n"
-                "######## %s WARNING ########\n"
-                "There are blank pixels in '%s' (hdu: '%s') and you have "
-                "asked for frequency domain convolution. As a result, all "
-                "the pixels in the output ('%s') will be blank. Only "
-                "spatial domain convolution can account for blank pixels "
-                "in the input data. You can run %s again with "
-                "'--domain=spatial'\n"
-                "----------------------------------------\n\n",
-                PROGRAM_NAME, p->filename, cp->hdu, cp->output,
-                PROGRAM_NAME);
-
-      /* Frequency domain is only implemented in 2D. */
-      if( p->input->ndim==1 )
-        error(EXIT_FAILURE, 0, "Frequency domain convolution is currently "
-              "not implemented on 1D datasets. Please use '--domain=spatial' "
-              "to convolve this dataset");
-    }
-  else
-    {
-      if(p->input->ndim>1)
-        gal_tile_full_sanity_check(p->filename, cp->hdu, p->input, &cp->tl);
-    }
-
-
   /* Read the file specified by --kernel. If makekernel is specified, then
      this is actually the sharper image and the input image (given as an
      argument) is the blurry image. */
@@ -654,6 +654,48 @@ ui_preparations(struct convolveparams *p)
     }
 
 
+  /* Domain-specific checks. These are done after reading the kernel,
+     because a kernel with fewer dimensions than the input can only be
+     used in the spatial domain. */
+  if(p->domain==CONVOLVE_DOMAIN_FREQUENCY)
+    {
+      /* Check the dimensionality. */
+      if(p->input->ndim!=2)
+        error(EXIT_FAILURE, 0, "%s (hdu %s) has %zu dimensions. Frequency "
+              "domain convolution currently only operates on 2D images",
+              p->filename, cp->hdu, p->input->ndim);
+
+      /* Blank values. */
+      if( gal_blank_present(p->input, 1) )
+        fprintf(stderr, "\n----------------------------------------\n"
+                "######## %s WARNING ########\n"
+                "There are blank pixels in '%s' (hdu: '%s') and you have "
+                "asked for frequency domain convolution. As a result, all "
+                "the pixels in the output ('%s') will be blank. Only "
+                "spatial domain convolution can account for blank pixels "
+                "in the input data. You can run %s again with "
+                "'--domain=spatial'\n"
+                "----------------------------------------\n\n",
+                PROGRAM_NAME, p->filename, cp->hdu, cp->output,
+                PROGRAM_NAME);
+
+      /* Frequency domain is only implemented in 2D. */
+      if( p->input->ndim==1 )
+        error(EXIT_FAILURE, 0, "Frequency domain convolution is currently "
+              "not implemented on 1D datasets. Please use '--domain=spatial' "
+              "to convolve this dataset");
+    }
+
+
+  /* Spatial domain convolution with a kernel that has the same
+     dimensionality as the input is done over tiles (a kernel with fewer
+     dimensions is applied on each slice/row independently). */
+  if( p->domain==CONVOLVE_DOMAIN_SPATIAL
+      && p->input->ndim>1
+      && p->kernel->ndim==p->input->ndim )
+    gal_tile_full_sanity_check(p->filename, cp->hdu, p->input, &cp->tl);
+
+
   /* Set the output name if the user hasn't set it. */
   if(cp->output==NULL)
     cp->output=gal_checkset_automatic_output(cp, p->filename, outsuffix);
@@ -71,6 +71,19 @@ struct argp_option program_options[] =
       GAL_OPTIONS_NOT_MANDATORY,
       GAL_OPTIONS_NOT_SET
     },
+    {
+      "cacheinput",
+      UI_KEY_CACHEINPUT,
+      0,
+      0,
+      "Keep pixels of input image(s) in memory.",
+      GAL_OPTIONS_GROUP_INPUT,
+      &p->cacheinput,
+      GAL_OPTIONS_NO_ARG_TYPE,
+      GAL_OPTIONS_RANGE_0_OR_1,
+      GAL_OPTIONS_NOT_MANDATORY,
+      GAL_OPTIONS_NOT_SET
+    },
     {
       "zeroisnotblank",
       UI_KEY_ZEROISNOTBLANK,
@@ -128,6 +141,20 @@ struct argp_option program_options[] =
       GAL_OPTIONS_MANDATORY,
       GAL_OPTIONS_NOT_SET
     },
+    {
+      "singlefile",
+      UI_KEY_SINGLEFILE,
+      "STR",
+      0,
+      "All crops in one file: 'cube' or 'hdus'.",
+      GAL_OPTIONS_GROUP_OUTPUT,
+      &p->singlefile,
+      GAL_TYPE_STRING,
+      GAL_OPTIONS_RANGE_ANY,
+      GAL_OPTIONS_NOT_MANDATORY,
+      GAL_OPTIONS_NOT_SET,
+      ui_parse_singlefile
+    },
     {
       "oneelemstdout",
       UI_KEY_ONEELEMSTDOUT,
@@ -30,6 +30,8 @@ along with Gnuastro. If not, see <http://www.gnu.org/licenses/>.
 #include <stdlib.h>
 
 #include <gnuastro/fits.h>
+#include <gnuastro/blank.h>
+#include <gnuastro/table.h>
 #include <gnuastro/threads.h>
 #include <gnuastro/pointer.h>
 
@@ -63,7 +65,9 @@ crop_verbose_info(struct onecropparams *crp)
   filestatus = ( crp->centerfilled==0
                  ? ( crp->numimg == 0
                      ? "no overlap"
-                     : "removed (blank center)" )
+                     : ( crp->p->singlefile
+                         ? "blank center"
+                         : "removed (blank center)" ) )
                  : "created");
 
   /* Define the output string based on the length of the output file. */
@@ -195,6 +199,133 @@ crop_write_to_log(struct onecropparams *crp)
 
 
 
+/* Read all the pixels of an input image (when '--cacheinput' is
+   given). Like 'fits_read_subset' in 'onecrop', blank pixels are replaced
+   by the blank value of the type. */
+static void *
+crop_input_read(struct cropparams *p, size_t ind, fitsfile *fptr)
+{
+  void *out;
+  int status=0, anynul=0;
+  size_t i, size=1, ndim=p->imgs[ind].ndim;
+  long fpixel[MAXDIM]={1,1,1};
+
+  /* Allocate the space and read the pixels. */
+  for(i=0;i<ndim;++i) size*=p->imgs[ind].dsize[i];
+  out=gal_pointer_allocate(p->type, size, 0, __func__, "out");
+  if( fits_read_pix(fptr, gal_fits_type_to_datatype(p->type), fpixel,
+                    size, p->blankptrread, out, &anynul, &status) )
+    gal_fits_io_error(status, NULL);
+  return out;
+}
+
+
+
+
+
+/* Close the input image that is currently open in this thread. */
+static void
+crop_input_close(struct onecropparams *crp)
+{
+  int status=0;
+
+  if(crp->openind==GAL_BLANK_SIZE_T) return;
+  if( fits_close_file(crp->infits, &status) )
+    gal_fits_io_error(status, "could not close FITS file");
+  free(crp->cache);
+  crp->cache=NULL;
+  crp->infits=NULL;
+  crp->openind=GAL_BLANK_SIZE_T;
+}
+
+
+
+
+
+/* Make sure input image 'ind' is open in this thread. The crops are
+   sorted by their input image (see 'crop_sort_by_input'), so an image
+   usually stays open for many crops and its header is only parsed (and
+   its pixels are only read with '--cacheinput') once. */
+static void
+crop_input_open(struct onecropparams *crp, size_t ind)
+{
+  struct cropparams *p=crp->p;
+
+  if(crp->openind==ind) return;
+  crop_input_close(crp);
+  crp->infits=gal_fits_hdu_open_format(p->imgs[ind].name, p->cp.hdu, 0);
+  if(p->cacheinput) crp->cache=crop_input_read(p, ind, crp->infits);
+  crp->openind=ind;
+}
+
+
+
+
+
+/* With '--singlefile', the crop's pixels are kept in the memory of the
+   current batch of crops (initialized to blank). */
+static void
+crop_single_array(struct onecropparams *crp)
+{
+  struct cropparams *p=crp->p;
+
+  crp->outarray=NULL;
+  crp->firstin=GAL_BLANK_SIZE_T;
+  if(p->singlefile==0) return;
+  crp->outarray = ( (uint8_t *)(p->singlearray)
+                    + ( (crp->out_ind - p->singlefirst) * p->cropsize
+                        * gal_type_sizeof(p->type) ) );
+  gal_blank_initialize_array(crp->outarray, p->cropsize, p->type);
+}
+
+
+
+
+
+/* With '--singlefile', keep the information of this crop in the index
+   table (the columns are defined in 'ui_make_singleindex'). */
+static void
+crop_single_record(struct onecropparams *crp)
+{
+  gal_data_t *tmp;
+  size_t counter=0, ind=crp->out_ind;
+  struct inputimgs *img = ( crp->firstin==GAL_BLANK_SIZE_T
+                            ? NULL : &crp->p->imgs[crp->firstin] );
+
+  crp->p->singlein[ind]=crp->firstin;
+  for(tmp=crp->p->singleindex; tmp!=NULL; tmp=tmp->next)
+    switch(++counter)
+      {
+      case 1:
+        gal_checkset_allocate_copy(crp->name, &((char **)(tmp->array))[ind]);
+        break;
+
+      case 2:
+        ((uint16_t *)(tmp->array))[ind]=crp->numimg;
+        break;
+
+      case 3:
+        ((uint8_t *)(tmp->array))[ind]=crp->centerfilled;
+        break;
+
+      case 4:
+        gal_checkset_allocate_copy(img ? img->name : GAL_BLANK_STRING,
+                                   &((char **)(tmp->array))[ind]);
+        break;
+
+      /* The offset of the crop's first pixel in the first input along
+         each dimension. */
+      default:
+        ((int64_t *)(tmp->array))[ind] = ( img
+                                           ? crp->firstfpixel[counter-5]-1
+                                           : GAL_BLANK_INT64 );
+      }
+}
+
+
+
+
+
 static void *
 crop_mode_img(void *inparam)
 {
@@ -202,7 +333,7 @@ crop_mode_img(void *inparam)
   struct cropparams *p=crp->p;
 
   size_t i;
-  int status;
+  int status, overlap;
   struct inputimgs *img;
 
   /* In image mode, we always only have one image. */
@@ -220,14 +351,16 @@ crop_mode_img(void *inparam)
       crp->out_ind=crp->indexs[i];
       crp->outfits=NULL;
       crp->numimg=1;   /* In Image mode there is only one input image. */
+      crop_single_array(crp);
       onecrop_name(crp);
 
       /* Crop the image. */
-      onecrop(crp);
+      overlap=onecrop(crp);
 
-      /* If there was no overlap, then no FITS pointer is created, so
-         'numimg' should be set to zero. */
-      if(crp->outfits==NULL) crp->numimg=0;
+      /* If there was no overlap, then no FITS pointer (or pixels in
+         memory with '--singlefile') is created, so 'numimg' should be set
+         to zero. */
+      if( crp->outarray ? overlap==0 : crp->outfits==NULL ) crp->numimg=0;
 
       /* Check the final output: */
       if(crp->numimg)
@@ -236,27 +369,30 @@ crop_mode_img(void *inparam)
           crp->centerfilled=onecrop_center_filled(crp);
 
           /* Add the final headers and close output FITS image: */
-          gal_fits_key_write_version_in_ptr(NULL, NULL, crp->outfits);
-          status=0;
-          if( fits_close_file(crp->outfits, &status) )
-            gal_fits_io_error(status, "CFITSIO could not close "
-                              "the opened file");
-
-          /* Remove the output image if its center was not filled. */
-          if(crp->centerfilled==0)
+          if(crp->outfits)
             {
-              errno=0;
-              if(unlink(crp->name))
-                error(EXIT_FAILURE, errno, "can't delete %s (center"
-                      "was blank)", crp->name);
+              gal_fits_key_write_version_in_ptr(NULL, NULL, crp->outfits);
+              status=0;
+              if( fits_close_file(crp->outfits, &status) )
+                gal_fits_io_error(status, "CFITSIO could not close "
+                                  "the opened file");
+
+              /* Remove the output image if its center was not filled. */
+              if(crp->centerfilled==0)
+                {
+                  errno=0;
+                  if(unlink(crp->name))
+                    error(EXIT_FAILURE, errno, "can't delete %s (center"
+                          "was blank)", crp->name);
+                }
             }
-
         }
       else crp->centerfilled=0;
 
       /* Report the status on stdout if verbose mode is requested. */
-      if(!p->cp.quiet) crop_verbose_info(crp);
-      if(p->cp.log)    crop_write_to_log(crp);
+      if(!p->cp.quiet)    crop_verbose_info(crp);
+      if(p->cp.log)       crop_write_to_log(crp);
+      if(crp->outarray)   crop_single_record(crp);
     }
 
   /* Close the input image. */
@@ -281,10 +417,18 @@ crop_mode_wcs(void *inparam)
   struct onecropparams *crp=(struct onecropparams *)inparam;
   struct cropparams *p=crp->p;
 
-  size_t i;
+  size_t i, j;
   int status;
 
 
+  /* Allocate the thread's arrays for the candidate input images of each
+     crop (see 'wcsmode_candidates'). */
+  crp->candidates=gal_pointer_allocate(GAL_TYPE_SIZE_T, p->numin, 0,
+                                       __func__, "crp->candidates");
+  crp->marks=gal_pointer_allocate(GAL_TYPE_SIZE_T, p->numin, 1,
+                                  __func__, "crp->marks");
+
+
   /* Go over all the output objects for this thread. */
   for(i=0; crp->indexs[i]!=GAL_BLANK_SIZE_T; ++i)
     {
@@ -293,45 +437,42 @@ crop_mode_wcs(void *inparam)
       crp->outfits=NULL;
       crp->name=NULL;
       crp->numimg=0;
+      crop_single_array(crp);
 
 
       /* Set the sides of the crop in RA and Dec */
       wcsmode_crop_corners(crp);
 
 
-      /* Go over all the images to see if this target is within their
-         range or not. */
-      crp->in_ind=0;
-      do
-        if(wcsmode_overlap(crp))
-          {
-            /* Open the input FITS file. */
-            crp->infits=gal_fits_hdu_open_format(p->imgs[crp->in_ind].name,
-                                                 p->cp.hdu, 0);
-
-            /* If a name isn't set yet, set it. */
-            if(crp->name==NULL) onecrop_name(crp);
-
-            /* Increment the number of images used (necessary for the
-               header keywords that are written in 'onecrop'). Then do the
-               crop. However, the previously WCS-based overlap can be
-               slightly different from the final overlap, so if we finally
-               don't find any overlap we'll decrement the 'numimg'. */
-            ++crp->numimg;
-            if( onecrop(crp)==0 ) --crp->numimg;
-
-            /* Close the file. */
-            status=0;
-            if( fits_close_file(crp->infits, &status) )
-              gal_fits_io_error(status, "could not close FITS file");
-          }
-      while ( ++(crp->in_ind) < p->numin );
+      /* Go over the images that may contain this target (found with the
+         spatial index of the inputs) to see if it is within their range
+         or not. */
+      wcsmode_candidates(crp);
+      for(j=0;j<crp->numcandidates;++j)
+        {
+          crp->in_ind=crp->candidates[j];
+          if(wcsmode_overlap(crp))
+            {
+              /* Open the input FITS file (if it isn't already open). */
+              crop_input_open(crp, crp->in_ind);
+
+              /* If a name isn't set yet, set it. */
+              if(crp->name==NULL) onecrop_name(crp);
+
+              /* Increment the number of images used (necessary for the
+                 header keywords that are written in 'onecrop'). Then do the
+                 crop. However, the previously WCS-based overlap can be
+                 slightly different from the final overlap, so if we finally
+                 don't find any overlap we'll decrement the 'numimg'. */
+              ++crp->numimg;
+              if( onecrop(crp)==0 ) --crp->numimg;
+            }
+        }
 
 
-      /* Correct in_ind. The loop above went until 'in_ind' is one more
-         than the index for the last input image (that is how it exited the
-         loop). But 'crp->in_ind' is needed later, so correct it here. */
-      --crp->in_ind;
+      /* 'crp->in_ind' is needed later (for example for the output name
+         when no image overlapped), so set it to the last input image. */
+      crp->in_ind=p->numin-1;
 
 
       /* Check the final output: */
@@ -341,17 +482,20 @@ crop_mode_wcs(void *inparam)
           crp->centerfilled=onecrop_center_filled(crp);
 
           /* Write all the dependency versions and close the file. */
-          gal_fits_key_write_version_in_ptr(NULL, NULL, crp->outfits);
-          status=0;
-          if( fits_close_file(crp->outfits, &status) )
-            gal_fits_io_error(status, "CFITSIO could not close the "
-                                     "opened file");
-
-          if(crp->centerfilled==0)
+          if(crp->outfits)
             {
-              errno=0;
-              if(unlink(crp->name))
-                error(EXIT_FAILURE, errno, "%s", crp->name);
+              gal_fits_key_write_version_in_ptr(NULL, NULL, crp->outfits);
+              status=0;
+              if( fits_close_file(crp->outfits, &status) )
+                gal_fits_io_error(status, "CFITSIO could not close the "
+                                         "opened file");
+
+              if(crp->centerfilled==0)
+                {
+                  errno=0;
+                  if(unlink(crp->name))
+                    error(EXIT_FAILURE, errno, "%s", crp->name);
+                }
             }
         }
       else
@@ -363,10 +507,16 @@ crop_mode_wcs(void *inparam)
 
 
       /* Report the status on stdout if verbose mode is requested. */
-      if(!p->cp.quiet) crop_verbose_info(crp);
-      if(p->cp.log)    crop_write_to_log(crp);
+      if(!p->cp.quiet)    crop_verbose_info(crp);
+      if(p->cp.log)       crop_write_to_log(crp);
+      if(crp->outarray)   crop_single_record(crp);
     }
 
+  /* Clean up. */
+  crop_input_close(crp);
+  free(crp->marks);
+  free(crp->candidates);
+
   /* Wait until all other threads finish, then return. */
   if(p->cp.numthreads>1)
     pthread_barrier_wait(crp->b);
@@ -395,22 +545,81 @@ crop_mode_wcs(void *inparam)
 /*******************************************************************/
 /**************           Output function           ****************/
 /*******************************************************************/
-/* Main function for the Image Mode. It is assumed that if only one
-   crop box from each input image is desired, the first and last
-   pixels are already set, irrespective of how the user specified that
-   box.  */
-void
-crop(struct cropparams *p)
+/* In WCS-mode, sort the crops by the first input image they overlap
+   with, and give each thread a contiguous range of the sorted crops
+   (instead of the interleaved distribution of
+   'gal_threads_dist_in_threads'). Therefore each thread will mostly use a
+   small set of input images and many consecutive crops will come from the
+   same (open) input image. The number of crops in each thread is not
+   changed. Only the 'num' crops starting from 'first' are sorted. */
+static void
+crop_sort_by_input(struct cropparams *p, size_t *indexs, size_t thrdcols,
+                   size_t nt, size_t first, size_t num)
+{
+  struct onecropparams crp;
+  size_t i, j, k, t, *host, *order, *start;
+
+  /* Allocate the necessary arrays. */
+  crp.p=p;
+  host=gal_pointer_allocate(GAL_TYPE_SIZE_T, num, 0, __func__, "host");
+  order=gal_pointer_allocate(GAL_TYPE_SIZE_T, num, 0, __func__, "order");
+  start=gal_pointer_allocate(GAL_TYPE_SIZE_T, p->numin+2, 1, __func__,
+                             "start");
+  crp.candidates=gal_pointer_allocate(GAL_TYPE_SIZE_T, p->numin, 0,
+                                      __func__, "crp.candidates");
+  crp.marks=gal_pointer_allocate(GAL_TYPE_SIZE_T, p->numin, 1, __func__,
+                                 "crp.marks");
+
+  /* Find the first input image that overlaps with each crop (crops with
+     no overlap are given 'numin', so they go to the end). */
+  for(i=0;i<num;++i)
+    {
+      host[i]=p->numin;
+      crp.out_ind=first+i;
+      wcsmode_crop_corners(&crp);
+      wcsmode_candidates(&crp);
+      for(j=0;j<crp.numcandidates;++j)
+        {
+          crp.in_ind=crp.candidates[j];
+          if( wcsmode_overlap(&crp) ) { host[i]=crp.in_ind; break; }
+        }
+    }
+
+  /* Sort the crops by their input image (a counting sort, so crops of
+     the same input keep their original order). */
+  for(i=0;i<num;++i)       ++start[ host[i]+1 ];
+  for(i=0;i<=p->numin;++i) start[i+1] += start[i];
+  for(i=0;i<num;++i)       order[ start[host[i]]++ ] = first+i;
+
+  /* Put the sorted crops into the threads. */
+  j=0;
+  for(t=0;t<nt;++t)
+    for(k=0; indexs[t*thrdcols+k]!=GAL_BLANK_SIZE_T; ++k)
+      indexs[t*thrdcols+k]=order[j++];
+
+  /* Clean up. */
+  free(crp.candidates);
+  free(crp.marks);
+  free(start);
+  free(order);
+  free(host);
+}
+
+
+
+
+
+/* Do the 'num' crops starting from 'first' on all the threads. */
+static void
+crop_on_threads(struct cropparams *p, struct onecropparams *crp,
+                size_t first, size_t num)
 {
   int err=0;
-  char *tmp;
-  pthread_t t; /* We don't use the thread id, so all are saved here. */
   char *mmapname;
+  pthread_t t; /* We don't use the thread id, so all are saved here. */
   pthread_attr_t attr;
   pthread_barrier_t b;
-  struct onecropparams *crp;
   size_t i, *indexs, thrdcols;
-  gal_list_str_t *comments=NULL;
   size_t nt=p->cp.numthreads, nb;
   void *(*modefunction)(void *)=NULL;
 
@@ -419,20 +628,21 @@ crop(struct cropparams *p)
   modefunction = p->mode==IMGCROP_MODE_IMG ? &crop_mode_img : &crop_mode_wcs;
 
 
-  /* Allocate the array of structures to keep the thread and parameters for
-     each thread. */
-  errno=0;
-  crp=malloc(nt*sizeof *crp);
-  if(crp==NULL)
-    error(EXIT_FAILURE, errno, "%s: allocating %zu bytes for 'crp'",
-          __func__, nt*sizeof *crp);
+  /* Distribute the indexs into the threads (for clarity, this is needed
+     even if we only have one object). The distributed indexs start from
+     zero, so they are shifted to the first crop of this batch. */
+  mmapname=gal_threads_dist_in_threads(num, nt, p->cp.minmapsize,
+                                       p->cp.quietmmap, &indexs, &thrdcols);
+  if(first)
+    for(i=0;i<nt*thrdcols;++i)
+      if(indexs[i]!=GAL_BLANK_SIZE_T) indexs[i]+=first;
 
 
-  /* Distribute the indexs into the threads (for clarity, this is needed
-     even if we only have one object). */
-  mmapname=gal_threads_dist_in_threads(p->catname ? p->numout : 1, nt,
-                                       p->cp.minmapsize, p->cp.quietmmap,
-                                       &indexs, &thrdcols);
+  /* In WCS-mode, sort the crops by their input image. When the crops are
+     printed on the standard output, their order is kept. */
+  if(p->mode==IMGCROP_MODE_WCS && p->catname && num>1
+     && p->oneelemstdout==0)
+    crop_sort_by_input(p, indexs, thrdcols, nt, first, num);
 
 
   /* Run the job, if there is only one thread, don't go through the
@@ -449,8 +659,8 @@ crop(struct cropparams *p)
          (that spinns off the nt threads) is also a thread, so the
          number the barrier should be one more than the number of
          threads spinned off. */
-      if(p->numout<nt) nb=p->numout+1;
-      else             nb=nt+1;
+      if(num<nt) nb=num+1;
+      else       nb=nt+1;
       gal_threads_attr_barrier_init(&attr, &b, nb);
 
       /* Spin off the threads: */
@@ -473,6 +683,251 @@ crop(struct cropparams *p)
     }
 
 
+  /* Clean up. */
+  if(mmapname) gal_pointer_mmap_free(&mmapname, p->cp.quietmmap);
+  else         free(indexs);
+}
+
+
+
+
+
+/* Create a new image HDU in the single output file (with 'ndim'
+   dimensions of 'naxes' in FITS order) for the crop(s). */
+static void
+crop_single_hdu(struct cropparams *p, fitsfile *fptr, size_t ndim,
+                long *naxes, char *extname)
+{
+  int status=0, type=p->type;
+
+  /* Create the HDU and remove the two comments that CFITSIO adds (see
+     'onecrop_make_array'). */
+  if( fits_create_img(fptr, gal_fits_type_to_bitpix(type), ndim, naxes,
+                      &status) )
+    gal_fits_io_error(status, "creating image");
+  fits_delete_key(fptr, "COMMENT", &status);
+  fits_delete_key(fptr, "COMMENT", &status);
+  status=0;
+
+  /* Name of extension. */
+  fits_update_key(fptr, TSTRING, "EXTNAME", extname,
+                  "Name of HDU (extension).", &status);
+  gal_fits_io_error(status, "writing EXTNAME");
+
+  /* Write the blank value as a FITS keyword if necessary. */
+  if( type!=GAL_TYPE_FLOAT32 && type!=GAL_TYPE_FLOAT64 )
+    if(fits_write_key(fptr, gal_fits_type_to_datatype(type), "BLANK",
+                      p->blankptrwrite, "Pixels with no data.",
+                      &status) )
+      gal_fits_io_error(status, "adding Blank");
+}
+
+
+
+
+
+/* Open the single output file (for '--singlefile'). Like the separate
+   crops, unless '--primaryimghdu' is called, the first HDU is empty. With
+   '--singlefile=cube', the cube (with one slice per crop) is also created
+   here, it is filled as each batch of crops finishes. */
+static fitsfile *
+crop_single_open(struct cropparams *p)
+{
+  fitsfile *fptr;
+  int status=0;
+  size_t i, ndim=p->imgs->ndim;
+  long naxes[MAXDIM+1]={0,0,0,0};
+  char *output=p->cp.output;
+
+  /* Create (or open) the output. */
+  if(p->append==0)
+    gal_checkset_writable_remove(output, p->cp.keep, p->cp.dontdelete);
+  if(p->append==0 || gal_checkset_check_file_return(output)==0)
+    {
+      if( fits_create_file(&fptr, output, &status) )
+        gal_fits_io_error(status, "creating file");
+      if(p->primaryimghdu==0)
+        fits_create_img(fptr, SHORT_IMG, 0, naxes, &status);
+    }
+  else
+    fits_open_file(&fptr, output, READWRITE, &status);
+  gal_fits_io_error(status, NULL);
+
+  /* Create the cube. */
+  if(p->singlefile==IMGCROP_SINGLEFILE_CUBE)
+    {
+      for(i=0;i<ndim;++i) naxes[i]=p->iwidth[i];
+      naxes[ndim]=p->numout;
+      crop_single_hdu(p, fptr, ndim+1, naxes, p->metaname);
+    }
+  return fptr;
+}
+
+
+
+
+
+/* Write the 'num' crops starting from 'first' (that are in
+   'p->singlearray') into the single output file. */
+static void
+crop_single_write(struct cropparams *p, fitsfile *fptr, size_t first,
+                  size_t num)
+{
+  double crpix;
+  int status=0;
+  struct inputimgs *img;
+  gal_data_t *name, *offset, *tmp;
+  size_t i, d, ndim=p->imgs->ndim;
+  char cpname[FLEN_KEYWORD], *array=p->singlearray;
+  int datatype=gal_fits_type_to_datatype(p->type);
+  size_t cropbytes=p->cropsize*gal_type_sizeof(p->type);
+
+  /* In a cube, the batch is a contiguous set of slices. */
+  if(p->singlefile==IMGCROP_SINGLEFILE_CUBE)
+    {
+      if( fits_write_img(fptr, datatype, first*p->cropsize+1,
+                         num*p->cropsize, array, &status) )
+        gal_fits_io_error(status, "writing crops into cube");
+      return;
+    }
+
+  /* Each crop in its own HDU: find the name and offset columns of the
+     index table (see 'ui_make_singleindex'). */
+  name=p->singleindex;
+  offset=name->next->next->next->next;
+  for(i=first;i<first+num;++i)
+    {
+      /* Make the HDU and write the pixels. */
+      crop_single_hdu(p, fptr, ndim, p->iwidth,
+                      ((char **)(name->array))[i]);
+      if( fits_write_img(fptr, datatype, 1, p->cropsize,
+                         array+(i-first)*cropbytes, &status) )
+        gal_fits_io_error(status, "writing crop");
+
+      /* Write the WCS of the first input, corrected for the position of
+         this crop within it. */
+      img = ( p->singlein[i]==GAL_BLANK_SIZE_T
+              ? NULL : &p->imgs[p->singlein[i]] );
+      if(img && img->wcs)
+        {
+          gal_fits_key_write_wcsstr(fptr, img->wcs, img->wcstxt,
+                                    img->nwcskeys);
+          for(d=0, tmp=offset; d<ndim; ++d, tmp=tmp->next)
+            {
+              sprintf(cpname, "CRPIX%zu", d+1);
+              crpix = ( img->wcs->crpix[d]
+                        - ((int64_t *)(tmp->array))[i] );
+              fits_update_key(fptr, TDOUBLE, cpname, &crpix, NULL,
+                              &status);
+              gal_fits_io_error(status, NULL);
+            }
+        }
+      gal_fits_key_write_version_in_ptr(NULL, NULL, fptr);
+    }
+}
+
+
+
+
+
+/* Close the single output file and write the index table of the crops
+   into it (as the next HDU). */
+static void
+crop_single_close(struct cropparams *p, fitsfile *fptr)
+{
+  int status=0;
+
+  if(p->singlefile==IMGCROP_SINGLEFILE_CUBE)
+    gal_fits_key_write_version_in_ptr(NULL, NULL, fptr);
+  if( fits_close_file(fptr, &status) )
+    gal_fits_io_error(status, "CFITSIO could not close the opened file");
+  gal_table_write(p->singleindex, NULL, NULL, GAL_TABLE_FORMAT_BFITS,
+                  p->cp.output, "CROP-INDEX", 0, 1);
+}
+
+
+
+
+
+/* Main function for the Image Mode. It is assumed that if only one
+   crop box from each input image is desired, the first and last
+   pixels are already set, irrespective of how the user specified that
+   box.
+
+   With '--singlefile', the crops are done in batches of consecutive
+   crops: the threads put the pixels of each crop in memory and the crops
+   of each batch are written (in order) into the single output file
+   before the next batch starts. The size of the batches is limited by
+   'CROP_SINGLE_BATCH_BYTES' (but is never smaller than the number of
+   threads). */
+void
+crop(struct cropparams *p)
+{
+  char *tmp;
+  fitsfile *infits, *single=NULL;
+  int status;
+  void *cache=NULL;
+  struct onecropparams *crp;
+  gal_list_str_t *comments=NULL;
+  size_t i, first, num, batch, nt=p->cp.numthreads;
+
+
+  /* Allocate the array of structures to keep the thread and parameters for
+     each thread. */
+  errno=0;
+  crp=malloc(nt*sizeof *crp);
+  if(crp==NULL)
+    error(EXIT_FAILURE, errno, "%s: allocating %zu bytes for 'crp'",
+          __func__, nt*sizeof *crp);
+
+
+  /* Initialize the input image of each thread. In Image-mode, there is
+     only one input, so with '--cacheinput' its pixels are read once here
+     and used by all the threads. */
+  if(p->mode==IMGCROP_MODE_IMG && p->cacheinput)
+    {
+      infits=gal_fits_hdu_open_format(p->imgs[0].name, p->cp.hdu, 0);
+      cache=crop_input_read(p, 0, infits);
+      status=0;
+      if( fits_close_file(infits, &status) )
+        gal_fits_io_error(status, "could not close FITS file");
+    }
+  for(i=0;i<nt;++i)
+    {
+      crp[i].cache=cache;
+      crp[i].infits=NULL;
+      crp[i].openind=GAL_BLANK_SIZE_T;
+    }
+
+
+  /* Do the crops: when they should all go in one file, they are done in
+     batches (see the comments above this function), otherwise, all the
+     crops are done in one batch. */
+  if(p->singlefile)
+    {
+      for(p->cropsize=1, i=0; i<p->imgs->ndim; ++i)
+        p->cropsize *= p->iwidth[i];
+      batch=( CROP_SINGLE_BATCH_BYTES
+              / (p->cropsize*gal_type_sizeof(p->type)) );
+      if(batch<nt)        batch=nt;
+      if(batch>p->numout) batch=p->numout;
+      p->singlearray=gal_pointer_allocate(p->type, batch*p->cropsize, 0,
+                                          __func__, "p->singlearray");
+      single=crop_single_open(p);
+      for(first=0; first<p->numout; first+=num)
+        {
+          num = first+batch>p->numout ? p->numout-first : batch;
+          p->singlefirst=first;
+          crop_on_threads(p, crp, first, num);
+          crop_single_write(p, single, first, num);
+        }
+      crop_single_close(p, single);
+      free(p->singlearray);
+    }
+  else
+    crop_on_threads(p, crp, 0, p->catname ? p->numout : 1);
+
+
   /* Print the log file. */
   if(p->cp.log)
     {
@@ -490,8 +945,7 @@ crop(struct cropparams *p)
     }
 
   /* Print the final verbose info, save log, and clean up: */
-  if(mmapname) gal_pointer_mmap_free(&mmapname, p->cp.quietmmap);
-  else         free(indexs);
   crop_verbose_final(p);
+  free(cache);
   free(crp);
 }
@@ -41,6 +41,7 @@ along with Gnuastro. If not, see <http://www.gnu.org/licenses/>.
 #define LOGFILENAME             PROGRAM_EXEC".log"
 #define FILENAME_BUFFER_IN_VERB 30
 #define MAXDIM                  3
+#define CROP_SINGLE_BATCH_BYTES 268435456 /* 256MB */
 
 
 /* Modes to interpret coordinates. */
@@ -55,6 +56,18 @@ enum crop_modes
 
 
 
+/* Writing all crops into a single file. */
+enum crop_singlefile
+{
+  IMGCROP_SINGLEFILE_INVALID,   /* Not requested: one file per crop. */
+
+  IMGCROP_SINGLEFILE_CUBE,      /* All crops as slices of one cube.  */
+  IMGCROP_SINGLEFILE_HDUS,      /* Each crop in one HDU of the file. */
+};
+
+
+
+
 /* The sides of the image keep the celestial coordinates of the four
    sides of this image. With respect to the pixels they are. */
 struct inputimgs
@@ -69,6 +82,7 @@ struct inputimgs
   double     corners[24];  /* WCS of corners (24: for 3D, 8: for 2D).     */
   double   sized[MAXDIM];  /* Width and height of image in degrees.       */
   double  equatorcorr[2];  /* If image crosses the equator, see wcsmode.c.*/
+  double       bounds[4];  /* Min/max RA, min/max Dec of possible overlap.*/
 };
 
 
@@ -85,6 +99,7 @@ struct cropparams
   size_t               hendwcs;  /* Header keyword No. to end read WCS.   */
   int                     mode;  /* Image or WCS mode.                    */
   uint8_t       zeroisnotblank;  /* ==1: In float or double, keep 0.0.    */
+  uint8_t           cacheinput;  /* ==1: Keep input pixels in memory.     */
   uint8_t        primaryimghdu;  /* ==1: write in primary/0-th HDU.       */
   uint8_t               append;  /* If output exists, append crop.        */
   uint8_t              noblank;  /* ==1: no blank (out of image) pixels.  */
@@ -102,6 +117,7 @@ struct cropparams
   uint8_t           polygonout;  /* ==1: Keep the inner polygon region.   */
   uint8_t          polygonsort;  /* Don't sort polygon vertices.          */
   char               *metaname;  /* Output's EXTNAME keyword.             */
+  int                singlefile;  /* Write all crops in one file.          */
 
   /* Internal */
   size_t                 numin;  /* Number of input images.               */
@@ -120,6 +136,16 @@ struct cropparams
   void           *blankptrread;  /* Null value for reading of output type.*/
   void          *blankptrwrite;  /* Null value for writing of output type.*/
   struct inputimgs       *imgs;  /* WCS and size information for inputs.  */
+  size_t           *indexstart;  /* Index: first of each cell in indeximg.*/
+  size_t             *indeximg;  /* Index: input images in each cell.     */
+  size_t          indexsize[2];  /* Index: number of cells in RA and Dec. */
+  double           indexmin[2];  /* Index: minimum RA and Dec of grid.    */
+  double         indexwidth[2];  /* Index: width of cells in RA and Dec.  */
+  size_t              cropsize;  /* Single file: pixels in each crop.     */
+  size_t           singlefirst;  /* Single file: first crop in batch.     */
+  void            *singlearray;  /* Single file: pixels of batch's crops. */
+  gal_data_t      *singleindex;  /* Single file: index table of crops.    */
+  size_t             *singlein;  /* Single file: first input of crops.    */
   gal_data_t              *log;  /* Log file contents.                    */
   int            oneelemstdout;  /* Print one element crops on stdout.    */
 };
@@ -388,7 +388,16 @@ onecrop_name(struct onecropparams *crp)
   struct gal_options_common_params *cp=&p->cp;
 
   /* Set the output name and crop sides: */
-  if(p->catname)
+  if(p->catname && p->singlefile)
+    {
+      /* All crops go into one file, so the name is only an identifier
+         (used in the log and the index table of the crops). */
+      if(p->name)
+        gal_checkset_allocate_copy(p->name[crp->out_ind], &crp->name);
+      else if( asprintf(&crp->name, "%zu", crp->out_ind+1)<0 )
+        error(EXIT_FAILURE, 0, "%s: asprintf allocation", __func__);
+    }
+  else if(p->catname)
     {
       /* If a name column was set, use it, otherwise, use the ID of the
          profile. */
@@ -642,6 +651,63 @@ onecrop_make_array(struct onecropparams *crp, long *fpixel_i,
 
 
 
+/* Copy the region from 'fpixel_i' to 'lpixel_i' (in FITS order and
+   counting from 1) out of the cached pixels of the input image (with
+   'naxes' elements along each dimension). */
+static void
+onecrop_from_cache(struct onecropparams *crp, long *naxes, long *fpixel_i,
+                   long *lpixel_i, void *array)
+{
+  struct cropparams *p=crp->p;
+  size_t ndim=p->imgs[crp->in_ind].ndim;
+  size_t sizeof_type=gal_type_sizeof(p->type);
+  size_t j, k, rowbytes=(lpixel_i[0]-fpixel_i[0]+1)*sizeof_type;
+  size_t kstart = ndim==3 ? fpixel_i[2] : 1, kend = ndim==3 ? lpixel_i[2] : 1;
+  uint8_t *in=crp->cache, *out=array;
+
+  /* Go over the rows in the region and copy each. */
+  for(k=kstart;k<=kend;++k)
+    for(j=fpixel_i[1];j<=lpixel_i[1];++j)
+      {
+        memcpy(out, in + ( ( (k-1)*naxes[1] + (j-1) ) * naxes[0]
+                           + fpixel_i[0]-1 ) * sizeof_type, rowbytes);
+        out+=rowbytes;
+      }
+}
+
+
+
+
+
+/* With '--singlefile', copy the region of the input (in 'array') into
+   the pixels of the crop (from 'fpixel_o' to 'lpixel_o', in FITS order
+   and counting from 1). */
+static void
+onecrop_to_array(struct onecropparams *crp, void *array, long *fpixel_o,
+                 long *lpixel_o)
+{
+  struct cropparams *p=crp->p;
+  long *naxes=p->iwidth;
+  size_t ndim=p->imgs->ndim;
+  size_t sizeof_type=gal_type_sizeof(p->type);
+  size_t j, k, rowbytes=(lpixel_o[0]-fpixel_o[0]+1)*sizeof_type;
+  size_t kstart = ndim==3 ? fpixel_o[2] : 1, kend = ndim==3 ? lpixel_o[2] : 1;
+  uint8_t *in=array, *out=crp->outarray;
+
+  /* Go over the rows in the region and copy each. */
+  for(k=kstart;k<=kend;++k)
+    for(j=fpixel_o[1];j<=lpixel_o[1];++j)
+      {
+        memcpy(out + ( ( (k-1)*naxes[1] + (j-1) ) * naxes[0]
+                       + fpixel_o[0]-1 ) * sizeof_type, in, rowbytes);
+        in+=rowbytes;
+      }
+}
+
+
+
+
+
 /* The starting and ending points are set in the onecropparams structure
    for one crop from one image. Crop that region out of the input.
 
@@ -696,8 +762,19 @@ onecrop(struct onecropparams *crp)
 
       /* Make the output FITS image and initialize it with an array of NaN
          or BLANK values. But only when '--oneelemstdout' isn't called and
-         the output is single-element. */
-      if(crp->outfits==NULL && !( p->oneelemstdout && hasoneelem) )
+         the output is single-element. With '--singlefile', the output is
+         already in memory, so only keep the first input and position of
+         the crop within it (for the index table of the crops). */
+      if(crp->outarray)
+        {
+          if(crp->numimg==1)
+            {
+              crp->firstin=crp->in_ind;
+              memcpy(crp->firstfpixel, crp->fpixel,
+                     ndim*sizeof *crp->firstfpixel);
+            }
+        }
+      else if(crp->outfits==NULL && !( p->oneelemstdout && hasoneelem) )
         onecrop_make_array(crp, fpixel_i, lpixel_i, fpixel_o, lpixel_o);
       ofp=crp->outfits;
 
@@ -707,9 +784,11 @@ onecrop(struct onecropparams *crp)
       status=0;
       for(i=0;i<ndim;++i) cropsize *= ( lpixel_i[i] - fpixel_i[i] + 1 );
       array=gal_pointer_allocate(p->type, cropsize, 0, __func__, "array");
-      if(fits_read_subset(ifp, gal_fits_type_to_datatype(p->type),
-                          fpixel_i, lpixel_i, inc, p->blankptrread, array,
-                          &anynul, &status))
+      if(crp->cache)
+        onecrop_from_cache(crp, naxes, fpixel_i, lpixel_i, array);
+      else if(fits_read_subset(ifp, gal_fits_type_to_datatype(p->type),
+                               fpixel_i, lpixel_i, inc, p->blankptrread,
+                               array, &anynul, &status))
         gal_fits_io_error(status, NULL);
 
 
@@ -772,6 +851,12 @@ onecrop(struct onecropparams *crp)
         }
 
 
+      /* All crops are written in a single file: put the pixels in the
+         crop's array. */
+      else if(crp->outarray)
+        onecrop_to_array(crp, array, fpixel_o, lpixel_o);
+
+
       /* The output should be printed in standard output. */
       else
         {
@@ -828,8 +913,8 @@ onecrop_center_filled(struct onecropparams *crp)
   struct cropparams *p=crp->p;
 
   void *array;
-  size_t size, ndim, *dsize;
   fitsfile *ofp=crp->outfits;
+  size_t i, j, k, size, ndim, *dsize, sizeof_type;
   int status=0, anynul=0, type;
   long checkcenter=p->checkcenter;
   long naxes[3], fpixel[3], lpixel[3], inc[3]={1,1,1};
@@ -838,17 +923,26 @@ onecrop_center_filled(struct onecropparams *crp)
   if(checkcenter==0) return GAL_BLANK_UINT8;
 
   /* Get the final size of the output image. */
-  gal_fits_img_info(ofp, &type, &ndim, &dsize, NULL, NULL);
-  if(ndim==2)
+  if(crp->outarray)
     {
-      naxes[0]=dsize[1];
-      naxes[1]=dsize[0];
+      type=p->type;
+      ndim=p->imgs->ndim;
+      for(i=0;i<ndim;++i) naxes[i]=p->iwidth[i];
     }
   else
     {
-      naxes[0]=dsize[2];
-      naxes[1]=dsize[1];
-      naxes[2]=dsize[0];
+      gal_fits_img_info(ofp, &type, &ndim, &dsize, NULL, NULL);
+      if(ndim==2)
+        {
+          naxes[0]=dsize[1];
+          naxes[1]=dsize[0];
+        }
+      else
+        {
+          naxes[0]=dsize[2];
+          naxes[1]=dsize[1];
+          naxes[2]=dsize[0];
+        }
     }
 
   /* Get the size and range of the central region to check. The +1 is
@@ -882,6 +976,20 @@ onecrop_center_filled(struct onecropparams *crp)
          lpixel[0], lpixel[1], size);
   */
 
+  /* With '--singlefile', check the pixels in memory. */
+  if(crp->outarray)
+    {
+      sizeof_type=gal_type_sizeof(type);
+      for(k=(ndim==3?fpixel[2]:1); k<=(ndim==3?lpixel[2]:1); ++k)
+        for(j=fpixel[1];j<=lpixel[1];++j)
+          for(i=fpixel[0];i<=lpixel[0];++i)
+            if( gal_blank_is( (uint8_t *)(crp->outarray)
+                              + ( ( (k-1)*naxes[1] + (j-1) ) * naxes[0]
+                                  + (i-1) ) * sizeof_type, type ) )
+              return 0;
+      return 1;
+    }
+
   /* Allocate the array and read in the pixels. */
   array=gal_pointer_allocate(type, size, 0, __func__, "array");
   if( fits_read_subset(ofp, gal_fits_type_to_datatype(type), fpixel, lpixel,
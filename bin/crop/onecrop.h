@@ -37,6 +37,8 @@ struct onecropparams
   /* About input image. */
   size_t              in_ind;  /* Index of this image in the input names.  */
   fitsfile           *infits;  /* Pointer to the input FITS image.         */
+  size_t             openind;  /* Index of the open input in 'infits'.     */
+  void                *cache;  /* All pixels of input ('--cacheinput').    */
   long        fpixel[MAXDIM];  /* Position of first pixel in input image.  */
   long        lpixel[MAXDIM];  /* Position of last pixel in input image.   */
   double           *ipolygon;  /* Input image based polygon vertices.      */
@@ -47,7 +49,13 @@ struct onecropparams
   double       sized[MAXDIM];  /* Width and height of image in degrees.    */
   double         corners[24];  /* RA and Dec of this crop's corners.       */
   double      equatorcorr[2];  /* Crop crosses the equator, see wcsmode.c. */
+  size_t         *candidates;  /* Input images that may overlap the crop.  */
+  size_t       numcandidates;  /* Number of elements in 'candidates'.      */
+  size_t              *marks;  /* Last crop each input was a candidate for.*/
   fitsfile          *outfits;  /* Pointer to the output FITS image.        */
+  void             *outarray;  /* Crop's pixels (with '--singlefile').     */
+  size_t             firstin;  /* First input used in crop ('--singlefile')*/
+  long   firstfpixel[MAXDIM];  /* Crop's first pixel in 'firstin'.         */
 
   /* For log */
   char                 *name;  /* Filename of crop.                        */
@@ -216,6 +216,40 @@ parse_opt(int key, char *arg, struct argp_state *state)
 
 
 
+/* Parse the value to '--singlefile'. */
+void *
+ui_parse_singlefile(struct argp_option *option, char *arg,
+                    char *filename, size_t lineno, void *junk)
+{
+  char *outstr;
+
+  /* We want to print the stored values. */
+  if(lineno==-1)
+    {
+      gal_checkset_allocate_copy( ( *(int *)(option->value)
+                                    ==IMGCROP_SINGLEFILE_CUBE
+                                    ? "cube" : "hdus" ), &outstr );
+      return outstr;
+    }
+  else
+    {
+      if      (!strcmp(arg, "cube"))
+        *(int *)(option->value)=IMGCROP_SINGLEFILE_CUBE;
+      else if (!strcmp(arg, "hdus"))
+        *(int *)(option->value)=IMGCROP_SINGLEFILE_HDUS;
+      else
+        error_at_line(EXIT_FAILURE, 0, filename, lineno, "'%s' (value to "
+                      "'--singlefile') not recognized. Recognized values "
+                      "are 'cube' (all crops as slices of one 3D cube) and "
+                      "'hdus' (each crop in a separate HDU)", arg);
+      return NULL;
+    }
+}
+
+
+
+
+
 /* Parse the mode to interpret the given coordinates. */
 void *
 ui_parse_coordinate_mode(struct argp_option *option, char *arg,
@@ -462,6 +496,28 @@ ui_check_options_and_arguments(struct cropparams *p)
     error(EXIT_FAILURE, 0, "in image mode, only one input image may be "
           "specified");
 
+  /* All the crops can only be written in a single file when they come
+     from a catalog and have the same size. */
+  if(p->singlefile)
+    {
+      if(p->catname==NULL)
+        error(EXIT_FAILURE, 0, "'--singlefile' is only relevant when the "
+              "crops are defined by a catalog (with '--catalog')");
+      if(p->oneelemstdout)
+        error(EXIT_FAILURE, 0, "'--singlefile' and '--oneelemstdout' "
+              "cannot be called together");
+      if(p->noblank && p->mode==IMGCROP_MODE_IMG)
+        error(EXIT_FAILURE, 0, "'--singlefile' and '--noblank' cannot "
+              "be called together: all the crops in a single file must "
+              "have the same size");
+
+      /* The output is a file, if it isn't given, use the first input's
+         name. */
+      if(p->cp.output==NULL)
+        p->cp.output=gal_checkset_automatic_output(&p->cp, p->inputs->v,
+                                                   p->suffix);
+    }
+
   /* If no output name is given, set it to the current directory. */
   if(p->cp.output==NULL)
     gal_checkset_allocate_copy("./", &p->cp.output);
@@ -499,8 +555,10 @@ ui_check_options_and_arguments(struct cropparams *p)
         }
 #endif
 
-      /* Make sure the given output is a directory. */
-      gal_checkset_check_dir_write_add_slash(&p->cp.output);
+      /* Make sure the given output is a directory (unless all the crops
+         should be written in a single file). */
+      if(p->singlefile==0)
+        gal_checkset_check_dir_write_add_slash(&p->cp.output);
     }
   else
     {
@@ -869,6 +927,70 @@ ui_make_log(struct cropparams *p)
 
 
 
+/* With '--singlefile', the index table of the crops (written as a table
+   HDU after the crops). Like the log, since this is a linked list, we
+   have to add the columns in the opposite order. */
+static void
+ui_make_singleindex(struct cropparams *p)
+{
+  char *name, *comment;
+  size_t i, ndim=p->imgs->ndim;
+
+  /* Return if all the crops aren't to be written in one file. */
+  if(p->singlefile==0) return;
+
+  /* Position of the crop's first pixel in the first input. */
+  for(i=ndim;i>0;--i)
+    {
+      if( asprintf(&name, "OFFSET_%zu", i)<0
+          || asprintf(&comment, "Crop's pixel X%zu is pixel X%zu+OFFSET_%zu "
+                      "in INPUT.", i, i, i)<0 )
+        error(EXIT_FAILURE, 0, "%s: asprintf allocation", __func__);
+      gal_list_data_add_alloc(&p->singleindex, NULL, GAL_TYPE_INT64, 1,
+                              &p->numout, NULL, 1, p->cp.minmapsize,
+                              p->cp.quietmmap, name, "pixel", comment);
+      free(comment);
+      free(name);
+    }
+
+  /* First input that was used in the crop. */
+  gal_list_data_add_alloc(&p->singleindex, NULL, GAL_TYPE_STRING, 1,
+                          &p->numout, NULL, 1, p->cp.minmapsize,
+                          p->cp.quietmmap, "INPUT", "name",
+                          "First input dataset used in this crop.");
+
+  /* Column to specify if the central pixels are filled. */
+  if( asprintf(&comment, "Are the central pixels filled? (1: yes, 0: no, "
+               "%u: not checked)", GAL_BLANK_UINT8)<0 )
+    error(EXIT_FAILURE, 0, "%s: asprintf allocation", __func__);
+  gal_list_data_add_alloc(&p->singleindex, NULL, GAL_TYPE_UINT8, 1,
+                          &p->numout, NULL, 1, p->cp.minmapsize,
+                          p->cp.quietmmap, "CENTER_FILLED", "bool",
+                          comment);
+  free(comment);
+
+  /* Number of datasets used in this crop. */
+  gal_list_data_add_alloc(&p->singleindex, NULL, GAL_TYPE_UINT16, 1,
+                          &p->numout, NULL, 1, p->cp.minmapsize,
+                          p->cp.quietmmap, "NUM_INPUTS", "count",
+                          "Number of input datasets used to make this "
+                          "crop.");
+
+  /* Name of the crop (the row number when no name column is given). */
+  gal_list_data_add_alloc(&p->singleindex, NULL, GAL_TYPE_STRING, 1,
+                          &p->numout, NULL, 1, p->cp.minmapsize,
+                          p->cp.quietmmap, "CROP_NAME", "name",
+                          "Name (or row number) of crop in catalog.");
+
+  /* Index of the first input of each crop (only used internally). */
+  p->singlein=gal_pointer_allocate(GAL_TYPE_SIZE_T, p->numout, 0, __func__,
+                                   "p->singlein");
+}
+
+
+
+
+
 /* When there is a single image, to avoid complications in the WCS checks,
    simply convert all the values to pixels and switch to image mode. */
 void
@@ -962,7 +1084,7 @@ ui_preparations_to_img_mode_values(struct cropparams *p)
                                 NULL, NULL, NULL);
 
       /* Convert the world coordinates to image coordinates. */
-      gal_wcs_world_to_img(coords, wcs, 1);
+      gal_wcs_world_to_img(coords, wcs, 1, p->cp.numthreads);
 
       /* Clean up: we want the 'array' elements, so we'll set them to
          NULL first, then clean up the list. */
@@ -1124,6 +1246,17 @@ ui_preparations(struct cropparams *p)
     }
 
 
+  /* In WCS mode, build the spatial index of the inputs. */
+  if(p->mode==IMGCROP_MODE_WCS) wcsmode_index(p);
+
+
+  /* A cube of crops is only possible from 2D inputs. */
+  if(p->singlefile==IMGCROP_SINGLEFILE_CUBE && p->imgs->ndim!=2)
+    error(EXIT_FAILURE, 0, "'--singlefile=cube' is only possible with 2D "
+          "inputs, but the inputs are %zuD. Please use "
+          "'--singlefile=hdus'", p->imgs->ndim);
+
+
   /* Polygon cropping is currently only supported on 2D */
   if(p->imgs->ndim!=2 && p->polygon)
     error(EXIT_FAILURE, 0, "%s: polygon cropping is currently only "
@@ -1149,6 +1282,10 @@ ui_preparations(struct cropparams *p)
 
   /* Prepare the log file if the user has asked for it. */
   ui_make_log(p);
+
+
+  /* Prepare the index table when all crops go into one file. */
+  ui_make_singleindex(p);
 }
 
 
@@ -1292,6 +1429,8 @@ ui_free_report(struct cropparams *p, struct timeval *t1)
   if(p->cp.hdu) free(p->cp.hdu);
   if(p->cathdu) free(p->cathdu);
   if(p->catname) free(p->catname);
+  free(p->indexstart);
+  free(p->indeximg);
 
   /* The arguments (note that the values were not allocated). */
   gal_list_str_free(p->inputs, 0);
@@ -1306,6 +1445,11 @@ ui_free_report(struct cropparams *p, struct timeval *t1)
 
   /* Free the log information. */
   if(p->cp.log) gal_list_data_free(p->log);
+  if(p->singlefile)
+    {
+      gal_list_data_free(p->singleindex);
+      free(p->singlein);
+    }
 
   /* Print the final message. */
   if(!p->cp.quiet)
@@ -76,6 +76,8 @@ enum option_keys_enum
   UI_KEY_POLYGONSORT,
   UI_KEY_CHECKCENTER,
   UI_KEY_PRIMARYIMGHDU,
+  UI_KEY_CACHEINPUT,
+  UI_KEY_SINGLEFILE,
 };
 
 
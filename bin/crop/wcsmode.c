@@ -46,6 +46,273 @@ along with Gnuastro. If not, see <http://www.gnu.org/licenses/>.
 
 
 
+/*******************************************************************/
+/************       Spatial index of input images     **************/
+/*******************************************************************/
+/* The overlap of a crop with all the input images is checked with the
+   corner tests of 'wcsmode_overlap'. When there are many input images,
+   most of the time is spent on rejecting images that are far from the
+   crop. So a grid over the RA and Dec of the inputs is built and each
+   crop is only checked against the images in the grid cells it touches.
+
+   The grid is built on the same RA and Dec values that are used in
+   'point_in_dataset' (not a fixed 0 to 360 degree range), so images that
+   are around RA=0 (with corners on both sides of it) don't need any
+   special treatment: they just extend the range of the grid. */
+
+/* Small margin to add to the range, so floating point errors can never
+   remove a real overlap. */
+#define WCSMODE_INDEX_MARGIN 1e-6
+
+
+
+
+/* Set the range of RA and Dec (in 'bounds': min RA, max RA, min Dec, max
+   Dec) that any point inside the region of a dataset (as defined in
+   'point_in_dataset', with 'i', 's' and 'c') or any of its corners can
+   have. Therefore, if two datasets overlap in 'wcsmode_overlap', their
+   ranges will also overlap. */
+static void
+wcsmode_bounds(double *i, double *s, double *c, size_t ndim,
+               double *bounds)
+{
+  size_t k, ncorners = ndim==2 ? 4 : 8;
+  double n, cosd, ra[2], dmax=i[1]+s[1];
+
+  /* Range of the corners. */
+  bounds[0] = bounds[2] = INFINITY;
+  bounds[1] = bounds[3] = -INFINITY;
+  for(k=0;k<ncorners;++k)
+    {
+      if(i[k*ndim]  <bounds[0]) bounds[0]=i[k*ndim];
+      if(i[k*ndim]  >bounds[1]) bounds[1]=i[k*ndim];
+      if(i[k*ndim+1]<bounds[2]) bounds[2]=i[k*ndim+1];
+      if(i[k*ndim+1]>bounds[3]) bounds[3]=i[k*ndim+1];
+    }
+
+  /* Declination range of the region. */
+  if(i[1]<bounds[2]) bounds[2]=i[1];
+  if(dmax>bounds[3]) bounds[3]=dmax;
+
+  /* RA range of the region. In the southern hemisphere, the range only
+     becomes narrower than the first pixel's range. In the northern
+     hemisphere, it is widest on the largest declination. */
+  if(i[1]<=0)
+    {
+      if(i[0]-s[0]<bounds[0]) bounds[0]=i[0]-s[0];
+      if(i[0]     >bounds[1]) bounds[1]=i[0];
+    }
+  if(dmax>0)
+    {
+      /* When the region touches the equator (but doesn't cross it), the
+         equator corrections aren't set, so don't limit the RA. */
+      ra[0]=-INFINITY;
+      ra[1]=INFINITY;
+      if( i[1]*dmax > 0 )                /* Doesn't cross the equator. */
+        {
+          cosd=cos((dmax-i[1])*M_PI/180);
+          if(cosd>0)
+            {
+              n=0.5f*s[0]*( 1/cosd - 1 );
+              ra[0]=i[0]-s[0]-n;
+              ra[1]=i[0]+n;
+            }
+        }
+      else if( i[1]*dmax < 0 )                 /* Crosses the equator. */
+        {
+          cosd=cos(dmax*M_PI/180);
+          if(cosd>0)
+            {
+              n=0.5f*c[1]*( 1/cosd - 1 );
+              ra[0]=c[0]-c[1]-n;
+              ra[1]=c[0]+n;
+            }
+        }
+      if(ra[0]<bounds[0]) bounds[0]=ra[0];
+      if(ra[1]>bounds[1]) bounds[1]=ra[1];
+    }
+
+  /* Add the margin. */
+  bounds[0]-=WCSMODE_INDEX_MARGIN;   bounds[1]+=WCSMODE_INDEX_MARGIN;
+  bounds[2]-=WCSMODE_INDEX_MARGIN;   bounds[3]+=WCSMODE_INDEX_MARGIN;
+}
+
+
+
+
+
+/* Set the first and last cell (along both dimensions) that the given
+   range covers. Ranges beyond the grid are clamped to its edge cells. */
+static void
+wcsmode_index_cells(struct cropparams *p, double *bounds, size_t *first,
+                    size_t *last)
+{
+  size_t d;
+  double lo, hi, nmax;
+
+  for(d=0;d<2;++d)
+    {
+      nmax=p->indexsize[d]-1;
+      lo=(bounds[2*d]  -p->indexmin[d])/p->indexwidth[d];
+      hi=(bounds[2*d+1]-p->indexmin[d])/p->indexwidth[d];
+      first[d] = lo<=0 ? 0 : ( lo>=nmax ? nmax : (size_t)lo );
+      last[d]  = hi<=0 ? 0 : ( hi>=nmax ? nmax : (size_t)hi );
+    }
+}
+
+
+
+
+
+/* Build the grid over the inputs. The width of each cell is the average
+   size of the input images (so each image is only in a few cells), but
+   the total number of cells is limited to a few times the number of
+   inputs. */
+void
+wcsmode_index(struct cropparams *p)
+{
+  double *b, size;
+  size_t d, i, x, y, c, numcells, *counts;
+  size_t first[2], last[2], numfinite[2]={0,0};
+  double min[2]={INFINITY, INFINITY}, max[2]={-INFINITY, -INFINITY};
+
+  /* Find the range of the grid and the average size of the images (only
+     using finite ranges). */
+  p->indexwidth[0]=p->indexwidth[1]=0;
+  for(i=0;i<p->numin;++i)
+    for(d=0;d<2;++d)
+      {
+        b=p->imgs[i].bounds;
+        if( isfinite(b[2*d]) && isfinite(b[2*d+1]) )
+          {
+            ++numfinite[d];
+            if(b[2*d]  <min[d]) min[d]=b[2*d];
+            if(b[2*d+1]>max[d]) max[d]=b[2*d+1];
+            p->indexwidth[d] += b[2*d+1] - b[2*d];
+          }
+      }
+
+  /* Set the number of cells along each dimension. */
+  for(d=0;d<2;++d)
+    {
+      if(numfinite[d]==0) { min[d]=max[d]=0; p->indexwidth[d]=1; }
+      else                p->indexwidth[d] /= numfinite[d];
+      p->indexmin[d]=min[d];
+      size=max[d]-min[d];
+      if( p->indexwidth[d] < size*1e-6 ) p->indexwidth[d]=size*1e-6;
+      if( p->indexwidth[d]<=0 )          p->indexwidth[d]=1;
+    }
+  do
+    {
+      for(d=0;d<2;++d)
+        p->indexsize[d] = (max[d]-min[d])/p->indexwidth[d] + 1;
+      if( p->indexsize[0]*p->indexsize[1] > 4*p->numin )
+        { p->indexwidth[0]*=2; p->indexwidth[1]*=2; }
+    }
+  while( p->indexsize[0]*p->indexsize[1] > 4*p->numin );
+  numcells=p->indexsize[0]*p->indexsize[1];
+
+  /* Count the number of images in each cell (in 'indexstart[c+1]'). */
+  p->indexstart=gal_pointer_allocate(GAL_TYPE_SIZE_T, numcells+1, 1,
+                                     __func__, "p->indexstart");
+  for(i=0;i<p->numin;++i)
+    {
+      wcsmode_index_cells(p, p->imgs[i].bounds, first, last);
+      for(y=first[1];y<=last[1];++y)
+        for(x=first[0];x<=last[0];++x)
+          ++p->indexstart[ y*p->indexsize[0] + x + 1 ];
+    }
+
+  /* Convert the counts to the first element of each cell, then put the
+     images in each cell (in the same order as the inputs). */
+  for(c=0;c<numcells;++c) p->indexstart[c+1] += p->indexstart[c];
+  p->indeximg=gal_pointer_allocate(GAL_TYPE_SIZE_T, p->indexstart[numcells],
+                                   0, __func__, "p->indeximg");
+  counts=gal_pointer_allocate(GAL_TYPE_SIZE_T, numcells, 1, __func__,
+                              "counts");
+  for(i=0;i<p->numin;++i)
+    {
+      wcsmode_index_cells(p, p->imgs[i].bounds, first, last);
+      for(y=first[1];y<=last[1];++y)
+        for(x=first[0];x<=last[0];++x)
+          {
+            c = y*p->indexsize[0] + x;
+            p->indeximg[ p->indexstart[c] + counts[c]++ ] = i;
+          }
+    }
+
+  /* Clean up. */
+  free(counts);
+}
+
+
+
+
+
+/* Find the input images that may overlap with this crop (in increasing
+   order, so the inputs are used in the same order as before), and put
+   them in 'crp->candidates'. This function should be called after
+   'wcsmode_crop_corners'. */
+void
+wcsmode_candidates(struct onecropparams *crp)
+{
+  double bounds[4], *b;
+  struct cropparams *p=crp->p;
+  size_t j, k, x, y, c, img, first[2], last[2];
+
+  /* Find the range of the crop and the cells it covers. */
+  wcsmode_bounds(crp->corners, crp->sized, crp->equatorcorr,
+                 p->imgs->ndim, bounds);
+  wcsmode_index_cells(p, bounds, first, last);
+
+  /* Go over the images in the cells. An image may be in more than one
+     cell, so 'marks' is used to only add it once for each crop. */
+  crp->numcandidates=0;
+  for(y=first[1];y<=last[1];++y)
+    for(x=first[0];x<=last[0];++x)
+      {
+        c = y*p->indexsize[0] + x;
+        for(k=p->indexstart[c]; k<p->indexstart[c+1]; ++k)
+          {
+            img=p->indeximg[k];
+            if( crp->marks[img] == crp->out_ind+1 ) continue;
+            crp->marks[img] = crp->out_ind+1;
+
+            /* Only keep the images whose range overlaps with the crop. */
+            b=p->imgs[img].bounds;
+            if( b[0]>bounds[1] || b[1]<bounds[0]
+                || b[2]>bounds[3] || b[3]<bounds[2] )
+              continue;
+
+            /* Insert it in its sorted position (there are only a few
+             candidates, so a simple insertion is enough). */
+            for(j=crp->numcandidates++;
+                j>0 && crp->candidates[j-1]>img; --j)
+              crp->candidates[j]=crp->candidates[j-1];
+            crp->candidates[j]=img;
+          }
+      }
+}
+
+
+
+
+
+
+
+
+
+
+
+
+
+
+
+
+
+
+
+
 /*******************************************************************/
 /****************        Check for ui.c        *********************/
 /*******************************************************************/
@@ -202,6 +469,12 @@ wcsmode_check_prepare(struct cropparams *p, struct inputimgs *img)
     }
 
 
+  /* Set the range of RA and Dec that may overlap with a crop (used in
+     the spatial index of the inputs). */
+  wcsmode_bounds(img->corners, img->sized, img->equatorcorr, ndim,
+                 img->bounds);
+
+
   /* Just to check:
   printf("\n\n%s:\n", img->name);
   if(ndim==2)
@@ -463,7 +736,7 @@ fillcrpipolygon(struct onecropparams *crp)
 
 
   /* Convert them to image coordinates. */
-  gal_wcs_world_to_img(coords, p->imgs[crp->in_ind].wcs, 1);
+  gal_wcs_world_to_img(coords, p->imgs[crp->in_ind].wcs, 1, 1);
 
 
   /* Allocate the image polygon array, and put the image polygon vertice
@@ -23,6 +23,12 @@ along with Gnuastro. If not, see <http://www.gnu.org/licenses/>.
 #ifndef WCSMODE_H
 #define WCSMODE_H
 
+void
+wcsmode_index(struct cropparams *p);
+
+void
+wcsmode_candidates(struct onecropparams *crp);
+
 void
 wcsmode_check_prepare(struct cropparams *p, struct inputimgs *img);
 
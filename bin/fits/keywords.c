@@ -594,8 +594,8 @@ keywords_wcs_convert(struct fitsparams *p)
       /* If the number of dimensions is two, then read the dataset,
          otherwise, ignore it. */
       if(ndim==2)
-        data=gal_fits_img_read(p->input->v, p->cp.hdu, p->cp.minmapsize,
-                               p->cp.quietmmap);
+        data=gal_fits_img_read(p->input->v, p->cp.hdu, p->cp.numthreads,
+                               p->cp.minmapsize, p->cp.quietmmap);
     }
 
   /* Read the input's WCS and make sure one exists. */
@@ -987,7 +987,8 @@ keywords_value(struct fitsparams *p)
   /* Write the values. */
   gal_checkset_writable_remove(p->cp.output, 0, p->cp.dontdelete);
   gal_table_write(out, NULL, NULL, p->cp.tableformat,
-                  p->cp.output, "KEY-VALUES", p->colinfoinstdout);
+                  p->cp.output, "KEY-VALUES", p->colinfoinstdout,
+                  p->cp.numthreads);
 
   /* Clean up. */
   gal_list_str_free(p->keyvalue, 0);
@@ -173,7 +173,8 @@ match_catalog_permute_inplace(struct matchparams *p, gal_data_t *in,
          strings that will be over-written need to be freed
          first. */
       numnotmatched = in->size - nummatched;
-      if(in->type==GAL_TYPE_STRING)
+      if(in->type==GAL_TYPE_STRING
+         && (in->flag & GAL_DATA_FLAG_STRARENA)==0 )
         {
           strarr=in->array;
           for(i=0;i<nummatched;++i)
@@ -203,8 +204,10 @@ match_catalog_permute_inplace(struct matchparams *p, gal_data_t *in,
   else
     {
       /* If we are on a string column, free the allocated space
-         for each element that should be removed. */
-      if(in->type==GAL_TYPE_STRING)
+         for each element that should be removed (when the strings are
+         in one allocation, they are freed with the array). */
+      if(in->type==GAL_TYPE_STRING
+         && (in->flag & GAL_DATA_FLAG_STRARENA)==0 )
         {
           strarr=in->array;
           for(i=nummatched;i<in->size;++i)
@@ -402,7 +405,7 @@ match_catalog_read_write_all(struct matchparams *p, size_t *permutation,
     {
       /* Write the catalog to a file. */
       gal_table_write(cat, NULL, NULL, p->cp.tableformat, outname,
-                      extname, 0);
+                      extname, 0, p->cp.numthreads);
 
       /* Clean up. */
       gal_list_data_free(cat);
@@ -456,7 +459,11 @@ match_catalog_write_one_row(struct matchparams *p, gal_data_t *a,
                                   p->cp.quietmmap, ta->name, ta->unit,
                                   ta->comment);
 
-          /* Copy the data of the first and second inputs in output. */
+          /* Copy the data of the first and second inputs in output
+             (strings in a single allocation are separated first, since
+             their pointers are moved into the output). */
+          gal_data_string_separate(ta);
+          gal_data_string_separate(tb);
           memcpy(cat->array, ta->array,
                  ta->size*gal_type_sizeof(ta->type));
           memcpy(gal_pointer_increment(cat->array, ta->size, cat->type),
@@ -478,7 +485,7 @@ match_catalog_write_one_row(struct matchparams *p, gal_data_t *a,
       /* Reverse the table and write it out. */
       gal_list_data_reverse(&cat);
       gal_table_write(cat, NULL, NULL, p->cp.tableformat,
-                      p->out1name, "MATCHED", 0);
+                      p->out1name, "MATCHED", 0, p->cp.numthreads);
       gal_list_data_free(cat);
     }
 
@@ -486,7 +493,7 @@ match_catalog_write_one_row(struct matchparams *p, gal_data_t *a,
      it ('a' will be freed in the higher-level function). */
   else
     gal_table_write(a, NULL, NULL, p->cp.tableformat, p->out1name,
-                    "MATCHED", 0);
+                    "MATCHED", 0, p->cp.numthreads);
 }
 
 
@@ -544,7 +551,7 @@ match_catalog_write_one_col(struct matchparams *p, gal_data_t *a,
   /* Reverse the table and write it out. */
   gal_list_data_reverse(&cat);
   gal_table_write(cat, NULL, NULL, p->cp.tableformat, p->out1name,
-                  "MATCHED", 0);
+                  "MATCHED", 0, p->cp.numthreads);
   gal_list_data_free(cat);
 }
 
@@ -587,7 +594,7 @@ match_catalog_kdtree_build(struct matchparams *p)
                             MATCH_KDTREE_ROOT_KEY, 0,
                             &root, 0, comment, 0, unit, 0);
   gal_table_write(kdtree, &keylist, NULL, GAL_TABLE_FORMAT_BFITS,
-                  p->out1name, "kdtree", 0);
+                  p->out1name, "kdtree", 0, p->cp.numthreads);
 
   /* Let the user know that the k-d tree has been built. */
   if(!p->cp.quiet)
@@ -809,7 +816,7 @@ match_catalog(struct matchparams *p)
 
       /* Write them into the table. */
       gal_table_write(mcols, NULL, NULL, p->cp.tableformat, p->logname,
-                      "LOG_INFO", 0);
+                      "LOG_INFO", 0, p->cp.numthreads);
 
       /* Set the comment pointer to NULL: they weren't allocated. */
       mcols->comment=NULL;
@@ -202,6 +202,19 @@ struct argp_option program_options[] =
       GAL_OPTIONS_NOT_SET,
       gal_options_read_sigma_clip
     },
+    {
+      "singlepass",
+      UI_KEY_SINGLEPASS,
+      0,
+      0,
+      "Measure all objects in one pass over the image.",
+      GAL_OPTIONS_GROUP_INPUT,
+      &p->singlepass,
+      GAL_OPTIONS_NO_ARG_TYPE,
+      GAL_OPTIONS_RANGE_0_OR_1,
+      GAL_OPTIONS_NOT_MANDATORY,
+      GAL_OPTIONS_NOT_SET
+    },
 
 
 
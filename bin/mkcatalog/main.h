@@ -235,6 +235,7 @@ struct mkcatalogparams
   uint8_t            spectrum;  /* Object spectrum for 3D datasets.     */
   uint8_t       inbetweenints;  /* Keep rows (integer ids) with no labels. */
   double         sigmaclip[2];  /* Sigma clip column settings.          */
+  uint8_t          singlepass;  /* Measure objects in one image pass.   */
 
   char            *upmaskfile;  /* Name of upper limit mask file.       */
   char             *upmaskhdu;  /* HDU of upper limit mask file.        */
@@ -267,6 +268,9 @@ struct mkcatalogparams
   gal_data_t      *objectcols;  /* Output columns for the objects.      */
   gal_data_t       *clumpcols;  /* Output columns for the clumps.       */
   gal_data_t           *tiles;  /* Tiles to cover each object.          */
+  double             *sptable;  /* Single-pass tables (one per band).   */
+  char           *sptablemmap;  /* Name of 'sptable' if memory-mapped.  */
+  size_t            spnumtabs;  /* Number of single-pass tables.        */
   char            *objectsout;  /* Output objects catalog.              */
   char             *clumpsout;  /* Output clumps catalog.               */
   char            *upcheckout;  /* Name of upperlimit check table.      */
@@ -280,6 +284,10 @@ struct mkcatalogparams
   size_t               rngmin;  /* Minimum possible value of RNG.       */
   size_t              rngdiff;  /* Difference of RNG max and min.       */
   uint8_t      uprangewarning;  /* A warning must be printed.           */
+  double            *upcumsum;  /* Cumulative sum of values in rows.    */
+  uint32_t          *upcumbad;  /* Cumulative no. of unusable pixels.   */
+  char          *upcumsummmap;  /* Name of 'upcumsum' if memory-mapped. */
+  char          *upcumbadmmap;  /* Name of 'upcumbad' if memory-mapped. */
   size_t         *hostobjid_c;  /* To sort the clumps table by Obj.ID.  */
   size_t         *numclumps_c;  /* To sort the clumps table by Obj.ID.  */
   gal_data_t   *specsliceinfo;  /* Slice information for spectra.       */
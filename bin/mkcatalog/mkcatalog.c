@@ -158,8 +158,11 @@ mkcatalog_single_object(void *in_prm)
       /* Initialize the parameters for this object/tile. */
       parse_initialize(&pp);
 
-      /* Get the first pass information. */
-      parse_objects(&pp);
+      /* Get the first pass information. With '--singlepass', it has
+         already been measured over the whole image, so it just has to be
+         merged for this object. */
+      if(p->sptable) parse_singlepass_merge(&pp, tprm->indexs[i]);
+      else           parse_objects(&pp);
 
       /* Currently the second pass is only necessary when there is a clumps
          image. */
@@ -250,29 +253,35 @@ mkcatalog_wcs_conversion(struct mkcatalogparams *p)
   /* Flux weighted center positions for clumps and objects. */
   if(p->wcs_vo)
     {
-      gal_wcs_img_to_world(p->wcs_vo, p->objects->wcs, 1);
+      gal_wcs_img_to_world(p->wcs_vo, p->objects->wcs, 1,
+                           p->cp.numthreads);
       if(p->wcs_vc)
-        gal_wcs_img_to_world(p->wcs_vc, p->objects->wcs, 1);
+        gal_wcs_img_to_world(p->wcs_vc, p->objects->wcs, 1,
+                             p->cp.numthreads);
     }
 
 
   /* Geometric center positions for clumps and objects. */
   if(p->wcs_go)
     {
-      gal_wcs_img_to_world(p->wcs_go, p->objects->wcs, 1);
+      gal_wcs_img_to_world(p->wcs_go, p->objects->wcs, 1,
+                           p->cp.numthreads);
       if(p->wcs_gc)
-        gal_wcs_img_to_world(p->wcs_gc, p->objects->wcs, 1);
+        gal_wcs_img_to_world(p->wcs_gc, p->objects->wcs, 1,
+                             p->cp.numthreads);
     }
 
 
   /* All clumps flux weighted center. */
   if(p->wcs_vcc)
-    gal_wcs_img_to_world(p->wcs_vcc, p->objects->wcs, 1);
+    gal_wcs_img_to_world(p->wcs_vcc, p->objects->wcs, 1,
+                         p->cp.numthreads);
 
 
   /* All clumps geometric center. */
   if(p->wcs_gcc)
-    gal_wcs_img_to_world(p->wcs_gcc, p->objects->wcs, 1);
+    gal_wcs_img_to_world(p->wcs_gcc, p->objects->wcs, 1,
+                         p->cp.numthreads);
 
 
   /* Go over all the object columns and fill in the values. */
@@ -662,7 +671,7 @@ mkcatalog_write_outputs(struct mkcatalogparams *p)
          here), write the objects catalog and free the comments. */
       gal_list_str_reverse(&comments);
       gal_table_write(p->objectcols, &keylist, NULL, p->cp.tableformat,
-                      p->objectsout, "OBJECTS", 0);
+                      p->objectsout, "OBJECTS", 0, p->cp.numthreads);
       gal_list_str_free(comments, 1);
 
 
@@ -679,7 +688,7 @@ mkcatalog_write_outputs(struct mkcatalogparams *p)
              here), write the objects catalog and free the comments. */
           gal_list_str_reverse(&comments);
           gal_table_write(p->clumpcols, NULL, comments, p->cp.tableformat,
-                          p->clumpsout, "CLUMPS", 0);
+                          p->clumpsout, "CLUMPS", 0, p->cp.numthreads);
           gal_list_str_free(comments, 1);
         }
     }
@@ -710,7 +719,7 @@ mkcatalog_write_outputs(struct mkcatalogparams *p)
                 sprintf(str, "SPECTRUM_%zu", i+1);
                 gal_table_write(&p->spectra[i], NULL, NULL,
                                 GAL_TABLE_FORMAT_BFITS,
-                                p->objectsout, str, 0);
+                                p->objectsout, str, 0, p->cp.numthreads);
               }
             else
               {
@@ -718,7 +727,7 @@ mkcatalog_write_outputs(struct mkcatalogparams *p)
                 fname=gal_checkset_automatic_output(&p->cp, p->objectsout,
                                                     str);
                 gal_table_write(&p->spectra[i], NULL, NULL, GAL_TABLE_FORMAT_TXT,
-                                fname, NULL, 0);
+                                fname, NULL, 0, p->cp.numthreads);
                 free(fname);
               }
           }
@@ -797,10 +806,20 @@ mkcatalog(struct mkcatalogparams *p)
      it to assign a column to the clumps in the final catalog. */
   if( p->cp.numthreads > 1 ) pthread_mutex_init(&p->mutex, NULL);
 
+  /* With '--singlepass', measure the properties that don't depend on
+     the order of pixels for all objects in one pass over the image. */
+  if(p->singlepass) parse_singlepass(p);
+
+  /* For the upper-limit measurements, prepare the cumulative sums of the
+     rows of the image. */
+  if(p->upperlimit) upperlimit_cumulative(p);
+
   /* Do the processing on each thread. */
   gal_threads_spin_off(mkcatalog_single_object, p, p->numobjects,
                        p->cp.numthreads, p->cp.minmapsize,
                        p->cp.quietmmap);
+  if(p->sptable)  parse_singlepass_free(p);
+  if(p->upcumsum) upperlimit_cumulative_free(p);
 
   /* Post-thread processing, for example to convert image coordinates to RA
      and Dec. */
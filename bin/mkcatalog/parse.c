@@ -30,7 +30,9 @@ along with Gnuastro. If not, see <http://www.gnu.org/licenses/>.
 #include <string.h>
 #include <stdlib.h>
 
+#include <gnuastro/tile.h>
 #include <gnuastro/data.h>
+#include <gnuastro/threads.h>
 #include <gnuastro/pointer.h>
 #include <gnuastro/dimension.h>
 #include <gnuastro/statistics.h>
@@ -423,7 +425,7 @@ parse_spectrum(struct mkcatalog_passparams *pp, gal_data_t *xybin)
 
   /* For a check.
   gal_table_write(pp->spectrum, NULL, NULL, GAL_TABLE_FORMAT_BFITS,
-                  "spectrum.fits", "SPECTRUM", 0);
+                  "spectrum.fits", "SPECTRUM", 0, p->cp.numthreads);
   */
 }
 
@@ -1597,3 +1599,403 @@ parse_order_based(struct mkcatalog_passparams *pp)
       free(ccounter);
     }
 }
+
+
+
+
+
+
+
+
+
+
+
+
+/*********************************************************************/
+/****************        Single-pass measurements       **************/
+/*********************************************************************/
+/* With '--singlepass', the objects are not parsed one by one over their
+   (possibly heavily overlapping) tiles. Instead, the whole image is
+   parsed once, in bands of contiguous rows (along the slowest dimension),
+   one band for each thread. The measurements that don't depend on the
+   order of the pixels (sums, moments and extrema) are accumulated into a
+   separate table for each band, and the tables are merged for each object
+   in 'parse_singlepass_merge' (on the same threads that later do the
+   order-based measurements and clumps over each object's tile). */
+struct parse_singlepass_params
+{
+  struct mkcatalogparams *p;    /* Main MakeCatalog parameters.         */
+  size_t               slab;    /* Number of pixels in one outer row.   */
+  size_t           bandrows;    /* Number of outer rows in one band.    */
+  size_t             *shift;    /* Shift coordinates of all objects.    */
+  uint32_t          *rowind;    /* Output row of each label (if needed).*/
+};
+
+
+
+
+
+static void *
+parse_singlepass_worker(void *in_prm)
+{
+  struct gal_threads_params *tprm=(struct gal_threads_params *)in_prm;
+  struct parse_singlepass_params *spp=tprm->params;
+  struct mkcatalogparams *p=spp->p;
+
+  double *oi, *table;
+  uint8_t goodvalue, *oif=p->oiflag;
+  float var, sval, varval, skyval, v=NAN;
+  size_t i, j, b, d, row, start, end, tid=0, c[3], sc[3], *shift;
+  size_t ndim=p->objects->ndim, *dsize=p->objects->dsize;
+  int32_t *O=p->objects->array, *C=p->clumps?p->clumps->array:NULL;
+  float *V=p->values?p->values->array:NULL;
+  float *std=p->std?p->std->array:NULL, *sky=p->sky?p->sky->array:NULL;
+  float *SK = ( p->sky && p->sky->size==p->objects->size
+                ? p->sky->array : NULL );
+  float *ST = ( p->std && p->std->size==p->objects->size
+                ? p->std->array : NULL );
+
+  /* See if the Sky or its standard deviation are defined on tiles. */
+  int tiled = ( (p->sky && p->sky->size>1 && SK==NULL)
+                || (p->std && p->std->size>1 && ST==NULL) );
+
+  /* Go over all the bands that were assigned to this thread. */
+  for(i=0; tprm->indexs[i]!=GAL_BLANK_SIZE_T; ++i)
+    {
+      /* Initialize this band's table: all the intermediate values start
+         from zero, except the extrema. */
+      b=tprm->indexs[i];
+      table=p->sptable + b * p->numobjects * PARSE_SP_WIDTH;
+      memset(table, 0, p->numobjects * PARSE_SP_WIDTH * sizeof *table);
+      for(j=0;j<p->numobjects;++j)
+        {
+          table[ j * PARSE_SP_WIDTH + PARSE_SP_MINV ] =  FLT_MAX;
+          table[ j * PARSE_SP_WIDTH + PARSE_SP_MAXV ] = -FLT_MAX;
+        }
+
+      /* Range of pixels in this band and the coordinates of its first
+         pixel (the coordinates are then incremented with the index). */
+      start = b * spp->bandrows * spp->slab;
+      end   = ( (b+1) * spp->bandrows < dsize[0]
+                ? (b+1) * spp->bandrows : dsize[0] ) * spp->slab;
+      gal_dimension_index_to_coord(start, ndim, dsize, c);
+
+      /* Parse the band. */
+      for(j=start; j<end; ++j)
+        {
+          if( O[j]>0 )
+            {
+              /* Table row of this label and the tile ID of this pixel
+                 (if necessary). */
+              row = spp->rowind ? spp->rowind[ O[j] ] : (size_t)(O[j]-1);
+              oi  = table + row * PARSE_SP_WIDTH;
+              if(tiled) tid=gal_tile_full_id_from_coord(&p->cp.tl, c);
+
+              /* INTERNAL: Get the number of clumps in this object: it is
+                 the largest clump ID over each object. */
+              if( C && C[j]>0 && C[j]>oi[ PARSE_SP_CLUMPS ] )
+                oi[ PARSE_SP_CLUMPS ] = C[j];
+
+              /* Geometric measurements (as in 'parse_objects'). */
+              if(oif[ OCOL_NUMALL ]) oi[ OCOL_NUMALL ]++;
+              if(oif[ OCOL_GX ]) oi[ OCOL_GX ] += c[ ndim-1 ]+1;
+              if(oif[ OCOL_GY ]) oi[ OCOL_GY ] += c[ ndim-2 ]+1;
+              if(oif[ OCOL_GZ ]) oi[ OCOL_GZ ] += c[ ndim-3 ]+1;
+              if(spp->shift)
+                {
+                  shift=spp->shift + row * ndim;
+                  for(d=0;d<ndim;++d) sc[d] = c[d] + 1 - shift[d];
+                  oi[ OCOL_GXX ] += sc[1] * sc[1];
+                  oi[ OCOL_GYY ] += sc[0] * sc[0];
+                  oi[ OCOL_GXY ] += sc[1] * sc[0];
+                }
+              if(C && C[j]>0)
+                {
+                  if(oif[ OCOL_C_NUMALL ]) oi[ OCOL_C_NUMALL ]++;
+                  if(oif[ OCOL_C_GX ]) oi[ OCOL_C_GX ] += c[ ndim-1 ]+1;
+                  if(oif[ OCOL_C_GY ]) oi[ OCOL_C_GY ] += c[ ndim-2 ]+1;
+                  if(oif[ OCOL_C_GZ ]) oi[ OCOL_C_GZ ] += c[ ndim-3 ]+1;
+                }
+
+              /* Value related measurements. */
+              goodvalue=0;
+              if( V && !( p->hasblank && isnan(V[j]) ) )
+                {
+                  v=V[j];
+                  goodvalue=1;
+                  if(oif[ OCOL_NUM ])   oi[ OCOL_NUM   ]++;
+                  if(oif[ OCOL_SUM ])   oi[ OCOL_SUM   ] += v;
+                  if(oif[ OCOL_SUMP2 ]) oi[ OCOL_SUMP2 ] += v * v;
+                  if(C && C[j]>0)
+                    {
+                      if(oif[ OCOL_C_NUM ]) oi[ OCOL_C_NUM ]++;
+                      if(oif[ OCOL_C_SUM ]) oi[ OCOL_C_SUM ] += v;
+                    }
+
+                  /* Extrema of the values: the value itself is kept in
+                     the extra columns of the table for the merging. */
+                  if( oif[ OCOL_MINVNUM ] && v<=oi[ PARSE_SP_MINV ] )
+                    {
+                      if( v<oi[ PARSE_SP_MINV ] )
+                        {
+                          oi[ PARSE_SP_MINV ] = v;
+                          oi[ OCOL_MINVNUM ]=1;
+                          if(oif[OCOL_MINVX]) oi[ OCOL_MINVX ] = c[ ndim-1 ]+1;
+                          if(oif[OCOL_MINVY]) oi[ OCOL_MINVY ] = c[ ndim-2 ]+1;
+                          if(oif[OCOL_MINVZ]) oi[ OCOL_MINVZ ] = c[ ndim-3 ]+1;
+                        }
+                      else
+                        {
+                          oi[ OCOL_MINVNUM ]++;
+                          if(oif[OCOL_MINVX]) oi[ OCOL_MINVX ] += c[ ndim-1 ]+1;
+                          if(oif[OCOL_MINVY]) oi[ OCOL_MINVY ] += c[ ndim-2 ]+1;
+                          if(oif[OCOL_MINVZ]) oi[ OCOL_MINVZ ] += c[ ndim-3 ]+1;
+                        }
+                    }
+                  if( oif[ OCOL_MAXVNUM ] && v>=oi[ PARSE_SP_MAXV ] )
+                    {
+                      if( v>oi[ PARSE_SP_MAXV ] )
+                        {
+                          oi[ PARSE_SP_MAXV ] = v;
+                          oi[ OCOL_MAXVNUM ]=1;
+                          if(oif[OCOL_MAXVX]) oi[ OCOL_MAXVX ] = c[ ndim-1 ]+1;
+                          if(oif[OCOL_MAXVY]) oi[ OCOL_MAXVY ] = c[ ndim-2 ]+1;
+                          if(oif[OCOL_MAXVZ]) oi[ OCOL_MAXVZ ] = c[ ndim-3 ]+1;
+                        }
+                      else
+                        {
+                          oi[ OCOL_MAXVNUM ]++;
+                          if(oif[OCOL_MAXVX]) oi[ OCOL_MAXVX ] += c[ ndim-1 ]+1;
+                          if(oif[OCOL_MAXVY]) oi[ OCOL_MAXVY ] += c[ ndim-2 ]+1;
+                          if(oif[OCOL_MAXVZ]) oi[ OCOL_MAXVZ ] += c[ ndim-3 ]+1;
+                        }
+                    }
+
+                  /* Flux weighted measurements (only positive values). */
+                  if( v > 0.0f )
+                    {
+                      if(oif[ OCOL_NUMWHT ]) oi[ OCOL_NUMWHT ]++;
+                      if(oif[ OCOL_SUMWHT ]) oi[ OCOL_SUMWHT ] += v;
+                      if(oif[ OCOL_VX ]) oi[ OCOL_VX ] += v*(c[ ndim-1 ]+1);
+                      if(oif[ OCOL_VY ]) oi[ OCOL_VY ] += v*(c[ ndim-2 ]+1);
+                      if(oif[ OCOL_VZ ]) oi[ OCOL_VZ ] += v*(c[ ndim-3 ]+1);
+                      if(spp->shift)
+                        {
+                          oi[ OCOL_VXX    ] += v * sc[1] * sc[1];
+                          oi[ OCOL_VYY    ] += v * sc[0] * sc[0];
+                          oi[ OCOL_VXY    ] += v * sc[1] * sc[0];
+                        }
+                      if(C && C[j]>0)
+                        {
+                          if(oif[ OCOL_C_NUMWHT ]) oi[ OCOL_C_NUMWHT ]++;
+                          if(oif[ OCOL_C_SUMWHT ]) oi[ OCOL_C_SUMWHT ] += v;
+                          if(oif[ OCOL_C_VX ])
+                            oi[   OCOL_C_VX ] += v * (c[ ndim-1 ]+1);
+                          if(oif[ OCOL_C_VY ])
+                            oi[   OCOL_C_VY ] += v * (c[ ndim-2 ]+1);
+                          if(oif[ OCOL_C_VZ ])
+                            oi[   OCOL_C_VZ ] += v * (c[ ndim-3 ]+1);
+                        }
+                    }
+                }
+
+              /* Sky value based measurements. */
+              if(p->sky && oif[ OCOL_SUMSKY ])
+                {
+                  skyval = ( SK
+                             ? (isnan(SK[j])?0:SK[j])
+                             : ( p->sky->size>1
+                                 ? (isnan(sky[tid])?0:sky[tid])
+                                 : sky[0] ) );
+                  if(!isnan(skyval))
+                    {
+                      oi[ OCOL_NUMSKY  ]++;
+                      oi[ OCOL_SUMSKY  ] += skyval;
+                    }
+                }
+
+              /* Sky standard deviation based measurements. */
+              if(p->std)
+                {
+                  sval = ST ? ST[j] : (p->std->size>1?std[tid]:std[0]);
+                  var = p->variance ? sval : sval*sval;
+                  if(oif[ OCOL_SUMVAR ] && (!isnan(var)))
+                    {
+                      oi[ OCOL_NUMVAR  ]++;
+                      oi[ OCOL_SUMVAR  ] += var;
+                    }
+                  if(oif[ OCOL_SUM_VAR ] && goodvalue)
+                    {
+                      varval=p->variance ? var : sval;
+                      if(!isnan(varval))
+                        {
+                          oi[ OCOL_SUM_VAR_NUM  ]++;
+                          oi[ OCOL_SUM_VAR      ] += varval + fabs(v);
+                        }
+                    }
+                }
+            }
+
+          /* Coordinates of the next pixel. */
+          d=ndim;
+          while(d--) { if(++c[d]<dsize[d]) break; c[d]=0; }
+        }
+    }
+
+  /* Wait for all the other threads to finish, then return. */
+  if(tprm->b) pthread_barrier_wait(tprm->b);
+  return NULL;
+}
+
+
+
+
+
+/* Parse the whole image once and fill the per-band tables. */
+void
+parse_singlepass(struct mkcatalogparams *p)
+{
+  uint8_t *oif=p->oiflag;
+  gal_data_t *tile;
+  size_t i, d, nbands, ndim=p->objects->ndim, *dsize=p->objects->dsize;
+  struct parse_singlepass_params spp={p, 0, 0, NULL, NULL};
+
+  /* The projected areas and spectra need a separate array for each
+     object, so they are only measured while parsing each object's
+     tile. */
+  if( p->spectrum || oif[ OCOL_NUMALLXY ] || oif[ OCOL_NUMXY ] )
+    error(EXIT_FAILURE, 0, "'--singlepass' can't be used with "
+          "'--spectrum', or with columns that need the area over the "
+          "first two dimensions (for example '--areaxy' or "
+          "'--geoareaxy')");
+
+  /* Set the bands: one band (of contiguous rows along the slowest
+     dimension) for each thread. */
+  spp.slab = p->objects->size / dsize[0];
+  nbands = p->cp.numthreads < dsize[0] ? p->cp.numthreads : dsize[0];
+  spp.bandrows = dsize[0]/nbands + (dsize[0]%nbands ? 1 : 0);
+  p->spnumtabs = dsize[0]/spp.bandrows + (dsize[0]%spp.bandrows ? 1 : 0);
+
+  /* When the labels in the image are not contiguous, we need the output
+     row of each label. */
+  if(p->outlabs)
+    {
+      spp.rowind=gal_pointer_allocate(GAL_TYPE_UINT32,
+                                      p->outlabs[p->numobjects-1]+1, 1,
+                                      __func__, "spp.rowind");
+      for(i=0;i<p->numobjects;++i) spp.rowind[ p->outlabs[i] ] = i;
+    }
+
+  /* The second order moments are measured relative to the first pixel of
+     each object's tile (see 'parse_initialize'). */
+  if( oif[    OCOL_GXX ] || oif[ OCOL_GYY ] || oif[ OCOL_GXY ]
+      || oif[ OCOL_VXX ] || oif[ OCOL_VYY ] || oif[ OCOL_VXY ] )
+    {
+      spp.shift=gal_pointer_allocate(GAL_TYPE_SIZE_T, p->numobjects*ndim,
+                                     0, __func__, "spp.shift");
+      for(i=0;i<p->numobjects;++i)
+        {
+          tile=&p->tiles[i];
+          gal_dimension_index_to_coord(
+                  gal_pointer_num_between(tile->block->array, tile->array,
+                                          tile->block->type),
+                  ndim, dsize, spp.shift + i*ndim);
+          for(d=0;d<ndim;++d) ++spp.shift[ i*ndim + d ];
+        }
+    }
+
+  /* Allocate the tables (this can be large with many objects and threads,
+     so it may be memory-mapped). */
+  p->sptable=gal_pointer_allocate_ram_or_mmap(GAL_TYPE_FLOAT64,
+                                 p->spnumtabs * p->numobjects * PARSE_SP_WIDTH,
+                                 0, p->cp.minmapsize, &p->sptablemmap,
+                                 p->cp.quietmmap, __func__, "p->sptable");
+
+  /* Parse the bands on the threads. */
+  gal_threads_spin_off(parse_singlepass_worker, &spp, p->spnumtabs,
+                       p->cp.numthreads, p->cp.minmapsize,
+                       p->cp.quietmmap);
+
+  /* Clean up. */
+  if(spp.shift)  free(spp.shift);
+  if(spp.rowind) free(spp.rowind);
+}
+
+
+
+
+
+/* Merge the tables of all the bands for one object (in row 'row' of the
+   output). This is called instead of 'parse_objects' (after
+   'parse_initialize'). */
+void
+parse_singlepass_merge(struct mkcatalog_passparams *pp, size_t row)
+{
+  struct mkcatalogparams *p=pp->p;
+
+  size_t i, j;
+  double *t, *oi=pp->oi, minv=FLT_MAX, maxv=-FLT_MAX;
+
+  for(i=0;i<p->spnumtabs;++i)
+    {
+      /* This object's row in the table of this band. */
+      t = p->sptable + (i * p->numobjects + row) * PARSE_SP_WIDTH;
+
+      /* All the intermediate values (except the extrema) are sums. */
+      for(j=0;j<OCOL_NUMCOLS;++j)
+        switch(j)
+          {
+          case OCOL_MINVX: case OCOL_MINVY: case OCOL_MINVZ:
+          case OCOL_MAXVX: case OCOL_MAXVY: case OCOL_MAXVZ:
+          case OCOL_MINVNUM: case OCOL_MAXVNUM: break;
+          default: oi[j] += t[j];
+          }
+
+      /* The extrema: only keep the positions of the smallest/largest
+         values, adding them when the same value is in several bands. */
+      if( t[ PARSE_SP_MINV ] <= minv )
+        {
+          if( t[ PARSE_SP_MINV ] < minv )
+            {
+              minv=t[ PARSE_SP_MINV ];
+              oi[ OCOL_MINVNUM ] = oi[ OCOL_MINVX ] = 0.0f;
+              oi[ OCOL_MINVY   ] = oi[ OCOL_MINVZ ] = 0.0f;
+            }
+          oi[ OCOL_MINVNUM ] += t[ OCOL_MINVNUM ];
+          oi[ OCOL_MINVX   ] += t[ OCOL_MINVX   ];
+          oi[ OCOL_MINVY   ] += t[ OCOL_MINVY   ];
+          oi[ OCOL_MINVZ   ] += t[ OCOL_MINVZ   ];
+        }
+      if( t[ PARSE_SP_MAXV ] >= maxv )
+        {
+          if( t[ PARSE_SP_MAXV ] > maxv )
+            {
+              maxv=t[ PARSE_SP_MAXV ];
+              oi[ OCOL_MAXVNUM ] = oi[ OCOL_MAXVX ] = 0.0f;
+              oi[ OCOL_MAXVY   ] = oi[ OCOL_MAXVZ ] = 0.0f;
+            }
+          oi[ OCOL_MAXVNUM ] += t[ OCOL_MAXVNUM ];
+          oi[ OCOL_MAXVX   ] += t[ OCOL_MAXVX   ];
+          oi[ OCOL_MAXVY   ] += t[ OCOL_MAXVY   ];
+          oi[ OCOL_MAXVZ   ] += t[ OCOL_MAXVZ   ];
+        }
+
+      /* Number of clumps in this object. */
+      if( t[ PARSE_SP_CLUMPS ] > pp->clumpsinobj )
+        pp->clumpsinobj = t[ PARSE_SP_CLUMPS ];
+    }
+}
+
+
+
+
+
+void
+parse_singlepass_free(struct mkcatalogparams *p)
+{
+  if(p->sptablemmap)
+    gal_pointer_mmap_free(&p->sptablemmap, p->cp.quietmmap);
+  else
+    free(p->sptable);
+  p->sptable=NULL;
+}
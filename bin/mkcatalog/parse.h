@@ -23,6 +23,12 @@ along with Gnuastro. If not, see <http://www.gnu.org/licenses/>.
 #ifndef PARSE_H
 #define PARSE_H
 
+/* Extra columns of the single-pass tables (after the 'OCOL_*' columns). */
+#define PARSE_SP_MINV   (OCOL_NUMCOLS)     /* Minimum value in this band. */
+#define PARSE_SP_MAXV   (OCOL_NUMCOLS+1)   /* Maximum value in this band. */
+#define PARSE_SP_CLUMPS (OCOL_NUMCOLS+2)   /* Largest clump label.        */
+#define PARSE_SP_WIDTH  (OCOL_NUMCOLS+3)   /* Width of the tables.        */
+
 void
 parse_initialize(struct mkcatalog_passparams *pp);
 
@@ -35,4 +41,13 @@ parse_clumps(struct mkcatalog_passparams *pp);
 void
 parse_order_based(struct mkcatalog_passparams *pp);
 
+void
+parse_singlepass(struct mkcatalogparams *p);
+
+void
+parse_singlepass_merge(struct mkcatalog_passparams *pp, size_t row);
+
+void
+parse_singlepass_free(struct mkcatalogparams *p);
+
 #endif
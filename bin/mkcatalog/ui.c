@@ -836,7 +836,8 @@ ui_read_labels(struct mkcatalogparams *p)
 
   /* Read it into memory. */
   p->objects = gal_array_read_one_ch(p->objectsfile, p->cp.hdu, NULL,
-                                     p->cp.minmapsize, p->cp.quietmmap);
+                                     p->cp.numthreads, p->cp.minmapsize,
+                                     p->cp.quietmmap);
   p->objects->ndim=gal_dimension_remove_extra(p->objects->ndim,
                                               p->objects->dsize, NULL);
 
@@ -914,8 +915,8 @@ ui_read_labels(struct mkcatalogparams *p)
 
       /* Read the clumps image. */
       p->clumps = gal_array_read_one_ch(p->usedclumpsfile, p->clumpshdu,
-                                        NULL, p->cp.minmapsize,
-                                        p->cp.quietmmap);
+                                        NULL, p->cp.numthreads,
+                                        p->cp.minmapsize, p->cp.quietmmap);
       p->clumps->ndim=gal_dimension_remove_extra(p->clumps->ndim,
                                                  p->clumps->dsize, NULL);
 
@@ -1266,6 +1267,7 @@ ui_preparations_read_inputs(struct mkcatalogparams *p)
       /* Read the values dataset. */
       p->values=gal_array_read_one_ch_to_type(p->usedvaluesfile, p->valueshdu,
                                               NULL, GAL_TYPE_FLOAT32,
+                                              p->cp.numthreads,
                                               p->cp.minmapsize,
                                               p->cp.quietmmap);
       p->values->ndim=gal_dimension_remove_extra(p->values->ndim,
@@ -1318,6 +1320,7 @@ ui_preparations_read_inputs(struct mkcatalogparams *p)
           /* Read the Sky dataset. */
           p->sky=gal_array_read_one_ch_to_type(p->usedskyfile, p->skyhdu,
                                                NULL, GAL_TYPE_FLOAT32,
+                                               p->cp.numthreads,
                                                p->cp.minmapsize,
                                                p->cp.quietmmap);
           p->sky->ndim=gal_dimension_remove_extra(p->sky->ndim,
@@ -1350,6 +1353,7 @@ ui_preparations_read_inputs(struct mkcatalogparams *p)
       /* Read the Sky standard deviation image into memory. */
       p->std=gal_array_read_one_ch_to_type(p->usedstdfile, p->stdhdu,
                                            NULL, GAL_TYPE_FLOAT32,
+                                           p->cp.numthreads,
                                            p->cp.minmapsize, p->cp.quietmmap);
       p->std->ndim=gal_dimension_remove_extra(p->std->ndim,
                                               p->std->dsize, NULL);
@@ -1385,7 +1389,8 @@ ui_preparations_read_inputs(struct mkcatalogparams *p)
 
           /* Read the mask image. */
           p->upmask = gal_array_read_one_ch(p->upmaskfile, p->upmaskhdu,
-                                            NULL, p->cp.minmapsize,
+                                            NULL, p->cp.numthreads,
+                                            p->cp.minmapsize,
                                             p->cp.quietmmap);
           p->upmask->ndim=gal_dimension_remove_extra(p->upmask->ndim,
                                                      p->upmask->dsize,
@@ -1673,7 +1678,7 @@ ui_preparations_spectrum_wcs(struct mkcatalogparams *p)
   coords=x;
   coords->next=y;
   coords->next->next=z;
-  gal_wcs_img_to_world(coords, p->objects->wcs, 1);
+  gal_wcs_img_to_world(coords, p->objects->wcs, 1, p->cp.numthreads);
 
   /* For a check.
   for(i=0;i<numslices;++i)
@@ -1700,7 +1705,7 @@ ui_preparations_spectrum_wcs(struct mkcatalogparams *p)
 
   /* For a final check.
   gal_table_write(p->specsliceinfo, NULL, NULL, GAL_TABLE_FORMAT_BFITS,
-                  "specsliceinfo.fits", "test-debug", 0);
+                  "specsliceinfo.fits", "test-debug", 0, p->cp.numthreads);
   */
 
   /* Clean up. */
@@ -106,6 +106,7 @@ enum option_keys_enum
   UI_KEY_NOCLUMPSORT,
   UI_KEY_FRACMAX,
   UI_KEY_SPATIALRESOLUTION,
+  UI_KEY_SINGLEPASS,
 
   UI_KEY_OBJID,                         /* Catalog columns. */
   UI_KEY_IDINHOSTOBJ,
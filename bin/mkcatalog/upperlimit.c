@@ -147,6 +147,123 @@ upperlimit_make_clump_tiles(struct mkcatalog_passparams *pp)
 
 
 
+/*********************************************************************/
+/*******************      Cumulative rows         ********************/
+/*********************************************************************/
+/* For every random position of a footprint, we need to know if any of its
+   pixels are over a label, are masked, or are blank, and the sum of the
+   values of the rest. To do this independently of the number of pixels,
+   the footprint is kept as runs of contiguous pixels (see
+   'upperlimit_footprint_runs') and the image as the cumulative sum of
+   each row (line along the fastest dimension) for the values and the
+   number of unusable pixels. The sum (or number) over a run is then the
+   difference of two elements. Each row of the cumulative arrays has one
+   extra element (the first, which is zero). */
+static void *
+upperlimit_cumulative_worker(void *in_prm)
+{
+  struct gal_threads_params *tprm=(struct gal_threads_params *)in_prm;
+  struct mkcatalogparams *p=(struct mkcatalogparams *)(tprm->params);
+
+  double *cs;
+  uint32_t *cb;
+  uint8_t bad;
+  size_t i, j, k, l, lf;
+  float *v=p->values->array;
+  int32_t *o=p->objects->array;
+  uint8_t *m=p->upmask?p->upmask->array:NULL;
+  size_t w=p->objects->dsize[p->objects->ndim-1];
+  size_t nlines=p->objects->size/w;
+
+  /* Go over the bands of rows that were assigned to this thread. */
+  for(i=0; tprm->indexs[i]!=GAL_BLANK_SIZE_T; ++i)
+    {
+      lf=(tprm->indexs[i]+1) * nlines / p->cp.numthreads;
+      for(l=tprm->indexs[i] * nlines / p->cp.numthreads; l<lf; ++l)
+        {
+          cs=p->upcumsum + l*(w+1);
+          cb=p->upcumbad + l*(w+1);
+          cs[0]=0.0f;
+          cb[0]=0;
+          for(j=0;j<w;++j)
+            {
+              k=l*w+j;
+              bad = o[k] || (m && m[k]) || ( p->hasblank && isnan(v[k]) );
+              cb[j+1] = cb[j] + bad;
+              cs[j+1] = cs[j] + (bad ? 0.0f : v[k]);
+            }
+        }
+    }
+
+  /* Wait for all the other threads to finish, then return. */
+  if(tprm->b) pthread_barrier_wait(tprm->b);
+  return NULL;
+}
+
+
+
+
+
+void
+upperlimit_cumulative(struct mkcatalogparams *p)
+{
+  size_t w=p->objects->dsize[p->objects->ndim-1];
+  size_t size=p->objects->size/w*(w+1);
+
+  /* Allocate the arrays. */
+  p->upcumsum=gal_pointer_allocate_ram_or_mmap(GAL_TYPE_FLOAT64, size, 0,
+                                               p->cp.minmapsize,
+                                               &p->upcumsummmap,
+                                               p->cp.quietmmap, __func__,
+                                               "p->upcumsum");
+  p->upcumbad=gal_pointer_allocate_ram_or_mmap(GAL_TYPE_UINT32, size, 0,
+                                               p->cp.minmapsize,
+                                               &p->upcumbadmmap,
+                                               p->cp.quietmmap, __func__,
+                                               "p->upcumbad");
+
+  /* Fill them (one band of rows for each thread). */
+  gal_threads_spin_off(upperlimit_cumulative_worker, p, p->cp.numthreads,
+                       p->cp.numthreads, p->cp.minmapsize,
+                       p->cp.quietmmap);
+}
+
+
+
+
+
+void
+upperlimit_cumulative_free(struct mkcatalogparams *p)
+{
+  if(p->upcumsummmap) gal_pointer_mmap_free(&p->upcumsummmap,
+                                            p->cp.quietmmap);
+  else                free(p->upcumsum);
+  if(p->upcumbadmmap) gal_pointer_mmap_free(&p->upcumbadmmap,
+                                            p->cp.quietmmap);
+  else                free(p->upcumbad);
+  p->upcumsum=NULL;
+  p->upcumbad=NULL;
+}
+
+
+
+
+
+
+
+
+
+
+
+
+
+
+
+
+
+
+
+
 /*********************************************************************/
 /*******************         For one tile         ********************/
 /*********************************************************************/
@@ -425,7 +542,7 @@ upperlimit_write_check(struct mkcatalogparams *p, gal_list_sizet_t *check_x,
   if(check_z) { y->next=z; z->next=s; }
   else        { y->next=s;            }
   gal_table_write(x, &keylist, NULL, p->cp.tableformat, p->upcheckout,
-                  "UPPERLIMIT_CHECK", 0);
+                  "UPPERLIMIT_CHECK", 0, p->cp.numthreads);
 
   /* Inform the user. */
   if(!p->cp.quiet)
@@ -539,6 +656,61 @@ upperlimit_measure(struct mkcatalog_passparams *pp, int32_t clumplab,
 
 
 
+/* The footprint of the object/clump as runs of contiguous pixels (along
+   the fastest dimension). Each run is kept as two numbers: the offset of
+   its first pixel from the tile's first pixel within the cumulative arrays
+   (that have one extra element in each row, see 'upperlimit_cumulative')
+   and its length. Since the random positions keep the tile within the
+   image, these offsets are the same for any position of the tile. */
+static size_t *
+upperlimit_footprint_runs(struct mkcatalog_passparams *pp, gal_data_t *tile,
+                          int32_t *st_oo, int32_t *st_oc, int32_t clumplab,
+                          size_t *numruns)
+{
+  struct mkcatalogparams *p=pp->p;
+  size_t ndim=p->objects->ndim, *tsize=tile->dsize;
+  size_t w=p->objects->dsize[ndim-1], nlines=tile->size/tsize[ndim-1];
+
+  int inrun;
+  int32_t *oO, *oC=NULL;
+  size_t i, n=0, increment=0, num_increment=1;
+  size_t *runs=gal_pointer_allocate(GAL_TYPE_SIZE_T,
+                                    2 * nlines * (tsize[ndim-1]/2+1), 0,
+                                    __func__, "runs");
+
+  /* Go over each contiguous line of the tile. */
+  while( num_increment<=nlines )
+    {
+      inrun=0;
+      oO = st_oo + increment;
+      if(clumplab) oC = st_oc + increment;
+      for(i=0;i<tsize[ndim-1];++i)
+        if( oO[i]==pp->object && ( oC==NULL || oC[i]==clumplab ) )
+          {
+            if(inrun) ++runs[ 2*n-1 ];
+            else
+              {
+                runs[ 2*n   ] = increment/w*(w+1) + increment%w + i;
+                runs[ 2*n+1 ] = 1;
+                ++n; inrun=1;
+              }
+          }
+        else inrun=0;
+
+      /* Go to the next line of the tile. */
+      increment += gal_tile_block_increment(p->objects, tsize,
+                                            num_increment++, NULL);
+    }
+
+  /* Return the runs. */
+  *numruns=n;
+  return runs;
+}
+
+
+
+
+
 static void
 upperlimit_one_tile(struct mkcatalog_passparams *pp, gal_data_t *tile,
                     unsigned long seed, int32_t clumplab)
@@ -547,14 +719,14 @@ upperlimit_one_tile(struct mkcatalog_passparams *pp, gal_data_t *tile,
   size_t ndim=p->objects->ndim, *dsize=p->objects->dsize;
 
   double sum;
-  void *tarray;
-  uint8_t *M=NULL, *st_m=NULL;
   int continueparse, writecheck=0;
   struct gal_list_f32_t *check_s=NULL;
-  size_t d, counter=0, se_inc[2], nfailed=0;
-  float *V, *st_v, *uparr=pp->up_vals->array;
-  size_t min[3], max[3], increment, num_increment;
-  int32_t *O, *OO, *oO, *st_o, *st_oo, *st_oc, *oC=NULL;
+  float *uparr=pp->up_vals->array;
+  int32_t *st_oo, *st_oc;
+  uint32_t *cb=p->upcumbad;
+  double *cs=p->upcumsum;
+  size_t d, i, b, e, start, numruns, *runs;
+  size_t counter=0, se_inc[2], nfailed=0, min[3], max[3];
   size_t maxfails = p->upnum * MKCATALOG_UPPERLIMIT_MAXFAILS_MULTIP;
   struct gal_list_sizet_t *check_x=NULL, *check_y=NULL, *check_z=NULL;
   size_t *rcoord=gal_pointer_allocate(GAL_TYPE_SIZE_T, ndim, 0, __func__,
@@ -576,7 +748,6 @@ upperlimit_one_tile(struct mkcatalog_passparams *pp, gal_data_t *tile,
 
 
   /* Initializations. */
-  tarray=tile->array;
   gsl_rng_set(pp->rng, seed);
   pp->up_vals->flag &= ~GAL_DATA_FLAG_SORT_CH;
 
@@ -593,6 +764,11 @@ upperlimit_one_tile(struct mkcatalog_passparams *pp, gal_data_t *tile,
   st_oc = clumplab ? (int32_t *)(p->clumps->array) + se_inc[0] : NULL;
 
 
+  /* The footprint of this object/clump (independent of its position). */
+  runs=upperlimit_footprint_runs(pp, tile, st_oo, st_oc, clumplab,
+                                 &numruns);
+
+
   /* Continue measuring randomly until we get the desired total number. */
   while(nfailed<maxfails && counter<p->upnum)
     {
@@ -600,65 +776,19 @@ upperlimit_one_tile(struct mkcatalog_passparams *pp, gal_data_t *tile,
       for(d=0;d<ndim;++d)
         rcoord[d] = upperlimit_random_position(pp, tile, d, min, max);
 
-      /* Set the tile's new starting pointer. */
-      tile->array = gal_pointer_increment(p->objects->array,
-                          gal_dimension_coord_to_index(ndim, dsize, rcoord),
-                                           p->objects->type);
-
-      /* Starting and ending coordinates for this random position, note
-         that in 'pp' we have the starting and ending coordinates of the
-         actual tile. */
-      increment     = 0;
-      num_increment = 1;
-      continueparse = 1;
-      sum           = 0.0f;
-
-      /* Starting pointers for the random tile. */
-      st_v   = gal_tile_start_end_ind_inclusive(tile, p->values, se_inc);
-      st_o               = (int32_t *)(p->objects->array) + se_inc[0];
-      if(p->upmask) st_m = (uint8_t *)(p->upmask->array)  + se_inc[0];
-
-      /* Parse over this object/clump. */
-      while( se_inc[0] + increment <= se_inc[1] )
-        {
-          /* Set the pointers. */
-          V               = st_v  + increment;    /* Random tile.   */
-          O               = st_o  + increment;    /* Random tile.   */
-          if(st_m) M      = st_m  + increment;    /* Random tile.   */
-          oO              = st_oo + increment;    /* Original tile. */
-          if(clumplab) oC = st_oc + increment;    /* Original tile. */
-
-
-          /* Parse over this contiguous region, similar to the first and
-             second pass functions. */
-          OO = O + tile->dsize[ndim-1];
-          do
-            {
-              /* Only use pixels over this object/clump. */
-              if( *oO==pp->object && ( oC==NULL || *oC==clumplab ) )
-                {
-                  /* If this pixel is a non-zero object code, or is masked,
-                     or has a blank value, then stop parsing. */
-                  if( *O || (M && *M) || ( p->hasblank && isnan(*V) ) )
-                    continueparse=0;
-                  else
-                    sum += *V;
-                }
+      /* Position of the tile's first pixel in the cumulative arrays. */
+      start = gal_dimension_coord_to_index(ndim, dsize, rcoord);
+      start = start/dsize[ndim-1]*(dsize[ndim-1]+1) + start%dsize[ndim-1];
 
-              /* Increment the other pointers. */
-              ++V;
-              ++oO;
-              if(M) ++M;
-              if(oC) ++oC;
-            }
-          while(continueparse && ++O<OO);
-
-
-          /* Increment to the next contiguous region of this tile. */
-          if(continueparse)
-            increment += ( gal_tile_block_increment(p->objects, dsize,
-                                                    num_increment++, NULL) );
-          else break;
+      /* Go over the runs of the footprint: if any pixel is on a label, or
+         is masked, or has a blank value, the position is not usable. */
+      sum=0.0f;
+      continueparse=1;
+      for(i=0;i<numruns;++i)
+        {
+          e = ( b = start + runs[2*i] ) + runs[2*i+1];
+          if( cb[e]!=cb[b] ) { continueparse=0; break; }
+          sum += cs[e] - cs[b];
         }
 
 
@@ -705,9 +835,9 @@ upperlimit_one_tile(struct mkcatalog_passparams *pp, gal_data_t *tile,
   /* Do the measurement on the random distribution. */
   upperlimit_measure(pp, clumplab, counter==p->upnum);
 
-  /* Reset the tile's array pointer, clean up and return. */
+  /* Clean up and return. */
+  free(runs);
   free(rcoord);
-  tile->array=tarray;
   gal_list_f32_free(check_s);
   gal_list_sizet_free(check_x);
   gal_list_sizet_free(check_y);
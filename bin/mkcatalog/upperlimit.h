@@ -27,6 +27,12 @@ void
 upperlimit_write_keys(struct mkcatalogparams *p,
                       gal_fits_list_key_t **keylist, int withsigclip);
 
+void
+upperlimit_cumulative(struct mkcatalogparams *p);
+
+void
+upperlimit_cumulative_free(struct mkcatalogparams *p);
+
 void
 upperlimit_calculate(struct mkcatalog_passparams *pp);
 
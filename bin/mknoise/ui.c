@@ -310,8 +310,8 @@ ui_preparations(struct mknoiseparams *p)
 {
   /* Read the input image as a double type */
   p->input=gal_array_read_one_ch_to_type(p->inputname, p->cp.hdu, NULL,
-                                         GAL_TYPE_FLOAT64, p->cp.minmapsize,
-                                         p->cp.quietmmap);
+                                         GAL_TYPE_FLOAT64, p->cp.numthreads,
+                                         p->cp.minmapsize, p->cp.quietmmap);
   p->input->wcs=gal_wcs_read(p->inputname, p->cp.hdu, p->cp.wcslinearmatrix,
                              0, 0, &p->input->nwcs);
   p->input->ndim=gal_dimension_remove_extra(p->input->ndim, p->input->dsize,
@@ -269,6 +269,19 @@ struct argp_option program_options[] =
       GAL_OPTIONS_MANDATORY,
       GAL_OPTIONS_NOT_SET
     },
+    {
+      "profilecache",
+      UI_KEY_PROFILECACHE,
+      "INT",
+      0,
+      "Re-use same profiles (centers in 1/INT pixels).",
+      UI_GROUP_PROFILES,
+      &p->profilecache,
+      GAL_TYPE_SIZE_T,
+      GAL_OPTIONS_RANGE_GE_0,
+      GAL_OPTIONS_NOT_MANDATORY,
+      GAL_OPTIONS_NOT_SET
+    },
     {
       "tunitinp",
       UI_KEY_TUNITINP,
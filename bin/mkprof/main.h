@@ -45,6 +45,19 @@ along with Gnuastro. If not, see <http://www.gnu.org/licenses/>.
 
 
 
+/* Cache of built profiles (with '--profilecache'). */
+#define MKPROF_CACHE_KEYLEN      12          /* Elements in each key.   */
+#define MKPROF_CACHE_NUMBUCKETS  4096        /* Buckets in hash table.  */
+#define MKPROF_CACHE_BYTES       1073741824  /* Max. bytes (all threads).*/
+
+
+
+/* Maximum number of bands (each with its own mutex) in the merged image,
+   see 'mkprof_merge'. */
+#define MKPROF_MERGE_MAXBANDS    1024
+
+
+
 /* Modes to interpret coordinates. */
 enum coord_modes
 {
@@ -104,6 +117,7 @@ struct builtqueue
   int        indivcreated;    /* ==1: an individual file is created. */
   size_t          numaccu;    /* Number of accurate pixels.          */
   double         accufrac;    /* Difference of accurate values.      */
+  double              sum;    /* Sum of pixels put in merged image.  */
 
   struct builtqueue *next;    /* Pointer to next element.            */
 };
@@ -133,6 +147,7 @@ struct mkprofparams
   char             *typestr;  /* Type of finally merged output image.     */
   size_t          numrandom;  /* Number of radom points for integration.  */
   float           tolerance;  /* Accuracy to stop integration.            */
+  size_t       profilecache;  /* Sub-pixel steps for caching profiles.    */
   uint8_t          tunitinp;  /* ==1: Truncation is in pixels, not radial.*/
   size_t             *shift;  /* Shift along axeses position of profiles. */
   uint8_t       prepforconv;  /* Shift and expand by size of first psf.   */
@@ -195,6 +210,9 @@ struct mkprofparams
   struct builtqueue     *bq;  /* Top (last) elem of build queue.          */
   pthread_cond_t     qready;  /* bq is ready to be written.               */
   pthread_mutex_t     qlock;  /* Mutex lock to change builtq.             */
+  pthread_mutex_t *bandlocks; /* Mutex lock of each band of merged image. */
+  size_t           bandrows;  /* Rows (slowest dim.) in each band.        */
+  size_t           numbands;  /* Number of bands in merged image.         */
   double          halfpixel;  /* Half pixel in oversampled image.         */
   char              *wcsstr;  /* The WCS keywords derived from main img.  */
   int            wcsnkeyrec;  /* The number of keywords in the WCS header.*/
@@ -91,6 +91,7 @@ builtqueue_addempty(struct builtqueue **bq)
   tbq->overlap_m    = NULL;
   tbq->func         = PROFILE_MAXIMUM_CODE;
   tbq->indivcreated = 0;
+  tbq->sum          = 0.0f;
   tbq->numaccu      = 0;
   tbq->accufrac     = 0.0f;
 
@@ -305,6 +306,46 @@ saveindividual(struct mkonthread *mkp)
 /**************************************************************/
 /************            The builders             *************/
 /**************************************************************/
+/* Put the pixels of the built profile into the merged image. This is done
+   by the thread that built the profile: the merged image is divided into
+   bands (along the slowest dimension) that each have a mutex, so a thread
+   only waits for others when their profiles overlap with the same
+   bands. The bands are always locked in increasing order, so there is no
+   chance of a deadlock. 'start' and 'rows' are the first row (of the
+   merged image) and the number of rows of the overlap. */
+static void
+mkprof_merge(struct mkonthread *mkp, size_t start, size_t rows)
+{
+  struct mkprofparams *p=mkp->p;
+  struct builtqueue *ibq=mkp->ibq;
+
+  double sum=0.0f;
+  size_t b, fb=0, lb=0;
+
+  /* Lock all the bands that this profile overlaps with. */
+  if(p->bandlocks)
+    {
+      fb=start/p->bandrows;
+      lb=(start+rows-1)/p->bandrows;
+      for(b=fb;b<=lb;++b) pthread_mutex_lock(&p->bandlocks[b]);
+    }
+
+  /* Add the overlapping pixels into the merged image. */
+  GAL_TILE_PO_OISET(float,float,ibq->overlap_i,ibq->overlap_m,1,0, {
+      *o  = p->replace ? ( *i>*o ? *i : *o ) :  (*i + *o);
+      sum += *i;
+    });
+
+  /* Unlock the bands and keep the sum for the log. */
+  if(p->bandlocks)
+    for(b=fb;b<=lb;++b) pthread_mutex_unlock(&p->bandlocks[b]);
+  ibq->sum=sum;
+}
+
+
+
+
+
 /* High-level function to built a single profile and prepare it for the
    next steps. */
 static void
@@ -385,7 +426,18 @@ mkprof_build_single(struct mkonthread *mkp, long *fpixel_i, long *lpixel_i,
       ibq->overlap_m=gal_data_alloc(ptr, p->out->type, ndim, dsize, NULL,
                                     0, -1, 1, NULL, NULL, NULL);
       ibq->overlap_m->block=p->out;
+
+      /* Put the profile into the merged image. */
+      if(ibq->overlaps)
+        mkprof_merge(mkp, start_mrg[0], dsize[0]);
     }
+
+  /* The built profile isn't needed any more. Note that there is no
+     problem to free a NULL pointer. */
+  gal_data_free(ibq->overlap_i);
+  gal_data_free(ibq->overlap_m);
+  gal_data_free(ibq->image);
+  ibq->overlap_i=ibq->overlap_m=ibq->image=NULL;
 }
 
 
@@ -491,6 +543,18 @@ mkprof_build(void *inparam)
   long fpixel_i[3], lpixel_i[3], fpixel_o[3], lpixel_o[3];
 
 
+  /* Allocate the hash table of built profiles on this thread. */
+  if(p->profilecache)
+    {
+      errno=0;
+      mkp->cache=calloc(MKPROF_CACHE_NUMBUCKETS, sizeof *mkp->cache);
+      if(mkp->cache==NULL)
+        error(EXIT_FAILURE, errno, "%s: allocating %zu bytes for "
+              "'mkp->cache'", __func__,
+              MKPROF_CACHE_NUMBUCKETS*sizeof *mkp->cache);
+    }
+
+
   /* Make each profile that was specified for this thread. */
   for(i=0; mkp->indexs[i]!=GAL_BLANK_SIZE_T; ++i)
     {
@@ -572,6 +636,7 @@ mkprof_build(void *inparam)
   /* Free the allocated space for this thread and wait until all other
      threads finish. */
   gsl_rng_free(mkp->rng);
+  if(mkp->cache) oneprofile_cache_free(mkp);
   if(p->cp.numthreads==1)
     p->bq=mkp->ibq;
   else
@@ -630,18 +695,12 @@ mkprof_write(struct mkprofparams *p)
               pthread_mutex_unlock(&p->qlock);
             }
         }
-      sum=0.0f;
 
 
-      /* During the build process, we also defined the overlap tiles of
-         both the individual array and the final merged array, here we will
-         use those to put the required profile pixels into the final
-         array. */
-      if(ibq->overlaps && out)
-        GAL_TILE_PO_OISET(float,float,ibq->overlap_i,ibq->overlap_m,1,0, {
-            *o  = p->replace ? ( *i>*o ? *i : *o ) :  (*i + *o);
-            sum += *i;
-          });
+      /* The profile was already put into the final array by the thread
+         that built it (see 'mkprof_merge'), only the sum of the pixels
+         that went into it is needed here. */
+      sum = (ibq->overlaps && out) ? ibq->sum : 0.0f;
 
 
       /* Fill the log array. */
@@ -683,12 +742,7 @@ mkprof_write(struct mkprofparams *p)
         }
 
 
-      /* Free the array and the queue element and change it to the next one
-         and increment complete. Note that there is no problem to free a
-         NULL pointer (when the built array didn't overlap). */
-      gal_data_free(ibq->overlap_i);
-      gal_data_free(ibq->overlap_m);
-      gal_data_free(ibq->image);
+      /* Free the queue element and change it to the next one. */
       tbq=ibq->next;
       free(ibq);
       ibq=tbq;
@@ -825,6 +879,26 @@ mkprof(struct mkprofparams *p)
       if(err) error(EXIT_FAILURE, 0, "%s: condition variable not initialized",
                     __func__);
 
+      /* Each thread puts its built profiles into the merged image, so
+         initialize the mutexes of the bands of the merged image. */
+      if(p->out)
+        {
+          p->numbands = ( p->out->dsize[0]<MKPROF_MERGE_MAXBANDS
+                          ? p->out->dsize[0] : MKPROF_MERGE_MAXBANDS );
+          p->bandrows = ( p->out->dsize[0] + p->numbands - 1 ) / p->numbands;
+          p->numbands = ( p->out->dsize[0] + p->bandrows - 1 ) / p->bandrows;
+          errno=0;
+          p->bandlocks=malloc(p->numbands * sizeof *p->bandlocks);
+          if(p->bandlocks==NULL)
+            error(EXIT_FAILURE, errno, "%s: allocating %zu bytes for "
+                  "'p->bandlocks'", __func__,
+                  p->numbands * sizeof *p->bandlocks);
+          for(i=0;i<p->numbands;++i)
+            if( pthread_mutex_init(&p->bandlocks[i], NULL) )
+              error(EXIT_FAILURE, 0, "%s: mutex of band %zu not "
+                    "initialized", __func__, i);
+        }
+
       /* Spin off the threads: */
       for(i=0;i<nt;++i)
         if(indexs[i*thrdcols]!=GAL_BLANK_SIZE_T)
@@ -888,6 +962,13 @@ mkprof(struct mkprofparams *p)
       pthread_barrier_destroy(&b);
       pthread_cond_destroy(&p->qready);
       pthread_mutex_destroy(&p->qlock);
+      if(p->bandlocks)
+        {
+          for(i=0;i<p->numbands;++i)
+            pthread_mutex_destroy(&p->bandlocks[i]);
+          free(p->bandlocks);
+          p->bandlocks=NULL;
+        }
     }
 
   /* If a merged image was created, let the user know.... */
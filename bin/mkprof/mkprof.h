@@ -27,6 +27,17 @@ along with Gnuastro. If not, see <http://www.gnu.org/licenses/>.
 
 #include "main.h"
 
+/* A built profile that can be re-used (see 'oneprofile_cache_key'). */
+struct mkprof_cache
+{
+  double key[MKPROF_CACHE_KEYLEN];   /* Function, shape and center.   */
+  gal_data_t             *image;     /* Profile before correction.    */
+  float                peakflux;     /* Flux at profile peak.         */
+  size_t                numaccu;     /* Number of accurate pixels.    */
+  double               accufrac;     /* Sum of accurate pixels.       */
+  struct mkprof_cache     *next;     /* Next element in this bucket.  */
+};
+
 struct mkonthread
 {
   /* General parameters: */
@@ -50,6 +61,8 @@ struct mkonthread
   int          correction;   /* ==1: correct the pixels afterwards.   */
   unsigned long  rng_seed;   /* Seed used to generate this profile.   */
   gal_data_t   *customimg;   /* Custom image for this profile.        */
+  struct mkprof_cache **cache; /* Hash table of built profiles.       */
+  size_t       cachebytes;   /* Number of bytes used in the cache.    */
 
   /* Random number generator: */
   gsl_rng            *rng;   /* Copy of main random number generator. */
@@ -26,7 +26,9 @@ along with Gnuastro. If not, see <http://www.gnu.org/licenses/>.
 #include <stdio.h>
 #include <errno.h>
 #include <error.h>
+#include <string.h>
 #include <stdlib.h>
+#include <stdint.h>
 
 #include <sys/time.h>            /* generate random seed */
 #include <gsl/gsl_rng.h>         /* used in setrandoms   */
@@ -523,6 +525,158 @@ oneprofile_pix_by_pix(struct mkonthread *mkp)
 
 
 
+/**************************************************************/
+/************          Cache of profiles          *************/
+/**************************************************************/
+/* With '--profilecache', the Sersic, Moffat and Gaussian profiles (that
+   need Monte Carlo integration) with the same shape parameters and the
+   same (quantized) sub-pixel position are only built once on each thread:
+   the built profile (before its brightness is corrected) is kept in a
+   hash table and the next profiles with the same key just copy it. The
+   key is written in 'key' and the returned value is 1 if this profile
+   can be cached and 0 otherwise. */
+static int
+oneprofile_cache_key(struct mkonthread *mkp, double *key)
+{
+  size_t i;
+  struct mkprofparams *p=mkp->p;
+  size_t id=mkp->ibq->id, ndim=p->ndim;
+
+  /* Only the profiles that need integration are cached. */
+  if( mkp->cache==NULL
+      || ( mkp->func!=PROFILE_SERSIC
+           && mkp->func!=PROFILE_MOFFAT
+           && mkp->func!=PROFILE_GAUSSIAN ) )
+    return 0;
+
+  /* Set the key (the Gaussian doesn't have an index). The center of the
+     profile in its own (oversampled) image also accounts for its
+     sub-pixel position. */
+  memset(key, 0, MKPROF_CACHE_KEYLEN * sizeof *key);
+  key[0] = mkp->func;
+  key[1] = p->r[id];
+  key[2] = mkp->func==PROFILE_GAUSSIAN ? 0.0f : p->n[id];
+  key[3] = p->t[id];
+  key[4] = p->q1[id];
+  key[5] = p->p1[id];
+  if(ndim==3)
+    {
+      key[6] = p->q2[id];
+      key[7] = p->p2[id];
+      key[8] = p->p3[id];
+    }
+  for(i=0;i<ndim;++i) key[9+i] = mkp->center[i];
+  return 1;
+}
+
+
+
+
+
+/* FNV-1a hash of the key (to select the bucket). */
+static size_t
+oneprofile_cache_bucket(double *key)
+{
+  size_t i;
+  uint64_t h=14695981039346656037ULL;
+  unsigned char *c=(unsigned char *)key;
+
+  for(i=0;i<MKPROF_CACHE_KEYLEN * sizeof *key;++i)
+    { h ^= c[i]; h *= 1099511628211ULL; }
+  return h % MKPROF_CACHE_NUMBUCKETS;
+}
+
+
+
+
+
+static struct mkprof_cache *
+oneprofile_cache_find(struct mkonthread *mkp, double *key, size_t bucket)
+{
+  struct mkprof_cache *c;
+
+  for(c=mkp->cache[bucket]; c!=NULL; c=c->next)
+    if( !memcmp(c->key, key, MKPROF_CACHE_KEYLEN * sizeof *key) )
+      return c;
+  return NULL;
+}
+
+
+
+
+
+/* Keep the profile that was just built in the cache (if there is still
+   space for it). */
+static void
+oneprofile_cache_add(struct mkonthread *mkp, double *key, size_t bucket)
+{
+  struct mkprof_cache *c;
+  gal_data_t *image=mkp->ibq->image;
+  size_t bytes=image->size * gal_type_sizeof(image->type);
+
+  /* See if there is still space in the cache. */
+  if( mkp->cachebytes + bytes
+      > MKPROF_CACHE_BYTES / mkp->p->cp.numthreads )
+    return;
+
+  /* Allocate the element and fill it. */
+  errno=0;
+  c=malloc(sizeof *c);
+  if(c==NULL)
+    error(EXIT_FAILURE, errno, "%s: allocating %zu bytes for 'c'",
+          __func__, sizeof *c);
+  memcpy(c->key, key, MKPROF_CACHE_KEYLEN * sizeof *key);
+  c->image    = gal_data_copy(image);
+  c->peakflux = mkp->peakflux;
+  c->numaccu  = mkp->ibq->numaccu;
+  c->accufrac = mkp->ibq->accufrac;
+
+  /* Put it on top of its bucket. */
+  c->next=mkp->cache[bucket];
+  mkp->cache[bucket]=c;
+  mkp->cachebytes+=bytes;
+}
+
+
+
+
+
+void
+oneprofile_cache_free(struct mkonthread *mkp)
+{
+  size_t i;
+  struct mkprof_cache *c, *tmp;
+
+  for(i=0;i<MKPROF_CACHE_NUMBUCKETS;++i)
+    for(c=mkp->cache[i]; c!=NULL; c=tmp)
+      {
+        tmp=c->next;
+        gal_data_free(c->image);
+        free(c);
+      }
+  free(mkp->cache);
+  mkp->cache=NULL;
+}
+
+
+
+
+
+
+
+
+
+
+
+
+
+
+
+
+
+
+
+
 /**************************************************************/
 /************        Set profile parameters       *************/
 /**************************************************************/
@@ -557,7 +711,7 @@ oneprofile_custom_img(struct mkprofparams *p, size_t id)
   timg=p->customimgname; for(i=1;i<imgcounter;++i) timg=timg->next;
   if(p->customimghdu->next)
     for(i=1;i<imgcounter;++i) thdu=thdu->next;
-  out=gal_fits_img_read_to_type(timg->v, thdu->v, GAL_TYPE_FLOAT32,
+  out=gal_fits_img_read_to_type(timg->v, thdu->v, GAL_TYPE_FLOAT32, 1,
                                 p->cp.minmapsize, p->cp.quietmmap);
 
   /* Make sure the image has an odd number of pixels on each side. */
@@ -640,6 +794,21 @@ oneprofile_set_prof_params(struct mkonthread *mkp)
     }
 
 
+  /* When built profiles are re-used, the centers of the profiles that
+     can be cached are quantized (in steps of '1/profilecache' pixels) so
+     profiles with the same shape can have the same sub-pixel position. */
+  if( p->profilecache
+      && ( mkp->func==PROFILE_SERSIC
+           || mkp->func==PROFILE_MOFFAT
+           || mkp->func==PROFILE_GAUSSIAN ) )
+    {
+      p->x[id] = round(p->x[id]*p->profilecache)/p->profilecache;
+      p->y[id] = round(p->y[id]*p->profilecache)/p->profilecache;
+      if(ndim==3)
+        p->z[id] = round(p->z[id]*p->profilecache)/p->profilecache;
+    }
+
+
   /* Fill the profile-dependent parameters. */
   switch (mkp->func)
     {
@@ -806,7 +975,9 @@ oneprofile_make(struct mkonthread *mkp)
 
   double sum;
   float *f, *ff;
-  size_t i, dsize[3], ndim=p->ndim;
+  struct mkprof_cache *c=NULL;
+  double key[MKPROF_CACHE_KEYLEN];
+  size_t i, bucket=0, dsize[3], ndim=p->ndim;
 
 
   /* Find the profile center in the over-sampled image in C
@@ -829,15 +1000,34 @@ oneprofile_make(struct mkonthread *mkp)
         }
 
 
+      /* See if an identical profile has already been built. */
+      if( oneprofile_cache_key(mkp, key) )
+        c=oneprofile_cache_find(mkp, key,
+                                bucket=oneprofile_cache_bucket(key));
+
+
       /* Allocate and clear the array for this one profile. */
       mkp->ibq->image=gal_data_alloc(NULL, GAL_TYPE_FLOAT32, ndim, dsize,
-                                     NULL, 1, p->cp.minmapsize,
+                                     NULL, c==NULL, p->cp.minmapsize,
                                      p->cp.quietmmap, "MOCK",
                                      "Brightness", NULL);
 
 
-      /* Build the profile in the image. */
-      oneprofile_pix_by_pix(mkp);
+      /* Build the profile in the image (or copy it from the cache). */
+      if(c)
+        {
+          memcpy(mkp->ibq->image->array, c->image->array,
+                 c->image->size * gal_type_sizeof(c->image->type));
+          mkp->peakflux      = c->peakflux;
+          mkp->ibq->numaccu  = c->numaccu;
+          mkp->ibq->accufrac = c->accufrac;
+        }
+      else
+        {
+          oneprofile_pix_by_pix(mkp);
+          if( oneprofile_cache_key(mkp, key) )
+            oneprofile_cache_add(mkp, key, bucket);
+        }
     }
 
   /* Correct the sum of pixels in the profile so it has the fixed total
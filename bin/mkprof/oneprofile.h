@@ -34,4 +34,7 @@ oneprofile_set_prof_params(struct mkonthread *mkp);
 void
 oneprofile_make(struct mkonthread *mkp);
 
+void
+oneprofile_cache_free(struct mkonthread *mkp);
+
 #endif
@@ -1727,7 +1727,7 @@ ui_finalize_coordinates(struct mkprofparams *p)
         }
 
       /* Convert the world coordinates to image coordinates (inplace). */
-      gal_wcs_world_to_img(coords, p->wcs, 1);
+      gal_wcs_world_to_img(coords, p->wcs, 1, p->cp.numthreads);
 
       /* Remove all blank elements (where WCSLIB couldn't do the
          conversion) and print a warning for those rows. IMPORTANT: we
@@ -1952,6 +1952,7 @@ ui_read_ndim(struct mkprofparams *p)
               /* Read the image. */
               p->out=gal_array_read_one_ch_to_type(p->backname, p->backhdu,
                                                    NULL, GAL_TYPE_FLOAT32,
+                                                   p->cp.numthreads,
                                                    p->cp.minmapsize,
                                                    p->cp.quietmmap);
               p->out->ndim=gal_dimension_remove_extra(p->out->ndim,
@@ -85,6 +85,32 @@ struct argp_option program_options[] =
       GAL_OPTIONS_NOT_MANDATORY,
       GAL_OPTIONS_NOT_SET
     },
+    {
+      "previnput",
+      UI_KEY_PREVINPUT,
+      "FITS",
+      0,
+      "Input of '--convolved': only convolve changes.",
+      GAL_OPTIONS_GROUP_INPUT,
+      &p->previnputname,
+      GAL_TYPE_STRING,
+      GAL_OPTIONS_RANGE_ANY,
+      GAL_OPTIONS_NOT_MANDATORY,
+      GAL_OPTIONS_NOT_SET
+    },
+    {
+      "prevhdu",
+      UI_KEY_PREVHDU,
+      "STR",
+      0,
+      "HDU/extension of '--previnput'.",
+      GAL_OPTIONS_GROUP_INPUT,
+      &p->prevhdu,
+      GAL_TYPE_STRING,
+      GAL_OPTIONS_RANGE_ANY,
+      GAL_OPTIONS_NOT_MANDATORY,
+      GAL_OPTIONS_NOT_SET
+    },
     {
       "widekernel",
       UI_KEY_WIDEKERNEL,
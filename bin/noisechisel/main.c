@@ -26,6 +26,7 @@ along with Gnuastro. If not, see <http://www.gnu.org/licenses/>.
 #include <stdlib.h>
 
 #include <gnuastro-internal/timing.h>
+#include <gnuastro-internal/server.h>
 
 #include "main.h"
 
@@ -40,6 +41,9 @@ main (int argc, char *argv[])
   struct timeval t1;
   struct noisechiselparams p={{{0},0},{0},0};
 
+  /* If a server is running for this program, let it do the job. */
+  gal_server_main(argc, argv, PROGRAM_EXEC, main);
+
   /* Set they starting time. */
   time(&p.rawtime);
   gettimeofday(&t1, NULL);
@@ -48,6 +48,8 @@ struct noisechiselparams
   char                  *khdu;  /* Kernel HDU.                            */
   char         *convolvedname;  /* Convolved image (to avoid convolution).*/
   char                  *chdu;  /* HDU of convolved image.                */
+  char         *previnputname;  /* Input that gave the convolved image.   */
+  char               *prevhdu;  /* HDU of previous input.                 */
   char        *widekernelname;  /* Name of wider kernel to be used.       */
   char                  *whdu;  /* Wide kernel HDU.                       */
 
@@ -102,6 +104,7 @@ struct noisechiselparams
   gal_data_t          *kernel;  /* Sharper kernel.                        */
   gal_data_t      *widekernel;  /* Wider kernel.                          */
   gal_data_t            *conv;  /* Convolved wth sharper kernel.          */
+  gal_data_t       *previnput;  /* Input of the given convolved image.    */
   gal_data_t           *wconv;  /* Convolved with wider kernel.           */
   gal_data_t          *binary;  /* For binary operations.                 */
   gal_data_t          *olabel;  /* Labels of objects in the detection.    */
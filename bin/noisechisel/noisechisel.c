@@ -25,10 +25,14 @@ along with Gnuastro. If not, see <http://www.gnu.org/licenses/>.
 #include <stdio.h>
 #include <errno.h>
 #include <error.h>
+#include <string.h>
 #include <stdlib.h>
 
 #include <gnuastro/fits.h>
+#include <gnuastro/tile.h>
 #include <gnuastro/blank.h>
+#include <gnuastro/threads.h>
+#include <gnuastro/pointer.h>
 #include <gnuastro/convolve.h>
 
 #include <gnuastro-internal/timing.h>
@@ -53,6 +57,137 @@ along with Gnuastro. If not, see <http://www.gnu.org/licenses/>.
 /***********************************************************************/
 /*************  Wrapper functions (for clean high-level) ***************/
 /***********************************************************************/
+/* Parameters to find the tiles that have changed. */
+struct noisechisel_changed_params
+{
+  uint8_t               *changed;  /* Flag for each tile.               */
+  struct noisechiselparams    *p;  /* Pointer to main program structure.*/
+};
+
+
+
+
+
+/* See if any pixel of the tile differs from the previous input. */
+static void *
+noisechisel_changed_worker(void *in_prm)
+{
+  struct gal_threads_params *tprm=(struct gal_threads_params *)in_prm;
+  struct noisechisel_changed_params *cprm
+    =(struct noisechisel_changed_params *)(tprm->params);
+  struct noisechiselparams *p=cprm->p;
+
+  size_t i, tind;
+  gal_data_t *tile;
+  uint8_t changed;
+
+  /* Go over all the tiles given to this thread. Note that a NaN isn't
+     equal to anything (even itself), so they are checked separately. */
+  for(i=0; tprm->indexs[i] != GAL_BLANK_SIZE_T; ++i)
+    {
+      changed=0;
+      tile=&p->cp.tl.tiles[ tind=tprm->indexs[i] ];
+      GAL_TILE_PO_OISET(float, float, tile, p->previnput, 1, 0, {
+          if( *i!=*o && !( isnan(*i) && isnan(*o) ) ) changed=1;
+        });
+      cprm->changed[tind]=changed;
+    }
+
+  /* Wait for all threads to finish and return. */
+  if(tprm->b) pthread_barrier_wait(tprm->b);
+  return NULL;
+}
+
+
+
+
+
+/* The convolved image that was given to '--convolved' was made from the
+   input given to '--previnput'. Only the regions that differ between it
+   and the current input need to be convolved again: any tile that is
+   within half a kernel of a tile with a changed pixel. */
+static void
+noisechisel_convolve_changed(struct noisechiselparams *p)
+{
+  char *msg;
+  uint8_t *affected;
+  struct timeval t1;
+  struct noisechisel_changed_params cprm;
+  struct gal_tile_two_layer_params *tl=&p->cp.tl;
+  size_t i, j, d, ndim=p->input->ndim, numtiles=tl->tottiles;
+  size_t *se, *tileids, *ks=p->kernel->dsize, numchanged=0, numconv=0;
+
+  /* Find the tiles with changed pixels. */
+  if(!p->cp.quiet) gettimeofday(&t1, NULL);
+  cprm.p=p;
+  cprm.changed=gal_pointer_allocate(GAL_TYPE_UINT8, numtiles, 0, __func__,
+                                    "cprm.changed");
+  gal_threads_spin_off(noisechisel_changed_worker, &cprm, numtiles,
+                       p->cp.numthreads, p->cp.minmapsize,
+                       p->cp.quietmmap);
+
+  /* Starting and ending coordinates of all the tiles. */
+  se=gal_pointer_allocate(GAL_TYPE_SIZE_T, 2*ndim*numtiles, 0, __func__,
+                          "se");
+  for(i=0;i<numtiles;++i)
+    {
+      gal_tile_start_end_coord(&tl->tiles[i], &se[2*ndim*i], 1);
+      numchanged += cprm.changed[i];
+    }
+
+  /* A tile must be convolved again when it overlaps with the region
+     around a changed tile that is within half a kernel of it. When more
+     than half of the tiles have changed, checking the tiles against each
+     other isn't worth it: all the tiles will be convolved again. */
+  affected=gal_pointer_allocate(GAL_TYPE_UINT8, numtiles, 1, __func__,
+                                "affected");
+  if(numchanged > numtiles/2)
+    memset(affected, 1, numtiles);
+  else
+    for(j=0;j<numtiles;++j)
+      if(cprm.changed[j])
+        for(i=0;i<numtiles;++i)
+          if(affected[i]==0)
+            {
+              /* Note that the ending coordinates are not inclusive. */
+              for(d=0;d<ndim;++d)
+                if( se[2*ndim*i+d] >= se[2*ndim*j+ndim+d] + ks[d]/2
+                    || se[2*ndim*i+ndim+d] + ks[d]/2 <= se[2*ndim*j+d] )
+                  break;
+              if(d==ndim) affected[i]=1;
+            }
+
+  /* Put the IDs of the affected tiles in one array and convolve them
+     into the convolved image. */
+  tileids=gal_pointer_allocate(GAL_TYPE_SIZE_T, numtiles, 0, __func__,
+                               "tileids");
+  for(i=0;i<numtiles;++i) if(affected[i]) tileids[numconv++]=i;
+  gal_convolve_spatial_tiles(tl->tiles, p->kernel, p->cp.numthreads, 1,
+                             tl->workoverch, tileids, numconv, p->conv);
+
+  /* Report the result. */
+  if(!p->cp.quiet)
+    {
+      if( asprintf(&msg, "Convolved %zu of %zu tiles (changed in %zu).",
+                   numconv, numtiles, numchanged)<0 )
+        error(EXIT_FAILURE, 0, "%s: asprintf allocation", __func__);
+      gal_timing_report(&t1, msg, 1);
+      free(msg);
+    }
+
+  /* Clean up (the previous input is no longer necessary). */
+  free(se);
+  free(tileids);
+  free(affected);
+  free(cprm.changed);
+  gal_data_free(p->previnput);
+  p->previnput=NULL;
+}
+
+
+
+
+
 static void
 noisechisel_convolve(struct noisechiselparams *p)
 {
@@ -83,6 +218,11 @@ noisechisel_convolve(struct noisechiselparams *p)
         p->conv=p->input;
     }
 
+  /* If the input of the given convolved image is also given, convolve
+     the regions that have changed since then. */
+  else if(p->previnput)
+    noisechisel_convolve_changed(p);
+
   /* Set a fixed name for the convolved image (since it will be used in
      many check images). */
   if(p->conv!=p->input)
@@ -143,7 +283,9 @@ noisechisel_output(struct noisechiselparams *p)
   gal_fits_list_key_t *keys=NULL;
 
 
-  /* Put a copy of the input into the output (when necessary). */
+  /* Put a copy of the input into the output (when necessary). Note that
+     the image HDUs are written asynchronously: while one HDU is being
+     written, the next one is prepared. */
   if(p->rawoutput==0)
     {
       /* Subtract the Sky value. */
@@ -152,7 +294,8 @@ noisechisel_output(struct noisechiselparams *p)
       /* Correct the name of the input and write it out. */
       if(p->input->name) free(p->input->name);
       p->input->name="INPUT-NO-SKY";
-      gal_fits_img_write(p->input, p->cp.output, NULL, PROGRAM_NAME);
+      gal_fits_img_write_async(p->input, p->cp.output, NULL, PROGRAM_NAME,
+                               0);
       p->input->name=NULL;
     }
 
@@ -169,13 +312,15 @@ noisechisel_output(struct noisechiselparams *p)
   if(p->label)
     {
       p->olabel->name = "DETECTIONS";
-      gal_fits_img_write(p->olabel, p->cp.output, keys, PROGRAM_NAME);
+      gal_fits_img_write_async(p->olabel, p->cp.output, keys,
+                               PROGRAM_NAME, 0);
       p->olabel->name=NULL;
     }
   else
     {
       p->binary->name = "DETECTIONS";
-      gal_fits_img_write(p->binary, p->cp.output, keys, PROGRAM_NAME);
+      gal_fits_img_write_async(p->binary, p->cp.output, keys,
+                               PROGRAM_NAME, 0);
       p->binary->name=NULL;
     }
   keys=NULL;
@@ -184,8 +329,9 @@ noisechisel_output(struct noisechiselparams *p)
   /* Write the Sky image into the output */
   if(p->sky->name) free(p->sky->name);
   p->sky->name="SKY";
-  gal_tile_full_values_write(p->sky, &p->cp.tl, !p->ignoreblankintiles,
-                             p->cp.output, NULL, PROGRAM_NAME);
+  gal_tile_full_values_write_async(p->sky, &p->cp.tl,
+                                   !p->ignoreblankintiles, p->cp.output,
+                                   NULL, PROGRAM_NAME);
   p->sky->name=NULL;
 
 
@@ -200,11 +346,18 @@ noisechisel_output(struct noisechiselparams *p)
   gal_fits_key_list_add(&keys, GAL_TYPE_FLOAT32, "MEDSTD", 0, &p->medstd, 0,
                         "Median raw tile standard deviation", 0,
                         p->input->unit, 0);
-  gal_tile_full_values_write(p->std, &p->cp.tl, !p->ignoreblankintiles,
-                             p->cp.output, keys, PROGRAM_NAME);
+  gal_tile_full_values_write_async(p->std, &p->cp.tl,
+                                   !p->ignoreblankintiles, p->cp.output,
+                                   keys, PROGRAM_NAME);
   p->std->name=NULL;
 
 
+  /* The HDUs above are written on a background thread (while the next
+     HDU is being prepared). Wait for them to be written before touching
+     the output file again. */
+  gal_fits_img_write_async_wait();
+
+
   /* Write the configuration keywords. */
   gal_fits_key_write_filename("input", p->inputname, &p->cp.okeys, 1,
                               p->cp.quiet);
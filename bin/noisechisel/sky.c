@@ -63,6 +63,7 @@ sky_mean_std_undetected(void *in_prm)
   size_t i, tind, numsky, bdsize=2, ndim=p->sky->ndim;
   size_t refarea, twidth=gal_type_sizeof(GAL_TYPE_FLOAT32);
   gal_data_t *tile, *fusage, *busage, *bintile, *sigmaclip;
+  gal_statistics_workspace_t *ws=gal_statistics_workspace_alloc();
 
 
   /* Put the temporary usage space for this thread into a data set for easy
@@ -129,9 +130,12 @@ sky_mean_std_undetected(void *in_prm)
               gal_blank_flag_apply(fusage, busage);
 
 
-              /* Do the sigma-clipping. */
-              sigmaclip=gal_statistics_sigma_clip(fusage, p->sigmaclip[0],
-                                                  p->sigmaclip[1], 1, 1);
+              /* Do the sigma-clipping. Note that the output is kept in
+                 the workspace (to avoid allocations on every tile), so it
+                 shouldn't be freed. */
+              sigmaclip=gal_statistics_sigma_clip_ws(fusage, p->sigmaclip[0],
+                                                     p->sigmaclip[1], 1, 1,
+                                                     ws);
 
 
               /* When there are zero-valued pixels on the edges of the
@@ -145,10 +149,9 @@ sky_mean_std_undetected(void *in_prm)
               else
                 {
                   /* Copy the sigma-clipped mean and STD to their
-                     respective places in the tile arrays. But first, make
-                     sure 'sigmaclip' has the same type as the sky and std
-                     arrays. */
-                  sigmaclip=gal_data_copy_to_new_type_free(sigmaclip, type);
+                     respective places in the tile arrays. Note that
+                     'sigmaclip' has the same type (float32) as the sky
+                     and std arrays. */
                   memcpy(gal_pointer_increment(p->sky->array, tind, type),
                          gal_pointer_increment(sigmaclip->array, 2, type),
                          twidth);
@@ -156,9 +159,6 @@ sky_mean_std_undetected(void *in_prm)
                          gal_pointer_increment(sigmaclip->array, 3, type),
                          twidth);
                 }
-
-              /* Clean up. */
-              gal_data_free(sigmaclip);
             }
           else
             setblank=1;
@@ -180,6 +180,7 @@ sky_mean_std_undetected(void *in_prm)
   gal_data_free(fusage);
   gal_data_free(busage);
   gal_data_free(bintile);
+  gal_statistics_workspace_free(ws);
   if(tprm->b) pthread_barrier_wait(tprm->b);
   return NULL;
 }
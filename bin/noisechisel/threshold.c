@@ -226,7 +226,7 @@ threshold_write_sn_table(struct noisechiselparams *p, gal_data_t *insn,
      FITS file. We have already deleted any existing file with the same
      name in 'ui_set_output_names'.*/
   gal_table_write(cols, NULL, comments, p->cp.tableformat, filename,
-                  extname, 0);
+                  extname, 0, p->cp.numthreads);
 
 
   /* Clean up (if necessary). */
@@ -400,6 +400,7 @@ qthresh_on_tile(void *in_prm)
   gal_data_t *meanconv = p->wconv ? p->wconv : p->conv;
   size_t i, tind, twidth=gal_type_sizeof(type), ndim=p->input->ndim;
   gal_data_t *tile, *mean, *num, *meanquant, *qvalue, *usage, *tblock=NULL;
+  gal_statistics_workspace_t *ws=gal_statistics_workspace_alloc();
 
   /* Put the temporary usage space for this thread into a data set for easy
      processing. */
@@ -436,12 +437,14 @@ qthresh_on_tile(void *in_prm)
 
       /* Find the mean's quantile on this tile, note that we have already
          copied the tile's dataset to a newly allocated place. So we have
-         set the 'inplace' flag to '1' to avoid extra allocation. */
-      mean=gal_statistics_mean(usage);
-      num=gal_statistics_number(usage);
-      mean=gal_data_copy_to_new_type_free(mean, usage->type);
+         set the 'inplace' flag to '1' to avoid extra allocation. Also
+         note that the outputs of the '_ws' functions are kept within the
+         workspace (they shouldn't be freed), and the type of 'mean' will
+         be converted to the type of 'usage' internally. */
+      mean=gal_statistics_mean_ws(usage, ws);
+      num=gal_statistics_number_ws(usage, ws);
       meanquant = ( *(size_t *)(num->array)
-                    ? gal_statistics_quantile_function(usage, mean, 1)
+                    ? gal_statistics_quantile_function_ws(usage, mean, 1, ws)
                     : NULL );
 
       /* Only continue if the mean's quantile is close enough to the
@@ -469,25 +472,23 @@ qthresh_on_tile(void *in_prm)
 
           /* Get the erosion quantile for this tile and save it. Note that
              the type of 'qvalue' is the same as the input dataset. */
-          qvalue=gal_statistics_quantile(usage, p->qthresh, 1);
+          qvalue=gal_statistics_quantile_ws(usage, p->qthresh, 1, ws);
           memcpy(gal_pointer_increment(qprm->erode_th->array, tind, type),
                  qvalue->array, twidth);
-          gal_data_free(qvalue);
 
           /* Same for the no-erode quantile. */
-          qvalue=gal_statistics_quantile(usage, p->noerodequant, 1);
+          qvalue=gal_statistics_quantile_ws(usage, p->noerodequant, 1, ws);
           memcpy(gal_pointer_increment(qprm->noerode_th->array, tind, type),
                  qvalue->array, twidth);
-          gal_data_free(qvalue);
 
           /* Same for the expansion quantile. */
           if(qprm->expand_th)
             {
-              qvalue=gal_statistics_quantile(usage, p->detgrowquant, 1);
+              qvalue=gal_statistics_quantile_ws(usage, p->detgrowquant, 1,
+                                                ws);
               memcpy(gal_pointer_increment(qprm->expand_th->array, tind,
                                             type),
                      qvalue->array, twidth);
-              gal_data_free(qvalue);
             }
         }
       else
@@ -501,15 +502,12 @@ qthresh_on_tile(void *in_prm)
                                                    tind, type), type);
         }
 
-      /* Clean up and fix the tile's pointers. */
-      gal_data_free(num);
-      gal_data_free(mean);
-      gal_data_free(meanquant);
     }
 
   /* Clean up and wait for the other threads to finish, then return. */
   usage->array=NULL;  /* Not allocated here. */
   gal_data_free(usage);
+  gal_statistics_workspace_free(ws);
   if(tprm->b) pthread_barrier_wait(tprm->b);
   return NULL;
 }
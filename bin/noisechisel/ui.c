@@ -232,6 +232,21 @@ ui_read_check_only_options(struct noisechiselparams *p)
           "and avoid convolution) it is mandatory to also specify a HDU "
           "for it");
 
+  /* The previous input is only meaningful with a convolved image and
+     needs its own HDU. */
+  if(p->previnputname)
+    {
+      if(p->convolvedname==NULL)
+        error(EXIT_FAILURE, 0, "'--previnput' is only meaningful with "
+              "'--convolved'. It is the input image that the image given "
+              "to '--convolved' was convolved from, so only the regions "
+              "that have changed since then are convolved again");
+      if(p->prevhdu==NULL)
+        error(EXIT_FAILURE, 0, "no value given to '--prevhdu'. When the "
+              "'--previnput' option is called, it is mandatory to also "
+              "specify a HDU for it");
+    }
+
   /* Make sure that the no-erode-quantile is not smaller or equal to
      qthresh. */
   if( p->noerodequant <= p->qthresh)
@@ -607,6 +622,7 @@ ui_preparations_read_input(struct noisechiselparams *p)
      (with a length of 1). */
   p->input = gal_array_read_one_ch_to_type(p->inputname, p->cp.hdu,
                                            NULL, GAL_TYPE_FLOAT32,
+                                           p->cp.numthreads,
                                            p->cp.minmapsize,
                                            p->cp.quietmmap);
   p->input->wcs = gal_wcs_read(p->inputname, p->cp.hdu,
@@ -680,6 +696,7 @@ ui_preparations(struct noisechiselparams *p)
       /* Read the input convolved image. */
       p->conv = gal_array_read_one_ch_to_type(p->convolvedname, p->chdu,
                                               NULL, GAL_TYPE_FLOAT32,
+                                              p->cp.numthreads,
                                               p->cp.minmapsize,
                                               p->cp.quietmmap);
 
@@ -689,6 +706,28 @@ ui_preparations(struct noisechiselparams *p)
               "'--convolvehdu', is not the same size as NoiseChisel's "
               "input: %s (hdu: %s)", p->convolvedname, p->chdu,
               p->inputname, p->cp.hdu);
+
+      /* If the input of the convolved image is given, the kernel is
+         necessary to convolve the changed regions again. */
+      if(p->previnputname)
+        {
+          p->previnput = gal_array_read_one_ch_to_type(p->previnputname,
+                                                       p->prevhdu, NULL,
+                                                       GAL_TYPE_FLOAT32,
+                                                       p->cp.numthreads,
+                                                       p->cp.minmapsize,
+                                                       p->cp.quietmmap);
+          if( gal_dimension_is_different(p->input, p->previnput) )
+            error(EXIT_FAILURE, 0, "%s (hdu %s), given to '--previnput' "
+                  "and '--prevhdu', is not the same size as NoiseChisel's "
+                  "input: %s (hdu: %s)", p->previnputname, p->prevhdu,
+                  p->inputname, p->cp.hdu);
+          ui_prepare_kernel(p);
+          if(p->kernel==NULL)
+            error(EXIT_FAILURE, 0, "'--previnput' needs a kernel to "
+                  "convolve the changed regions of the input, but no "
+                  "convolution was requested with '--kernel'");
+        }
     }
   else
     ui_prepare_kernel(p);
@@ -798,8 +837,13 @@ ui_read_check_inputs_setup(int argc, char *argv[],
              p->cp.numthreads==1 ? "." : "s.");
       printf("  - Input: %s (hdu: %s)\n", p->inputname, p->cp.hdu);
       if(p->convolvedname)
-        printf("  - Convolved input: %s (hdu: %s)\n",
-               p->convolvedname, p->chdu);
+        {
+          printf("  - Convolved input: %s (hdu: %s)\n",
+                 p->convolvedname, p->chdu);
+          if(p->previnputname)
+            printf("  - Its input: %s (hdu: %s)\n",
+                   p->previnputname, p->prevhdu);
+        }
       else
         {
           if(p->kernelname)
@@ -898,6 +942,7 @@ ui_free_report(struct noisechiselparams *p, struct timeval *t1)
   if(p->khdu) free(p->khdu);
   if(p->whdu) free(p->whdu);
   if(p->chdu) free(p->chdu);
+  if(p->prevhdu) free(p->prevhdu);
   if(p->skyname) free(p->skyname);
   if(p->detskyname) free(p->detskyname);
   if(p->qthreshname) free(p->qthreshname);
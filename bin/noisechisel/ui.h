@@ -103,6 +103,8 @@ enum option_keys_enum
   UI_KEY_CHECKSKY,
   UI_KEY_RAWOUTPUT,
   UI_KEY_IGNOREBLANKINTILES,
+  UI_KEY_PREVINPUT,
+  UI_KEY_PREVHDU,
 };
 
 
@@ -271,7 +271,7 @@ query_output_data(struct queryparams *p)
                        p->cp.minmapsize, p->cp.quietmmap, NULL);
   gal_table_write(table, NULL, NULL, p->cp.tableformat,
                   p->cp.output ? p->cp.output : p->cp.output,
-                  "QUERY", 0);
+                  "QUERY", 0, p->cp.numthreads);
 
   /* Get basic information about the table and free it. */
   p->outtableinfo[0]=table->size;
@@ -556,7 +556,7 @@ clumps_write_sn_table(struct segmentparams *p, gal_data_t *insn,
 
   /* write the table. */
   gal_table_write(cols, NULL, comments, p->cp.tableformat, filename,
-                  "SKY_CLUMP_SN", 0);
+                  "SKY_CLUMP_SN", 0, p->cp.numthreads);
 
   /* Clean up (if necessary). */
   if(sn!=insn) gal_data_free(sn);
@@ -205,272 +205,169 @@ segment_relab_noseg(struct clumps_thread_params *cltprm)
 
 
 
-/* Find the adjacency matrixs (number, sum and signal to noise) for the
-   rivers between potentially separate objects in a detection region. They
-   have to be allocated prior to entering this function.
-
-   The way to find connected objects is through an adjacency matrix. It is
-   a square matrix with a side equal to numobjs. So to see if regions 'a'
-   and 'b' are connected. All we have to do is to look at element
-   a*numobjs+b or b*numobjs+a and get the answer. Since the number of
-   objects in a given region will not be too high, this is efficient. */
-static void
-segment_relab_to_objects_array(struct clumps_thread_params *cltprm)
+/* The rivers between the clumps of a detection are kept as the edges of a
+   graph in an open-addressing hash table: each edge is the pair of clump
+   labels ('a<b') with the number of river pixels between them and the sum
+   of their (averaged) values. So the memory and processing is linear in
+   the number of clump boundaries (not the square of the number of
+   clumps). */
+struct segment_relab_edge
 {
-  size_t amwidth=cltprm->numtrueclumps+1;
-  struct segmentparams *p=cltprm->clprm->p;
-  size_t ndim=p->input->ndim, *dsize=p->input->dsize;
+  int32_t             a;     /* Smaller label (0: empty slot in table).  */
+  int32_t             b;     /* Larger label.                            */
+  size_t            num;     /* Number of river pixels.                  */
+  double            sum;     /* Sum of values of river pixels.           */
+};
 
-  size_t mdsize[2]={amwidth, amwidth};
-  gal_data_t *nums_d=gal_data_alloc(NULL, GAL_TYPE_SIZE_T, 2, mdsize, NULL,
-                                    1, p->cp.minmapsize, p->cp.quietmmap,
-                                    NULL, NULL, NULL);
-  gal_data_t *sums_d=gal_data_alloc(NULL, GAL_TYPE_FLOAT64, 2, mdsize, NULL,
-                                    1, p->cp.minmapsize, p->cp.quietmmap,
-                                    NULL, NULL, NULL);
-  gal_data_t *adjacency_d=gal_data_alloc(NULL, GAL_TYPE_UINT8, 2, mdsize,
-                                         NULL, 1, p->cp.minmapsize,
-                                         p->cp.quietmmap, NULL, NULL, NULL);
+struct segment_relab_graph
+{
+  struct segment_relab_edge *edges; /* Hash table of edges.              */
+  size_t               size;  /* Number of slots (a power of 2).         */
+  size_t                num;  /* Number of used slots.                   */
+};
 
-  float *imgss=p->input->array;
-  int32_t *olabel=p->olabel->array;
-  double var=cltprm->std*cltprm->std;
-  uint8_t *adjacency=adjacency_d->array;
-  size_t nngb=gal_dimension_num_neighbors(ndim);
-  size_t *dinc=gal_dimension_increment(ndim, dsize);
-  size_t *s, *sf, i, j, ii, rpnum, *nums=nums_d->array;
-  double ave, rpsum, c=sqrt(1/p->cpscorr), *sums=sums_d->array;
-  int32_t *ngblabs=gal_pointer_allocate(GAL_TYPE_UINT32, nngb, 0, __func__,
-                                         "ngblabs");
 
 
-  /* Go over all the still-unlabeled pixels (if they exist) and see which
-     labels they touch. In the process, get the average value of the
-     river-pixel values and put them in the respective adjacency
-     matrix. Note that at this point, the rivers are also part of the
-     "diffuse" regions. So we don't need to go over all the indexs of this
-     object, only its diffuse indexs. */
-  sf=(s=cltprm->diffuseindexs->array)+cltprm->diffuseindexs->size;
-  do
-    /* We only want to work on pixels that have already been identified as
-       touching more than one label: river pixels. */
-    if( olabel[ *s ]==GAL_LABEL_RIVER )
-      {
-        /* Initialize the values. */
-        i=ii=0;
-        rpnum=1;              /* River-pixel number of points used. */
-        rpsum=imgss[*s];      /* River-pixel sum of values used.    */
-        memset(ngblabs, 0, nngb*sizeof *ngblabs);
 
-        /* Check all the fully-connected neighbors of this pixel and
-           see if it touches a label or not */
-        GAL_DIMENSION_NEIGHBOR_OP(*s, ndim, dsize, ndim, dinc, {
-            if( olabel[nind] > 0 )
-              {
-                /* Add this neighbor's value and increment the number. */
-                if( !isnan(imgss[nind]) ) { ++rpnum; rpsum+=imgss[nind]; }
 
-                /* Go over the already found neighbors and see if this
-                   grown clump has already been considered or not. */
-                for(i=0;i<ii;++i) if(ngblabs[i]==olabel[nind]) break;
+static struct segment_relab_edge *
+segment_relab_graph_alloc(size_t size)
+{
+  struct segment_relab_edge *edges;
 
-                /* This is the first time we are getting to this
-                   neighbor: */
-                if(i==ii) ngblabs[ ii++ ] = olabel[nind];
-              }
-          } );
+  errno=0;
+  edges=calloc(size, sizeof *edges);
+  if(edges==NULL)
+    error(EXIT_FAILURE, errno, "%s: couldn't allocate %zu bytes for "
+          "'edges'", __func__, size * sizeof *edges);
+  return edges;
+}
 
-        /* For a check:
-        if(ii>0)
-          {
-            printf("%zu, %zu:\n", *s%dsize[1]+1, *s/dsize[1]+1);
-            for(i=0;i<ii;++i) printf("\t%u\n", ngblabs[i]);
-          }
-        */
 
-        /* If more than one neighboring label was found, fill in the
-           'sums' and 'nums' adjacency matrixs with the values for this
-           pixel. Recall that ii is the number of neighboring labels to
-           this river pixel. */
-        if(ii>i)
-          for(i=0;i<ii;++i)
-            for(j=0;j<ii;++j)
-              if(i!=j)
-                {
-                  /* For safety, we will fill both sides of the
-                     diagonal. */
-                  ++nums[ ngblabs[i] * amwidth + ngblabs[j] ];
-                  ++nums[ ngblabs[j] * amwidth + ngblabs[i] ];
-                  sums[ ngblabs[i] * amwidth + ngblabs[j] ] +=
-                    rpsum/rpnum;
-                  sums[ ngblabs[j] * amwidth + ngblabs[i] ] +=
-                    rpsum/rpnum;
-                }
-      }
-  while(++s<sf);
 
-  /* We now have the average values and number of all rivers between
-     the grown clumps. We now want to finalize their connection (given
-     the user's criteria). */
-  for(i=1;i<amwidth;++i)
-    for(j=1;j<i;++j)
-      {
-        ii = i * amwidth + j;
-        if(nums[ii]>p->minriverlength)       /* There is a connection. */
-          {
-            /* For easy reading. */
-            ave=sums[ii]/nums[ii];
-
-            /* In case the average is negative (only possible if 'sums'
-               is negative), don't change the adjacency: it is already
-               initialized to zero. Note that even an area of 1 is
-               acceptable, and we put no area criteria here, because
-               the fact that a river exists between two clumps is
-               important. */
-            if( ave>0.0f && ( c * ave / sqrt(ave+var) ) > p->objbordersn )
-              {
-                adjacency[ii]=1;   /* We want to set both sides of the */
-                adjacency[ j * amwidth + i ] = 1; /* Symmetric matrix. */
-              }
-          }
-      }
 
-  /* For a check:
-  if(cltprm->id==XXX)
-    {
-      printf("=====================\n");
-      printf("%zu:\n--------\n", cltprm->id);
-      for(i=1;i<amwidth;++i)
-        {
-          printf(" %zu...\n", i);
-          for(j=1;j<amwidth;++j)
-            {
-              ii=i*amwidth+j;
-              if(nums[ii])
-                {
-                  ave=sums[ii]/nums[ii];
-                  printf("    ...%zu: N:%-4zu S:%-10.2f S/N: %-10.2f "
-                         "--> %u\n", j, nums[ii], sums[ii],
-                         c*ave/sqrt(ave+var), adjacency[ii]);
-                }
-            }
-          printf("\n");
-        }
-    }
-  */
 
-  /* Calculate the new labels for each grown clump. */
-  cltprm->clumptoobj = gal_binary_connected_adjacency_matrix(adjacency_d,
-                                                     &cltprm->numobjects);
+/* Slot of the edge between 'a' and 'b' (the empty slot it should be put
+   in, if it doesn't exist yet). */
+static struct segment_relab_edge *
+segment_relab_graph_slot(struct segment_relab_edge *edges, size_t size,
+                         int32_t a, int32_t b)
+{
+  size_t h=( ( (uint64_t)a * 0x9E3779B97F4A7C15ULL ) ^ (uint64_t)b )
+           * 0xBF58476D1CE4E5B9ULL >> 17;
 
-  /* Clean up and return. */
-  free(dinc);
-  free(ngblabs);
-  gal_data_free(nums_d);
-  gal_data_free(sums_d);
-  gal_data_free(adjacency_d);
+  /* Linear probing (the table is never more than half full). */
+  for(h &= size-1; edges[h].a; h=(h+1) & (size-1))
+    if( edges[h].a==a && edges[h].b==b ) break;
+  return &edges[h];
 }
 
 
 
 
 
-/* For a large number of clumps, 'segment_relab_to_objects_array' will
-   consume too much memory and can completely fill the memory. So we need
-   to use a list-based adjacency solution. */
-typedef struct segment_relab_list_t
+/* Add one river pixel (with value 'value') between clumps 'a' and
+   'b'. Similar to the (old) adjacency matrix that was filled on both sides
+   of the diagonal for each ordered pair of labels, every river pixel is
+   counted twice (this is important for the comparison with
+   '--minriverlength'). */
+static void
+segment_relab_graph_add(struct segment_relab_graph *graph, int32_t a,
+                        int32_t b, double value)
 {
-  size_t num;
-  double sum;
-  size_t ngbid;
-  struct segment_relab_list_t *next;
-} segment_relab_list_t;
+  size_t i, oldsize;
+  struct segment_relab_edge *e, *oldedges, *ne;
 
+  /* Keep the smaller label first. */
+  if(a>b) { i=a; a=b; b=i; }
 
+  /* Find the slot of this edge, if it is new, put it in the table and
+     make the table larger when it is half full. */
+  e=segment_relab_graph_slot(graph->edges, graph->size, a, b);
+  if(e->a==0)
+    {
+      e->a=a;
+      e->b=b;
+      if( ++graph->num * 2 > graph->size )
+        {
+          oldedges=graph->edges;
+          oldsize=graph->size;
+          graph->size*=2;
+          graph->edges=segment_relab_graph_alloc(graph->size);
+          for(i=0;i<oldsize;++i)
+            if(oldedges[i].a)
+              {
+                ne=segment_relab_graph_slot(graph->edges, graph->size,
+                                            oldedges[i].a, oldedges[i].b);
+                *ne=oldedges[i];
+              }
+          free(oldedges);
+          e=segment_relab_graph_slot(graph->edges, graph->size, a, b);
+        }
+    }
+
+  /* Add this pixel (twice). */
+  e->num += 2;
+  e->sum += value;
+  e->sum += value;
+}
 
 
 
-static void
-segment_relab_list_add(struct segment_relab_list_t **list, size_t ngbid,
-                       double value)
-{
-  int done=0;
-  struct segment_relab_list_t *tmp=NULL;
 
-  /* Check if the desired index has already been found or not. Note that if
-     'list' is empty, then it will never enter the loop.*/
-  for(tmp=*list; tmp!=NULL; tmp=tmp->next)
-    if( tmp->ngbid == ngbid )
-      {
-        tmp->sum += value;
-        ++tmp->num;
-        done=1;
-        break;
-      }
 
-  /* Either the list was empty, or the desired index didn't exist in it. So
-     we need to allocate a new node and add it to the list. */
-  if(done==0)
+/* Find the root of a label in the union-find forest (with path
+   halving). */
+static int32_t
+segment_relab_find(int32_t *parent, int32_t x)
+{
+  while(parent[x]!=x)
     {
-      /* Allocate a new node. */
-      errno=0;
-      tmp=malloc(sizeof *tmp);
-      if(tmp==NULL)
-        error(EXIT_FAILURE, errno, "%s: couldn't allocate %zu bytes "
-              "for 'tmp'", __func__, sizeof tmp);
-
-      /* Fill in the node. */
-      tmp->num=1;
-      tmp->sum=value;
-      tmp->ngbid=ngbid;
-
-      /* Put the node at the top of the list. */
-      tmp->next = *list ? *list : NULL;
-      *list=tmp;
+      parent[x]=parent[ parent[x] ];
+      x=parent[x];
     }
+  return x;
 }
 
 
 
 
 
+/* Find the rivers between potentially separate objects in a detection
+   region (their number of pixels and sum of values), then use them to
+   find which clumps are connected (with a union-find). The smaller label
+   of two connected clumps always becomes the root, so the object labels
+   are given in order of their smallest clump label (exactly like the
+   connected components of an adjacency matrix). */
 static void
-segment_relab_to_objects_list(struct clumps_thread_params *cltprm)
+segment_relab_to_objects_graph(struct clumps_thread_params *cltprm)
 {
   size_t amwidth=cltprm->numtrueclumps+1;
   struct segmentparams *p=cltprm->clprm->p;
   size_t ndim=p->input->ndim, *dsize=p->input->dsize;
 
-  int addadj;
   float *imgss=p->input->array;
-  size_t *s, *sf, i, j, ii, rpnum;
+  struct segment_relab_edge *e;
+  struct segment_relab_graph graph;
   int32_t *olabel=p->olabel->array;
   double var=cltprm->std*cltprm->std;
-  gal_list_sizet_t **adjacency, *atmp;
-  segment_relab_list_t **rlist, *rtmp;
+  size_t *s, *sf, i, j, ii, rpnum, curlab=1;
   double ave, rpsum, c=sqrt(1/p->cpscorr);
   size_t nngb=gal_dimension_num_neighbors(ndim);
   size_t *dinc=gal_dimension_increment(ndim, dsize);
+  int32_t ra, rb, *parent, *clumptoobj;
   int32_t *ngblabs=gal_pointer_allocate(GAL_TYPE_UINT32, nngb, 0, __func__,
                                          "ngblabs");
 
-  /* Allocate the two lists to keep the number and sum, as well as the
-     final adjacency matrix. */
-  errno=0;
-  rlist=calloc(amwidth, sizeof *rlist);
-  if(rlist==NULL)
-    error(EXIT_FAILURE, errno, "%s: couldn't allocate %zu bytes for 'rlist'",
-          __func__, amwidth * (sizeof *rlist));
-  errno=0;
-  adjacency=calloc(amwidth, sizeof *adjacency);
-  if(adjacency==NULL)
-    error(EXIT_FAILURE, errno, "%s: couldn't allocate %zu bytes for 'adjacency'",
-          __func__, amwidth * (sizeof *adjacency));
+  /* Initialize the graph. */
+  graph.num=0;
+  graph.size=64;
+  graph.edges=segment_relab_graph_alloc(graph.size);
 
   /* Go over all the still-unlabeled pixels (if they exist) and see which
      labels they touch. In the process, get the average value of the
-     river-pixel values and put them in the respective adjacency
-     matrix. Note that at this point, the rivers are also part of the
+     river-pixel values and put them in the respective edge of the
+     graph. Note that at this point, the rivers are also part of the
      "diffuse" regions. So we don't need to go over all the indexs of this
      object, only its diffuse indexs. */
   sf=(s=cltprm->diffuseindexs->array)+cltprm->diffuseindexs->size;
@@ -483,7 +380,6 @@ segment_relab_to_objects_list(struct clumps_thread_params *cltprm)
         i=ii=0;
         rpnum=1;              /* River-pixel number of points used. */
         rpsum=imgss[*s];      /* River-pixel sum of values used.    */
-        memset(ngblabs, 0, nngb*sizeof *ngblabs);
 
         /* Check all the fully-connected neighbors of this pixel and
            see if it touches a label or not */
@@ -503,107 +399,62 @@ segment_relab_to_objects_list(struct clumps_thread_params *cltprm)
               }
           } );
 
-        /* For a check:
-        if(ii>0)
-          {
-            printf("%zu, %zu:\n", *s%dsize[1]+1, *s/dsize[1]+1);
-            for(i=0;i<ii;++i) printf("\t%u\n", ngblabs[i]);
-          }
-        */
-
-        /* If more than one neighboring label was found, fill in the
-           'sums' and 'nums' adjacency matrixs with the values for this
-           pixel. Recall that ii is the number of neighboring labels to
-           this river pixel. */
-        if(ii>i)
+        /* If more than one neighboring label was found, add this pixel to
+           the edges between all of them. */
+        if(ii>1)
           for(i=0;i<ii;++i)
-            for(j=0;j<ii;++j)
-              if(i!=j)
-                {
-                  /* For safety and ease of processing, we will fill
-                     both sides of the diagonal. */
-                  segment_relab_list_add(&rlist[ ngblabs[i] ], ngblabs[j],
-                                         rpsum/rpnum);
-                  segment_relab_list_add(&rlist[ ngblabs[j] ], ngblabs[i],
-                                         rpsum/rpnum);
-                }
+            for(j=i+1;j<ii;++j)
+              segment_relab_graph_add(&graph, ngblabs[i], ngblabs[j],
+                                      rpsum/rpnum);
       }
   while(++s<sf);
 
-  /* We now have the average values and number of all rivers between
-     the grown clumps. We now want to finalize their connection (given
-     the user's criteria). */
-  for(i=1; i<amwidth; ++i)
-    for(rtmp=rlist[i]; rtmp!=NULL; rtmp=rtmp->next)
+  /* Initialize the union-find forest: each clump is its own root. */
+  parent=gal_pointer_allocate(GAL_TYPE_INT32, amwidth, 0, __func__,
+                              "parent");
+  for(i=0;i<amwidth;++i) parent[i]=i;
+
+  /* We now have the average values and number of all rivers between the
+     grown clumps. We now want to finalize their connection (given the
+     user's criteria). */
+  for(i=0;i<graph.size;++i)
+    if( (e=&graph.edges[i])->a && e->num > p->minriverlength )
       {
-        if(rtmp->num > p->minriverlength)  /* There is a connection. */
+        /* For easy reading. */
+        ave=e->sum/e->num;
+
+        /* In case the average is negative (only possible if 'sum' is
+           negative), the two clumps aren't connected. Note that even an
+           area of 1 is acceptable, and we put no area criteria here,
+           because the fact that a river exists between two clumps is
+           important. */
+        if( ave>0.0f && ( c * ave / sqrt(ave+var) ) > p->objbordersn )
           {
-            /* For easy reading. */
-            ave = rtmp->sum / rtmp->num;
-
-            /* In case the average is negative (only possible if 'sums'
-               is negative), don't change the adjacency: it is already
-               initialized to zero. Note that even an area of 1 is
-               acceptable, and we put no area criteria here, because
-               the fact that a river exists between two clumps is
-               important. */
-            if( ave>0.0f && ( c * ave / sqrt(ave+var) ) > p->objbordersn )
-              {
-                addadj=1;
-                for(atmp=adjacency[i]; atmp!=NULL; atmp=atmp->next)
-                  if(atmp->v==rtmp->ngbid)
-                    { addadj=0; break; }
-                if(addadj)
-                  {
-                    gal_list_sizet_add(&adjacency[i], rtmp->ngbid);
-                    gal_list_sizet_add(&adjacency[rtmp->ngbid], i);
-                  }
-              }
+            ra=segment_relab_find(parent, e->a);
+            rb=segment_relab_find(parent, e->b);
+            if(ra<rb) parent[rb]=ra; else if(rb<ra) parent[ra]=rb;
           }
       }
 
-  /* For a check:
-  if(cltprm->id==2)
+  /* Calculate the new labels for each grown clump. Since the root of each
+     component is its smallest label, it has already been given its object
+     label when a larger label is checked. */
+  cltprm->clumptoobj = gal_data_alloc(NULL, GAL_TYPE_INT32, 1, &amwidth,
+                                      NULL, 1, p->cp.minmapsize,
+                                      p->cp.quietmmap, NULL, NULL, NULL);
+  clumptoobj=cltprm->clumptoobj->array;
+  for(i=1;i<amwidth;++i)
     {
-      printf("=====================\n");
-      printf("%zu:\n--------\n", cltprm->id);
-      for(i=1; i<amwidth; ++i)
-        {
-          printf(" %zu...\n", i);
-          for(rtmp=rlist[i]; rtmp!=NULL; rtmp=rtmp->next)
-            {
-              if(rtmp->num)
-                {
-                  ave=rtmp->sum/rtmp->num;
-                  printf("    ...%zu: N:%-4zu S:%-10.2f S/N: %-10.2f\n",
-                         rtmp->ngbid, rtmp->num, rtmp->sum,
-                         c*ave/sqrt(ave+var));
-                }
-            }
-          printf("FINAL: ");
-          for(atmp=adjacency[i]; atmp!=NULL; atmp=atmp->next)
-            printf("%zu ", atmp->v);
-          printf("\n\n");
-        }
-      exit(0);
+      ra=segment_relab_find(parent, i);
+      clumptoobj[i] = ra==(int32_t)i ? (int32_t)(curlab++) : clumptoobj[ra];
     }
-  */
-
-  /* Calculate the new labels for each grown clump. */
-  cltprm->clumptoobj=gal_binary_connected_adjacency_list(adjacency,
-                                               amwidth, p->cp.minmapsize,
-                                               p->cp.quietmmap,
-                                               &cltprm->numobjects);
+  cltprm->numobjects=curlab-1;
 
   /* Clean up. */
-  for(i=1; i<amwidth; ++i)
-    while(rlist[i]!=NULL)
-      { rtmp=rlist[i]->next; free(rlist[i]); rlist[i]=rtmp; }
-  for(i=1; i<amwidth; ++i) gal_list_sizet_free(adjacency[i]);
-  free(adjacency);
-  free(ngblabs);
-  free(rlist);
   free(dinc);
+  free(parent);
+  free(ngblabs);
+  free(graph.edges);
 }
 
 
@@ -627,19 +478,12 @@ segment_relab_to_objects(struct clumps_thread_params *cltprm)
      and 'clumptoobj' manually.*/
   if(cltprm->diffuseindexs->size)
     {
-      /* See if we should use a matrix-based adjacent finding (good for
-         small numbers) or a list-based method (necessary for large
-         numbers). Here we'll set the limit to 1000, because of this: the
-         adjacency array will be 1e6 pixels in three types (size_t, double
-         and uint8_t), so it will consume (8+8+1)*1e6 bytes which is 17
-         megabytes and reasonable. But the same argument for a 10000 limit
-         would be 17*e8 bytes or 1.7GB which is not reasonable. Note that
-         cases with +600000 have also been encountered (wide images of
-         dense fields near the Milky way disk). */
-      if( amwidth>1000 )
-        segment_relab_to_objects_list(cltprm);
-      else
-        segment_relab_to_objects_array(cltprm);
+      /* Find the connected clumps through the graph of rivers between
+         them (its size only depends on the number of clump boundaries, so
+         it is also good for cases with +600000 clumps, that have been
+         encountered in wide images of dense fields near the Milky way
+         disk). */
+      segment_relab_to_objects_graph(cltprm);
       clumptoobj = cltprm->clumptoobj->array;
     }
   else
@@ -792,13 +636,19 @@ segment_on_threads(void *in_prm)
   struct clumps_params *clprm=(struct clumps_params *)(tprm->params);
   struct segmentparams *p=clprm->p;
 
-  size_t i, *s, *sf;
+  gal_data_t labind;
   gal_data_t *topinds;
+  size_t i, *s, *sf, zero=0;
   struct clumps_thread_params cltprm;
+  size_t *labindexs=clprm->labindexs->array;
   int32_t *clabel=p->clabel->array, *olabel=p->olabel->array;
 
-  /* Initialize the general parameters for this thread. */
+  /* Initialize the general parameters for this thread. The indexs of
+     each detection are within the single (contiguous) array of all
+     detections, so the dataset of this thread only points to them. */
   cltprm.clprm = clprm;
+  gal_data_initialize(&labind, NULL, GAL_TYPE_SIZE_T, 1, &zero, NULL, 0,
+                      p->cp.minmapsize, p->cp.quietmmap, NULL, NULL, NULL);
 
   /* Go over all the detections given to this thread (counting from zero.) */
   for(i=0; tprm->indexs[i] != GAL_BLANK_SIZE_T; ++i)
@@ -807,7 +657,10 @@ segment_on_threads(void *in_prm)
          counted from zero, but the IDs start from 1, so we'll add a 1 to
          the ID given to this thread. */
       cltprm.id     = tprm->indexs[i]+1;
-      cltprm.indexs = &clprm->labindexs[ cltprm.id ];
+      cltprm.indexs = &labind;
+      labind.array  = labindexs + clprm->laboffsets[ cltprm.id ];
+      labind.size   = labind.dsize[0] = ( clprm->laboffsets[ cltprm.id+1 ]
+                                          - clprm->laboffsets[ cltprm.id ] );
       cltprm.numinitclumps = cltprm.numtrueclumps = cltprm.numobjects = 0;
 
 
@@ -991,6 +844,10 @@ segment_on_threads(void *in_prm)
       segment_relab_overall(&cltprm);
     }
 
+  /* Clean up (the indexs belong to the array of all detections). */
+  labind.array=NULL;
+  gal_data_free_contents(&labind);
+
   /* Wait until all the threads finish then return. */
   if(tprm->b) pthread_barrier_wait(tprm->b);
   return NULL;
@@ -1065,7 +922,7 @@ segment_save_sn_table(struct clumps_params *clprm)
   clumpinobj->next=sn;
   objind->next=clumpinobj;
   gal_table_write(objind, NULL, comments, p->cp.tableformat, p->clumpsn_d_name,
-                  "DET_CLUMP_SN", 0);
+                  "DET_CLUMP_SN", 0, p->cp.numthreads);
 
 
   /* Clean up. */
@@ -1141,12 +998,14 @@ segment_detections(struct segmentparams *p)
 {
   char *msg;
   struct clumps_params clprm;
+  size_t *laboffsets;
   gal_data_t *labindexs, *claborig, *demo=NULL;
 
 
-  /* Get the indexs of all the pixels in each label. */
-  labindexs=gal_label_indexs(p->olabel, p->numdetections, p->cp.minmapsize,
-                             p->cp.quietmmap);
+  /* Get the indexs of all the pixels in each label (in one array). */
+  labindexs=gal_label_indexs_csr(p->olabel, p->numdetections, &laboffsets,
+                                 p->cp.numthreads, p->cp.minmapsize,
+                                 p->cp.quietmmap);
 
 
   /* Initialize the necessary thread parameters. Note that since the object
@@ -1157,6 +1016,7 @@ segment_detections(struct segmentparams *p)
   clprm.totobjects=0;
   clprm.snind = NULL;
   clprm.labindexs=labindexs;
+  clprm.laboffsets=laboffsets;
   clprm.sn=gal_data_array_calloc(p->numdetections+1);
 
 
@@ -1350,7 +1210,8 @@ segment_detections(struct segmentparams *p)
 
   /* Clean up allocated structures and destroy the mutex. */
   gal_data_array_free(clprm.sn, p->numdetections+1, 1);
-  gal_data_array_free(labindexs, p->numdetections+1, 1);
+  gal_data_free(labindexs);
+  free(laboffsets);
   if( p->cp.numthreads>1 ) pthread_mutex_destroy(&clprm.labmutex);
 }
 
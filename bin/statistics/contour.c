@@ -104,7 +104,7 @@ contour_pgfplots(gal_data_t *edgeindexs, gal_data_t *input, float level,
 
               /* Convert the pixel positions to WCS. */
               x->next=y;
-              gal_wcs_img_to_world(x, input->wcs, 1);
+              gal_wcs_img_to_world(x, input->wcs, 1, 1);
 
               /* Write them. */
               xa=x->array;
@@ -54,9 +54,10 @@ sky_on_thread(void *in_prm)
   struct statisticsparams *p=(struct statisticsparams *)tprm->params;
 
   void *tblock=NULL, *tarray=NULL;
-  int stype=p->sky_t->type, itype=p->input->type;
+  int stype=p->sky_t->type;
   gal_data_t *num, *tile, *mean, *meanquant, *sigmaclip;
   size_t i, tind, twidth=gal_type_sizeof(p->sky_t->type);
+  gal_statistics_workspace_t *ws=gal_statistics_workspace_alloc();
 
 
   /* Find the Sky and its standard deviation on the tiles given to this
@@ -77,12 +78,14 @@ sky_on_thread(void *in_prm)
           tile->block=p->convolved;
         }
 
-      /* Calculate the mean's quantile. */
-      mean=gal_statistics_mean(tile);
-      num=gal_statistics_number(tile);
-      mean=gal_data_copy_to_new_type_free(mean, itype);
+      /* Calculate the mean's quantile. The outputs of the '_ws'
+         functions are kept in the workspace (to avoid allocations on
+         every tile), so they shouldn't be freed. The tile's copy (that
+         is necessary for sorting) is also kept within the workspace. */
+      mean=gal_statistics_mean_ws(tile, ws);
+      num=gal_statistics_number_ws(tile, ws);
       meanquant = ( *(size_t *)(num->array)
-                    ? gal_statistics_quantile_function(tile, mean, 1)
+                    ? gal_statistics_quantile_function_ws(tile, mean, 1, ws)
                     : NULL );
 
       /* Reset the pointers of 'tile'. */
@@ -97,19 +100,16 @@ sky_on_thread(void *in_prm)
           /* Get the sigma-clipped mean and standard deviation. 'inplace'
              is irrelevant here because this is a tile and it will be
              copied anyway. */
-          sigmaclip=gal_statistics_sigma_clip(tile, p->sclipparams[0],
-                                              p->sclipparams[1], 1, 1);
+          sigmaclip=gal_statistics_sigma_clip_ws(tile, p->sclipparams[0],
+                                                 p->sclipparams[1], 1, 1,
+                                                 ws);
 
           /* Put the mean and its standard deviation into the respective
-             place for this tile. */
-          sigmaclip=gal_data_copy_to_new_type_free(sigmaclip, stype);
+             place for this tile (both are float32). */
           memcpy(gal_pointer_increment(p->sky_t->array, tind, stype),
                  gal_pointer_increment(sigmaclip->array, 2, stype), twidth);
           memcpy(gal_pointer_increment(p->std_t->array, tind, stype),
                  gal_pointer_increment(sigmaclip->array, 3, stype), twidth);
-
-          /* Clean up. */
-          gal_data_free(sigmaclip);
         }
       else
         {
@@ -118,15 +118,11 @@ sky_on_thread(void *in_prm)
           gal_blank_write(gal_pointer_increment(p->std_t->array, tind,
                                                  stype), stype);
         }
-
-      /* Clean up. */
-      gal_data_free(num);
-      gal_data_free(mean);
-      gal_data_free(meanquant);
     }
 
 
-  /* Wait for all threads to finish and return. */
+  /* Clean up, wait for all threads to finish and return. */
+  gal_statistics_workspace_free(ws);
   if(tprm->b) pthread_barrier_wait(tprm->b);
   return NULL;
 }
@@ -679,7 +679,7 @@ write_output_table(struct statisticsparams *p, gal_data_t *table,
   /* Write the table. */
   gal_checkset_writable_remove(output, 0, p->cp.dontdelete);
   gal_table_write(table, NULL, comments, p->cp.tableformat, output,
-                  "TABLE", 0);
+                  "TABLE", 0, p->cp.numthreads);
 
 
   /* Write the configuration information if we have a FITS output. */
@@ -1373,7 +1373,7 @@ statistics_fit_estimate(struct statisticsparams *p, gal_data_t *fit,
         }
       keys=statistics_fit_params_to_keys(p, fit, whtnat, redchisq);
       gal_table_write(p->fitestval, &keys, NULL, p->cp.tableformat,
-                      p->cp.output, "FIT_ESTIMATE", 0);
+                      p->cp.output, "FIT_ESTIMATE", 0, p->cp.numthreads);
     }
 
   /* Print estimated value on the commandline. */
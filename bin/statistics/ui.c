@@ -1134,7 +1134,8 @@ ui_preparations(struct statisticsparams *p)
     {
       p->inputformat=INPUT_FORMAT_IMAGE;
       p->input=gal_array_read_one_ch(p->inputname, cp->hdu, NULL,
-                                     cp->minmapsize, p->cp.quietmmap);
+                                     cp->numthreads, cp->minmapsize,
+                                     p->cp.quietmmap);
       p->input->wcs=gal_wcs_read(p->inputname, cp->hdu,
                                  p->cp.wcslinearmatrix, 0, 0,
                                  &p->input->nwcs);
@@ -1186,7 +1187,7 @@ ui_preparations(struct statisticsparams *p)
               gal_checkset_writable_remove(tl->tilecheckname, 0,
                                            cp->dontdelete);
               gal_table_write(check, NULL, NULL, cp->tableformat,
-                              tl->tilecheckname, "TABLE", 0);
+                              tl->tilecheckname, "TABLE", 0, cp->numthreads);
             }
           gal_data_free(check);
         }
@@ -624,7 +624,7 @@ arithmetic_wcs(struct tableparams *p, gal_data_t **stack, int operator)
   if(operator==ARITHMETIC_TABLE_OP_WCSTOIMG)
     {
       /* Do the conversion. */
-      gal_wcs_world_to_img(coord[0], wcs, 1);
+      gal_wcs_world_to_img(coord[0], wcs, 1, p->cp.numthreads);
 
       /* For image coordinates, we don't need much precision. */
       for(i=0;i<ndim;++i)
@@ -637,7 +637,7 @@ arithmetic_wcs(struct tableparams *p, gal_data_t **stack, int operator)
     }
   else
     {
-      gal_wcs_img_to_world(coord[0], wcs, 1);
+      gal_wcs_img_to_world(coord[0], wcs, 1, p->cp.numthreads);
       arithmetic_update_metadata(coord[0], wcs->ctype[0], wcs->cunit[0],
                                  "Converted from pixel coordinates");
       arithmetic_update_metadata(coord[1], coord[1]?wcs->ctype[1]:NULL,
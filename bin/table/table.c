@@ -81,6 +81,7 @@ table_apply_permutation(gal_data_t *table, size_t *permutation,
 static void
 table_bring_to_top(gal_data_t *table, gal_data_t *rowids)
 {
+  int arena;
   char **strarr;
   gal_data_t *col;
   size_t i, *ids=rowids->array;
@@ -91,8 +92,11 @@ table_bring_to_top(gal_data_t *table, gal_data_t *rowids)
   /* Go over each column and move the desired rows to the top. */
   for(col=table;col!=NULL;col=col->next)
     {
-      /* For easy operation if the column is a string. */
+      /* For easy operation if the column is a string. When all the
+         strings are in one allocation, they are only freed with the
+         array. */
       strarr = col->type==GAL_TYPE_STRING ? col->array : NULL;
+      arena = col->flag & GAL_DATA_FLAG_STRARENA;
 
       /* Move the desired rows up to the top. */
       for(i=0;i<rowids->size;++i)
@@ -102,7 +106,7 @@ table_bring_to_top(gal_data_t *table, gal_data_t *rowids)
                copying pointers. */
             if(col->type==GAL_TYPE_STRING)
               {
-                free(strarr[i]);
+                if(!arena) free(strarr[i]);
                 strarr[i]=strarr[ ids[i] ];
                 strarr[ ids[i] ]=NULL;
               }
@@ -113,7 +117,7 @@ table_bring_to_top(gal_data_t *table, gal_data_t *rowids)
           }
 
       /* For string arrays, free the pointers of the remaining rows. */
-      if(col->type==GAL_TYPE_STRING)
+      if(col->type==GAL_TYPE_STRING && !arena)
         for(i=rowids->size;i<col->size;++i)
           if(strarr[i]) free(strarr[i]);
 
@@ -706,8 +710,10 @@ table_select_by_position(struct tableparams *p)
          not be used (outside the allocated array directly
          'gal_data_t'). We don't have to worry about the space for the
          actual pointers (they will be free'd by 'free' in any case, since
-         they are in the initially allocated array).*/
-      if(col->type==GAL_TYPE_STRING)
+         they are in the initially allocated array). When all the
+         strings are in one allocation, there is nothing to free here.*/
+      if(col->type==GAL_TYPE_STRING
+         && (col->flag & GAL_DATA_FLAG_STRARENA)==0 )
         {
           /* Parse the rows and free extra pointers. */
           strarr=col->array;
@@ -907,7 +913,10 @@ table_catrows_prepare(struct tableparams *p)
                           tmp->name, tmp->unit, tmp->comment);
 
       /* Put the full contents of the existing column into the new
-         column: this will be the first set of rows,  */
+         column: this will be the first set of rows. Strings that are
+         in a single allocation need to be separated first (their
+         pointers are moved into the new array). */
+      gal_data_string_separate(tmp);
       memcpy(ocol->array, tmp->array, tmp->size*gal_type_sizeof(tmp->type));
 
       /* If the column type is a string, we should set the input pointers
@@ -999,7 +1008,10 @@ table_catrows(struct tableparams *p)
                   gal_fits_name_save_as_string(filell->v, hdu), colcount,
                   gal_type_name(tmp->type, 1), gal_type_name(ttmp->type, 1));
 
-          /* Add the new rows and incremenet the counter. */
+          /* Add the new rows and incremenet the counter (strings that
+             are in a single allocation need to be separated first,
+             since their pointers are moved to the final table). */
+          gal_data_string_separate(tmp);
           memcpy(gal_pointer_increment(ttmp->array, filledrows, ttmp->type),
                  tmp->array, tmp->size*gal_type_sizeof(tmp->type));
 
@@ -1269,7 +1281,7 @@ table(struct tableparams *p)
     {
       table_txt_formats(p);
       gal_table_write(p->table, NULL, NULL, p->cp.tableformat, p->cp.output,
-                      "TABLE", p->colinfoinstdout);
+                      "TABLE", p->colinfoinstdout, p->cp.numthreads);
     }
   else
     error(EXIT_FAILURE, 0, "no output columns");
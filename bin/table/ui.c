@@ -1212,10 +1212,87 @@ ui_check_select_sort_after(struct tableparams *p, size_t nselect,
 
 
 
+/* Some row selections can be done while reading the input table, so the
+   rows that aren't necessary are never read. This is only possible when
+   no other table is concatenated with the input (the selections apply to
+   the final table). The value-based selections are only pushed to the
+   reader when all of them are simple comparisons (not polygons or blank
+   checks, that need the full columns). The position-based selections
+   ('--head', '--tail' and '--rowrange') are applied after sorting and
+   value-based selection, so they are only given to the reader when
+   neither remains. The given selections are removed from 'p' so they
+   aren't applied again. */
+static gal_data_t *
+ui_select_while_reading(struct tableparams *p, size_t *head, size_t *tail,
+                        size_t **rowrange)
+{
+  double *darr;
+  gal_data_t *tmp, *predicates=NULL;
+  gal_data_t *select[3]={p->range, p->equal, p->notequal};
+  int i, types[3]={GAL_TABLE_SELECT_RANGE, GAL_TABLE_SELECT_EQUAL,
+                   GAL_TABLE_SELECT_NOTEQUAL};
+
+  /* Initialize the position-based selections. */
+  *rowrange=NULL;
+  *head=*tail=GAL_BLANK_SIZE_T;
+
+  /* When another table is concatenated, all selections should be done
+     after reading. */
+  if(p->catcolumnfile || p->catrowfile) return NULL;
+
+  /* Value-based selection: put all the selections in one list (the
+     'status' of each node is the type of selection). */
+  if( p->selection
+      && p->inpolygon==NULL && p->outpolygon==NULL && p->noblankll==NULL )
+    {
+      for(i=2;i>=0;--i)
+        if(select[i])
+          {
+            for(tmp=select[i]; tmp!=NULL; tmp=tmp->next)
+              {
+                tmp->status=types[i];
+                if(tmp->next==NULL) { tmp->next=predicates; break; }
+              }
+            predicates=select[i];
+          }
+      p->selection=0;
+      p->range=p->equal=p->notequal=NULL;
+    }
+
+  /* Position-based selection. */
+  if( p->selection==0 && p->sort==NULL && p->rowrandom==0 )
+    {
+      *head=p->head;
+      *tail=p->tail;
+      if(p->rowrange)
+        {
+          /* Note that '--rowrange' was already converted to start
+             counting from 0 in 'ui_read_check_only_options'. */
+          darr=p->rowrange->array;
+          *rowrange=gal_pointer_allocate(GAL_TYPE_SIZE_T, 2, 0, __func__,
+                                         "rowrange");
+          (*rowrange)[0]=darr[0];
+          (*rowrange)[1]=darr[1];
+          gal_data_free(p->rowrange);
+          p->rowrange=NULL;
+        }
+      p->head=p->tail=GAL_BLANK_SIZE_T;
+    }
+
+  /* Return the list of predicates. */
+  return predicates;
+}
+
+
+
+
+
 static void
 ui_preparations(struct tableparams *p)
 {
   gal_list_str_t *lines;
+  gal_data_t *predicates;
+  size_t *rowrange, head, tail;
   size_t nselect=0, origoutncols=0;
   size_t sortindout=GAL_BLANK_SIZE_T;
   struct gal_options_common_params *cp=&p->cp;
@@ -1240,6 +1317,10 @@ ui_preparations(struct tableparams *p)
                    || p->notequal || p->noblankll );
 
 
+  /* See which row selections can be done while reading the table. */
+  predicates=ui_select_while_reading(p, &head, &tail, &rowrange);
+
+
   /* If row sorting or selection are requested, see if we should read any
      extra columns. */
   if(p->selection || p->sort)
@@ -1257,11 +1338,15 @@ ui_preparations(struct tableparams *p)
 
 
   /* Read the necessary columns. */
-  p->table=gal_table_read(p->filename, cp->hdu, lines, p->columns,
-                          cp->searchin, cp->ignorecase, cp->numthreads,
-                          cp->minmapsize, p->cp.quietmmap, p->colmatch);
+  p->table=gal_table_read_select(p->filename, cp->hdu, lines, p->columns,
+                                 predicates, head, tail, rowrange,
+                                 cp->searchin, cp->ignorecase,
+                                 cp->numthreads, cp->minmapsize,
+                                 p->cp.quietmmap, p->colmatch);
   if(p->filename==NULL) p->filename="stdin";
+  gal_list_data_free(predicates);
   gal_list_str_free(lines, 1);
+  if(rowrange) free(rowrange);
 
 
   /* If row sorting or selection are requested, keep them as separate
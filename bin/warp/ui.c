@@ -673,6 +673,7 @@ ui_check_options_and_arguments(struct warpparams *p)
   /* Read the input image as double type and its WCS structure. */
   p->input=gal_array_read_one_ch_to_type(p->inputname, p->cp.hdu,
                                          NULL, GAL_TYPE_FLOAT64,
+                                         p->cp.numthreads,
                                          p->cp.minmapsize,
                                          p->cp.quietmmap);
 
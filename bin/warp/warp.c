@@ -28,6 +28,7 @@ along with Gnuastro. If not, see <http://www.gnu.org/licenses/>.
 #include <stdio.h>
 #include <float.h>
 #include <stdlib.h>
+#include <string.h>
 
 #include <gnuastro/wcs.h>
 #include <gnuastro/fits.h>
@@ -400,7 +401,8 @@ warp_linear_init(struct warpparams *p)
 static void
 warp_write_to_file(struct warpparams *p, int hasmatrix)
 {
-  size_t i;
+  int compress;
+  size_t i, len;
   gal_data_t *tmp=NULL;
   char keyword[9*FLEN_KEYWORD];
   gal_fits_list_key_t *headers=NULL;
@@ -422,9 +424,18 @@ warp_write_to_file(struct warpparams *p, int hasmatrix)
   if(p->cp.type && p->cp.type!=p->output->type)
     p->output=gal_data_copy_to_new_type_free(p->output, p->cp.type);
 
-  /* Save the output and 'MAX-FRAC' if available. */
+  /* Save the output and 'MAX-FRAC' if available. When the output's
+     suffix is '.fz', it is tile-compressed (like 'fpack') on all the
+     threads. */
+  len=strlen(p->cp.output);
+  compress = len>3 && strcmp(&p->cp.output[len-3], ".fz")==0;
   for(tmp=p->output;tmp!=NULL;tmp=tmp->next)
-    gal_fits_img_write(tmp, p->cp.output, NULL, PROGRAM_NAME);
+    if(compress)
+      gal_fits_img_write_compressed(tmp, p->cp.output, NULL, PROGRAM_NAME,
+                                    GAL_FITS_COMPRESS_RICE,
+                                    p->cp.numthreads);
+    else
+      gal_fits_img_write(tmp, p->cp.output, NULL, PROGRAM_NAME);
 
   /* Write the configuration keywords on HDU/extension '0'. */
   gal_fits_key_write_filename("input", p->inputname, &p->cp.okeys,
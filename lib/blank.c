@@ -114,6 +114,7 @@ gal_blank_initialize(gal_data_t *input)
      types we will consider tiles. */
   if(input->type==GAL_TYPE_STRING)
     {
+      gal_data_string_separate(input);
       strarr=input->array;
       for(i=0;i<input->size;++i)
         {
@@ -672,6 +673,8 @@ gal_blank_flag_apply(gal_data_t *input, gal_data_t *flag)
 
     /* Strings. */
     case GAL_TYPE_STRING:
+      gal_data_string_separate(input);
+      strarr=input->array;
       for(j=0; j<input->size; ++j)
         {
           if(*f && *f!=GAL_BLANK_UINT8)
@@ -751,7 +754,11 @@ gal_blank_flag_remove(gal_data_t *input, gal_data_t *flag)
       for(i=0;i<input->size;++i)
         {
           if( *f && *f!=GAL_BLANK_UINT8 )        /* Flagged to be removed */
-            { free(strarr[i]); strarr[i]=NULL; }
+            {
+              if( (input->flag & GAL_DATA_FLAG_STRARENA)==0 )
+                free(strarr[i]);
+              strarr[i]=NULL;
+            }
           else strarr[num++]=strarr[i];          /* Keep. */
           ++f;
         }
@@ -815,7 +822,12 @@ gal_blank_remove(gal_data_t *input)
           for(i=0;i<input->size;++i)
             if( strcmp(strarr[i], GAL_BLANK_STRING) ) /* Not blank. */
               { strarr[num++]=strarr[i]; }
-            else { free(strarr[i]); strarr[i]=NULL; }  /* Is blank. */
+            else                                      /* Is blank. */
+              {
+                if( (input->flag & GAL_DATA_FLAG_STRARENA)==0 )
+                  free(strarr[i]);
+                strarr[i]=NULL;
+              }
           break;
         default:
           error(EXIT_FAILURE, 0, "%s: type code %d not recognized",
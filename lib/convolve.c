@@ -118,6 +118,7 @@ struct spatial_params
   gal_data_t     *block;     /* Pointer to block for this tile.          */
   gal_data_t    *kernel;     /* Kernel to convolve with input.           */
   gal_data_t *tocorrect;     /* (possible) convolved image to correct.   */
+  size_t       *tileids;     /* (possible) IDs of tiles to convolve.     */
   int        convoverch;     /* Ignore channel edges in convolution.     */
   int    edgecorrection;     /* Correct convolution's edge effects.      */
   struct per_thread_spatial_prm *pprm; /* Array of per-thread parameters.*/
@@ -457,8 +458,12 @@ convolve_spatial_on_thread(void *inparam)
   /* Go over all the tiles given to this thread. */
   for(i=0; tprm->indexs[i] != GAL_BLANK_SIZE_T; ++i)
     {
-      /* Set this tile's pointer into this thread's parameters. */
-      pprm->id   = tprm->indexs[i];
+      /* Set this tile's pointer into this thread's parameters (when only
+         some tiles should be convolved, the action is an index in the
+         list of the tile IDs). */
+      pprm->id   = ( cprm->tileids
+                     ? cprm->tileids[ tprm->indexs[i] ]
+                     : tprm->indexs[i] );
       pprm->tile = &cprm->tiles[ pprm->id ];
 
       /* Do the convolution on this tile. */
@@ -482,15 +487,19 @@ convolve_spatial_on_thread(void *inparam)
 
 
 
-/* General spatial convolve function. This function is called by both
-   'gal_convolve_spatial' and */
+/* General spatial convolve function. This function is called by all the
+   'gal_convolve_spatial*' functions. When 'tileids!=NULL', only the
+   'numtileids' tiles with those IDs are convolved and the result is
+   written into the already allocated 'out'. */
 static gal_data_t *
 gal_convolve_spatial_general(gal_data_t *tiles, gal_data_t *kernel,
                              size_t numthreads, int edgecorrection,
-                             int convoverch, gal_data_t *tocorrect)
+                             int convoverch, gal_data_t *tocorrect,
+                             size_t *tileids, size_t numtileids,
+                             gal_data_t *out)
 {
   struct spatial_params params;
-  gal_data_t *out, *block=gal_tile_block(tiles);
+  gal_data_t *block=gal_tile_block(tiles);
 
 
   /* Small sanity checks. */
@@ -515,7 +524,7 @@ gal_convolve_spatial_general(gal_data_t *tiles, gal_data_t *kernel,
 
   /* Set the output datastructure.  */
   if(tocorrect) out=tocorrect;
-  else
+  else if(out==NULL)
     {
       /* Allocate the space for the convolved image. */
       out=gal_data_alloc(NULL, GAL_TYPE_FLOAT32, block->ndim, block->dsize,
@@ -534,6 +543,7 @@ gal_convolve_spatial_general(gal_data_t *tiles, gal_data_t *kernel,
   params.tiles=tiles;
   params.block=block;
   params.kernel=kernel;
+  params.tileids=tileids;
   params.tocorrect=tocorrect;
   params.convoverch=convoverch;
   params.edgecorrection=edgecorrection;
@@ -549,7 +559,9 @@ gal_convolve_spatial_general(gal_data_t *tiles, gal_data_t *kernel,
 
   /* Do the spatial convolution on threads. */
   gal_threads_spin_off(convolve_spatial_on_thread, &params,
-                       gal_list_data_number(tiles), numthreads,
+                       ( tileids
+                         ? numtileids
+                         : gal_list_data_number(tiles) ), numthreads,
                        tiles->minmapsize, tiles->quietmmap);
 
 
@@ -577,7 +589,44 @@ gal_convolve_spatial(gal_data_t *tiles, gal_data_t *kernel,
 
   /* Call the general function. */
   return gal_convolve_spatial_general(tiles, kernel, numthreads,
-                                      edgecorrection, convoverch, NULL);
+                                      edgecorrection, convoverch, NULL,
+                                      NULL, 0, NULL);
+}
+
+
+
+
+
+/* Only convolve the tiles with the given IDs (in the 'tiles' array) and
+   write the result into the already allocated 'out' (that must have the
+   same size as the block of the tiles), other pixels of 'out' are not
+   touched. This is useful when only part of the input has changed since
+   'out' was convolved: only the tiles that are affected by the change
+   need to be convolved again. */
+void
+gal_convolve_spatial_tiles(gal_data_t *tiles, gal_data_t *kernel,
+                           size_t numthreads, int edgecorrection,
+                           int convoverch, size_t *tileids,
+                           size_t numtileids, gal_data_t *out)
+{
+  gal_data_t *block=gal_tile_block(tiles);
+
+  /* Some small sanity checks. */
+  if( gal_dimension_is_different(block, out) )
+    error(EXIT_FAILURE, 0, "%s: the 'out' dataset has to have the "
+          "same dimensions/size as the block of the 'tiles' input", __func__);
+  if( out->type!=GAL_TYPE_FLOAT32 )
+    error(EXIT_FAILURE, 0, "%s: the 'out' dataset has to have a 'float32' "
+          "type, but it has a '%s' type", __func__,
+          gal_type_name(out->type, 1));
+
+  /* Nothing to do when there are no tiles. */
+  if(numtileids==0) return;
+
+  /* Call the general function. */
+  if(tiles->block==NULL) convoverch=1;
+  gal_convolve_spatial_general(tiles, kernel, numthreads, edgecorrection,
+                               convoverch, NULL, tileids, numtileids, out);
 }
 
 
@@ -609,5 +658,220 @@ gal_convolve_spatial_correct_ch_edge(gal_data_t *tiles, gal_data_t *kernel,
 
   /* Call the general function, which will do the correction. */
   gal_convolve_spatial_general(tiles, kernel, numthreads,
-                               edgecorrection, 0, tocorrect);
+                               edgecorrection, 0, tocorrect, NULL, 0,
+                               NULL);
+}
+
+
+
+
+
+
+
+
+
+
+
+
+
+
+
+
+
+
+
+
+/*********************************************************************/
+/********************      Batch convolution      ********************/
+/*********************************************************************/
+struct batch_params
+{
+  gal_data_t        *input;  /* Input dataset (all the items).          */
+  gal_data_t       *kernel;  /* Kernel (with fewer dimensions).         */
+  gal_data_t          *out;  /* Output dataset.                         */
+  size_t          itemsize;  /* Number of elements in each item.        */
+  int       edgecorrection;  /* Correct the edges of each item.         */
+};
+
+
+
+
+
+/* Convolve one 1D item (for example a spectrum) with a 1D kernel. */
+static void
+convolve_batch_1d(float *in, float *out, size_t n, float *kernel,
+                  size_t kn, int edgecorrection)
+{
+  double sum, ksum;
+  size_t x, k, kstart, kend, c=kn/2;
+
+  for(x=0;x<n;++x)
+    if( isnan(in[x]) ) out[x]=NAN;
+    else
+      {
+        /* The kernel elements that overlap with the item: element 'k' of
+           the kernel is on element 'x+k-c' of the input. */
+        kstart = x<c ? c-x : 0;
+        kend   = x+kn-c>n ? n+c-x : kn;
+
+        /* Do the convolution on this element. */
+        sum=0.0;
+        ksum = edgecorrection ? 0.0 : 1.0;
+        for(k=kstart;k<kend;++k)
+          if( !isnan(in[x+k-c]) )
+            {
+              sum += in[x+k-c] * kernel[k];
+              if(edgecorrection) ksum += kernel[k];
+            }
+        out[x] = ksum==0.0 ? NAN : sum/ksum;
+      }
+}
+
+
+
+
+
+/* Convolve one 2D item (for example a slice of a cube) with a 2D
+   kernel. */
+static void
+convolve_batch_2d(float *in, float *out, size_t *dsize, float *kernel,
+                  size_t *kdsize, int edgecorrection)
+{
+  double sum, ksum;
+  float *ip, *kp, *kpf;
+  size_t y, x, ky, ky0, ky1, kx0, kx1;
+  size_t cy=kdsize[0]/2, cx=kdsize[1]/2;
+
+  for(y=0;y<dsize[0];++y)
+    {
+      /* Rows of the kernel that overlap with the item on this row. */
+      ky0 = y<cy ? cy-y : 0;
+      ky1 = y+kdsize[0]-cy>dsize[0] ? dsize[0]+cy-y : kdsize[0];
+
+      /* Go over the elements of this row. */
+      for(x=0;x<dsize[1];++x)
+        if( isnan(in[y*dsize[1]+x]) ) out[y*dsize[1]+x]=NAN;
+        else
+          {
+            /* Columns of the kernel that overlap with the item. */
+            kx0 = x<cx ? cx-x : 0;
+            kx1 = x+kdsize[1]-cx>dsize[1] ? dsize[1]+cx-x : kdsize[1];
+
+            /* Do the convolution on this element. */
+            sum=0.0;
+            ksum = edgecorrection ? 0.0 : 1.0;
+            for(ky=ky0;ky<ky1;++ky)
+              {
+                kpf=kernel+ky*kdsize[1]+kx1;
+                kp=kernel+ky*kdsize[1]+kx0;
+                ip=in+(y+ky-cy)*dsize[1]+x+kx0-cx;
+                do
+                  {
+                    if( !isnan(*ip) )
+                      {
+                        sum += *ip * *kp;
+                        if(edgecorrection) ksum += *kp;
+                      }
+                    ++ip;
+                  }
+                while(++kp<kpf);
+              }
+            out[y*dsize[1]+x] = ksum==0.0 ? NAN : sum/ksum;
+          }
+    }
+}
+
+
+
+
+
+/* Convolve the items (contiguous groups of elements along the fastest
+   dimensions) that are assigned to this thread. */
+static void *
+convolve_batch_on_thread(void *inparam)
+{
+  struct gal_threads_params *tprm=(struct gal_threads_params *)inparam;
+  struct batch_params *bprm=(struct batch_params *)(tprm->params);
+  gal_data_t *input=bprm->input, *kernel=bprm->kernel;
+
+  size_t i, start;
+  float *in=input->array, *out=bprm->out->array, *k=kernel->array;
+  size_t *dsize=input->dsize+input->ndim-kernel->ndim;
+
+  /* Go over all the items given to this thread. */
+  for(i=0; tprm->indexs[i] != GAL_BLANK_SIZE_T; ++i)
+    {
+      start=tprm->indexs[i]*bprm->itemsize;
+      if(kernel->ndim==1)
+        convolve_batch_1d(in+start, out+start, dsize[0], k,
+                          kernel->dsize[0], bprm->edgecorrection);
+      else
+        convolve_batch_2d(in+start, out+start, dsize, k, kernel->dsize,
+                          bprm->edgecorrection);
+    }
+
+  /* Wait until all other threads finish, then return. */
+  if(tprm->b) pthread_barrier_wait(tprm->b);
+  return NULL;
+}
+
+
+
+
+
+/* Convolve every item of the input with the same kernel. When the kernel
+   has fewer dimensions than the input, the input is a "batch" of items
+   along its fastest dimensions (that have the same dimensionality as the
+   kernel): for example, a 2D kernel on a 3D cube will convolve each slice
+   of the cube, or a 1D kernel on a 2D dataset (like a set of spectra in
+   an image) will convolve each row. The items are distributed between the
+   threads. */
+gal_data_t *
+gal_convolve_spatial_batch(gal_data_t *input, gal_data_t *kernel,
+                           size_t numthreads, int edgecorrection)
+{
+  size_t i;
+  gal_data_t *out;
+  struct batch_params params;
+
+  /* Small sanity checks. */
+  if(input->block)
+    error(EXIT_FAILURE, 0, "%s: the input must be a full (allocated) "
+          "dataset, not a tile", __func__);
+  if( input->type!=GAL_TYPE_FLOAT32 || kernel->type!=GAL_TYPE_FLOAT32 )
+    error(EXIT_FAILURE, 0, "%s: only accepts 'float32' type input and "
+          "kernel currently", __func__);
+  if(kernel->ndim>=input->ndim)
+    error(EXIT_FAILURE, 0, "%s: the kernel (with %zu dimensions) must have "
+          "fewer dimensions than the input (with %zu dimensions)", __func__,
+          kernel->ndim, input->ndim);
+  if(kernel->ndim>2)
+    error(EXIT_FAILURE, 0, "%s: currently only 1D or 2D kernels are "
+          "supported, but the given kernel has %zu dimensions", __func__,
+          kernel->ndim);
+
+  /* Number of elements in each item. */
+  params.itemsize=1;
+  for(i=input->ndim-kernel->ndim; i<input->ndim; ++i)
+    params.itemsize *= input->dsize[i];
+
+  /* Allocate the output, spatial convolution won't change the blank
+     bit-flag, so use the input's blank bit flag. */
+  out=gal_data_alloc(NULL, GAL_TYPE_FLOAT32, input->ndim, input->dsize,
+                     input->wcs, 0, input->minmapsize, input->quietmmap,
+                     NULL, input->unit, NULL);
+  out->flag = ( input->flag
+                | ( GAL_DATA_FLAG_BLANK_CH | GAL_DATA_FLAG_HASBLANK ) );
+
+  /* Do the convolution on threads. */
+  params.out=out;
+  params.input=input;
+  params.kernel=kernel;
+  params.edgecorrection=edgecorrection;
+  gal_threads_spin_off(convolve_batch_on_thread, &params,
+                       input->size/params.itemsize, numthreads,
+                       input->minmapsize, input->quietmmap);
+
+  /* Return the output. */
+  return out;
 }
@@ -279,8 +279,10 @@ gal_data_free_contents(gal_data_t *data)
 
   /* If the data type is string, then each element in the array is actually
      a pointer to the array of characters, so free them before freeing the
-     actual array. */
-  if(data->type==GAL_TYPE_STRING && data->array)
+     actual array. When all the strings are in one allocation with the
+     array (see 'gal_data_string_arena'), freeing the array is enough. */
+  if(data->type==GAL_TYPE_STRING && data->array
+     && (data->flag & GAL_DATA_FLAG_STRARENA)==0 )
     {
       strarr=data->array;
       for(i=0;i<data->size;++i) if(strarr[i]) free(strarr[i]);
@@ -474,6 +476,158 @@ gal_data_array_ptr_free(gal_data_t **dataptr, size_t size, int free_array)
 
 
 
+
+/*********************************************************************/
+/*************             String datasets          ******************/
+/*********************************************************************/
+/* Free the separately allocated strings of a string dataset along with
+   the array of pointers (which may have been memory-mapped). */
+static void
+data_string_free_array(gal_data_t *data)
+{
+  size_t i;
+  char **strarr=data->array;
+
+  if( (data->flag & GAL_DATA_FLAG_STRARENA)==0 )
+    for(i=0;i<data->size;++i) if(strarr[i]) free(strarr[i]);
+
+  if(data->mmapname)
+    gal_pointer_mmap_free(&data->mmapname, data->quietmmap);
+  else free(data->array);
+}
+
+
+
+
+
+/* Put all the strings of a string dataset into one allocation: the array
+   of 'data->size' pointers is immediately followed by the characters of
+   all the strings. The 'char **' interface to the strings is unchanged,
+   but a table with many rows will not need one small allocation per row
+   and its strings will be contiguous in memory.
+
+   When 'width==0', each string will only occupy its own length (plus
+   the terminating '\0') and NULL pointers will remain NULL. Otherwise,
+   every string gets 'width' bytes (including the '\0'); the bytes after
+   each string are cleared, so they can be filled (for example by a
+   reader) up to 'width-1' characters. Longer strings are truncated and
+   NULL pointers become empty strings in this case.
+
+   Every pointer in 'data->array' must either be NULL or point to an
+   allocated string: to prepare the space of a newly allocated dataset,
+   allocate it with 'clear=1'. */
+void
+gal_data_string_arena(gal_data_t *data, size_t width)
+{
+  size_t i, len, nbytes;
+  char *mmapname=NULL;
+  char **in=data->array, **out, *c;
+
+  /* Sanity checks. */
+  if(data->type!=GAL_TYPE_STRING)
+    error(EXIT_FAILURE, 0, "%s: input must have a string type, but it "
+          "has type '%s'", __func__, gal_type_name(data->type, 1));
+  if(data->block)
+    error(EXIT_FAILURE, 0, "%s: tile inputs not supported ('block' "
+          "element must be NULL)", __func__);
+  if(data->array==NULL || data->size==0) return;
+
+  /* Find the total number of necessary bytes. */
+  nbytes=data->size * sizeof *out;
+  if(width) nbytes += data->size * width;
+  else
+    for(i=0;i<data->size;++i)
+      if(in[i]) nbytes += strlen(in[i])+1;
+
+  /* Allocate the arena and put the characters immediately after the
+     pointers. */
+  out=gal_pointer_allocate_ram_or_mmap(GAL_TYPE_UINT8, nbytes, 0,
+                                       data->minmapsize, &mmapname,
+                                       data->quietmmap, __func__, "out");
+  c=(char *)(out+data->size);
+  for(i=0;i<data->size;++i)
+    if(width)
+      {
+        out[i]=c;
+        memset(c, 0, width);
+        if(in[i])
+          {
+            len=strlen(in[i]);
+            memcpy(c, in[i], len<width ? len : width-1);
+          }
+        c+=width;
+      }
+    else
+      {
+        if(in[i])
+          {
+            len=strlen(in[i])+1;
+            memcpy(out[i]=c, in[i], len);
+            c+=len;
+          }
+        else out[i]=NULL;
+      }
+
+  /* Free the old strings and replace the array. */
+  data_string_free_array(data);
+  data->array=out;
+  data->mmapname=mmapname;
+  data->flag |= GAL_DATA_FLAG_STRARENA;
+}
+
+
+
+
+
+/* Inverse of 'gal_data_string_arena': give every string its own
+   allocation so the strings can be individually freed or re-allocated
+   by the caller. If the dataset isn't an arena, nothing is done. */
+void
+gal_data_string_separate(gal_data_t *data)
+{
+  size_t i;
+  char *mmapname=NULL;
+  char **in=data->array, **out;
+
+  /* If there is nothing to do, return. */
+  if( data->type!=GAL_TYPE_STRING
+      || (data->flag & GAL_DATA_FLAG_STRARENA)==0 )
+    return;
+  if(data->array==NULL) { data->flag &= ~GAL_DATA_FLAG_STRARENA; return; }
+
+  /* Allocate the new array and copy each string. */
+  out=gal_pointer_allocate_ram_or_mmap(data->type, data->size, 0,
+                                       data->minmapsize, &mmapname,
+                                       data->quietmmap, __func__, "out");
+  for(i=0;i<data->size;++i)
+    if(in[i]) gal_checkset_allocate_copy(in[i], &out[i]);
+    else      out[i]=NULL;
+
+  /* Free the arena and replace the array. */
+  data_string_free_array(data);
+  data->array=out;
+  data->mmapname=mmapname;
+  data->flag &= ~GAL_DATA_FLAG_STRARENA;
+}
+
+
+
+
+
+
+
+
+
+
+
+
+
+
+
+
+
+
+
 /*************************************************************
  **************            Copying             ***************
  *************************************************************/
@@ -680,9 +834,24 @@ data_copy_to_string(gal_data_t *from, gal_data_t *to)
 
 
 
+/* Convert the 'n' contiguous elements of 'i' into 'o'. The loop has no
+   branches (so it can be vectorized by the compiler) and also checks if
+   the output has blank elements (in 'nb'), so no extra pass over the
+   output is necessary for 'gal_blank_present'. 'INBLANK' and 'OUTBLANK'
+   are the blank-checks of the input and output elements (different for
+   floating point types that have a NaN blank). */
+#define COPY_CONVERT(INBLANK, OUTBLANK)                                 \
+  for(k=0;k<n;++k)                                                      \
+    {                                                                   \
+      ov = INBLANK ? ob : i[k];                                         \
+      o[k]=ov;                                                          \
+      nb |= OUTBLANK;                                                   \
+    }
+
 #define COPY_OT_IT_SET(OT, IT) {                                        \
-    OT ob, *restrict o=out->array;                                      \
-    size_t increment=0, num_increment=1;                                \
+    int nb=0;                                                           \
+    OT ob, ov, *restrict o=out->array;                                  \
+    size_t k, n, increment=0, num_increment=1;                          \
     size_t mclen=0, contig_len=in->dsize[in->ndim-1];                   \
     IT ib, *ist=NULL, *restrict i=in->array, *f=i+in->size;             \
     size_t s_e_ind[2]={0,iblock->size-1}; /* -1: this is INCLUSIVE */   \
@@ -721,8 +890,18 @@ data_copy_to_string(gal_data_t *from, gal_data_t *to)
             /* types), it will fail any comparison, so we'll exploit */ \
             /* this property in such cases. For other cases, a       */ \
             /* '*i==ib' is enough.                                   */ \
-            if(ib==ib) do *o++ = *i==ib ? ob : *i; while(++i<f);        \
-            else       do *o++ = *i!=*i ? ob : *i; while(++i<f);        \
+            n=f-i;                                                      \
+            if(ib==ib)                                                  \
+              {                                                         \
+                if(ob==ob) COPY_CONVERT(i[k]==ib,   ov==ob)             \
+                else       COPY_CONVERT(i[k]==ib,   ov!=ov)             \
+              }                                                         \
+            else                                                        \
+              {                                                         \
+                if(ob==ob) COPY_CONVERT(i[k]!=i[k], ov==ob)             \
+                else       COPY_CONVERT(i[k]!=i[k], ov!=ov)             \
+              }                                                         \
+            o+=n;                                                       \
           }                                                             \
                                                                         \
         /* Update the increment from the start of the input. */         \
@@ -730,6 +909,17 @@ data_copy_to_string(gal_data_t *from, gal_data_t *to)
                        : gal_tile_block_increment(iblock, in->dsize,    \
                                                   num_increment++,      \
                                                   NULL) );              \
+      }                                                                 \
+                                                                        \
+    /* When the type was converted, the blank flags of the input may */ \
+    /* not apply to the output (for example a converted value may be */ \
+    /* equal to the blank value of the output type). But we have     */ \
+    /* just checked all the output elements, so set the flags.       */ \
+    if(iblock->type!=out->type)                                         \
+      {                                                                 \
+        out->flag |= GAL_DATA_FLAG_BLANK_CH;                            \
+        if(nb) out->flag |= GAL_DATA_FLAG_HASBLANK;                     \
+        else   out->flag &= ~GAL_DATA_FLAG_HASBLANK;                    \
       }                                                                 \
   }
 
@@ -802,6 +992,11 @@ gal_data_copy_to_new_type(gal_data_t *in, uint8_t newtype)
   /* Fill in the output array: */
   gal_data_copy_to_allocated(in, out);
 
+  /* If the input strings were in one allocation, keep the output's
+     strings that way also. */
+  if(newtype==GAL_TYPE_STRING && (in->flag & GAL_DATA_FLAG_STRARENA))
+    gal_data_string_arena(out, 0);
+
   /* Return the created array */
   return out;
 }
@@ -881,8 +1076,10 @@ gal_data_copy_to_allocated(gal_data_t *in, gal_data_t *out)
   if(out->unit)    free(out->unit);
   if(out->comment) free(out->comment);
 
-  /* Write the basic meta-data. */
-  out->flag           = in->flag;
+  /* Write the basic meta-data. Note that the output strings will be
+     separately allocated (the arena flag is about the allocation, not the
+     contents). */
+  out->flag           = in->flag & ~GAL_DATA_FLAG_STRARENA;
   out->next           = in->next;
   out->status         = in->status;
   out->disp_width     = in->disp_width;
@@ -44,6 +44,7 @@ along with Gnuastro. If not, see <http://www.gnu.org/licenses/>.
 #include <gnuastro/pointer.h>
 
 #include <gnuastro-internal/checkset.h>
+#include <gnuastro-internal/server.h>
 #include <gnuastro-internal/tableintern.h>
 #include <gnuastro-internal/fixedstringmacros.h>
 
@@ -2272,58 +2273,123 @@ gal_fits_key_write_config(gal_fits_list_key_t **keylist, char *title,
 
 
 
-/* From an input list of FITS files and a HDU, select those that have a
-   certain value(s) in a certain keyword.*/
-gal_list_str_t *
-gal_fits_with_keyvalue(gal_list_str_t *files, char *hdu, char *name,
-                       gal_list_str_t *values)
+/* Parameters for reading the value of a keyword in many files. */
+struct fits_keyvalue_params
+{
+  char       **files;    /* Names of the files.                      */
+  char         *hdu;     /* HDU to read the keyword from.            */
+  char        *name;     /* Name of the keyword.                     */
+  char     **values;     /* Output: value in each file (or NULL).    */
+};
+
+
+
+
+
+/* Worker function for 'gal_fits_keyvalue_in_files': each thread opens
+   its files independently. */
+static void *
+fits_keyvalue_in_files_worker(void *in_prm)
 {
+  struct gal_threads_params *tprm=(struct gal_threads_params *)in_prm;
+  struct fits_keyvalue_params *p=(struct fits_keyvalue_params *)tprm->params;
+
+  size_t i, ind;
   int status=0;
   fitsfile *fptr;
   char keyvalue[FLEN_VALUE];
-  gal_list_str_t *f, *v, *out=NULL;
 
-  /* Go over the list of files and see if they have the requested
-     keyword(s). */
-  for(f=files; f!=NULL; f=f->next)
+  /* Go over all the files that were assigned to this thread. */
+  for(i=0; tprm->indexs[i] != GAL_BLANK_SIZE_T; ++i)
     {
       /* Open the file. */
-      fptr=gal_fits_hdu_open(f->v, hdu, READONLY, 0);
+      ind=tprm->indexs[i];
+      fptr=gal_fits_hdu_open(p->files[ind], p->hdu, READONLY, 0);
 
       /* Only attempt to read the value if the requested HDU could be
          opened ('fptr!=NULL'). */
       if(fptr)
         {
           /* Check if the keyword actually exists. */
-          if( gal_fits_key_exists_fptr(fptr, name) )
+          if( gal_fits_key_exists_fptr(fptr, p->name) )
             {
               /* Read the keyword. Note that we aren't checking for the
                  'status' here. If for any reason CFITSIO couldn't read the
-                 value and status if non-zero, the next step won't consider
-                 the file any more. */
+                 value and status if non-zero, the file won't have a
+                 value. */
               status=0;
-              fits_read_key(fptr, TSTRING, name, &keyvalue, NULL,
+              fits_read_key(fptr, TSTRING, p->name, &keyvalue, NULL,
                             &status);
-
-              /* If the value corresponds to any of the user's values for this
-                 keyword, add it to the list of output names. */
               if(status==0)
-                for(v=values; v!=NULL; v=v->next)
-                  {
-                    if( strcmp(v->v, keyvalue)==0 )
-                      { gal_list_str_add(&out, f->v, 1); break; }
-                  }
+                gal_checkset_allocate_copy(keyvalue, &p->values[ind]);
             }
 
           /* Close the file. */
+          status=0;
           if( fits_close_file(fptr, &status) )
             gal_fits_io_error(status, NULL);
         }
     }
 
-  /* Reverse the list to be in same order as input and return. */
-  gal_list_str_reverse(&out);
-  return out;
+  /* Wait for all the other threads to finish, then return. */
+  if(tprm->b) pthread_barrier_wait(tprm->b);
+  return NULL;
+}
+
+
+
+
+
+/* Read the value of the 'name' keyword in the 'hdu' HDU of all the given
+   FITS files (in parallel, when CFITSIO is thread-safe). The output is an
+   array with one (allocated) string for each file, in the same order as
+   the input. The element of a file is NULL when the HDU couldn't be
+   opened (for example it is not a FITS file) or the keyword couldn't be
+   read. */
+char **
+gal_fits_keyvalue_in_files(gal_list_str_t *files, char *hdu, char *name,
+                           size_t numthreads)
+{
+  size_t i, numfiles;
+  gal_list_str_t *f;
+  struct fits_keyvalue_params p;
+
+  /* If the 'fits_is_reentrant' function exists, then use it to see if
+     CFITSIO was configured in multi-thread mode. Otherwise, just use a
+     single thread. */
+#if GAL_CONFIG_HAVE_FITS_IS_REENTRANT == 1
+  size_t nthreads = fits_is_reentrant() ? numthreads : 1;
+#else
+  size_t nthreads=1;
+#endif
+
+  /* If there are no files, return NULL. */
+  numfiles=gal_list_str_number(files);
+  if(numfiles==0) return NULL;
+
+  /* Put the file names in an array and allocate the output. */
+  errno=0;
+  p.files=malloc(numfiles*sizeof *p.files);
+  if(p.files==NULL)
+    error(EXIT_FAILURE, errno, "%s: couldn't allocate %zu bytes for "
+          "'p.files'", __func__, numfiles*sizeof *p.files);
+  for(i=0, f=files; f!=NULL; f=f->next) p.files[i++]=f->v;
+  errno=0;
+  p.values=calloc(numfiles, sizeof *p.values);
+  if(p.values==NULL)
+    error(EXIT_FAILURE, errno, "%s: couldn't allocate %zu bytes for "
+          "'p.values'", __func__, numfiles*sizeof *p.values);
+
+  /* Read the keyword values. */
+  p.hdu=hdu;
+  p.name=name;
+  if(nthreads>numfiles) nthreads=numfiles;
+  gal_threads_spin_off(fits_keyvalue_in_files_worker, &p, numfiles,
+                       nthreads, -1, 1);
+
+  /* Clean up and return. */
+  free(p.files);
+  return p.values;
 }
 
 
@@ -2333,53 +2399,64 @@ gal_fits_with_keyvalue(gal_list_str_t *files, char *hdu, char *name,
 /* From an input list of FITS files and a HDU, select those that have a
    certain value(s) in a certain keyword.*/
 gal_list_str_t *
-gal_fits_unique_keyvalues(gal_list_str_t *files, char *hdu, char *name)
+gal_fits_with_keyvalue(gal_list_str_t *files, char *hdu, char *name,
+                       gal_list_str_t *values)
 {
-  fitsfile *fptr;
-  int status=0, newvalue;
-  char *keyv, keyvalue[FLEN_VALUE];
+  size_t i;
+  char **keyvalues;
   gal_list_str_t *f, *v, *out=NULL;
 
-  /* Go over the list of files and see if they have the requested
-     keyword(s). */
-  for(f=files; f!=NULL; f=f->next)
-    {
-      /* Open the file. */
-      fptr=gal_fits_hdu_open(f->v, hdu, READONLY, 0);
+  /* Read the keyword's value in all the files. */
+  keyvalues=gal_fits_keyvalue_in_files(files, hdu, name, 1);
 
-      /* Only attempt to read the value if the requested HDU could be
-         opened ('fptr!=NULL'). */
-      if(fptr)
-        {
-          /* Check if the keyword actually exists. */
-          if( gal_fits_key_exists_fptr(fptr, name) )
-            {
-              /* Read the keyword. Note that we aren't checking for the
-                 'status' here. If for any reason CFITSIO couldn't read the
-                 value and status if non-zero, the next step won't consider
-                 the file any more. */
-              status=0;
-              fits_read_key(fptr, TSTRING, name, &keyvalue, NULL,
-                            &status);
+  /* If the value corresponds to any of the user's values for this
+     keyword, add it to the list of output names. */
+  for(i=0, f=files; f!=NULL; ++i, f=f->next)
+    if(keyvalues[i])
+      {
+        for(v=values; v!=NULL; v=v->next)
+          if( strcmp(v->v, keyvalues[i])==0 )
+            { gal_list_str_add(&out, f->v, 1); break; }
+        free(keyvalues[i]);
+      }
 
-              /* If the value is new, add it to the list. */
-              if(status==0)
-                {
-                  newvalue=1;
-                  keyv=gal_txt_trim_space(keyvalue);
-                  for(v=out; v!=NULL; v=v->next)
-                    { if( strcmp(v->v, keyv)==0 ) newvalue=0; }
-                  if(newvalue) gal_list_str_add(&out, keyv, 1);
-                }
-            }
+  /* Reverse the list to be in same order as input and return. */
+  if(keyvalues) free(keyvalues);
+  gal_list_str_reverse(&out);
+  return out;
+}
 
-          /* Close the file. */
-          if( fits_close_file(fptr, &status) )
-            gal_fits_io_error(status, NULL);
-        }
-    }
+
+
+
+
+/* From an input list of FITS files and a HDU, return the unique values
+   of a certain keyword (in the order they were found). */
+gal_list_str_t *
+gal_fits_unique_keyvalues(gal_list_str_t *files, char *hdu, char *name)
+{
+  size_t i;
+  int newvalue;
+  char *keyv, **keyvalues;
+  gal_list_str_t *f, *v, *out=NULL;
+
+  /* Read the keyword's value in all the files. */
+  keyvalues=gal_fits_keyvalue_in_files(files, hdu, name, 1);
+
+  /* If the value is new, add it to the list. */
+  for(i=0, f=files; f!=NULL; ++i, f=f->next)
+    if(keyvalues[i])
+      {
+        newvalue=1;
+        keyv=gal_txt_trim_space(keyvalues[i]);
+        for(v=out; v!=NULL; v=v->next)
+          { if( strcmp(v->v, keyv)==0 ) newvalue=0; }
+        if(newvalue) gal_list_str_add(&out, keyv, 1);
+        free(keyvalues[i]);
+      }
 
   /* Reverse the list to be in same order as input and return. */
+  if(keyvalues) free(keyvalues);
   gal_list_str_reverse(&out);
   return out;
 }
@@ -2517,10 +2594,167 @@ gal_fits_img_info_dim(char *filename, char *hdu, size_t *ndim)
 
 
 
-/* Read a FITS image HDU into a Gnuastro data structure. */
+/* Parameters for reading a tile-compressed image in parallel. */
+struct fits_img_read_params
+{
+  char      *filename;   /* Name of the input file.                  */
+  char           *hdu;   /* HDU of the input image.                  */
+  int        datatype;   /* CFITSIO datatype of the output array.    */
+  void         *blank;   /* Blank value to use for null pixels.      */
+  gal_data_t     *img;   /* Output (already allocated) dataset.      */
+  size_t    blockrows;   /* Number of rows (slowest axis) in a block.*/
+};
+
+
+
+
+
+/* Each thread opens its own pointer to the compressed HDU and reads its
+   blocks of rows (along the slowest dimension) with 'fits_read_subset'.
+   CFITSIO will only decompress the tiles that overlap each block, so the
+   decompression of different blocks happens in parallel. */
+static void *
+fits_img_read_compressed_worker(void *in_prm)
+{
+  struct gal_threads_params *tprm=(struct gal_threads_params *)in_prm;
+  struct fits_img_read_params *p=(struct fits_img_read_params *)tprm->params;
+
+  fitsfile *fptr;
+  gal_data_t *img=p->img;
+  size_t i, d, first, last, rowsize;
+  int status=0, anyblank, ndim=img->ndim;
+  long *fpixel=NULL, *lpixel=NULL, *inc=NULL;
+
+  /* Only open the file if this thread actually has a job. */
+  if(tprm->indexs[0]!=GAL_BLANK_SIZE_T)
+    {
+      /* Allocate the CFITSIO coordinate arrays. */
+      fpixel=gal_pointer_allocate( ( sizeof(long)==8
+                                     ? GAL_TYPE_INT64
+                                     : GAL_TYPE_INT32 ), 3*ndim, 0,
+                                   __func__, "fpixel");
+      lpixel=fpixel+ndim;
+      inc=lpixel+ndim;
+
+      /* The number of elements in one row (along the slowest axis). */
+      rowsize=img->size/img->dsize[0];
+
+      /* Open this thread's own pointer to the HDU. */
+      fptr=gal_fits_hdu_open_format(p->filename, p->hdu, 0);
+
+      /* Go over the blocks of this thread. Note that the FITS axis order
+         is the inverse of the C order, so the block's rows are on the
+         last FITS axis. */
+      for(i=0; tprm->indexs[i] != GAL_BLANK_SIZE_T; ++i)
+        {
+          /* Rows of this block (counting from 0). */
+          first=tprm->indexs[i]*p->blockrows;
+          last=first+p->blockrows;
+          if(last>img->dsize[0]) last=img->dsize[0];
+
+          /* Set the first and last pixels (counting from 1). */
+          for(d=0;d<ndim;++d)
+            {
+              inc[d]=1;
+              fpixel[d]=1;
+              lpixel[d]=img->dsize[ndim-1-d];
+            }
+          fpixel[ndim-1]=first+1;
+          lpixel[ndim-1]=last;
+
+          /* Read this block into its place in the output. */
+          fits_read_subset(fptr, p->datatype, fpixel, lpixel, inc,
+                           p->blank,
+                           gal_pointer_increment(img->array, first*rowsize,
+                                                 img->type),
+                           &anyblank, &status);
+          gal_fits_io_error(status, NULL);
+        }
+
+      /* Clean up. */
+      if( fits_close_file(fptr, &status) ) gal_fits_io_error(status, NULL);
+      free(fpixel);
+    }
+
+  /* Wait for all the other threads to finish, then return. */
+  if(tprm->b) pthread_barrier_wait(tprm->b);
+  return NULL;
+}
+
+
+
+
+
+/* If the HDU is a tile-compressed image, 'numthreads>1' and CFITSIO is
+   thread-safe, read it in parallel and return 1. Otherwise, return 0 (to
+   let the caller read the image in serial). The blocks are an integer
+   multiple of the compression tiles along the slowest dimension (one row
+   by default in 'fpack'), so no tile is decompressed by more than one
+   thread. */
+static int
+fits_img_read_compressed(fitsfile *fptr, char *filename, char *hdu,
+                         gal_data_t *img, void *blank, size_t numthreads)
+{
+  long ztile;
+  int status=0;
+  char keyname[FLEN_KEYWORD];
+  struct fits_img_read_params p;
+  size_t nthreads, tiles, numblocks, blockrows;
+
+  /* If the 'fits_is_reentrant' function exists, then use it to see if
+     CFITSIO was configured in multi-thread mode. Otherwise, just use a
+     single thread. */
+#if GAL_CONFIG_HAVE_FITS_IS_REENTRANT == 1
+  nthreads = ( numthreads>1 && fits_is_reentrant() ) ? numthreads : 1;
+#else
+  nthreads=1;
+#endif
+
+  /* Only tile-compressed images (where the decompression is the
+     bottleneck) are worth reading in parallel. */
+  if( nthreads==1 || fits_is_compressed_image(fptr, &status)==0 )
+    return 0;
+
+  /* The size of the compression tiles along the slowest dimension. If
+     the keyword doesn't exist, CFITSIO's default is to compress each row
+     separately. */
+  sprintf(keyname, "ZTILE%zu", img->ndim);
+  if( fits_read_key(fptr, TLONG, keyname, &ztile, NULL, &status)
+      || ztile<1 )
+    ztile=1;
+
+  /* Set the number of rows in each block: the blocks should be a multiple
+     of the tile size, while giving each thread (roughly) the same number
+     of blocks. */
+  tiles=img->dsize[0]/ztile + (img->dsize[0]%ztile ? 1 : 0);
+  if(tiles<2) return 0;
+  numblocks = tiles<4*nthreads ? tiles : 4*nthreads;
+  blockrows = ztile * ( tiles/numblocks + (tiles%numblocks ? 1 : 0) );
+  numblocks = img->dsize[0]/blockrows + (img->dsize[0]%blockrows ? 1 : 0);
+
+  /* Read the blocks in parallel. */
+  p.hdu=hdu;
+  p.img=img;
+  p.blank=blank;
+  p.filename=filename;
+  p.blockrows=blockrows;
+  p.datatype=gal_fits_type_to_datatype(img->type);
+  if(nthreads>numblocks) nthreads=numblocks;
+  gal_threads_spin_off(fits_img_read_compressed_worker, &p, numblocks,
+                       nthreads, img->minmapsize, img->quietmmap);
+  return 1;
+}
+
+
+
+
+
+/* Read a FITS image HDU into a Gnuastro data structure. Tile-compressed
+   images are decompressed on 'numthreads' threads (callers that are
+   already running on many threads should give 1). */
 gal_data_t *
-gal_fits_img_read(char *filename, char *hdu, size_t minmapsize,
-                  int quietmmap)
+gal_fits_img_read(char *filename, char *hdu, size_t numthreads,
+                  size_t minmapsize, int quietmmap)
 {
   void *blank;
   long *fpixel;
@@ -2570,10 +2804,15 @@ gal_fits_img_read(char *filename, char *hdu, size_t minmapsize,
   free(dsize);
 
 
-  /* Read the image into the allocated array: */
-  fits_read_pix(fptr, gal_fits_type_to_datatype(type), fpixel,
-                img->size, blank, img->array, &anyblank, &status);
-  if(status) gal_fits_io_error(status, NULL);
+  /* Read the image into the allocated array. Tile-compressed images are
+     decompressed in parallel (when possible). */
+  if( fits_img_read_compressed(fptr, filename, hdu, img, blank,
+                               numthreads)==0 )
+    {
+      fits_read_pix(fptr, gal_fits_type_to_datatype(type), fpixel,
+                    img->size, blank, img->array, &anyblank, &status);
+      if(status) gal_fits_io_error(status, NULL);
+    }
   free(fpixel);
   free(blank);
 
@@ -2596,12 +2835,13 @@ gal_fits_img_read(char *filename, char *hdu, size_t minmapsize,
    used to convert the input file to the desired type. */
 gal_data_t *
 gal_fits_img_read_to_type(char *inputname, char *hdu, uint8_t type,
-                          size_t minmapsize, int quietmmap)
+                          size_t numthreads, size_t minmapsize,
+                          int quietmmap)
 {
   gal_data_t *in, *converted;
 
   /* Read the specified input image HDU. */
-  in=gal_fits_img_read(inputname, hdu, minmapsize, quietmmap);
+  in=gal_fits_img_read(inputname, hdu, numthreads, minmapsize, quietmmap);
 
   /* If the input had another type, convert it to float. */
   if(in->type!=type)
@@ -2629,8 +2869,14 @@ gal_fits_img_read_kernel(char *filename, char *hdu, size_t minmapsize,
   gal_data_t *kernel;
   float *f, *fp, tmp;
 
-  /* Read the image as a float and if it has a WCS structure, free it. */
-  kernel=gal_fits_img_read_to_type(filename, hdu, GAL_TYPE_FLOAT32,
+  /* When running under a server, the kernel may already be cached. */
+  kernel=gal_server_cache_find_data("kernel", filename, hdu, minmapsize,
+                                    quietmmap);
+  if(kernel) return kernel;
+
+  /* Read the image as a float and if it has a WCS structure, free it
+     (kernels are small, so there is no need for multiple threads). */
+  kernel=gal_fits_img_read_to_type(filename, hdu, GAL_TYPE_FLOAT32, 1,
                                    minmapsize, quietmmap);
   if(kernel->wcs) { wcsfree(kernel->wcs); kernel->wcs=NULL; }
 
@@ -2668,6 +2914,9 @@ gal_fits_img_read_kernel(char *filename, char *hdu, size_t minmapsize,
       f[ kernel->size - i - 1 ]=tmp;
     }
 
+  /* Keep the kernel for the next programs of the server (if any). */
+  gal_server_cache_add_data("kernel", filename, hdu, kernel);
+
   /* Return the kernel*/
   return kernel;
 }
@@ -2676,13 +2925,143 @@ gal_fits_img_read_kernel(char *filename, char *hdu, size_t minmapsize,
 
 
 
-/* This function will write all the data array information (including its
-   WCS information) into a FITS file, but will not close it. Instead it
-   will pass along the FITS pointer for further modification. */
-fitsfile *
-gal_fits_img_write_to_ptr(gal_data_t *input, char *filename)
+/* Dither seed of tile-compressed images (see
+   'fits_img_write_compress_params'). */
+#define FITS_IMG_COMPRESS_DITHER_SEED 1
+
+
+
+
+
+/* Convert Gnuastro's compression type into CFITSIO's. */
+static int
+fits_img_compress_type(uint8_t comptype)
+{
+  switch(comptype)
+    {
+    case GAL_FITS_COMPRESS_RICE:  return RICE_1;
+    case GAL_FITS_COMPRESS_GZIP:  return GZIP_1;
+    default:
+      error(EXIT_FAILURE, 0, "%s: a bug! Please contact us at %s to fix "
+            "the problem. The code %u isn't recognized as a compression "
+            "type", __func__, PACKAGE_BUGREPORT, comptype);
+    }
+
+  /* Control should not reach here. */
+  error(EXIT_FAILURE, 0, "%s: a bug! Please contact us at %s to fix the "
+        "problem. Control should not reach the end of this function",
+        __func__, PACKAGE_BUGREPORT);
+  return NOCOMPRESS;
+}
+
+
+
+
+
+/* Set the tile-compression parameters of the next image HDU that is
+   created in 'fptr'. Each row (along the first FITS axis) is compressed
+   as a separate tile, which is also CFITSIO's default, but we set it here
+   because the parallel writer depends on it. The dither seed (used when
+   quantizing floating point images) is fixed so the output doesn't
+   depend on the time it was written or on the number of threads. */
+static void
+fits_img_write_compress_params(fitsfile *fptr, int comptype, int seed,
+                               long *naxes, size_t ndim)
+{
+  size_t i;
+  int status=0;
+  long ztile[MAX_COMPRESS_DIM];
+
+  /* Set the tile size. */
+  if(ndim>MAX_COMPRESS_DIM)
+    error(EXIT_FAILURE, 0, "%s: CFITSIO can only compress images with "
+          "%d dimensions or less (input has %zu)", __func__,
+          MAX_COMPRESS_DIM, ndim);
+  for(i=0;i<ndim;++i) ztile[i] = i ? 1 : naxes[0];
+
+  /* Set the parameters. */
+  fits_set_compression_type(fptr, comptype, &status);
+  fits_set_tile_dim(fptr, ndim, ztile, &status);
+  fits_set_dither_seed(fptr, seed, &status);
+  gal_fits_io_error(status, "setting the compression parameters");
+}
+
+
+
+
+
+/* Write the keywords that describe the image (after the array has been
+   written). */
+static void
+fits_img_write_keys(fitsfile *fptr, gal_data_t *towrite, int datatype,
+                    int hasblank)
 {
   void *blank;
+  int status=0;
+
+  /* Remove the two comment lines put by CFITSIO. Note that in some cases,
+     it might not exist. When this happens, the status value will be
+     non-zero. We don't care about this error, so to be safe, we will just
+     reset the status variable after these calls. */
+  fits_delete_key(fptr, "COMMENT", &status);
+  fits_delete_key(fptr, "COMMENT", &status);
+  status=0;
+
+
+  /* If we have blank pixels, we need to define a BLANK keyword when we are
+     dealing with integer types. */
+  if(hasblank)
+    switch(towrite->type)
+      {
+      case GAL_TYPE_FLOAT32:
+      case GAL_TYPE_FLOAT64:
+        /* Do nothing! Since there are much fewer floating point types
+           (that don't need any BLANK keyword), we are checking them.*/
+        break;
+
+      default:
+        blank=gal_fits_key_img_blank(towrite->type);
+        if(fits_write_key(fptr, datatype, "BLANK", blank,
+                          "Pixels with no data.", &status) )
+          gal_fits_io_error(status, "adding the BLANK keyword");
+        free(blank);
+      }
+
+
+  /* Write the extension name to the header. */
+  if(towrite->name)
+    fits_write_key(fptr, TSTRING, "EXTNAME", towrite->name, "", &status);
+
+
+  /* Write the units to the header. */
+  if(towrite->unit)
+    fits_write_key(fptr, TSTRING, "BUNIT", towrite->unit, "", &status);
+
+
+  /* Write comments if they exist. */
+  if(towrite->comment)
+    fits_write_comment(fptr, towrite->comment, &status);
+
+
+  /* If a WCS structure is present, write it in */
+  if(towrite->wcs)
+    gal_wcs_write_in_fitsptr(fptr, towrite->wcs);
+
+
+  /* Report any errors if we had any */
+  gal_fits_io_error(status, NULL);
+}
+
+
+
+
+
+/* Write the image into a new HDU of 'filename' and return the open
+   pointer. If 'comptype' isn't 'NOCOMPRESS', CFITSIO will tile-compress
+   the image with that algorithm. */
+static fitsfile *
+fits_img_write_to_ptr(gal_data_t *input, char *filename, int comptype)
+{
   int64_t *i64;
   char *u64key;
   fitsfile *fptr;
@@ -2718,6 +3097,14 @@ gal_fits_img_write_to_ptr(gal_data_t *input, char *filename)
   for(i=0;i<ndim;++i) naxes[ndim-1-i]=towrite->dsize[i];
 
 
+  /* If the image should be compressed, set the compression parameters
+     before creating the HDU. */
+  if(comptype!=NOCOMPRESS)
+    fits_img_write_compress_params(fptr, comptype,
+                                   FITS_IMG_COMPRESS_DITHER_SEED,
+                                   naxes, ndim);
+
+
   /* Create the FITS file. Unfortunately CFITSIO doesn't have a macro for
      UINT64, TLONGLONG is only for (signed) INT64. So if the dataset has
      that type, we'll have to convert it to 'INT64' and in the mean-time
@@ -2766,76 +3153,40 @@ gal_fits_img_write_to_ptr(gal_data_t *input, char *filename)
       gal_fits_io_error(status, NULL);
     }
   else
-    {
-      /* Set the datatype */
-      datatype=gal_fits_type_to_datatype(block->type);
-
-      /* Create the FITS file. */
-      fits_create_img(fptr, gal_fits_type_to_bitpix(towrite->type),
-                      ndim, naxes, &status);
-      gal_fits_io_error(status, NULL);
-
-      /* Write the image into the file. */
-      fits_write_img(fptr, datatype, fpixel, towrite->size, towrite->array,
-                     &status);
-      gal_fits_io_error(status, NULL);
-    }
-
-
-  /* Remove the two comment lines put by CFITSIO. Note that in some cases,
-     it might not exist. When this happens, the status value will be
-     non-zero. We don't care about this error, so to be safe, we will just
-     reset the status variable after these calls. */
-  fits_delete_key(fptr, "COMMENT", &status);
-  fits_delete_key(fptr, "COMMENT", &status);
-  status=0;
-
-
-  /* If we have blank pixels, we need to define a BLANK keyword when we are
-     dealing with integer types. */
-  if(hasblank)
-    switch(towrite->type)
-      {
-      case GAL_TYPE_FLOAT32:
-      case GAL_TYPE_FLOAT64:
-        /* Do nothing! Since there are much fewer floating point types
-           (that don't need any BLANK keyword), we are checking them.*/
-        break;
-
-      default:
-        blank=gal_fits_key_img_blank(towrite->type);
-        if(fits_write_key(fptr, datatype, "BLANK", blank,
-                          "Pixels with no data.", &status) )
-          gal_fits_io_error(status, "adding the BLANK keyword");
-        free(blank);
-      }
-
+    {
+      /* Set the datatype */
+      datatype=gal_fits_type_to_datatype(block->type);
 
-  /* Write the extension name to the header. */
-  if(towrite->name)
-    fits_write_key(fptr, TSTRING, "EXTNAME", towrite->name, "", &status);
+      /* Create the FITS file. */
+      fits_create_img(fptr, gal_fits_type_to_bitpix(towrite->type),
+                      ndim, naxes, &status);
+      gal_fits_io_error(status, NULL);
 
+      /* Write the image into the file. */
+      fits_write_img(fptr, datatype, fpixel, towrite->size, towrite->array,
+                     &status);
+      gal_fits_io_error(status, NULL);
+    }
 
-  /* Write the units to the header. */
-  if(towrite->unit)
-    fits_write_key(fptr, TSTRING, "BUNIT", towrite->unit, "", &status);
 
+  /* Write the keywords, clean up and return. */
+  fits_img_write_keys(fptr, towrite, datatype, hasblank);
+  free(naxes);
+  if(towrite!=input) gal_data_free(towrite);
+  return fptr;
+}
 
-  /* Write comments if they exist. */
-  if(towrite->comment)
-    fits_write_comment(fptr, towrite->comment, &status);
 
 
-  /* If a WCS structure is present, write it in */
-  if(towrite->wcs)
-    gal_wcs_write_in_fitsptr(fptr, towrite->wcs);
 
 
-  /* Report any errors if we had any */
-  free(naxes);
-  gal_fits_io_error(status, NULL);
-  if(towrite!=input) gal_data_free(towrite);
-  return fptr;
+/* This function will write all the data array information (including its
+   WCS information) into a FITS file, but will not close it. Instead it
+   will pass along the FITS pointer for further modification. */
+fitsfile *
+gal_fits_img_write_to_ptr(gal_data_t *input, char *filename)
+{
+  return fits_img_write_to_ptr(input, filename, NOCOMPRESS);
 }
 
 
@@ -2943,6 +3294,506 @@ gal_fits_img_write_corr_wcs_str(gal_data_t *input, char *filename,
 
 
 
+/* Parameters for tile-compressing an image in parallel. */
+struct fits_img_write_params
+{
+  gal_data_t      *img;   /* Image to write (contiguous).              */
+  int         comptype;   /* CFITSIO compression algorithm.            */
+  size_t     blockrows;   /* Number of rows (slowest axis) in a block. */
+  size_t   tilesperrow;   /* Number of tiles in each row.              */
+  fitsfile     **fptrs;   /* In-memory FITS file of each block.        */
+  void      **buffers;    /* Memory buffer of each in-memory file.     */
+  size_t    *bufsizes;    /* Size of each memory buffer.               */
+};
+
+
+
+
+
+/* Each thread compresses its blocks of rows (along the slowest
+   dimension) into separate in-memory FITS files. */
+static void *
+fits_img_write_compressed_worker(void *in_prm)
+{
+  struct gal_threads_params *tprm=(struct gal_threads_params *)in_prm;
+  struct fits_img_write_params *p=(struct fits_img_write_params *)tprm->params;
+
+  fitsfile *fptr;
+  gal_data_t *img=p->img;
+  long emptynaxes=0, *naxes;
+  int seed, status=0, ndim=img->ndim;
+  size_t i, b, d, first, last, rowsize=img->size/img->dsize[0];
+
+  /* Only allocate space if this thread actually has a job. */
+  if(tprm->indexs[0]!=GAL_BLANK_SIZE_T)
+    {
+      /* Allocate the CFITSIO dimensions array. */
+      naxes=gal_pointer_allocate( ( sizeof(long)==8
+                                    ? GAL_TYPE_INT64
+                                    : GAL_TYPE_INT32 ), ndim, 0,
+                                  __func__, "naxes");
+
+      /* Go over the blocks of this thread. */
+      for(i=0; tprm->indexs[i] != GAL_BLANK_SIZE_T; ++i)
+        {
+          /* Rows of this block (counting from 0) and its dimensions (in
+             FITS order). */
+          b=tprm->indexs[i];
+          first=b*p->blockrows;
+          last=first+p->blockrows;
+          if(last>img->dsize[0]) last=img->dsize[0];
+          for(d=0;d<ndim;++d) naxes[d]=img->dsize[ndim-1-d];
+          naxes[ndim-1]=last-first;
+
+          /* The dither of each tile is found from its tile number (row in
+             the compressed table) and the seed, modulo CFITSIO's random
+             sequence length (10000). So to have the same dither as the
+             full image, the seed is shifted by the number of tiles
+             before this block. */
+          seed = ( FITS_IMG_COMPRESS_DITHER_SEED - 1
+                   + first * p->tilesperrow ) % 10000 + 1;
+
+          /* Create the in-memory FITS file: a compressed image can't be
+             in the first HDU, so an empty first HDU is made. */
+          errno=0;
+          p->bufsizes[b]=2880;
+          p->buffers[b]=malloc(p->bufsizes[b]);
+          if(p->buffers[b]==NULL)
+            error(EXIT_FAILURE, errno, "%s: couldn't allocate %zu bytes "
+                  "for 'p->buffers[b]'", __func__, p->bufsizes[b]);
+          fits_create_memfile(&fptr, &p->buffers[b], &p->bufsizes[b], 0,
+                              realloc, &status);
+          fits_create_img(fptr, BYTE_IMG, 0, &emptynaxes, &status);
+          gal_fits_io_error(status, NULL);
+
+          /* Compress this block into the second HDU. The file is flushed
+             so its header keywords (like the number of rows) are
+             complete when it is copied. */
+          fits_img_write_compress_params(fptr, p->comptype, seed, naxes,
+                                         ndim);
+          fits_create_img(fptr, gal_fits_type_to_bitpix(img->type), ndim,
+                          naxes, &status);
+          fits_write_img(fptr, gal_fits_type_to_datatype(img->type), 1,
+                         (last-first)*rowsize,
+                         gal_pointer_increment(img->array, first*rowsize,
+                                               img->type), &status);
+          fits_flush_file(fptr, &status);
+          gal_fits_io_error(status, NULL);
+          p->fptrs[b]=fptr;
+        }
+
+      /* Clean up. */
+      free(naxes);
+    }
+
+  /* Wait for all the other threads to finish, then return. */
+  if(tprm->b) pthread_barrier_wait(tprm->b);
+  return NULL;
+}
+
+
+
+
+
+/* Copy the rows (tiles) of the compressed block in 'in' into the
+   compressed table of 'out', starting from row 'firstrow+1' (the rows
+   must already exist). */
+static void
+fits_img_write_compressed_append(fitsfile *out, fitsfile *in,
+                                 long firstrow)
+{
+  uint8_t type;
+  int zblank, anynul;
+  LONGLONG num, offset;
+  long r, nrows, repeat, width;
+  void *buf=NULL;
+  size_t size, bufsize=0;
+  char keyname[FLEN_KEYWORD], ttype[FLEN_VALUE], tform[FLEN_VALUE];
+  int c, incols, outcol, outcols, typecode, datatype, status=0;
+
+  /* Basic information of the block. */
+  fits_get_num_rows(in, &nrows, &status);
+  fits_get_num_cols(in, &incols, &status);
+  gal_fits_io_error(status, NULL);
+
+  /* Go over the columns. */
+  for(c=1;c<=incols;++c)
+    {
+      /* Find this column in the output (by its name). CFITSIO only adds
+         some columns when they are necessary (for example
+         'GZIP_COMPRESSED_DATA' for tiles that couldn't be quantized), so
+         if it doesn't exist in the output, it is added. */
+      sprintf(keyname, "TTYPE%d", c);
+      fits_read_key(in, TSTRING, keyname, ttype, NULL, &status);
+      gal_fits_io_error(status, NULL);
+      if( fits_get_colnum(out, CASESEN, ttype, &outcol, &status)
+          ==COL_NOT_FOUND )
+        {
+          status=0;
+          sprintf(keyname, "TFORM%d", c);
+          fits_read_key(in, TSTRING, keyname, tform, NULL, &status);
+          fits_get_num_cols(out, &outcols, &status);
+          outcol=outcols+1;
+          fits_insert_col(out, outcol, ttype, tform, &status);
+        }
+      gal_fits_io_error(status, NULL);
+
+      /* Type of the column (it is negative for variable-length
+         columns). */
+      fits_get_coltype(in, c, &typecode, &repeat, &width, &status);
+      gal_fits_io_error(status, NULL);
+      type=gal_fits_datatype_to_type(abs(typecode), 1);
+      datatype=gal_fits_type_to_datatype(type);
+
+      /* Copy the value(s) of each row. */
+      for(r=1;r<=nrows;++r)
+        {
+          /* Number of elements in this row. */
+          if(typecode<0)
+            fits_read_descriptll(in, c, r, &num, &offset, &status);
+          else
+            num=repeat;
+          gal_fits_io_error(status, NULL);
+
+          /* Copy the values (empty variable-length cells only need a
+             descriptor). */
+          if(num)
+            {
+              size=num*gal_type_sizeof(type);
+              if(size>bufsize)
+                {
+                  errno=0;
+                  buf=realloc(buf, size);
+                  if(buf==NULL)
+                    error(EXIT_FAILURE, errno, "%s: couldn't allocate "
+                          "%zu bytes for 'buf'", __func__, size);
+                  bufsize=size;
+                }
+              fits_read_col(in, datatype, c, r, 1, num, NULL, buf,
+                            &anynul, &status);
+              fits_write_col(out, datatype, outcol, firstrow+r, 1, num,
+                             buf, &status);
+            }
+          else if(typecode<0)
+            fits_write_descript(out, outcol, firstrow+r, 0, 0, &status);
+          gal_fits_io_error(status, NULL);
+        }
+    }
+
+  /* CFITSIO only writes the 'ZBLANK' keyword when a tile has blank
+     values, so it may not have been in the previous blocks. */
+  if( fits_read_key(in, TINT, "ZBLANK", &zblank, NULL, &status)==0 )
+    fits_update_key(out, TINT, "ZBLANK", &zblank,
+                    "null value in the compressed integer array", &status);
+  else status=0;
+  gal_fits_io_error(status, NULL);
+
+  /* Clean up. */
+  free(buf);
+}
+
+
+
+
+
+/* Write 'data' as a tile-compressed image (each row is a tile) in a new
+   HDU of 'filename'. The image is divided into blocks of rows (along the
+   slowest dimension) that are compressed in parallel (on 'numthreads'
+   threads) into separate in-memory FITS files. The compressed tiles of
+   all the blocks are then written in order into the output. The output
+   is identical to the serial compression of the full image by CFITSIO
+   (which is used when 'numthreads==1' or CFITSIO isn't thread-safe). */
+void
+gal_fits_img_write_compressed(gal_data_t *data, char *filename,
+                              gal_fits_list_key_t *headers,
+                              char *program_string, uint8_t comptype,
+                              size_t numthreads)
+{
+  fitsfile *fptr;
+  LONGLONG znaxis;
+  long nrows, totrows;
+  char keyname[FLEN_KEYWORD];
+  struct fits_img_write_params p;
+  size_t i, nthreads, numblocks, blockrows;
+  gal_data_t *towrite, *block=gal_tile_block(data);
+  int status=0, cfitsiotype=fits_img_compress_type(comptype);
+
+  /* If the 'fits_is_reentrant' function exists, then use it to see if
+     CFITSIO was configured in multi-thread mode. Otherwise, just use a
+     single thread. */
+#if GAL_CONFIG_HAVE_FITS_IS_REENTRANT == 1
+  nthreads = ( numthreads>1 && fits_is_reentrant() ) ? numthreads : 1;
+#else
+  nthreads=1;
+#endif
+
+  /* Set the number of rows in each block (giving each thread roughly the
+     same number of blocks). */
+  numblocks = data->dsize[0]<4*nthreads ? data->dsize[0] : 4*nthreads;
+  blockrows = data->dsize[0]/numblocks + (data->dsize[0]%numblocks ? 1 : 0);
+  numblocks = data->dsize[0]/blockrows + (data->dsize[0]%blockrows ? 1 : 0);
+
+  /* If there is no parallelism, let CFITSIO compress the full image. A
+     1D dataset is a single tile (its only row), so it can't be divided
+     between blocks either. The 64-bit unsigned integer type also needs
+     conversion (see 'fits_img_write_to_ptr'), so it is done in the same
+     way. */
+  if( nthreads==1 || numblocks<2 || data->ndim==1
+      || block->type==GAL_TYPE_UINT64 )
+    {
+      fptr=fits_img_write_to_ptr(data, filename, cfitsiotype);
+      gal_fits_key_write_version_in_ptr(&headers, program_string, fptr);
+      fits_close_file(fptr, &status);
+      gal_fits_io_error(status, NULL);
+      return;
+    }
+
+  /* Small sanity check. */
+  if( gal_fits_name_is_fits(filename)==0 )
+    error(EXIT_FAILURE, 0, "%s: not a FITS suffix", filename);
+
+  /* If the input is a tile (isn't a contiguous region of memory), then
+     copy it into a contiguous region. */
+  towrite = data==block ? data : gal_data_copy(data);
+
+  /* Allocate the arrays for each block. */
+  errno=0;
+  p.fptrs=malloc(numblocks * sizeof *p.fptrs);
+  p.buffers=malloc(numblocks * sizeof *p.buffers);
+  p.bufsizes=malloc(numblocks * sizeof *p.bufsizes);
+  if(p.fptrs==NULL || p.buffers==NULL || p.bufsizes==NULL)
+    error(EXIT_FAILURE, errno, "%s: couldn't allocate the arrays for "
+          "%zu blocks", __func__, numblocks);
+
+  /* Compress the blocks in parallel. */
+  p.img=towrite;
+  p.blockrows=blockrows;
+  p.comptype=cfitsiotype;
+  p.tilesperrow=towrite->size/towrite->dsize[0]
+                /towrite->dsize[towrite->ndim-1];
+  if(nthreads>numblocks) nthreads=numblocks;
+  gal_threads_spin_off(fits_img_write_compressed_worker, &p, numblocks,
+                       nthreads, towrite->minmapsize, towrite->quietmmap);
+
+  /* Copy the compressed HDU of the first block into the output and add
+     the rows of the other blocks to it. All the new rows are inserted
+     at once, so the heap (where the compressed tiles are kept) is only
+     moved once. */
+  fptr=gal_fits_open_to_write(filename);
+  fits_copy_hdu(p.fptrs[0], fptr, 0, &status);
+  fits_get_num_rows(fptr, &nrows, &status);
+  totrows=towrite->size/towrite->dsize[towrite->ndim-1];
+  fits_insert_rows(fptr, nrows, totrows-nrows, &status);
+  gal_fits_io_error(status, NULL);
+  for(i=1;i<numblocks;++i)
+    fits_img_write_compressed_append(fptr, p.fptrs[i],
+                                     i*blockrows*p.tilesperrow);
+
+  /* Correct the length of the slowest dimension. */
+  znaxis=towrite->dsize[0];
+  sprintf(keyname, "ZNAXIS%zu", towrite->ndim);
+  fits_update_key(fptr, TLONGLONG, keyname, &znaxis, NULL, &status);
+  gal_fits_io_error(status, NULL);
+
+  /* Write the image keywords and the version information. */
+  fits_img_write_keys(fptr, towrite,
+                      gal_fits_type_to_datatype(towrite->type),
+                      gal_blank_present(towrite, 0));
+  gal_fits_key_write_version_in_ptr(&headers, program_string, fptr);
+
+  /* Close the output and clean up. */
+  fits_close_file(fptr, &status);
+  for(i=0;i<numblocks;++i)
+    {
+      fits_close_file(p.fptrs[i], &status);
+      free(p.buffers[i]);
+    }
+  gal_fits_io_error(status, NULL);
+  if(towrite!=data) gal_data_free(towrite);
+  free(p.bufsizes);
+  free(p.buffers);
+  free(p.fptrs);
+}
+
+
+
+
+
+/* Asynchronous image writing: a single background thread writes the
+   queued images in the same order that they were given, so the HDUs of
+   one file have the same order as the synchronous writer. */
+struct fits_write_async_item
+{
+  gal_data_t             data; /* Shallow copy (own name and WCS).     */
+  gal_data_t        *tofree;   /* Dataset to free after writing.       */
+  char            *filename;   /* Name of output (allocated).          */
+  char      *program_string;   /* Program string (not allocated).      */
+  gal_fits_list_key_t *keys;   /* Keywords to write (freed on write).  */
+  struct fits_write_async_item *next; /* Next item in the queue.       */
+};
+
+static struct
+{
+  int                          running;  /* If the writer thread exists.*/
+  int                           finish;  /* Writer should return.       */
+  pthread_t                     thread;  /* The writer thread.          */
+  pthread_mutex_t                 lock;  /* Protects this structure.    */
+  pthread_cond_t                  cond;  /* Signals changes in queue.   */
+  struct fits_write_async_item   *head;  /* First item to write.        */
+  struct fits_write_async_item   *tail;  /* Last item to write.         */
+} fits_write_async={0, 0, 0, PTHREAD_MUTEX_INITIALIZER,
+                    PTHREAD_COND_INITIALIZER, NULL, NULL};
+
+
+
+
+
+/* Write one queued item and free it. */
+static void
+fits_write_async_item_write(struct fits_write_async_item *item)
+{
+  gal_fits_img_write(&item->data, item->filename, item->keys,
+                     item->program_string);
+  if(item->tofree) gal_data_free(item->tofree);
+  if(item->data.name) free(item->data.name);
+  if(item->data.wcs) gal_wcs_free(item->data.wcs);
+  free(item->filename);
+  free(item);
+}
+
+
+
+
+
+/* The writer thread: write the queued items until there is nothing left
+   and 'gal_fits_img_write_async_wait' has been called. */
+static void *
+fits_write_async_thread(void *in_prm)
+{
+  struct fits_write_async_item *item;
+
+  pthread_mutex_lock(&fits_write_async.lock);
+  while(1)
+    {
+      /* Wait until there is something to do. */
+      while(fits_write_async.head==NULL && fits_write_async.finish==0)
+        pthread_cond_wait(&fits_write_async.cond, &fits_write_async.lock);
+
+      /* If the queue is empty, we are done. */
+      if(fits_write_async.head==NULL) break;
+
+      /* Pop the first item and write it (without holding the lock, so
+         the caller can continue queuing). */
+      item=fits_write_async.head;
+      fits_write_async.head=item->next;
+      if(fits_write_async.head==NULL) fits_write_async.tail=NULL;
+      pthread_mutex_unlock(&fits_write_async.lock);
+      fits_write_async_item_write(item);
+      pthread_mutex_lock(&fits_write_async.lock);
+    }
+  pthread_mutex_unlock(&fits_write_async.lock);
+  return NULL;
+}
+
+
+
+
+
+/* Queue an image for writing (as a new HDU of 'filename') on a background
+   thread and return immediately. The array and units of 'data' must not
+   be changed until 'gal_fits_img_write_async_wait' is called (its name
+   and WCS can be changed: a copy is kept). If 'freedata' is non-zero, 'data'
+   will be freed after it is written. Like 'gal_fits_img_write', the
+   'headers' list will be freed after writing. */
+void
+gal_fits_img_write_async(gal_data_t *data, char *filename,
+                         gal_fits_list_key_t *headers, char *program_string,
+                         int freedata)
+{
+  int err;
+  struct fits_write_async_item *item;
+
+  /* If CFITSIO isn't thread-safe, the caller may read (or write) other
+     FITS files while the writer thread is working. So we'll just write
+     the image here. */
+#if GAL_CONFIG_HAVE_FITS_IS_REENTRANT == 1
+  if( fits_is_reentrant()==0 )
+#endif
+    {
+      gal_fits_img_write(data, filename, headers, program_string);
+      if(freedata) gal_data_free(data);
+      return;
+    }
+
+  /* Allocate and fill the item. */
+  errno=0;
+  item=malloc(sizeof *item);
+  if(item==NULL)
+    error(EXIT_FAILURE, errno, "%s: couldn't allocate %zu bytes for "
+          "'item'", __func__, sizeof *item);
+  item->data=*data;
+  item->data.next=NULL;
+  item->data.name=NULL;
+  if(data->name) gal_checkset_allocate_copy(data->name, &item->data.name);
+  item->data.wcs=gal_wcs_copy(data->wcs);
+  gal_checkset_allocate_copy(filename, &item->filename);
+  item->tofree = freedata ? data : NULL;
+  item->program_string=program_string;
+  item->keys=headers;
+  item->next=NULL;
+
+  /* Add it to the end of the queue and start the writer thread if it
+     isn't already running. */
+  pthread_mutex_lock(&fits_write_async.lock);
+  if(fits_write_async.tail) fits_write_async.tail->next=item;
+  else                      fits_write_async.head=item;
+  fits_write_async.tail=item;
+  if(fits_write_async.running==0)
+    {
+      fits_write_async.finish=0;
+      err=pthread_create(&fits_write_async.thread, NULL,
+                         fits_write_async_thread, NULL);
+      if(err)
+        error(EXIT_FAILURE, err, "%s: couldn't create the writer thread",
+              __func__);
+      fits_write_async.running=1;
+    }
+  else pthread_cond_signal(&fits_write_async.cond);
+  pthread_mutex_unlock(&fits_write_async.lock);
+}
+
+
+
+
+
+/* Wait until all the queued images have been written. This has to be
+   called before the written files are used (or the datasets that were
+   given to 'gal_fits_img_write_async' are modified or freed). */
+void
+gal_fits_img_write_async_wait(void)
+{
+  int running;
+
+  /* Let the writer thread know that it should return once the queue is
+     empty. */
+  pthread_mutex_lock(&fits_write_async.lock);
+  running=fits_write_async.running;
+  fits_write_async.finish=1;
+  pthread_cond_signal(&fits_write_async.cond);
+  pthread_mutex_unlock(&fits_write_async.lock);
+
+  /* Wait for it to finish. */
+  if(running)
+    {
+      pthread_join(fits_write_async.thread, NULL);
+      fits_write_async.running=0;
+    }
+}
+
+
+
+
+
 
 
 
@@ -3470,12 +4321,14 @@ gal_fits_tab_info(char *filename, char *hdu, size_t *numcols,
 
 
 /* Read CFITSIO un-readable (INF, -INF or NAN) floating point values in
-   FITS ASCII tables. */
+   FITS ASCII tables. Only 'numrows' rows are read, starting from
+   'firstrow' (counting from zero), they are written into 'out' starting
+   from its 'outfirst' row. */
 static void
-fits_tab_read_ascii_float_special(char *filename, char *hdu, fitsfile *fptr,
-                                  gal_data_t *out, size_t colnum,
-                                  size_t numrows, size_t minmapsize,
-                                  int quietmmap)
+fits_tab_read_ascii_float_special(fitsfile *fptr, gal_data_t *out,
+                                  size_t colnum, size_t firstrow,
+                                  size_t outfirst, size_t numrows,
+                                  size_t minmapsize, int quietmmap)
 {
   double tmp;
   char **strarr;
@@ -3484,24 +4337,19 @@ fits_tab_read_ascii_float_special(char *filename, char *hdu, fitsfile *fptr,
   size_t i, colwidth=50;
   int anynul=0, status=0;
 
-  /* Allocate the dataset to keep the string values. */
-  strrows=gal_data_alloc(NULL, GAL_TYPE_STRING, 1, &numrows, NULL, 0,
+  /* Allocate the dataset to keep the string values. The array of
+     pointers is cleared (all NULL) so 'gal_data_string_arena' doesn't
+     read or free anything. */
+  strrows=gal_data_alloc(NULL, GAL_TYPE_STRING, 1, &numrows, NULL, 1,
                          minmapsize, quietmmap, NULL, NULL, NULL);
 
-  /* Allocate the space to keep the string values. */
+  /* Allocate the space to keep the string values (in one allocation). */
+  gal_data_string_arena(strrows, colwidth);
   strarr=strrows->array;
-  for(i=0;i<numrows;++i)
-    {
-      errno=0;
-      strarr[i]=calloc(colwidth, sizeof *strarr[i]);
-      if(strarr[i]==NULL)
-        error(EXIT_FAILURE, errno, "%s: allocating %zu bytes for "
-              "strarr[%zu]", __func__, colwidth * sizeof *strarr[i], i);
-    }
 
   /* Read the column as a string. */
-  fits_read_col(fptr, TSTRING, colnum, 1, 1, out->size, NULL, strrows->array,
-                &anynul, &status);
+  fits_read_col(fptr, TSTRING, colnum, firstrow+1, 1, numrows, NULL,
+                strrows->array, &anynul, &status);
   gal_fits_io_error(status, NULL);
 
   /* Convert the strings to float. */
@@ -3514,9 +4362,9 @@ fits_tab_read_ascii_float_special(char *filename, char *hdu, fitsfile *fptr,
 
       /* Write it into the output dataset. */
       if(out->type==GAL_TYPE_FLOAT32)
-        ((float *)(out->array))[i]=tmp;
+        ((float *)(out->array))[outfirst+i]=tmp;
       else
-        ((double *)(out->array))[i]=tmp;
+        ((double *)(out->array))[outfirst+i]=tmp;
     }
 
   /* Clean up. */
@@ -3527,158 +4375,149 @@ fits_tab_read_ascii_float_special(char *filename, char *hdu, fitsfile *fptr,
 
 
 
-/* Read one column of the table in parallel. */
-struct fits_tab_read_onecol_params
+/* Read the table in parallel. FITS tables are stored row-by-row (all the
+   columns of the first row, then all the columns of the second row and so
+   on). So reading the table column-by-column would go over the full file
+   for every column. Here, each thread is given a contiguous range of rows
+   ('blockrows' rows). Within its range, a thread reads all the requested
+   columns in small sub-blocks of 'iorows' rows (the optimal number of rows
+   that fit in CFITSIO's internal buffers, see 'fits_get_rowsize'). So the
+   raw bytes of each sub-block are only read from the file once and
+   CFITSIO's (bulk) conversion to the native byte-order/type of each column
+   is done from its internal buffers.
+
+   When only some of the rows are requested ('rowids!=NULL'), the blocks
+   are defined on the output rows and each sub-block is a run of
+   consecutive input rows. */
+struct fits_tab_read_params
 {
   char              *filename;  /* Name of FITS file with table.     */
   char                   *hdu;  /* HDU of input table.               */
-  size_t              numrows;  /* Number of rows in table to read.  */
+  int                 hdutype;  /* Binary or ASCII table.            */
+  size_t              numrows;  /* Number of rows to read.           */
+  size_t              *rowids;  /* Sorted rows to read (or NULL).    */
   size_t              numcols;  /* Number of columns.                */
+  size_t            blockrows;  /* Number of rows for each thread.   */
+  size_t               iorows;  /* Number of rows in each I/O block. */
   size_t           minmapsize;  /* Minimum space to memory-map.      */
   int               quietmmap;  /* Don't print memory-mapping info.  */
   gal_data_t         *allcols;  /* Information of all columns.       */
   gal_data_t       **colarray;  /* Array of pointers to all columns. */
-  gal_list_sizet_t   *indexll;  /* Index of columns to read.         */
+  size_t            *colindex;  /* Index of each column in the input.*/
+  void              **blanks;   /* Blank value to give CFITSIO.      */
 };
+
+
+
+
+
 void *
-fits_tab_read_onecol(void *in_prm)
+fits_tab_read_rows(void *in_prm)
 {
   /* Low-level definitions to be done first. */
   struct gal_threads_params *tprm=(struct gal_threads_params *)in_prm;
-  struct fits_tab_read_onecol_params *p
-    = (struct fits_tab_read_onecol_params *)tprm->params;
+  struct fits_tab_read_params *p=(struct fits_tab_read_params *)tprm->params;
 
   /* Subsequent definitions. */
   char **strarr;
   fitsfile *fptr;
-  gal_data_t *col;
-  gal_list_sizet_t *tmp;
-  void *blank, *blankuse;
-  int isfloat, hdutype, anynul=0, status=0;
-  size_t i, j, c, strw, indout, indin=GAL_BLANK_SIZE_T;
+  void *blankuse;
+  int isfloat, anynul=0, status=0;
+  gal_data_t *col, *incol;
+  size_t i, j, c, start, end, first, num, inrow;
 
   /* Open the FITS file */
   fptr=gal_fits_hdu_open_format(p->filename, p->hdu, 1);
 
-  /* See if its a Binary or ASCII table (necessary for floating point
-     blank values). */
-  if (fits_get_hdu_type(fptr, &hdutype, &status) )
-    gal_fits_io_error(status, NULL);
-
-  /* Go over all the columns that were assigned to this thread. */
+  /* Go over all the row-blocks that were assigned to this thread. */
   for(i=0; tprm->indexs[i] != GAL_BLANK_SIZE_T; ++i)
     {
-      /* Find the necessary indexs (index of output column 'indout', and
-         index of input 'indin'). */
-      c=0;
-      indout = tprm->indexs[i];
-      for(tmp=p->indexll;tmp!=NULL;tmp=tmp->next)
-        { if(c==indout) { indin=tmp->v; break; } ++c; }
-
-      /* Allocate the necessary space for this column. */
-      col=gal_data_alloc(NULL, p->allcols[indin].type, 1,
-                         &p->numrows, NULL, 0, p->minmapsize,
-                         p->quietmmap, p->allcols[indin].name,
-                         p->allcols[indin].unit,
-                         p->allcols[indin].comment);
-
-      /* For a string column, we need an allocated array for each element,
-         even in binary values. This value should be stored in the
-         disp_width element of the data structure, which is done
-         automatically in 'gal_fits_table_info'. */
-      if(col->type==GAL_TYPE_STRING)
+      /* Range of rows of this block. */
+      start = tprm->indexs[i] * p->blockrows;
+      end   = ( start + p->blockrows > p->numrows
+                ? p->numrows
+                : start + p->blockrows );
+
+      /* Go over the I/O sub-blocks of this block, and read all the
+         columns for each sub-block. 'first' is the output row of the
+         sub-block and 'inrow' is the same row in the input table. */
+      for(first=start; first<end; first+=num)
         {
-          /* Since the column may contain blank values, and the blank
-             string is pre-defined in Gnuastro, we need to be sure that for
-             each row, a blank string can fit. */
-          strw = ( strlen(GAL_BLANK_STRING) > p->allcols[indin].disp_width
-                   ? strlen(GAL_BLANK_STRING)
-                   : p->allcols[indin].disp_width );
-
-          /* Allocate the space for each row's strings. */
-          strarr=col->array;
-          for(j=0;j<p->numrows;++j)
+          if(p->rowids)
             {
-              errno=0;
-              strarr[j]=calloc(strw+1, sizeof *strarr[0]); /* +1 for '\0' */
-              if(strarr[j]==NULL)
-                error(EXIT_FAILURE, errno, "%s: allocating %zu bytes for "
-                      "strarr[%zu]", __func__,
-                      (p->allcols[indin].disp_width+1) * sizeof *strarr[j],
-                      j);
+              num=1;
+              inrow=p->rowids[first];
+              while( first+num<end && num<p->iorows
+                     && p->rowids[first+num]==inrow+num )
+                ++num;
             }
-        }
-
-      /* If this column has a 'repeat' of zero, then just set all its
-         elements to its relevant blank type and don't call CFITSIO (there
-         is nothing for it to read, and it will crash with "FITSIO status =
-         308: bad first element number First element to write is too large:
-         1; max allowed value is 0"). */
-      if(p->allcols[indin].flag & GAL_TABLEINTERN_FLAG_TFORM_REPEAT_IS_ZERO)
-        gal_blank_initialize(col);
-
-      /* The column has non-zero width, read its contents. */
-      else
-        {
-          /* Allocate a blank value for the given type and read/store the
-             column using CFITSIO.
-
-             * For binary tables, we only need blank values for integer
-               types. For binary floating point types, the FITS standard
-               defines blanks as NaN (same as almost any other software
-               like Gnuastro). However if a blank value is specified,
-               CFITSIO will convert other special numbers like 'inf' to NaN
-               also. We want to be able to distringuish 'inf' and NaN here,
-               so for floating point types in binary tables, we won't
-               define any blank value. In ASCII tables, CFITSIO doesn't
-               read the 'NAN' values (that it has written itself) unless we
-               specify a blank pointer/value.
-
-             * 'fits_read_col' takes the pointer to the thing that should
-               be placed in a blank column (for strings, the 'char *')
-               pointer. However, for strings, 'gal_blank_alloc_write' will
-               return a 'char **' pointer! So for strings, we need to
-               dereference the blank. This is why we need 'blankuse'. */
-          isfloat = ( col->type==GAL_TYPE_FLOAT32
-                      || col->type==GAL_TYPE_FLOAT64 );
-          blank = ( ( hdutype==BINARY_TBL && isfloat )
-                    ? NULL
-                    : gal_blank_alloc_write(col->type) );
-          blankuse = ( col->type==GAL_TYPE_STRING
-                       ? *((char **)blank)
-                       : blank);
-          fits_read_col(fptr, gal_fits_type_to_datatype(col->type),
-                        indin+1, 1, 1, col->size, blankuse, col->array,
-                        &anynul, &status);
-
-          /* In the ASCII table format some things need to be checked. */
-          if( hdutype==ASCII_TBL )
+          else
+            {
+              inrow=first;
+              num = first + p->iorows > end ? end - first : p->iorows;
+            }
+          for(c=0;c<p->numcols;++c)
             {
-              /* CFITSIO might not be able to read 'INF' or '-INF'. In this
-                case, it will set status to 'BAD_C2D' or 'BAD_C2F'. So,
-                we'll use our own parser for the column values. */
-              if(isfloat && (status==BAD_C2D || status==BAD_C2F) )
+              /* For easy reading. */
+              col=p->colarray[c];
+              incol=&p->allcols[ p->colindex[c] ];
+
+              /* If this column has a 'repeat' of zero, then just set its
+                 elements to its relevant blank type and don't call CFITSIO
+                 (there is nothing for it to read, and it will crash with
+                 "FITSIO status = 308: bad first element number First
+                 element to write is too large: 1; max allowed value is
+                 0"). */
+              if(incol->flag & GAL_TABLEINTERN_FLAG_TFORM_REPEAT_IS_ZERO)
+                {
+                  if(col->type==GAL_TYPE_STRING)
+                    {
+                      strarr=col->array;
+                      for(j=first;j<first+num;++j)
+                        strcpy(strarr[j], GAL_BLANK_STRING);
+                    }
+                  else
+                    gal_blank_initialize_array(
+                            gal_pointer_increment(col->array, first,
+                                                  col->type),
+                            num, col->type);
+                  continue;
+                }
+
+              /* 'fits_read_col' takes the pointer to the thing that should
+                 be placed in a blank column (for strings, the 'char *')
+                 pointer. However, for strings, 'gal_blank_alloc_write'
+                 will return a 'char **' pointer! So for strings, we need
+                 to dereference the blank. This is why we need
+                 'blankuse'. */
+              blankuse = ( (col->type==GAL_TYPE_STRING && p->blanks[c])
+                           ? *((char **)(p->blanks[c]))
+                           : p->blanks[c] );
+              fits_read_col(fptr, gal_fits_type_to_datatype(col->type),
+                            p->colindex[c]+1, inrow+1, 1, num, blankuse,
+                            gal_pointer_increment(col->array, first,
+                                                  col->type),
+                            &anynul, &status);
+
+              /* CFITSIO might not be able to read 'INF' or '-INF' in
+                 ASCII tables. In this case, it will set status to
+                 'BAD_C2D' or 'BAD_C2F'. So, we'll use our own parser for
+                 the column values. */
+              isfloat = ( col->type==GAL_TYPE_FLOAT32
+                          || col->type==GAL_TYPE_FLOAT64 );
+              if( p->hdutype==ASCII_TBL && isfloat
+                  && (status==BAD_C2D || status==BAD_C2F) )
                 {
-                  fits_tab_read_ascii_float_special(p->filename, p->hdu,
-                                                    fptr, col, indin+1,
-                                                    p->numrows,
+                  fits_tab_read_ascii_float_special(fptr, col,
+                                                    p->colindex[c]+1,
+                                                    inrow, first, num,
                                                     p->minmapsize,
                                                     p->quietmmap);
                   status=0;
                 }
+              gal_fits_io_error(status, NULL); /* After 'status' check. */
             }
-          gal_fits_io_error(status, NULL); /* After 'status' correction. */
-
-          /* Clean up and sanity check (just note that the blank value for
-             strings, is an array of strings, so we need to free the
-             contents before freeing itself). */
-          if(col->type==GAL_TYPE_STRING)
-            {strarr=blank; free(strarr[0]);}
-          if(blank) free(blank);
         }
-
-      /* Everything is fine, put this column in the output array. */
-      p->colarray[indout]=col;
     }
 
   /* Close the FITS file */
@@ -3695,16 +4534,21 @@ fits_tab_read_onecol(void *in_prm)
 
 
 
-/* Read the column indexs into a dataset. */
+/* Read the column indexs into a dataset. When 'rowids!=NULL', only the
+   (sorted, counting from zero) rows within it will be read. */
 gal_data_t *
 gal_fits_tab_read(char *filename, char *hdu, size_t numrows,
                   gal_data_t *allcols, gal_list_sizet_t *indexll,
-                  size_t numthreads, size_t minmapsize, int quietmmap)
+                  gal_data_t *rowids, size_t numthreads,
+                  size_t minmapsize, int quietmmap)
 {
-  size_t i;
+  long iorows;
+  size_t i, strw;
+  int status=0;
+  fitsfile *fptr;
   gal_data_t *out=NULL;
   gal_list_sizet_t *ind;
-  struct fits_tab_read_onecol_params p;
+  struct fits_tab_read_params p;
 
   /* If the 'fits_is_reentrant' function exists, then use it to see if
      CFITSIO was configured in multi-thread mode. Otherwise, just use a
@@ -3715,35 +4559,128 @@ gal_fits_tab_read(char *filename, char *hdu, size_t numrows,
   size_t nthreads=1;
 #endif
 
+  /* If only some rows are requested, the output will only have those
+     rows. */
+  if(rowids)
+    {
+      if(rowids->type!=GAL_TYPE_SIZE_T)
+        error(EXIT_FAILURE, 0, "%s: 'rowids' should have a type of "
+              "'size_t' (GAL_TYPE_SIZE_T)", __func__);
+      numrows=rowids->size;
+    }
+
   /* We actually do have columns to read. */
   if(numrows)
     {
-      /* Allocate array of output columns (to keep each read column in its
-         proper place as they are read in parallel). */
-      errno=0;
+      /* Get the table type and the optimal number of rows to read in
+         each call to CFITSIO. */
+      fptr=gal_fits_hdu_open_format(filename, hdu, 1);
+      if( fits_get_hdu_type(fptr, &p.hdutype, &status) )
+        gal_fits_io_error(status, NULL);
+      if( fits_get_rowsize(fptr, &iorows, &status) )
+        gal_fits_io_error(status, NULL);
+      fits_close_file(fptr, &status);
+      gal_fits_io_error(status, NULL);
+
+      /* Allocate the arrays of output columns, their input index and the
+         blank values to use. */
       p.numcols = gal_list_sizet_number(indexll);
+      p.colindex = gal_pointer_allocate(GAL_TYPE_SIZE_T, p.numcols, 0,
+                                        __func__, "p.colindex");
+      errno=0;
       p.colarray = calloc( p.numcols, sizeof *(p.colarray) );
       if(p.colarray==NULL)
         error(EXIT_FAILURE, 0, "%s: couldn't allocate %zu bytes for "
               "'p.colarray'", __func__, p.numcols*(sizeof *(p.colarray)));
+      errno=0;
+      p.blanks = calloc( p.numcols, sizeof *(p.blanks) );
+      if(p.blanks==NULL)
+        error(EXIT_FAILURE, 0, "%s: couldn't allocate %zu bytes for "
+              "'p.blanks'", __func__, p.numcols*(sizeof *(p.blanks)));
+
+      /* Allocate all the output columns (so the threads only have to fill
+         them) and set their blank values.
+
+         * For binary tables, we only need blank values for integer
+           types. For binary floating point types, the FITS standard
+           defines blanks as NaN (same as almost any other software like
+           Gnuastro). However if a blank value is specified, CFITSIO will
+           convert other special numbers like 'inf' to NaN also. We want to
+           be able to distringuish 'inf' and NaN here, so for floating
+           point types in binary tables, we won't define any blank
+           value. In ASCII tables, CFITSIO doesn't read the 'NAN' values
+           (that it has written itself) unless we specify a blank
+           pointer/value. */
+      for(i=0, ind=indexll; ind!=NULL; ++i, ind=ind->next)
+        {
+          /* String columns are cleared (all pointers NULL), so
+             'gal_data_string_arena' (below) doesn't read or free
+             un-initialized pointers. */
+          p.colindex[i]=ind->v;
+          p.colarray[i]=gal_data_alloc(NULL, allcols[ind->v].type, 1,
+                                       &numrows, NULL,
+                                       allcols[ind->v].type==GAL_TYPE_STRING,
+                                       minmapsize, quietmmap,
+                                       allcols[ind->v].name,
+                                       allcols[ind->v].unit,
+                                       allcols[ind->v].comment);
+
+          /* For a string column, CFITSIO needs allocated space for each
+             element. The width of the strings is stored in the
+             'disp_width' element of the column information (which is
+             done automatically in 'gal_fits_table_info'). Since the
+             column may contain blank values, and the blank string is
+             pre-defined in Gnuastro, we need to be sure that a blank
+             string can also fit in each row. To avoid one allocation per
+             row, all the strings are put in a single allocation. */
+          if(p.colarray[i]->type==GAL_TYPE_STRING)
+            {
+              strw = ( strlen(GAL_BLANK_STRING) > allcols[ind->v].disp_width
+                       ? strlen(GAL_BLANK_STRING)
+                       : allcols[ind->v].disp_width );
+              gal_data_string_arena(p.colarray[i], strw+1);
+            }
+          p.blanks[i] = ( ( p.hdutype==BINARY_TBL
+                            && ( p.colarray[i]->type==GAL_TYPE_FLOAT32
+                                 || p.colarray[i]->type==GAL_TYPE_FLOAT64 ) )
+                          ? NULL
+                          : gal_blank_alloc_write(p.colarray[i]->type) );
+        }
 
-      /* Prepare for parallelization and spin-off the threads. */
+      /* Prepare for parallelization: each thread will get one contiguous
+         block of rows. */
       p.hdu = hdu;
       p.allcols = allcols;
       p.numrows = numrows;
-      p.indexll = indexll;
       p.filename = filename;
+      p.rowids = rowids ? rowids->array : NULL;
       p.quietmmap = quietmmap;
       p.minmapsize = minmapsize;
-      gal_threads_spin_off(fits_tab_read_onecol, &p, p.numcols, nthreads,
+      if(nthreads>numrows) nthreads=numrows;
+      p.iorows = iorows>0 ? iorows : 1;
+      p.blockrows = numrows/nthreads + (numrows%nthreads ? 1 : 0);
+
+      /* Spin-off the threads. */
+      gal_threads_spin_off(fits_tab_read_rows, &p, nthreads, nthreads,
                            minmapsize, quietmmap);
 
-      /* Put the columns into a single list and free the array of
-         pointers. */
+      /* Put the columns into a single list and clean up (just note that
+         the blank value for strings, is an array of strings, so we need
+         to free the contents before freeing itself). */
       out=p.colarray[0];
-      for(i=0;i<p.numcols-1;++i)
-        p.colarray[i]->next = p.colarray[i+1];
+      for(i=0;i<p.numcols;++i)
+        {
+          if(i<p.numcols-1) p.colarray[i]->next = p.colarray[i+1];
+          if(p.blanks[i])
+            {
+              if(p.colarray[i]->type==GAL_TYPE_STRING)
+                free( *((char **)(p.blanks[i])) );
+              free(p.blanks[i]);
+            }
+        }
       free(p.colarray);
+      free(p.colindex);
+      free(p.blanks);
     }
 
   /* There are no rows to read ('numrows==NULL'). Make an empty-sized
@@ -3786,8 +4723,8 @@ gal_fits_tab_read(char *filename, char *hdu, size_t numrows,
 static size_t
 fits_string_fixed_alloc_size(gal_data_t *data)
 {
-  size_t i, j, maxlen=0;
-  char *tmp, **strarr=data->array;
+  size_t i, maxlen=0;
+  char **strarr=data->array;
 
   /* Return 0 if the dataset is not a string. */
   if(data->type!=GAL_TYPE_STRING)
@@ -3797,29 +4734,10 @@ fits_string_fixed_alloc_size(gal_data_t *data)
   for(i=0;i<data->size;++i)
     maxlen = strlen(strarr[i])>maxlen ? strlen(strarr[i]) : maxlen;
 
-  /* For all elements, check the length and if they aren't equal to maxlen,
-     then allocate a maxlen sized array and put the values in. */
-  for(i=0;i<data->size;++i)
-    {
-      /* Allocate (and clear) the space for the new string. We want it to
-         be cleared, so when the strings are smaller, the rest of the space
-         is filled with '\0' (ASCII for 0) values.*/
-      errno=0;
-      tmp=calloc(maxlen+1, sizeof *strarr[i]);
-      if(tmp==NULL)
-        error(EXIT_FAILURE, 0, "%s: %zu bytes for tmp", __func__,
-              (maxlen+1)*sizeof *strarr[i]);
-
-      /* Put the old array into the newly allocated space. 'tmp' was
-         cleared (all values set to '\0', so we don't need to set the final
-         one explicity after the copy.*/
-      for(j=0;strarr[i][j]!='\0';++j)
-        tmp[j]=strarr[i][j];
-
-      /* Free the old array and put in the new one. */
-      free(strarr[i]);
-      strarr[i]=tmp;
-    }
+  /* Put all the strings in one allocation where each has 'maxlen+1'
+     bytes. The space after shorter strings is cleared (filled with '\0'
+     characters) in the process. */
+  gal_data_string_arena(data, maxlen+1);
 
   /* Return the allocated space. */
   return maxlen+1;
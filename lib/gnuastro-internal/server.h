@@ -0,0 +1,87 @@
+/*********************************************************************
+Optional resident server to run the programs without re-starting them.
+This is part of GNU Astronomy Utilities (Gnuastro) package.
+
+Original author:
+     Mohammad Akhlaghi <mohammad@akhlaghi.org>
+Contributing author(s):
+Copyright (C) 2022 Free Software Foundation, Inc.
+
+Gnuastro is free software: you can redistribute it and/or modify it
+under the terms of the GNU General Public License as published by the
+Free Software Foundation, either version 3 of the License, or (at your
+option) any later version.
+
+Gnuastro is distributed in the hope that it will be useful, but
+WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with Gnuastro. If not, see <http://www.gnu.org/licenses/>.
+**********************************************************************/
+#ifndef __GAL_SERVER_H__
+#define __GAL_SERVER_H__
+
+/* Include other headers if necessary here. Note that other header files
+   must be included before the C++ preparations below */
+#include <gnuastro/data.h>
+
+
+
+/* C++ Preparations */
+#undef __BEGIN_C_DECLS
+#undef __END_C_DECLS
+#ifdef __cplusplus
+# define __BEGIN_C_DECLS extern "C" {
+# define __END_C_DECLS }
+#else
+# define __BEGIN_C_DECLS                /* empty */
+# define __END_C_DECLS                  /* empty */
+#endif
+/* End of C++ preparations */
+
+
+
+/* Actual header contants (the above were for the Pre-processor). */
+__BEGIN_C_DECLS  /* From C++ preparations */
+
+
+
+/* Environment variable containing the directory of the servers' sockets
+   and the special (first) argument to start a server. */
+#define GAL_SERVER_ENV            "GNUASTRO_SERVER"
+#define GAL_SERVER_ARG            "--server"
+
+/* Maximum number of bytes to keep in the cache of each server. */
+#define GAL_SERVER_CACHE_MAXSIZE  (256*1024*1024)
+
+
+
+void
+gal_server_main(int argc, char *argv[], char *program_exec,
+                int (*program_main)(int, char **));
+
+int
+gal_server_served();
+
+void *
+gal_server_cache_find(char *kind, char *filename, char *hdu, size_t *size);
+
+void
+gal_server_cache_add(char *kind, char *filename, char *hdu, void *data,
+                     size_t size);
+
+gal_data_t *
+gal_server_cache_find_data(char *kind, char *filename, char *hdu,
+                           size_t minmapsize, int quietmmap);
+
+void
+gal_server_cache_add_data(char *kind, char *filename, char *hdu,
+                          gal_data_t *data);
+
+
+
+__END_C_DECLS    /* From C++ preparations */
+
+#endif           /* __GAL_SERVER_H__ */
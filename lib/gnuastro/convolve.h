@@ -49,11 +49,21 @@ gal_convolve_spatial(gal_data_t *tiles, gal_data_t *kernel,
                      size_t numthreads, int edgecorrection, int convoverch);
 
 
+void
+gal_convolve_spatial_tiles(gal_data_t *tiles, gal_data_t *kernel,
+                           size_t numthreads, int edgecorrection,
+                           int convoverch, size_t *tileids,
+                           size_t numtileids, gal_data_t *out);
+
 void
 gal_convolve_spatial_correct_ch_edge(gal_data_t *tiles, gal_data_t *kernel,
                                      size_t numthreads, int edgecorrection,
                                      gal_data_t *tocorrect);
 
+gal_data_t *
+gal_convolve_spatial_batch(gal_data_t *input, gal_data_t *kernel,
+                           size_t numthreads, int edgecorrection);
+
 
 
 __END_C_DECLS    /* From C++ preparations */
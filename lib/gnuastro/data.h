@@ -90,12 +90,16 @@ __BEGIN_C_DECLS  /* From C++ preparations */
 /* Bit 4: Dataset is sorted and decreasing. */
 #define GAL_DATA_FLAG_SORTED_D     0x10
 
+/* Bit 5: String dataset whose pointers and characters are all in one
+          allocation (see 'gal_data_string_arena'). */
+#define GAL_DATA_FLAG_STRARENA     0x20
+
 /* Maximum internal flag value. Higher-level flags can be defined with the
    bitwise shift operators on this value to define internal flags for
    libraries/programs that depend on Gnuastro without causing any possible
    conflict with the internal flags or having to check the values manually
    on every release. */
-#define GAL_DATA_FLAG_MAXFLAG      GAL_DATA_FLAG_SORTED_D
+#define GAL_DATA_FLAG_MAXFLAG      GAL_DATA_FLAG_STRARENA
 
 
 
@@ -275,6 +279,19 @@ gal_data_array_ptr_free(gal_data_t **dataptr, size_t size, int free_array);
 
 
 
+
+/*********************************************************************/
+/*************             String datasets          ******************/
+/*********************************************************************/
+void
+gal_data_string_arena(gal_data_t *data, size_t width);
+
+void
+gal_data_string_separate(gal_data_t *data);
+
+
+
+
 /*************************************************************
  **************            Copying             ***************
  *************************************************************/
@@ -74,6 +74,17 @@ __BEGIN_C_DECLS  /* From C++ preparations */
 
 
 
+/* Tile-compression algorithms (for 'gal_fits_img_write_compressed'). */
+enum gal_fits_compress_types
+{
+  GAL_FITS_COMPRESS_INVALID,      /* Invalid (=0 by C standard).       */
+
+  GAL_FITS_COMPRESS_RICE,         /* Rice (CFITSIO's 'RICE_1').        */
+  GAL_FITS_COMPRESS_GZIP,         /* GZIP (CFITSIO's 'GZIP_1').        */
+};
+
+
+
 /* To create a linked list of headers. */
 typedef struct gal_fits_list_key_t
 {
@@ -268,6 +279,10 @@ void
 gal_fits_key_write_config(gal_fits_list_key_t **keylist, char *title,
                           char *extname, char *filename, char *hdu);
 
+char **
+gal_fits_keyvalue_in_files(gal_list_str_t *files, char *hdu, char *name,
+                           size_t numthreads);
+
 gal_list_str_t *
 gal_fits_with_keyvalue(gal_list_str_t *files, char *hdu, char *name,
                        gal_list_str_t *values);
@@ -290,11 +305,13 @@ size_t *
 gal_fits_img_info_dim(char *filename, char *hdu, size_t *ndim);
 
 gal_data_t *
-gal_fits_img_read(char *filename, char *hdu, size_t minmapsize, int quietmmap);
+gal_fits_img_read(char *filename, char *hdu, size_t numthreads,
+                  size_t minmapsize, int quietmmap);
 
 gal_data_t *
 gal_fits_img_read_to_type(char *inputname, char *hdu, uint8_t type,
-                          size_t minmapsize, int quietmmap);
+                          size_t numthreads, size_t minmapsize,
+                          int quietmmap);
 
 gal_data_t *
 gal_fits_img_read_kernel(char *filename, char *hdu, size_t minmapsize,
@@ -318,6 +335,20 @@ gal_fits_img_write_corr_wcs_str(gal_data_t *input, char *filename,
                                 gal_fits_list_key_t *headers,
                                 char *program_string);
 
+void
+gal_fits_img_write_compressed(gal_data_t *data, char *filename,
+                              gal_fits_list_key_t *headers,
+                              char *program_string, uint8_t comptype,
+                              size_t numthreads);
+
+void
+gal_fits_img_write_async(gal_data_t *data, char *filename,
+                         gal_fits_list_key_t *headers, char *program_string,
+                         int freedata);
+
+void
+gal_fits_img_write_async_wait(void);
+
 
 
 
@@ -338,7 +369,8 @@ gal_fits_tab_info(char *filename, char *hdu, size_t *numcols,
 gal_data_t *
 gal_fits_tab_read(char *filename, char *hdu, size_t numrows,
                   gal_data_t *allcols, gal_list_sizet_t *indexll,
-                  size_t numthreads, size_t minmapsize, int quietmmap);
+                  gal_data_t *rowids, size_t numthreads,
+                  size_t minmapsize, int quietmmap);
 
 void
 gal_fits_tab_write(gal_data_t *cols, gal_list_str_t *comments,
@@ -66,6 +66,38 @@ enum bin_status
 };
 
 
+
+/* Re-usable space for statistics functions that are called many times
+   (for example on each tile of a tessellation within one thread). The
+   outputs of the '_ws' functions are kept in the workspace: they must
+   not be freed by the caller and will be over-written by the next call
+   to the same function with the same workspace. */
+typedef struct
+{
+  gal_data_t    *number;  /* Output of 'gal_statistics_number_ws'.       */
+  gal_data_t      *mean;  /* Output of 'gal_statistics_mean_ws'.         */
+  gal_data_t  *quantile;  /* Output of 'gal_statistics_quantile_ws'.     */
+  gal_data_t     *qfunc;  /* Output of '..._quantile_function_ws'.       */
+  gal_data_t   *sigclip;  /* Output of 'gal_statistics_sigma_clip_ws'.   */
+  gal_data_t     *value;  /* Internal: single value in the input type.   */
+  gal_data_t      *copy;  /* Internal: contiguous copy of the input.     */
+  size_t      copybytes;  /* Internal: allocated bytes in 'copy'.        */
+} gal_statistics_workspace_t;
+
+
+
+
+/****************************************************************
+ ********                  Workspace                      *******
+ ****************************************************************/
+gal_statistics_workspace_t *
+gal_statistics_workspace_alloc();
+
+void
+gal_statistics_workspace_free(gal_statistics_workspace_t *ws);
+
+
+
 /****************************************************************
  ********               Simple statistics                 *******
  ****************************************************************/
@@ -73,6 +105,9 @@ enum bin_status
 gal_data_t *
 gal_statistics_number(gal_data_t *input);
 
+gal_data_t *
+gal_statistics_number_ws(gal_data_t *input, gal_statistics_workspace_t *ws);
+
 gal_data_t *
 gal_statistics_minimum(gal_data_t *input);
 
@@ -85,6 +120,9 @@ gal_statistics_sum(gal_data_t *input);
 gal_data_t *
 gal_statistics_mean(gal_data_t *input);
 
+gal_data_t *
+gal_statistics_mean_ws(gal_data_t *input, gal_statistics_workspace_t *ws);
+
 gal_data_t *
 gal_statistics_std(gal_data_t *input);
 
@@ -103,6 +141,10 @@ gal_statistics_quantile_index(size_t size, double quantile);
 gal_data_t *
 gal_statistics_quantile(gal_data_t *input, double quantile, int inplace);
 
+gal_data_t *
+gal_statistics_quantile_ws(gal_data_t *input, double quantile, int inplace,
+                           gal_statistics_workspace_t *ws);
+
 size_t
 gal_statistics_quantile_function_index(gal_data_t *input, gal_data_t *value,
                                        int inplace);
@@ -111,6 +153,11 @@ gal_data_t *
 gal_statistics_quantile_function(gal_data_t *input, gal_data_t *value,
                                  int inplace);
 
+gal_data_t *
+gal_statistics_quantile_function_ws(gal_data_t *input, gal_data_t *value,
+                                    int inplace,
+                                    gal_statistics_workspace_t *ws);
+
 gal_data_t *
 gal_statistics_unique(gal_data_t *input, int inplace);
 
@@ -182,6 +229,11 @@ gal_data_t *
 gal_statistics_sigma_clip(gal_data_t *input, float multip, float param,
                           int inplace, int quiet);
 
+gal_data_t *
+gal_statistics_sigma_clip_ws(gal_data_t *input, float multip, float param,
+                             int inplace, int quiet,
+                             gal_statistics_workspace_t *ws);
+
 gal_data_t *
 gal_statistics_outlier_bydistance(int pos1_neg0, gal_data_t *input,
                                   size_t window_size, float sigma,
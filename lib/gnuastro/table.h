@@ -123,6 +123,21 @@ enum gal_table_where_to_search
 
 
 
+
+/* Types of row selection while reading a table (value to the 'status'
+   element of each predicate given to 'gal_table_read_select'). */
+enum gal_table_select_types
+{
+  GAL_TABLE_SELECT_INVALID,       /* Invalid (=0 by C standard).     */
+
+  GAL_TABLE_SELECT_RANGE,         /* Value in range: min<=v<max.     */
+  GAL_TABLE_SELECT_EQUAL,         /* Equal to one of the values.     */
+  GAL_TABLE_SELECT_NOTEQUAL,      /* Not equal to any of the values. */
+};
+
+
+
+
 /************************************************************************/
 /***************            Internal conversions          ***************/
 /************************************************************************/
@@ -155,6 +170,13 @@ gal_table_read(char *filename, char *hdu, gal_list_str_t *lines,
                size_t numthreads, size_t minmapsize, int quietmmap,
                size_t *colmatch);
 
+gal_data_t *
+gal_table_read_select(char *filename, char *hdu, gal_list_str_t *lines,
+                      gal_list_str_t *cols, gal_data_t *predicates,
+                      size_t head, size_t tail, size_t *rowrange,
+                      int searchin, int ignorecase, size_t numthreads,
+                      size_t minmapsize, int quietmmap, size_t *colmatch);
+
 gal_list_sizet_t *
 gal_table_list_of_indexs(gal_list_str_t *cols, gal_data_t *allcols,
                          size_t numcols, int searchin, int ignorecase,
@@ -172,7 +194,7 @@ gal_table_comments_add_intro(gal_list_str_t **comments,
 void
 gal_table_write(gal_data_t *cols, struct gal_fits_list_key_t **keylist,
                 gal_list_str_t *comments, int tableformat, char *filename,
-                char *extname, uint8_t colinfoinstdout);
+                char *extname, uint8_t colinfoinstdout, size_t numthreads);
 
 void
 gal_table_write_log(gal_data_t *logll, char *program_string,
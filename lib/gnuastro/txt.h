@@ -96,6 +96,7 @@ gal_txt_image_info(char *filename, gal_list_str_t *lines, size_t *numimg,
 gal_data_t *
 gal_txt_table_read(char *filename, gal_list_str_t *lines, size_t numrows,
                    gal_data_t *colinfo, gal_list_sizet_t *indexll,
+                   gal_data_t *rowids, size_t numthreads,
                    size_t minmapsize, int quietmmap);
 
 gal_data_t *
@@ -108,7 +109,7 @@ gal_txt_stdin_read(long timeout_microsec);
 void
 gal_txt_write(gal_data_t *input, struct gal_fits_list_key_t **keylist,
               gal_list_str_t *comment, char *filename,
-              uint8_t colinfoinstdout);
+              uint8_t colinfoinstdout, size_t numthreads);
 
 
 
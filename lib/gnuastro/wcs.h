@@ -214,10 +214,12 @@ gal_wcs_coverage(char *filename, char *hdu, size_t *ndim,
 /**********              Conversion                ************/
 /**************************************************************/
 gal_data_t *
-gal_wcs_world_to_img(gal_data_t *coords, struct wcsprm *wcs, int inplace);
+gal_wcs_world_to_img(gal_data_t *coords, struct wcsprm *wcs, int inplace,
+                     size_t numthreads);
 
 gal_data_t *
-gal_wcs_img_to_world(gal_data_t *coords, struct wcsprm *wcs, int inplace);
+gal_wcs_img_to_world(gal_data_t *coords, struct wcsprm *wcs, int inplace,
+                     size_t numthreads);
 
 
 
@@ -32,6 +32,7 @@ along with Gnuastro. If not, see <http://www.gnu.org/licenses/>.
 #include <gnuastro/qsort.h>
 #include <gnuastro/label.h>
 #include <gnuastro/pointer.h>
+#include <gnuastro/threads.h>
 #include <gnuastro/dimension.h>
 #include <gnuastro/statistics.h>
 
@@ -149,6 +150,148 @@ gal_label_indexs(gal_data_t *labels, size_t numlabs, size_t minmapsize,
 
 
 
+/* Parameters for the parallel passes of 'gal_label_indexs_csr'. */
+struct label_csr_params
+{
+  int32_t        *labels;  /* Labels array.                              */
+  size_t            size;  /* Number of elements in labels.              */
+  size_t         numlabs;  /* Number of labels.                          */
+  size_t          nparts;  /* Number of contiguous parts of the labels.  */
+  size_t         *counts;  /* Counter of each label (in each part).      */
+  size_t         *indexs;  /* Output: contiguous indexs.                 */
+  int              pass1;  /* ==1: counting pass, ==0: scatter pass.     */
+};
+
+
+
+
+
+/* The labels are divided into 'nparts' contiguous parts. In the first
+   pass, the number of pixels of each label in each part is counted (in
+   'counts', with 'numlabs+1' elements for each part). Before the second
+   pass, each count is replaced by the position that the part's first
+   pixel of that label should be written in the output. So in the second
+   pass, the parts can independently put their indexs in the output. */
+static void *
+label_indexs_csr_worker(void *in_prm)
+{
+  struct gal_threads_params *tprm=(struct gal_threads_params *)in_prm;
+  struct label_csr_params *cp=(struct label_csr_params *)tprm->params;
+
+  int32_t *l, *lf;
+  size_t i, part, *counts, *indexs=cp->indexs;
+
+  /* Go over all the parts of this thread. */
+  for(i=0; tprm->indexs[i]!=GAL_BLANK_SIZE_T; ++i)
+    {
+      /* Set the range of this part and its counter. */
+      part=tprm->indexs[i];
+      counts=cp->counts+part*(cp->numlabs+1);
+      l  = cp->labels + part*(cp->size/cp->nparts);
+      lf = ( part==cp->nparts-1
+             ? cp->labels + cp->size
+             : cp->labels + (part+1)*(cp->size/cp->nparts) );
+
+      /* Count (or put) the indexs. Only labeled regions are used:
+         '*l==0' (undetected), '*l<0' (blank). */
+      if(cp->pass1)
+        { for(;l<lf;++l) if(*l>0) ++counts[*l]; }
+      else
+        { for(;l<lf;++l) if(*l>0) indexs[ counts[*l]++ ] = l-cp->labels; }
+    }
+
+  /* Wait for all the other threads to finish, then return. */
+  if(tprm->b) pthread_barrier_wait(tprm->b);
+  return NULL;
+}
+
+
+
+
+
+/* Similar to 'gal_label_indexs', but instead of allocating a separate
+   dataset for each label, all the indexs are put in one contiguous array
+   (the returned dataset), sorted by label: the indexs of label 'i' start
+   at element '(*offsets)[i]' and finish before '(*offsets)[i+1]' (the
+   'offsets' array has 'numlabs+2' elements). This is a "compressed sparse
+   row" (CSR) layout. */
+gal_data_t *
+gal_label_indexs_csr(gal_data_t *labels, size_t numlabs, size_t **offsets,
+                     size_t numthreads, size_t minmapsize, int quietmmap)
+{
+  gal_data_t *max, *out;
+  size_t i, t, sum, nparts, numall, *off;
+  struct label_csr_params cp;
+
+  /* Sanity check. */
+  label_check_type(labels, GAL_TYPE_INT32, "labels", __func__);
+
+  /* If the user hasn't given the number of labels, find it (maximum
+     label). */
+  if(numlabs==0)
+    {
+      max=gal_statistics_maximum(labels);
+      numlabs=*((int32_t *)(max->array));
+      gal_data_free(max);
+    }
+
+  /* Each part needs its own counter for all the labels, so the number of
+     parts is limited such that the counters don't need more elements
+     than the labels (when there are many labels in a small image). */
+  nparts=labels->size/(numlabs+1);
+  if(nparts>numthreads) nparts=numthreads;
+  if(nparts==0)         nparts=1;
+
+  /* Count the number of pixels of each label in each part. */
+  cp.pass1=1;
+  cp.indexs=NULL;
+  cp.nparts=nparts;
+  cp.numlabs=numlabs;
+  cp.size=labels->size;
+  cp.labels=labels->array;
+  cp.counts=gal_pointer_allocate(GAL_TYPE_SIZE_T, nparts*(numlabs+1), 1,
+                                 __func__, "cp.counts");
+  gal_threads_spin_off(label_indexs_csr_worker, &cp, nparts, nparts,
+                       minmapsize, quietmmap);
+
+  /* Set the offsets of each label and the starting position of each part
+     within each label. */
+  off=gal_pointer_allocate(GAL_TYPE_SIZE_T, numlabs+2, 0, __func__,
+                           "off");
+  off[0]=off[1]=sum=0;
+  for(i=1;i<=numlabs;++i)
+    {
+      off[i]=sum;
+      for(t=0;t<nparts;++t)
+        {
+          numall=cp.counts[t*(numlabs+1)+i];
+          cp.counts[t*(numlabs+1)+i]=sum;
+          sum+=numall;
+        }
+    }
+  off[numlabs+1]=sum;
+
+  /* Allocate the output and put the indexs in it. */
+  out=gal_data_alloc(NULL, GAL_TYPE_SIZE_T, 1, &sum, NULL, 0, minmapsize,
+                     quietmmap, NULL, NULL, NULL);
+  if(sum)
+    {
+      cp.pass1=0;
+      cp.indexs=out->array;
+      gal_threads_spin_off(label_indexs_csr_worker, &cp, nparts, nparts,
+                           minmapsize, quietmmap);
+    }
+
+  /* Clean up and return. */
+  free(cp.counts);
+  *offsets=off;
+  return out;
+}
+
+
+
+
+
 
 
 
@@ -167,6 +310,121 @@ gal_label_indexs(gal_data_t *labels, size_t numlabs, size_t minmapsize,
 /****************************************************************
  *****************   Over segmentation       ********************
  ****************************************************************/
+/* To sort the indexs by their value without any global variable (so
+   'gal_label_watershed' can be called on many threads at the same time),
+   each index is kept with its value. */
+struct label_sort_pair
+{
+  float  value;         /* Value of this element.                      */
+  size_t index;         /* Index of this element in the full dataset.  */
+};
+
+
+
+
+
+/* When the values of two pairs are equal (or at least one is NaN), NaN
+   values are put at the end and pairs with equal values are sorted by
+   their index. So the output doesn't depend on the 'qsort'
+   implementation. */
+static int
+label_sort_pair_tie(const struct label_sort_pair *A,
+                    const struct label_sort_pair *B)
+{
+  float ta=A->value, tb=B->value;
+
+  /* NaN values go to the end. */
+  if( isnan(ta) && !isnan(tb) ) return 1;
+  if( !isnan(ta) && isnan(tb) ) return -1;
+
+  /* Equal values (or both NaN): sort by index. */
+  return (A->index > B->index) - (A->index < B->index);
+}
+
+
+
+
+
+/* Similar to 'gal_qsort_index_single_float32_d' (decreasing values). */
+static int
+label_sort_pair_d(const void *a, const void *b)
+{
+  const struct label_sort_pair *A=(const struct label_sort_pair *)a;
+  const struct label_sort_pair *B=(const struct label_sort_pair *)b;
+  int out=(B->value > A->value) - (B->value < A->value);
+  return out ? out : label_sort_pair_tie(A, B);
+}
+
+
+
+
+
+/* Similar to 'gal_qsort_index_single_float32_i' (increasing values). */
+static int
+label_sort_pair_i(const void *a, const void *b)
+{
+  const struct label_sort_pair *A=(const struct label_sort_pair *)a;
+  const struct label_sort_pair *B=(const struct label_sort_pair *)b;
+  int out=(A->value > B->value) - (A->value < B->value);
+  return out ? out : label_sort_pair_tie(A, B);
+}
+
+
+
+
+
+/* Sort the indexs by their value (decreasing when 'min0_max1==1'). */
+static void
+label_watershed_sort(float *arr, gal_data_t *indexs, int min0_max1)
+{
+  struct label_sort_pair *pairs;
+  size_t i, *ind=indexs->array, size=indexs->size;
+
+  /* Allocate the pairs and fill them. */
+  errno=0;
+  pairs=malloc(size * sizeof *pairs);
+  if(pairs==NULL)
+    error(EXIT_FAILURE, errno, "%s: allocating %zu bytes for 'pairs'",
+          __func__, size * sizeof *pairs);
+  for(i=0;i<size;++i) { pairs[i].index=ind[i]; pairs[i].value=arr[ind[i]]; }
+
+  /* Sort the pairs and put the sorted indexs back. */
+  qsort(pairs, size, sizeof *pairs,
+        min0_max1 ? label_sort_pair_d : label_sort_pair_i);
+  for(i=0;i<size;++i) ind[i]=pairs[i].index;
+
+  /* Clean up. */
+  free(pairs);
+}
+
+
+
+
+
+/* Add an element to the end of an array that is used for the pixels of
+   an equal-valued region. It is only re-allocated when it is full (by
+   doubling its size), so it is effectively only allocated a few times in
+   each call to 'gal_label_watershed' (not for every pixel). */
+static void
+label_watershed_array_add(size_t **arr, size_t *num, size_t *alloc,
+                          size_t ind)
+{
+  if(*num==*alloc)
+    {
+      *alloc = *alloc ? 2 * *alloc : 64;
+      errno=0;
+      *arr=realloc(*arr, *alloc * sizeof **arr);
+      if(*arr==NULL)
+        error(EXIT_FAILURE, errno, "%s: re-allocating %zu bytes for "
+              "'arr'", __func__, *alloc * sizeof **arr);
+    }
+  (*arr)[(*num)++]=ind;
+}
+
+
+
+
+
 /* Over-segment the region specified by its indexs into peaks and their
    respective regions (clumps). This is very similar to the immersion
    method of Vincent & Soille(1991), but here, we will not separate the
@@ -187,10 +445,10 @@ gal_label_watershed(gal_data_t *values, gal_data_t *indexs,
 
   int hasblank;
   float *arr=values->array;
-  gal_list_sizet_t *Q=NULL, *cleanup=NULL;
-  size_t *a, *af, ind, *dsize=values->dsize;
-  size_t *dinc=gal_dimension_increment(ndim, dsize);
+  size_t *a, *af, ind, *dsize=values->dsize, *dinc;
   int32_t n1, nlab, rlab, curlab=1, *labs=labels->array;
+  size_t *Q=NULL, qnum=0, qalloc=0;
+  size_t *cleanup=NULL, c, cnum=0, clalloc=0;
 
   /* Sanity checks */
   label_check_type(values, GAL_TYPE_FLOAT32, "values", __func__);
@@ -236,22 +494,17 @@ gal_label_watershed(gal_data_t *values, gal_data_t *indexs,
 
   /* If the size of the indexs is zero, then this function is pointless. */
   if(indexs->size==0) return 0;
+  dinc=gal_dimension_increment(ndim, dsize);
 
 
   /* If the indexs aren't already sorted (by the value they correspond to),
-     sort them given indexs based on their flux ('gal_qsort_index_arr' is
-     defined as static in 'gnuastro/qsort.h') */
+     sort them based on their flux. This doesn't use the global
+     'gal_qsort_index_single', so it is thread-safe. */
   if( !( (indexs->flag & GAL_DATA_FLAG_SORT_CH)
         && ( indexs->flag
              & (GAL_DATA_FLAG_SORTED_I
                 | GAL_DATA_FLAG_SORTED_D) ) ) )
-    {
-      gal_qsort_index_single=values->array;
-      qsort(indexs->array, indexs->size, sizeof(size_t),
-            ( min0_max1
-              ? gal_qsort_index_single_float32_d
-              : gal_qsort_index_single_float32_i) );
-    }
+    label_watershed_sort(arr, indexs, min0_max1);
 
 
   /* Initialize the region we want to over-segment. */
@@ -285,24 +538,20 @@ gal_label_watershed(gal_data_t *values, gal_data_t *indexs,
             /* Label of first neighbor found. */
             n1=0;
 
-            /* A small sanity check. */
-            if(Q!=NULL || cleanup!=NULL)
-              error(EXIT_FAILURE, 0, "%s: a bug! Please contact us at %s so "
-                    "we can fix this problem. 'Q' and 'cleanup' should be "
-                    "NULL but while checking the equal flux regions they "
-                    "aren't", __func__, PACKAGE_BUGREPORT);
-
-            /* Add this pixel to a queue. */
-            gal_list_sizet_add(&Q, *a);
-            gal_list_sizet_add(&cleanup, *a);
+            /* Add this pixel to a queue. 'Q' is used as a stack (last
+               element is popped first) and 'cleanup' keeps all the pixels
+               of this region. */
+            qnum=cnum=0;
+            label_watershed_array_add(&Q, &qnum, &qalloc, *a);
+            label_watershed_array_add(&cleanup, &cnum, &clalloc, *a);
             labs[*a] = GAL_LABEL_TMPCHECK;
 
             /* Find all the pixels that have the same flux and are
                connected. */
-            while(Q!=NULL)
+            while(qnum)
               {
                 /* Pop an element from the queue. */
-                ind=gal_list_sizet_pop(&Q);
+                ind=Q[--qnum];
 
                 /* Look at the neighbors and see if we already have a
                    label. */
@@ -324,8 +573,10 @@ gal_label_watershed(gal_data_t *values, gal_data_t *indexs,
                              if( nlab==GAL_LABEL_INIT && arr[nind]==arr[*a] )
                                {
                                  labs[nind]=GAL_LABEL_TMPCHECK;
-                                 gal_list_sizet_add(&Q, nind);
-                                 gal_list_sizet_add(&cleanup, nind);
+                                 label_watershed_array_add(&Q, &qnum,
+                                                           &qalloc, nind);
+                                 label_watershed_array_add(&cleanup, &cnum,
+                                                           &clalloc, nind);
                                }
                              else
                                n1=( nlab>0
@@ -384,9 +635,9 @@ gal_label_watershed(gal_data_t *values, gal_data_t *indexs,
             /* Give the same label to the whole connected equal flux
                region, except those that might have been on the side of
                the image and were a river pixel. */
-            while(cleanup!=NULL)
+            for(c=0;c<cnum;++c)
               {
-                ind=gal_list_sizet_pop(&cleanup);
+                ind=cleanup[c];
                 /* If it was on the sides of the image, it has been
                    changed to a river pixel. */
                 if( labs[ ind ]==GAL_LABEL_TMPCHECK ) labs[ ind ]=rlab;
@@ -502,6 +753,8 @@ gal_label_watershed(gal_data_t *values, gal_data_t *indexs,
 
   /* Clean up. */
   free(dinc);
+  if(Q) free(Q);
+  if(cleanup) free(cleanup);
 
   /* Return the total number of clumps. */
   return curlab-1;
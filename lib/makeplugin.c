@@ -27,10 +27,16 @@ along with Gnuastro. If not, see <http://www.gnu.org/licenses/>.
 #include <error.h>
 #include <string.h>
 #include <stdlib.h>
+#include <stdint.h>
+#include <unistd.h>
+#include <sys/stat.h>
 
 #include <gnumake.h>
+#include <stat-time.h>
 
 #include <gnuastro/txt.h>
+#include <gnuastro/fits.h>
+#include <gnuastro/threads.h>
 
 #include <gnuastro-internal/options.h>
 #include <gnuastro-internal/checkset.h>
@@ -58,6 +64,40 @@ static char *fits_unique_keyvalues_name=MAKEPLUGIN_FUNC_PREFIX"-fits-unique-keyv
 
 
 
+/* Cache of keyword values in FITS files: a file with this name is kept in
+   the directory of the FITS files (see 'makeplugin_cache_write'). */
+#define MAKEPLUGIN_CACHE_NAME      ".gnuastro-fits-keys"
+#define MAKEPLUGIN_CACHE_HEADER    "# GNU Astronomy Utilities: cache of " \
+                                   "FITS keyword values (format 1)."
+#define MAKEPLUGIN_CACHE_BUCKETS   65536
+
+/* One keyword value of one HDU in one file. */
+struct makeplugin_key
+{
+  char                  *path;  /* Name of file (as given to Make).    */
+  char                   *hdu;  /* HDU of the keyword.                 */
+  char                  *name;  /* Name of the keyword.                */
+  char                 *value;  /* Value of keyword (NULL: not found). */
+  size_t                 size;  /* Size of the file (in bytes).        */
+  struct timespec       mtime;  /* Last modification time of the file. */
+  size_t                  dir;  /* Index of directory in the cache.    */
+  struct makeplugin_key *next;  /* Next key in the same hash bucket.   */
+};
+
+/* All the keys that are read from (or will be written into) the cache
+   files of the directories. */
+struct makeplugin_cache
+{
+  size_t                numdirs;  /* Number of directories.            */
+  char                    **dirs; /* Directory names (ending in '/').  */
+  uint8_t              *changed;  /* If the directory's cache changed. */
+  struct makeplugin_key **buckets; /* Hash table of keys.              */
+};
+
+
+
+
+
 
 
 
@@ -217,6 +257,373 @@ makeplugin_fits_check_input(char **argv, size_t numargs, char *name)
 
 
 
+/* Hash of the file name, HDU and keyword name (FNV-1a). */
+static size_t
+makeplugin_cache_hash(char *path, char *hdu, char *name)
+{
+  char *c;
+  uint64_t h=14695981039346656037ULL;
+  for(c=path; *c!='\0'; ++c) { h^=(unsigned char)(*c); h*=1099511628211ULL; }
+  h^='\t'; h*=1099511628211ULL;
+  for(c=hdu;  *c!='\0'; ++c) { h^=(unsigned char)(*c); h*=1099511628211ULL; }
+  h^='\t'; h*=1099511628211ULL;
+  for(c=name; *c!='\0'; ++c) { h^=(unsigned char)(*c); h*=1099511628211ULL; }
+  return h & (MAKEPLUGIN_CACHE_BUCKETS-1);
+}
+
+
+
+
+
+static struct makeplugin_key *
+makeplugin_cache_find(struct makeplugin_cache *cache, char *path,
+                      char *hdu, char *name)
+{
+  struct makeplugin_key *k;
+  for(k=cache->buckets[ makeplugin_cache_hash(path, hdu, name) ];
+      k!=NULL; k=k->next)
+    if( !strcmp(k->path, path) && !strcmp(k->hdu, hdu)
+        && !strcmp(k->name, name) )
+      return k;
+  return NULL;
+}
+
+
+
+
+
+/* Add (or update) a key in the cache. The 'value' string is used
+   directly (it will be freed with the cache). */
+static struct makeplugin_key *
+makeplugin_cache_add(struct makeplugin_cache *cache, char *path, char *hdu,
+                     char *name, char *value, size_t size,
+                     struct timespec mtime, size_t dir)
+{
+  size_t h;
+  struct makeplugin_key *k=makeplugin_cache_find(cache, path, hdu, name);
+
+  /* If the key doesn't exist, allocate it and put it in the table. */
+  if(k==NULL)
+    {
+      errno=0;
+      k=malloc(sizeof *k);
+      if(k==NULL)
+        error(EXIT_FAILURE, errno, "%s: couldn't allocate %zu bytes",
+              __func__, sizeof *k);
+      gal_checkset_allocate_copy(path, &k->path);
+      gal_checkset_allocate_copy(hdu,  &k->hdu);
+      gal_checkset_allocate_copy(name, &k->name);
+      h=makeplugin_cache_hash(path, hdu, name);
+      k->next=cache->buckets[h];
+      cache->buckets[h]=k;
+    }
+  else if(k->value) free(k->value);
+
+  /* Write the value and the file's properties. */
+  k->dir=dir;
+  k->size=size;
+  k->mtime=mtime;
+  k->value=value;
+  return k;
+}
+
+
+
+
+
+/* Read the cache file of the given directory. Each line of the cache has
+   these tab-separated components: the size of the file, the seconds and
+   nano-seconds of its modification time, a flag (1 if the keyword has a
+   value, 0 otherwise), the HDU, the keyword name, the value and the file
+   name (which is last, so it may contain any character except a
+   new-line). Lines that can't be parsed are ignored: the cache will be
+   re-built for them. */
+static void
+makeplugin_cache_read(struct makeplugin_cache *cache, size_t dir)
+{
+  FILE *fp;
+  ssize_t nread;
+  size_t i, len=0;
+  struct timespec mtime;
+  char *c, *tailptr, *line=NULL, *cname, *path, *f[8];
+
+  /* Open the cache file (if it doesn't exist, there is nothing to do). */
+  if( asprintf(&cname, "%s%s", cache->dirs[dir], MAKEPLUGIN_CACHE_NAME)<0 )
+    error(EXIT_FAILURE, 0, "%s: asprintf allocation", __func__);
+  fp=fopen(cname, "r");
+  free(cname);
+  if(fp==NULL) return;
+
+  /* The first line should be the header of this format. */
+  if( (nread=getline(&line, &len, fp))>0 )
+    {
+      if(line[nread-1]=='\n') line[nread-1]='\0';
+      if( strcmp(line, MAKEPLUGIN_CACHE_HEADER) )
+        { free(line); fclose(fp); return; }
+    }
+
+  /* Parse the lines. */
+  while( (nread=getline(&line, &len, fp))>0 )
+    {
+      /* Remove the new-line character and ignore comments. */
+      if(line[nread-1]=='\n') line[nread-1]='\0';
+      if(line[0]=='#') continue;
+
+      /* Separate the components. */
+      f[0]=line;
+      for(i=1, c=line; i<8; ++i)
+        {
+          if( (c=strchr(c, '\t'))==NULL ) break;
+          *c++='\0';
+          f[i]=c;
+        }
+      if(i<8 || (f[3][0]!='0' && f[3][0]!='1') || f[7][0]=='\0') continue;
+
+      /* Read the file's properties. */
+      mtime.tv_sec=strtoll(f[1], &tailptr, 10);
+      if(*tailptr!='\0') continue;
+      mtime.tv_nsec=strtol(f[2], &tailptr, 10);
+      if(*tailptr!='\0') continue;
+
+      /* Add the key. */
+      if( asprintf(&path, "%s%s", cache->dirs[dir], f[7])<0 )
+        error(EXIT_FAILURE, 0, "%s: asprintf allocation", __func__);
+      c=NULL;
+      if(f[3][0]=='1') gal_checkset_allocate_copy(f[6], &c);
+      makeplugin_cache_add(cache, path, f[4], f[5], c,
+                           strtoull(f[0], NULL, 10), mtime, dir);
+      free(path);
+    }
+
+  /* Clean up. */
+  free(line);
+  fclose(fp);
+}
+
+
+
+
+
+/* Return the index of the directory of the given file in the cache (the
+   directory's cache file is read the first time it is seen). */
+static size_t
+makeplugin_cache_dir(struct makeplugin_cache *cache, char *path)
+{
+  size_t i, dlen;
+  char *slash=strrchr(path, '/');
+
+  /* Find the directory (including the final '/', it is an empty string
+     for the running directory). */
+  dlen = slash ? slash-path+1 : 0;
+  for(i=0;i<cache->numdirs;++i)
+    if( strlen(cache->dirs[i])==dlen
+        && !strncmp(cache->dirs[i], path, dlen) )
+      return i;
+
+  /* This is a new directory, add it to the list and read its cache. */
+  errno=0;
+  cache->dirs=realloc(cache->dirs, (i+1)*sizeof *cache->dirs);
+  cache->changed=realloc(cache->changed, (i+1)*sizeof *cache->changed);
+  if(cache->dirs==NULL || cache->changed==NULL)
+    error(EXIT_FAILURE, errno, "%s: couldn't re-allocate the list of "
+          "directories", __func__);
+  errno=0;
+  cache->dirs[i]=malloc(dlen+1);
+  if(cache->dirs[i]==NULL)
+    error(EXIT_FAILURE, errno, "%s: couldn't allocate %zu bytes",
+          __func__, dlen+1);
+  memcpy(cache->dirs[i], path, dlen);
+  cache->dirs[i][dlen]='\0';
+  cache->changed[i]=0;
+  cache->numdirs=i+1;
+  makeplugin_cache_read(cache, i);
+  return i;
+}
+
+
+
+
+
+/* Write the cache of the given directory. The new cache is first written
+   in a temporary file that then replaces the old one, so a cache file is
+   always complete. This is only a cache: if the directory isn't writable
+   (for example the raw data are in a read-only directory), nothing is
+   written. */
+static void
+makeplugin_cache_write(struct makeplugin_cache *cache, size_t dir)
+{
+  int fd;
+  FILE *fp;
+  mode_t mode;
+  size_t b, dlen;
+  struct stat st;
+  struct makeplugin_key *k;
+  char *cname, *tmpname;
+
+  /* Open a temporary file in the directory. */
+  if( asprintf(&cname, "%s%s", cache->dirs[dir], MAKEPLUGIN_CACHE_NAME)<0
+      || asprintf(&tmpname, "%s.XXXXXX", cname)<0 )
+    error(EXIT_FAILURE, 0, "%s: asprintf allocation", __func__);
+
+  /* 'mkstemp' only gives access to the user, but the cache should have
+     the same permissions as any other file that is created in the
+     directory (or the permissions of the old cache, if it exists). */
+  if( stat(cname, &st)==0 ) mode=st.st_mode & 0777;
+  else { mode=umask(0); umask(mode); mode=0666 & ~mode; }
+  if( (fd=mkstemp(tmpname))==-1
+      || fchmod(fd, mode)
+      || (fp=fdopen(fd, "w"))==NULL )
+    {
+      if(fd!=-1) { close(fd); remove(tmpname); }
+      free(tmpname); free(cname); return;
+    }
+
+  /* Write the keys of this directory. */
+  dlen=strlen(cache->dirs[dir]);
+  fprintf(fp, "%s\n", MAKEPLUGIN_CACHE_HEADER);
+  for(b=0;b<MAKEPLUGIN_CACHE_BUCKETS;++b)
+    for(k=cache->buckets[b]; k!=NULL; k=k->next)
+      if(k->dir==dir)
+        fprintf(fp, "%zu\t%lld\t%ld\t%d\t%s\t%s\t%s\t%s\n", k->size,
+                (long long)(k->mtime.tv_sec), (long)(k->mtime.tv_nsec),
+                k->value ? 1 : 0, k->hdu, k->name,
+                k->value ? k->value : "", k->path+dlen);
+
+  /* Close the file and put it in place of the old cache. */
+  if( fclose(fp)==EOF || rename(tmpname, cname) )
+    remove(tmpname);
+  free(tmpname);
+  free(cname);
+}
+
+
+
+
+
+static void
+makeplugin_cache_free(struct makeplugin_cache *cache)
+{
+  size_t i;
+  struct makeplugin_key *k, *kn;
+
+  /* The cache may not have been used (for example with no files). */
+  if(cache->buckets==NULL) return;
+
+  for(i=0;i<MAKEPLUGIN_CACHE_BUCKETS;++i)
+    for(k=cache->buckets[i]; k!=NULL; k=kn)
+      {
+        kn=k->next;
+        free(k->hdu);
+        free(k->path);
+        free(k->name);
+        if(k->value) free(k->value);
+        free(k);
+      }
+  for(i=0;i<cache->numdirs;++i) free(cache->dirs[i]);
+  if(cache->dirs) free(cache->dirs);
+  if(cache->changed) free(cache->changed);
+  free(cache->buckets);
+}
+
+
+
+
+
+/* Return the value of the 'name' keyword in the 'hdu' HDU of all the
+   files (as an array with one element per file). The value in each file
+   is first looked up in the cache of its directory (only used when the
+   file's size and modification time are unchanged). Only the files that
+   aren't in the cache are opened (in parallel) and the caches of their
+   directories are updated. The returned strings belong to the cache (the
+   array should be freed, not the strings). */
+static char **
+makeplugin_fits_keyvalues(struct makeplugin_cache *cache,
+                          gal_list_str_t *files, char *hdu, char *name)
+{
+  struct stat st;
+  char **values, **cvalues;
+  struct makeplugin_key *k;
+  gal_list_str_t *f, *cold=NULL;
+  size_t i, d, numfiles=gal_list_str_number(files);
+  size_t *coldind=NULL, *colddir=NULL, *coldsize=NULL, numcold=0;
+  struct timespec *coldmtime=NULL;
+
+  /* If there are no files, there is nothing to read. */
+  if(numfiles==0) return NULL;
+
+  /* Allocate the necessary arrays. */
+  errno=0;
+  values=calloc(numfiles, sizeof *values);
+  coldind=malloc(numfiles*sizeof *coldind);
+  colddir=malloc(numfiles*sizeof *colddir);
+  coldsize=malloc(numfiles*sizeof *coldsize);
+  coldmtime=malloc(numfiles*sizeof *coldmtime);
+  cache->buckets=calloc(MAKEPLUGIN_CACHE_BUCKETS, sizeof *cache->buckets);
+  if( values==NULL || coldind==NULL || colddir==NULL || coldsize==NULL
+      || coldmtime==NULL || cache->buckets==NULL )
+    error(EXIT_FAILURE, errno, "%s: couldn't allocate the arrays for "
+          "%zu files", __func__, numfiles);
+
+  /* Look for each file in the cache. Files that don't exist are
+     ignored. */
+  for(i=0, f=files; f!=NULL; ++i, f=f->next)
+    if( stat(f->v, &st)==0 )
+      {
+        d=makeplugin_cache_dir(cache, f->v);
+        k=makeplugin_cache_find(cache, f->v, hdu, name);
+        if( k && k->size==(size_t)(st.st_size)
+            && k->mtime.tv_sec==get_stat_mtime(&st).tv_sec
+            && k->mtime.tv_nsec==get_stat_mtime(&st).tv_nsec )
+          values[i]=k->value;
+        else
+          {
+            gal_list_str_add(&cold, f->v, 0);
+            colddir[numcold]=d;
+            coldind[numcold]=i;
+            coldsize[numcold]=st.st_size;
+            coldmtime[numcold++]=get_stat_mtime(&st);
+          }
+      }
+
+  /* Read the keyword values in the files that weren't in the cache (in
+     parallel), then put them in the cache. When a file is given more
+     than once, its value is replaced (and freed) in the cache by the
+     next occurrence, so the values are only taken from the cache after
+     all of them have been added. */
+  if(numcold)
+    {
+      gal_list_str_reverse(&cold);
+      cvalues=gal_fits_keyvalue_in_files(cold, hdu, name,
+                                         gal_threads_number());
+      for(i=0, f=cold; f!=NULL; ++i, f=f->next)
+        {
+          makeplugin_cache_add(cache, f->v, hdu, name, cvalues[i],
+                               coldsize[i], coldmtime[i], colddir[i]);
+          cache->changed[ colddir[i] ]=1;
+        }
+      for(i=0, f=cold; f!=NULL; ++i, f=f->next)
+        values[ coldind[i] ]=makeplugin_cache_find(cache, f->v, hdu,
+                                                   name)->value;
+      free(cvalues);
+
+      /* Write the caches that have changed. */
+      for(d=0;d<cache->numdirs;++d)
+        if(cache->changed[d]) makeplugin_cache_write(cache, d);
+    }
+
+  /* Clean up and return. */
+  free(coldind);
+  free(colddir);
+  free(coldsize);
+  free(coldmtime);
+  gal_list_str_free(cold, 0);
+  return values;
+}
+
+
+
+
+
 /* Select files, were a certain keyword has a certain value. It takes four
    arguments:
        0. Keyword name.
@@ -227,7 +634,10 @@ static char *
 makeplugin_fits_with_keyvalue(const char *caller, unsigned int argc,
                               char **argv)
 {
-  gal_list_str_t *outlist=NULL;
+  size_t i;
+  char **keyvalues;
+  gal_list_str_t *f, *v, *outlist=NULL;
+  struct makeplugin_cache cache={0};
   char *name=gal_txt_trim_space(argv[0]);
   gal_list_str_t *files=NULL, *values=NULL;
   char *out, *hdu=gal_txt_trim_space(argv[2]);
@@ -237,18 +647,29 @@ makeplugin_fits_with_keyvalue(const char *caller, unsigned int argc,
     return NULL;
 
   /* Extract the components in the arguments with possibly multiple
-     values and find the output files.*/
+     values and read the keyword's value in all the files. */
   files=gal_list_str_extract(argv[3]);
   values=gal_list_str_extract(argv[1]);
-  outlist=gal_fits_with_keyvalue(files, hdu, name, values);
+  keyvalues=makeplugin_fits_keyvalues(&cache, files, hdu, name);
+
+  /* Select the files that have one of the requested values. */
+  for(i=0, f=files; f!=NULL; ++i, f=f->next)
+    if(keyvalues[i])
+      for(v=values; v!=NULL; v=v->next)
+        if( strcmp(v->v, keyvalues[i])==0 )
+          { gal_list_str_add(&outlist, f->v, 0); break; }
 
-  /* Write the output string */
+  /* Write the output string (after reversing the list to have the same
+     order as the input). */
+  gal_list_str_reverse(&outlist);
   out=gal_list_str_cat(outlist);
 
   /* Clean up and return. */
+  free(keyvalues);
   gal_list_str_free(files, 1);
   gal_list_str_free(values, 1);
-  gal_list_str_free(outlist, 1);
+  gal_list_str_free(outlist, 0);
+  makeplugin_cache_free(&cache);
   return out;
 }
 
@@ -264,8 +685,12 @@ static char *
 makeplugin_fits_unique_keyvalues(const char *caller, unsigned int argc,
                                  char **argv)
 {
+  size_t i;
+  int newvalue;
   gal_list_str_t *files=NULL;
-  gal_list_str_t *outlist=NULL;
+  char *keyv, **keyvalues;
+  gal_list_str_t *f, *v, *outlist=NULL;
+  struct makeplugin_cache cache={0};
   char *name=gal_txt_trim_space(argv[0]);
   char *out, *hdu=gal_txt_trim_space(argv[1]);
 
@@ -274,16 +699,30 @@ makeplugin_fits_unique_keyvalues(const char *caller, unsigned int argc,
     return NULL;
 
   /* Extract the components in the arguments with possibly multiple
-     values and find the output files.*/
+     values and read the keyword's value in all the files.*/
   files=gal_list_str_extract(argv[2]);
-  outlist=gal_fits_unique_keyvalues(files, hdu, name);
-
-  /* Write the output value. */
+  keyvalues=makeplugin_fits_keyvalues(&cache, files, hdu, name);
+
+  /* Keep the values that haven't been seen before. */
+  for(i=0, f=files; f!=NULL; ++i, f=f->next)
+    if(keyvalues[i])
+      {
+        newvalue=1;
+        keyv=gal_txt_trim_space(keyvalues[i]);
+        for(v=outlist; v!=NULL; v=v->next)
+          { if( strcmp(v->v, keyv)==0 ) newvalue=0; }
+        if(newvalue) gal_list_str_add(&outlist, keyv, 1);
+      }
+
+  /* Write the output value (in the same order as the input). */
+  gal_list_str_reverse(&outlist);
   out=gal_list_str_cat(outlist);
 
   /* Clean up and return. */
+  free(keyvalues);
   gal_list_str_free(files, 1);
   gal_list_str_free(outlist, 1);
+  makeplugin_cache_free(&cache);
   return out;
 }
 
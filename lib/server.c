@@ -0,0 +1,1045 @@
+/*********************************************************************
+Optional resident server to run the programs without re-starting them.
+This is part of GNU Astronomy Utilities (Gnuastro) package.
+
+Original author:
+     Mohammad Akhlaghi <mohammad@akhlaghi.org>
+Contributing author(s):
+Copyright (C) 2022 Free Software Foundation, Inc.
+
+Gnuastro is free software: you can redistribute it and/or modify it
+under the terms of the GNU General Public License as published by the
+Free Software Foundation, either version 3 of the License, or (at your
+option) any later version.
+
+Gnuastro is distributed in the hope that it will be useful, but
+WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with Gnuastro. If not, see <http://www.gnu.org/licenses/>.
+**********************************************************************/
+#include <config.h>
+
+#include <poll.h>
+#include <stdio.h>
+#include <errno.h>
+#include <error.h>
+#include <fcntl.h>
+#include <limits.h>
+#include <signal.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <pthread.h>
+#include <sys/un.h>
+#include <sys/stat.h>
+#include <sys/wait.h>
+#include <sys/types.h>
+#include <sys/socket.h>
+
+#include <gnuastro/type.h>
+#include <gnuastro/pointer.h>
+
+#include <gnuastro-internal/server.h>
+
+/* Not all systems have this flag (it is only to avoid a 'SIGPIPE'). */
+#ifndef MSG_NOSIGNAL
+#define MSG_NOSIGNAL 0
+#endif
+
+/* Largest request (current directory, arguments and environment) that
+   a server will accept. */
+#define SERVER_REQUEST_MAXSIZE (16*1024*1024)
+
+/* The environment of the client is given to the served program. */
+extern char **environ;
+
+
+
+
+
+
+
+
+
+
+
+
+
+
+
+
+
+
+
+
+/***********************************************************************/
+/**************             Internal structures         ****************/
+/***********************************************************************/
+/* Each program that is run by a server (a "served" program) can send
+   these messages to the server to update its cache. */
+enum server_message_types
+{
+  SERVER_MESSAGE_ADD,           /* A new entry for the cache.           */
+  SERVER_MESSAGE_HIT,           /* An entry of the cache was used.      */
+};
+
+/* Header of each message (the key and data of the entry follow it). */
+struct server_message
+{
+  uint8_t      type;            /* Type of message.                     */
+  size_t     keylen;            /* Number of bytes in the key.          */
+  size_t   datasize;            /* Number of bytes in the data.         */
+};
+
+/* Header of cached datasets (the size of each dimension and the array
+   follow it). */
+struct server_data
+{
+  uint8_t      type;            /* Type of the dataset.                 */
+  uint8_t      flag;            /* Flags of the dataset.                */
+  size_t       ndim;            /* Number of dimensions.                */
+};
+
+/* One entry of the cache. The entries are kept in a list that is sorted
+   by their last usage (most recently used first), so when the cache is
+   full, the last entries are removed. */
+struct server_cache_entry
+{
+  char                      *key;   /* Key to identify the entry.       */
+  size_t                  keylen;   /* Number of bytes in the key.      */
+  void                     *data;   /* Contents of the entry.           */
+  size_t                    size;   /* Number of bytes in the data.     */
+  struct server_cache_entry *prev;  /* More recently used entry.        */
+  struct server_cache_entry *next;  /* Less recently used entry.        */
+};
+
+/* Information of the thread waiting for one request. */
+struct server_request
+{
+  pid_t                      pid;   /* Process running the request.     */
+  int                       conn;   /* Connection to the client.        */
+  int                      msgfd;   /* Messages from the served program.*/
+};
+
+/* State of this process: the cache is only modified by the server. Each
+   served program is a forked copy of the server, so it inherits the
+   cache at the moment it started and only reads it. */
+static struct
+{
+  int                     served;   /* ==1: we are a served program.    */
+  int                      msgfd;   /* Served: socket to the server.    */
+  pthread_mutex_t        msglock;   /* Served: one message at a time.   */
+  pthread_mutex_t           lock;   /* Server: protect the cache.       */
+  size_t                    used;   /* Server: bytes in the cache.      */
+  struct server_cache_entry *first; /* Most recently used entry.        */
+  struct server_cache_entry  *last; /* Least recently used entry.       */
+  struct sockaddr_un         addr;  /* Server: address of the socket.   */
+} server = { 0, -1, PTHREAD_MUTEX_INITIALIZER, PTHREAD_MUTEX_INITIALIZER,
+             0, NULL, NULL };
+
+
+
+
+
+
+
+
+
+
+
+
+
+
+
+
+
+
+
+
+/***********************************************************************/
+/**************           Low-level communication       ****************/
+/***********************************************************************/
+/* Send the full buffer over the socket (return 0 on success). */
+static int
+server_send(int fd, void *buf, size_t size)
+{
+  ssize_t n;
+  char *c=buf;
+
+  while(size)
+    {
+      n=send(fd, c, size, MSG_NOSIGNAL);
+      if(n<0)
+        {
+          if(errno==EINTR) continue;
+          return -1;
+        }
+      c+=n;
+      size-=n;
+    }
+  return 0;
+}
+
+
+
+
+
+/* Receive the full buffer from the socket (return 0 on success, a
+   premature end of the connection is also a failure). */
+static int
+server_recv(int fd, void *buf, size_t size)
+{
+  ssize_t n;
+  char *c=buf;
+
+  while(size)
+    {
+      n=recv(fd, c, size, 0);
+      if(n<0)
+        {
+          if(errno==EINTR) continue;
+          return -1;
+        }
+      if(n==0) return -1;
+      c+=n;
+      size-=n;
+    }
+  return 0;
+}
+
+
+
+
+
+/* Fill the address of the socket of the given program's server. */
+static void
+server_socket_address(char *dir, char *program_exec,
+                      struct sockaddr_un *addr)
+{
+  /* The socket name is 'DIR/PROGRAM_EXEC.sock' (7 is for the '/', the
+     '.sock' suffix and the trailing '\0'). */
+  if( strlen(dir)+strlen(program_exec)+7 > sizeof addr->sun_path )
+    error(EXIT_FAILURE, 0, "the directory in the '%s' environment "
+          "variable ('%s') is too long: the full name of the socket can "
+          "have at most %zu characters", GAL_SERVER_ENV, dir,
+          sizeof addr->sun_path-1);
+
+  /* Fill the address. */
+  memset(addr, 0, sizeof *addr);
+  addr->sun_family=AF_UNIX;
+  sprintf(addr->sun_path, "%s/%s.sock", dir, program_exec);
+}
+
+
+
+
+
+
+
+
+
+
+
+
+
+
+
+
+
+
+
+
+/***********************************************************************/
+/**************                 Cache                   ****************/
+/***********************************************************************/
+/* Find the entry with the given key (NULL if it isn't in the cache). */
+static struct server_cache_entry *
+server_cache_get(char *key, size_t keylen)
+{
+  struct server_cache_entry *e;
+
+  for(e=server.first; e!=NULL; e=e->next)
+    if( e->keylen==keylen && !memcmp(e->key, key, keylen) )
+      return e;
+  return NULL;
+}
+
+
+
+
+
+/* Remove the entry from the list (without freeing it). */
+static void
+server_cache_pop(struct server_cache_entry *e)
+{
+  if(e->prev) e->prev->next=e->next; else server.first=e->next;
+  if(e->next) e->next->prev=e->prev; else server.last=e->prev;
+  e->prev=e->next=NULL;
+}
+
+
+
+
+
+/* Put the entry at the start of the list (most recently used). */
+static void
+server_cache_push(struct server_cache_entry *e)
+{
+  e->prev=NULL;
+  e->next=server.first;
+  if(server.first) server.first->prev=e; else server.last=e;
+  server.first=e;
+}
+
+
+
+
+
+/* Remove the entry from the cache and free it. */
+static void
+server_cache_free(struct server_cache_entry *e)
+{
+  server_cache_pop(e);
+  server.used-=e->size;
+  free(e->data);
+  free(e->key);
+  free(e);
+}
+
+
+
+
+
+/* Apply a message of a served program to the cache of the server (the
+   key and data are freed or used in the cache). */
+static void
+server_cache_message(uint8_t type, char *key, size_t keylen, void *data,
+                     size_t size)
+{
+  struct server_cache_entry *e;
+
+  pthread_mutex_lock(&server.lock);
+  e=server_cache_get(key, keylen);
+  switch(type)
+    {
+    /* Only move the entry to the start of the list. */
+    case SERVER_MESSAGE_HIT:
+      if(e) { server_cache_pop(e); server_cache_push(e); }
+      free(key);
+      free(data);
+      break;
+
+    /* Add the entry (replacing any old version), then remove the least
+       recently used entries until the cache is small enough. */
+    case SERVER_MESSAGE_ADD:
+      if(e) server_cache_free(e);
+      errno=0;
+      e=malloc(sizeof *e);
+      if(e==NULL)
+        error(EXIT_FAILURE, errno, "%s: %zu bytes for 'e'", __func__,
+              sizeof *e);
+      e->key=key;
+      e->keylen=keylen;
+      e->data=data;
+      e->size=size;
+      server_cache_push(e);
+      server.used+=size;
+      while(server.used>GAL_SERVER_CACHE_MAXSIZE)
+        server_cache_free(server.last);
+      break;
+
+    default:
+      free(key);
+      free(data);
+    }
+  pthread_mutex_unlock(&server.lock);
+}
+
+
+
+
+
+/* Key of a file's entry in the cache. Besides the absolute name of the
+   file and its HDU, the key also contains the properties of the file
+   that change when it is re-written, so a changed file will not be
+   confused with its old (cached) version. If the file can't be found
+   (for example when CFITSIO's extended file name syntax is used), NULL
+   is returned so the file isn't cached. */
+static char *
+server_cache_key(char *kind, char *filename, char *hdu, size_t *keylen)
+{
+  char *path, *key;
+  struct stat st;
+
+  /* Get the absolute file name and its properties. */
+  if( (path=realpath(filename, NULL))==NULL ) return NULL;
+  if( stat(path, &st) ) { free(path); return NULL; }
+
+  /* Write the key. */
+  if( asprintf(&key, "%s\n%s\n%s\n%ju %jd %jd %jd", kind, path,
+               hdu ? hdu : "", (uintmax_t)st.st_ino,
+               (intmax_t)st.st_size, (intmax_t)st.st_mtime,
+               (intmax_t)st.st_ctime)<0 )
+    error(EXIT_FAILURE, 0, "%s: asprintf allocation", __func__);
+
+  /* Clean up and return. */
+  free(path);
+  *keylen=strlen(key);
+  return key;
+}
+
+
+
+
+
+/* Send a message to the server. If the server can't be reached, no more
+   messages will be sent (the served program continues normally). */
+static void
+server_cache_send(uint8_t type, char *key, size_t keylen, void *data,
+                  size_t size)
+{
+  struct server_message msg;
+
+  /* Prepare the header. */
+  memset(&msg, 0, sizeof msg);
+  msg.type=type;
+  msg.keylen=keylen;
+  msg.datasize=size;
+
+  /* Send the message. */
+  pthread_mutex_lock(&server.msglock);
+  if( server.msgfd>=0
+      && ( server_send(server.msgfd, &msg, sizeof msg)
+           || server_send(server.msgfd, key, keylen)
+           || (size && server_send(server.msgfd, data, size)) ) )
+    {
+      close(server.msgfd);
+      server.msgfd=-1;
+    }
+  pthread_mutex_unlock(&server.msglock);
+}
+
+
+
+
+
+/* Return 1 if this is a served program (see 'gal_server_main'). */
+int
+gal_server_served()
+{
+  return server.served;
+}
+
+
+
+
+
+/* Return a copy of the cached contents of the given file and HDU (its
+   size is put in 'size'). When not running under a server, or when the
+   file isn't cached, NULL is returned. */
+void *
+gal_server_cache_find(char *kind, char *filename, char *hdu, size_t *size)
+{
+  size_t keylen;
+  void *out=NULL;
+  char *key;
+  struct server_cache_entry *e;
+
+  /* Only served programs have a cache (inherited from the server). */
+  if(server.served==0) return NULL;
+
+  /* Find the entry and let the server know that it was used. */
+  if( (key=server_cache_key(kind, filename, hdu, &keylen))==NULL )
+    return NULL;
+  if( (e=server_cache_get(key, keylen)) )
+    {
+      out=gal_pointer_allocate(GAL_TYPE_UINT8, e->size, 0, __func__,
+                               "out");
+      memcpy(out, e->data, e->size);
+      *size=e->size;
+      server_cache_send(SERVER_MESSAGE_HIT, key, keylen, NULL, 0);
+    }
+
+  /* Clean up and return. */
+  free(key);
+  return out;
+}
+
+
+
+
+
+/* Give the contents of a file and HDU to the server to keep them for the
+   next requests. When not running under a server, this does nothing. */
+void
+gal_server_cache_add(char *kind, char *filename, char *hdu, void *data,
+                     size_t size)
+{
+  char *key;
+  size_t keylen;
+
+  /* Only served programs can add to the cache (the contents shouldn't be
+     larger than the full cache). */
+  if( server.served==0 || size==0 || size>GAL_SERVER_CACHE_MAXSIZE )
+    return;
+
+  /* Send the contents to the server. */
+  if( (key=server_cache_key(kind, filename, hdu, &keylen))==NULL )
+    return;
+  server_cache_send(SERVER_MESSAGE_ADD, key, keylen, data, size);
+  free(key);
+}
+
+
+
+
+
+/* Similar to 'gal_server_cache_find', but for a dataset that was cached
+   with 'gal_server_cache_add_data'. The WCS and metadata of the dataset
+   are not cached. */
+gal_data_t *
+gal_server_cache_find_data(char *kind, char *filename, char *hdu,
+                           size_t minmapsize, int quietmmap)
+{
+  size_t size;
+  gal_data_t *out;
+  char *buf, *array;
+  struct server_data head;
+
+  /* See if the dataset is cached. */
+  buf=gal_server_cache_find(kind, filename, hdu, &size);
+  if(buf==NULL) return NULL;
+
+  /* Allocate the dataset and fill it. */
+  memcpy(&head, buf, sizeof head);
+  array=buf+sizeof head+head.ndim*sizeof(size_t);
+  out=gal_data_alloc(NULL, head.type, head.ndim,
+                     (size_t *)(buf+sizeof head), NULL, 0, minmapsize,
+                     quietmmap, NULL, NULL, NULL);
+  memcpy(out->array, array, out->size*gal_type_sizeof(out->type));
+  out->flag=head.flag;
+
+  /* Clean up and return. */
+  free(buf);
+  return out;
+}
+
+
+
+
+
+/* Cache the array of the given dataset (see 'gal_server_cache_add'). */
+void
+gal_server_cache_add_data(char *kind, char *filename, char *hdu,
+                          gal_data_t *data)
+{
+  char *buf;
+  size_t size;
+  struct server_data head;
+
+  /* Only served programs cache, and strings or tiles can't be cached. */
+  if( server.served==0
+      || data->block
+      || data->type==GAL_TYPE_STRING )
+    return;
+
+  /* Prepare the header. */
+  memset(&head, 0, sizeof head);
+  head.type=data->type;
+  head.flag=data->flag;
+  head.ndim=data->ndim;
+
+  /* Write the header, dimensions and array into one buffer. */
+  size=( sizeof head + data->ndim*sizeof(size_t)
+         + data->size*gal_type_sizeof(data->type) );
+  buf=gal_pointer_allocate(GAL_TYPE_UINT8, size, 0, __func__, "buf");
+  memcpy(buf, &head, sizeof head);
+  memcpy(buf+sizeof head, data->dsize, data->ndim*sizeof(size_t));
+  memcpy(buf+sizeof head+data->ndim*sizeof(size_t), data->array,
+         data->size*gal_type_sizeof(data->type));
+
+  /* Send it to the server and clean up. */
+  gal_server_cache_add(kind, filename, hdu, buf, size);
+  free(buf);
+}
+
+
+
+
+
+
+
+
+
+
+
+
+
+
+
+
+
+
+
+
+/***********************************************************************/
+/**************                  Server                 ****************/
+/***********************************************************************/
+/* Remove the socket when the server is stopped. */
+static void
+server_stop(int sig)
+{
+  unlink(server.addr.sun_path);
+  signal(sig, SIG_DFL);
+  raise(sig);
+}
+
+
+
+
+
+/* Read a request from the connection. The client's standard input,
+   output and error are given along with the size of the request. The
+   request is a series of '\0'-terminated strings: the current directory,
+   the number of arguments, the arguments and the environment. NULL is
+   returned if the request isn't complete. */
+static char *
+server_request_read(int conn, int *fds, size_t *size)
+{
+  int i;
+  char *out;
+  uint64_t insize;
+  struct iovec iov;
+  struct msghdr mh;
+  struct cmsghdr *cm;
+  union
+  {
+    struct cmsghdr align;
+    char buf[CMSG_SPACE(3*sizeof(int))];
+  } ctrl;
+
+  /* Read the size and the standard streams of the client. */
+  memset(&mh, 0, sizeof mh);
+  iov.iov_base=&insize;
+  iov.iov_len=sizeof insize;
+  mh.msg_iov=&iov;
+  mh.msg_iovlen=1;
+  mh.msg_control=ctrl.buf;
+  mh.msg_controllen=sizeof ctrl.buf;
+  if( recvmsg(conn, &mh, 0)!=sizeof insize ) return NULL;
+  cm=CMSG_FIRSTHDR(&mh);
+  if( cm==NULL
+      || cm->cmsg_level!=SOL_SOCKET
+      || cm->cmsg_type!=SCM_RIGHTS
+      || cm->cmsg_len!=CMSG_LEN(3*sizeof(int)) )
+    return NULL;
+  memcpy(fds, CMSG_DATA(cm), 3*sizeof(int));
+
+  /* Read the strings (with an extra '\0' for safety). */
+  if( insize==0 || insize>SERVER_REQUEST_MAXSIZE ) out=NULL;
+  else
+    {
+      out=gal_pointer_allocate(GAL_TYPE_UINT8, insize+1, 0, __func__,
+                               "out");
+      out[insize]='\0';
+      if( server_recv(conn, out, insize) ) { free(out); out=NULL; }
+    }
+
+  /* Clean up and return. */
+  if(out==NULL) for(i=0;i<3;++i) close(fds[i]);
+  *size=insize;
+  return out;
+}
+
+
+
+
+
+/* Run the request in this (forked) process: we are now a served program
+   in the client's directory, with its standard streams and environment.
+   This function doesn't return. */
+static void
+server_request_run(char *req, size_t size, int *fds,
+                   int (*program_main)(int, char **))
+{
+  int i, argc;
+  size_t numenv;
+  char *c, *cwd, *end=req+size, **argv;
+
+  /* Use the client's standard streams and directory. */
+  for(i=0;i<3;++i)
+    if(fds[i]!=i) { dup2(fds[i], i); close(fds[i]); }
+  cwd=req;
+  if( chdir(cwd) )
+    error(EXIT_FAILURE, errno, "%s", cwd);
+
+  /* Read the arguments. */
+  c=cwd+strlen(cwd)+1;
+  argc = c<end ? atoi(c) : 0;
+  if(argc<1) error(EXIT_FAILURE, 0, "%s: bad request", __func__);
+  c+=strlen(c)+1;
+  errno=0;
+  argv=malloc((argc+1)*sizeof *argv);
+  if(argv==NULL)
+    error(EXIT_FAILURE, errno, "%s: %zu bytes for 'argv'", __func__,
+          (argc+1)*sizeof *argv);
+  for(i=0;i<argc;++i)
+    {
+      if(c>=end) error(EXIT_FAILURE, 0, "%s: bad request", __func__);
+      argv[i]=c;
+      c+=strlen(c)+1;
+    }
+  argv[argc]=NULL;
+
+  /* The remaining strings are the environment. */
+  numenv=0;
+  for(cwd=c; cwd<end; cwd+=strlen(cwd)+1) ++numenv;
+  errno=0;
+  environ=malloc((numenv+1)*sizeof *environ);
+  if(environ==NULL)
+    error(EXIT_FAILURE, errno, "%s: %zu bytes for 'environ'", __func__,
+          (numenv+1)*sizeof *environ);
+  for(numenv=0; c<end; c+=strlen(c)+1) environ[numenv++]=c;
+  environ[numenv]=NULL;
+
+  /* Run the program and return its status to the server. */
+  exit( program_main(argc, argv) );
+}
+
+
+
+
+
+/* Wait for a served program to finish: apply its messages to the cache
+   and stop it if the client disconnects (for example with CTRL-C). When
+   it finishes, send its exit status to the client. */
+static void *
+server_request_wait(void *in)
+{
+  int status;
+  int32_t out;
+  void *data;
+  char *key;
+  struct pollfd fds[2];
+  struct server_message msg;
+  struct server_request *req=(struct server_request *)in;
+
+  /* Wait for messages. The client doesn't send anything after its
+     request, so any event on its connection means it has gone. */
+  fds[0].fd=req->msgfd;   fds[0].events=POLLIN;
+  fds[1].fd=req->conn;    fds[1].events=POLLIN;
+  while(1)
+    {
+      /* Wait for an event. */
+      if( poll(fds, 2, -1)<0 )
+        { if(errno==EINTR) continue; else break; }
+
+      /* The client has gone. */
+      if(fds[1].revents)
+        {
+          kill(req->pid, SIGTERM);
+          fds[1].fd=-1;
+        }
+
+      /* A message from the served program (when it finishes, its socket
+         is closed and reading fails). */
+      if(fds[0].revents)
+        {
+          if( server_recv(req->msgfd, &msg, sizeof msg)
+              || msg.keylen==0
+              || msg.keylen>SERVER_REQUEST_MAXSIZE
+              || msg.datasize>GAL_SERVER_CACHE_MAXSIZE )
+            break;
+          key=gal_pointer_allocate(GAL_TYPE_UINT8, msg.keylen, 0,
+                                   __func__, "key");
+          data = ( msg.datasize
+                   ? gal_pointer_allocate(GAL_TYPE_UINT8, msg.datasize,
+                                          0, __func__, "data")
+                   : NULL );
+          if( server_recv(req->msgfd, key, msg.keylen)
+              || ( msg.datasize
+                   && server_recv(req->msgfd, data, msg.datasize) ) )
+            { free(key); free(data); break; }
+          server_cache_message(msg.type, key, msg.keylen, data,
+                               msg.datasize);
+        }
+    }
+
+  /* Wait for the program to finish and send its status to the client (if
+     it was killed by a signal, use the same status as the shell). */
+  close(req->msgfd);
+  while( waitpid(req->pid, &status, 0)<0 && errno==EINTR ) continue;
+  out = WIFEXITED(status) ? WEXITSTATUS(status) : 128+WTERMSIG(status);
+  server_send(req->conn, &out, sizeof out);
+
+  /* Clean up. */
+  close(req->conn);
+  free(req);
+  return NULL;
+}
+
+
+
+
+
+/* Run the server: wait for requests and run each in a forked copy of
+   this process (which inherits the cache). This function doesn't
+   return: the server is stopped with a signal (like CTRL-C). */
+static void
+server_run(char *dir, char *program_exec,
+           int (*program_main)(int, char **))
+{
+  pid_t pid;
+  pthread_t t;
+  mode_t mask;
+  size_t size;
+  char *request;
+  pthread_attr_t attr;
+  struct server_request *sr;
+  int i, err, sock, conn, fds[3], msgfds[2];
+
+  /* Set the address and make sure that no other server is using it. */
+  server_socket_address(dir, program_exec, &server.addr);
+  if( (sock=socket(AF_UNIX, SOCK_STREAM, 0))<0 )
+    error(EXIT_FAILURE, errno, "%s: couldn't create socket", __func__);
+  if( connect(sock, (struct sockaddr *)&server.addr,
+              sizeof server.addr)==0 )
+    error(EXIT_FAILURE, 0, "a server is already running on '%s'",
+          server.addr.sun_path);
+  close(sock);
+
+  /* Remove any remaining socket of a previous server and open the new
+     socket (only accessible to the user). */
+  unlink(server.addr.sun_path);
+  if( (sock=socket(AF_UNIX, SOCK_STREAM, 0))<0 )
+    error(EXIT_FAILURE, errno, "%s: couldn't create socket", __func__);
+  mask=umask(077);
+  if( bind(sock, (struct sockaddr *)&server.addr, sizeof server.addr) )
+    error(EXIT_FAILURE, errno, "%s", server.addr.sun_path);
+  umask(mask);
+  if( listen(sock, SOMAXCONN) )
+    error(EXIT_FAILURE, errno, "%s", server.addr.sun_path);
+
+  /* Remove the socket when stopped and don't stop when a client has
+     gone before receiving its status. */
+  signal(SIGINT, server_stop);
+  signal(SIGTERM, server_stop);
+  signal(SIGPIPE, SIG_IGN);
+
+  /* The threads waiting for each request are detached. */
+  err=pthread_attr_init(&attr);
+  if(err) error(EXIT_FAILURE, 0, "%s: thread attr not initialized",
+                __func__);
+  err=pthread_attr_setdetachstate(&attr, PTHREAD_CREATE_DETACHED);
+  if(err) error(EXIT_FAILURE, 0, "%s: thread attr not detached",
+                __func__);
+
+  /* Let the user know. */
+  error(EXIT_SUCCESS, 0, "server (process %ld) waiting for requests on "
+        "'%s'", (long)getpid(), server.addr.sun_path);
+
+  /* Wait for requests. */
+  while(1)
+    {
+      /* Read the next request. */
+      if( (conn=accept(sock, NULL, NULL))<0 )
+        {
+          if(errno==EINTR || errno==ECONNABORTED) continue;
+          error(EXIT_FAILURE, errno, "%s: accepting a connection",
+                __func__);
+        }
+      if( (request=server_request_read(conn, fds, &size))==NULL )
+        { close(conn); continue; }
+
+      /* Socket for the messages of the served program. */
+      if( socketpair(AF_UNIX, SOCK_STREAM, 0, msgfds) )
+        error(EXIT_FAILURE, errno, "%s: couldn't create socket pair",
+              __func__);
+      fcntl(msgfds[1], F_SETFD, FD_CLOEXEC);
+
+      /* Run the request in a copy of this process. The cache shouldn't
+         be changed while it is copied. */
+      fflush(NULL);
+      pthread_mutex_lock(&server.lock);
+      pid=fork();
+      pthread_mutex_unlock(&server.lock);
+      if(pid==0)
+        {
+          server.served=1;
+          server.msgfd=msgfds[1];
+          close(msgfds[0]);
+          close(sock);
+          close(conn);
+          signal(SIGINT, SIG_DFL);
+          signal(SIGTERM, SIG_DFL);
+          signal(SIGPIPE, SIG_DFL);
+          server_request_run(request, size, fds, program_main);
+        }
+
+      /* The server doesn't need these any more. */
+      free(request);
+      close(msgfds[1]);
+      for(i=0;i<3;++i) close(fds[i]);
+      if(pid<0)
+        {
+          error(EXIT_SUCCESS, errno, "couldn't fork a process for the "
+                "request");
+          close(msgfds[0]);
+          close(conn);
+          continue;
+        }
+
+      /* Wait for the served program in a separate thread. */
+      errno=0;
+      sr=malloc(sizeof *sr);
+      if(sr==NULL)
+        error(EXIT_FAILURE, errno, "%s: %zu bytes for 'sr'", __func__,
+              sizeof *sr);
+      sr->pid=pid;
+      sr->conn=conn;
+      sr->msgfd=msgfds[0];
+      err=pthread_create(&t, &attr, server_request_wait, sr);
+      if(err)
+        error(EXIT_FAILURE, 0, "%s: can't create thread", __func__);
+    }
+}
+
+
+
+
+
+
+
+
+
+
+
+
+
+
+
+
+
+
+
+
+/***********************************************************************/
+/**************                  Client                 ****************/
+/***********************************************************************/
+/* Send the request to the program's server and wait for it to finish. If
+   no server is running, return -1, otherwise, return the exit status of
+   the request. */
+static int
+server_client(char *dir, char *program_exec, int argc, char *argv[])
+{
+  int32_t status;
+  uint64_t outsize;
+  char *cwd, *request, *c;
+  struct iovec iov;
+  struct msghdr mh;
+  struct cmsghdr *cm;
+  struct sockaddr_un addr;
+  char argcstr[32];
+  int i, sock, fds[3]={STDIN_FILENO, STDOUT_FILENO, STDERR_FILENO};
+  size_t size;
+  union
+  {
+    struct cmsghdr align;
+    char buf[CMSG_SPACE(3*sizeof(int))];
+  } ctrl;
+
+  /* Connect to the server (if it isn't running, return). */
+  server_socket_address(dir, program_exec, &addr);
+  if( (sock=socket(AF_UNIX, SOCK_STREAM, 0))<0 ) return -1;
+  if( connect(sock, (struct sockaddr *)&addr, sizeof addr) )
+    { close(sock); return -1; }
+
+  /* Prepare the request (see 'server_request_read'). */
+  if( (cwd=getcwd(NULL, 0))==NULL )
+    error(EXIT_FAILURE, errno, "%s: couldn't get current directory",
+          __func__);
+  sprintf(argcstr, "%d", argc);
+  size=strlen(cwd)+1+strlen(argcstr)+1;
+  for(i=0;i<argc;++i) size+=strlen(argv[i])+1;
+  for(i=0;environ[i];++i) size+=strlen(environ[i])+1;
+  request=gal_pointer_allocate(GAL_TYPE_UINT8, size, 0, __func__,
+                               "request");
+  c=stpcpy(request, cwd)+1;
+  c=stpcpy(c, argcstr)+1;
+  for(i=0;i<argc;++i) c=stpcpy(c, argv[i])+1;
+  for(i=0;environ[i];++i) c=stpcpy(c, environ[i])+1;
+
+  /* Send the size of the request along with the standard streams. */
+  outsize=size;
+  memset(&mh, 0, sizeof mh);
+  memset(&ctrl, 0, sizeof ctrl);
+  iov.iov_base=&outsize;
+  iov.iov_len=sizeof outsize;
+  mh.msg_iov=&iov;
+  mh.msg_iovlen=1;
+  mh.msg_control=ctrl.buf;
+  mh.msg_controllen=sizeof ctrl.buf;
+  cm=CMSG_FIRSTHDR(&mh);
+  cm->cmsg_level=SOL_SOCKET;
+  cm->cmsg_type=SCM_RIGHTS;
+  cm->cmsg_len=CMSG_LEN(3*sizeof(int));
+  memcpy(CMSG_DATA(cm), fds, 3*sizeof(int));
+  if( sendmsg(sock, &mh, MSG_NOSIGNAL)!=sizeof outsize
+      || server_send(sock, request, size) )
+    error(EXIT_FAILURE, errno, "couldn't send the request to the server "
+          "on '%s'", addr.sun_path);
+
+  /* Wait for the exit status. */
+  if( server_recv(sock, &status, sizeof status) )
+    error(EXIT_FAILURE, 0, "the server on '%s' stopped before finishing "
+          "the request", addr.sun_path);
+
+  /* Clean up and return. */
+  close(sock);
+  free(request);
+  free(cwd);
+  return status;
+}
+
+
+
+
+
+/* Called at the start of each program's 'main' function. If the first
+   argument is '--server', this process will become the program's server
+   and never return. Otherwise, if a server is running for this program,
+   the request will be given to it and this process will exit with its
+   status. When no server is running (or this is already a served
+   program), this function just returns. */
+void
+gal_server_main(int argc, char *argv[], char *program_exec,
+                int (*program_main)(int, char **))
+{
+  int status;
+  char *dir=getenv(GAL_SERVER_ENV);
+
+  /* A served program should just continue. */
+  if(server.served) return;
+
+  /* Start the server. */
+  if( argc>1 && !strcmp(argv[1], GAL_SERVER_ARG) )
+    {
+      if(argc>2)
+        error(EXIT_FAILURE, 0, "'%s' doesn't take any other arguments",
+              GAL_SERVER_ARG);
+      if(dir==NULL || dir[0]=='\0')
+        error(EXIT_FAILURE, 0, "the '%s' environment variable should "
+              "contain the directory to host the server's socket",
+              GAL_SERVER_ENV);
+      server_run(dir, program_exec, program_main);
+    }
+
+  /* If a server is running, let it do the job. */
+  if( dir && dir[0]!='\0'
+      && (status=server_client(dir, program_exec, argc, argv))>=0 )
+    exit(status);
+}
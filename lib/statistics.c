@@ -51,17 +51,137 @@ along with Gnuastro. If not, see <http://www.gnu.org/licenses/>.
 
 
 
+/****************************************************************
+ ********                  Workspace                      *******
+ ****************************************************************/
+/* Allocate a workspace for the '_ws' functions. All the single-element
+   outputs are allocated here once. The single-element datasets whose type
+   depends on the input are allocated as 8-byte types (the largest numeric
+   type), their 'type' is then set on every call. */
+gal_statistics_workspace_t *
+gal_statistics_workspace_alloc()
+{
+  size_t one=1, four=4;
+  gal_statistics_workspace_t *ws;
+
+  /* Allocate the structure. */
+  errno=0;
+  ws=malloc(sizeof *ws);
+  if(ws==NULL)
+    error(EXIT_FAILURE, errno, "%s: %zu bytes for 'ws'", __func__,
+          sizeof *ws);
+
+  /* Allocate the outputs. */
+  ws->number=gal_data_alloc(NULL, GAL_TYPE_SIZE_T, 1, &one, NULL, 0, -1,
+                            1, NULL, NULL, NULL);
+  ws->mean=gal_data_alloc(NULL, GAL_TYPE_FLOAT64, 1, &one, NULL, 0, -1,
+                          1, NULL, NULL, NULL);
+  ws->quantile=gal_data_alloc(NULL, GAL_TYPE_FLOAT64, 1, &one, NULL, 0,
+                              -1, 1, NULL, NULL, NULL);
+  ws->qfunc=gal_data_alloc(NULL, GAL_TYPE_FLOAT64, 1, &one, NULL, 0, -1,
+                           1, NULL, NULL, NULL);
+  ws->sigclip=gal_data_alloc(NULL, GAL_TYPE_FLOAT32, 1, &four, NULL, 0,
+                             -1, 1, NULL, NULL, NULL);
+  ws->value=gal_data_alloc(NULL, GAL_TYPE_FLOAT64, 1, &one, NULL, 0, -1,
+                           1, NULL, NULL, NULL);
+
+  /* The contiguous copy is only allocated when necessary. */
+  ws->copy=NULL;
+  ws->copybytes=0;
+  return ws;
+}
+
+
+
+
+
+void
+gal_statistics_workspace_free(gal_statistics_workspace_t *ws)
+{
+  /* The type of the single-element datasets may have changed, but their
+     space was allocated as 8-byte numbers, so we can free them with any
+     numeric type. */
+  if(ws==NULL) return;
+  gal_data_free(ws->number);
+  gal_data_free(ws->mean);
+  gal_data_free(ws->quantile);
+  gal_data_free(ws->qfunc);
+  gal_data_free(ws->sigclip);
+  gal_data_free(ws->value);
+  if(ws->copy) gal_data_free(ws->copy);
+  free(ws);
+}
+
+
+
+
+
+/* Return a contiguous version of the input that can be modified in place
+   (either the input itself, or a copy of it within the workspace). This
+   is the workspace counterpart of the copy that
+   'gal_statistics_no_blank_sorted' does for tiles or when 'inplace==0':
+   the space is only re-allocated when the previous one is too small. */
+static gal_data_t *
+statistics_ws_contig(gal_data_t *input, int inplace,
+                     gal_statistics_workspace_t *ws)
+{
+  uint8_t type=gal_tile_block(input)->type;
+  size_t nbytes=input->size * gal_type_sizeof(type);
+
+  /* If the input can be used directly, just return it. Zero-sized inputs
+     are also returned directly: 'gal_statistics_no_blank_sorted' won't
+     touch them. */
+  if( input->size==0 || (inplace && input->block==NULL) ) return input;
+
+  /* If the already allocated copy is not large enough (or has a different
+     dimensionality), re-allocate it. Note that the copy will always be
+     given a non-zero size to avoid problems with zero-sized inputs. */
+  if( ws->copy==NULL || ws->copybytes<nbytes
+      || ws->copy->ndim!=input->ndim )
+    {
+      if(ws->copy) gal_data_free(ws->copy);
+      ws->copy=gal_data_alloc(NULL, type, input->ndim, input->dsize, NULL,
+                              0, -1, 1, NULL, NULL, NULL);
+      ws->copybytes=nbytes;
+    }
+
+  /* Reset the type and size of the copy (they may have been changed by
+     the previous call), then copy the input into it. */
+  ws->copy->type=type;
+  ws->copy->ndim=input->ndim;
+  ws->copy->size=ws->copybytes/gal_type_sizeof(type);
+  gal_data_copy_to_allocated(input, ws->copy);
+  ws->copy->block=NULL;
+  return ws->copy;
+}
+
+
+
+
+
+
+
+
+
+
+
+
+
+
+
+
+
+
+
+
 /****************************************************************
  ********               Simple statistics                 *******
  ****************************************************************/
-/* Return the number of non-blank elements in an array as a single element,
-   'size_t' type data structure. */
-gal_data_t *
-gal_statistics_number(gal_data_t *input)
+/* Count the number of non-blank elements and put it in 'out'. */
+static void
+statistics_number(gal_data_t *input, gal_data_t *out)
 {
-  size_t counter=0, dsize=1;
-  gal_data_t *out=gal_data_alloc(NULL, GAL_TYPE_SIZE_T, 1, &dsize,
-                                 NULL, 1, -1, 1, NULL, NULL, NULL);
+  size_t counter=0;
 
   /* If there is no blank values in the input, then the total number is
      just the size. */
@@ -72,6 +192,21 @@ gal_statistics_number(gal_data_t *input)
 
   /* Write the value into memory. */
   *((size_t *)(out->array)) = counter;
+}
+
+
+
+
+
+/* Return the number of non-blank elements in an array as a single element,
+   'size_t' type data structure. */
+gal_data_t *
+gal_statistics_number(gal_data_t *input)
+{
+  size_t dsize=1;
+  gal_data_t *out=gal_data_alloc(NULL, GAL_TYPE_SIZE_T, 1, &dsize,
+                                 NULL, 1, -1, 1, NULL, NULL, NULL);
+  statistics_number(input, out);
   return out;
 }
 
@@ -79,6 +214,19 @@ gal_statistics_number(gal_data_t *input)
 
 
 
+/* Similar to 'gal_statistics_number', but the output is kept in the
+   workspace. */
+gal_data_t *
+gal_statistics_number_ws(gal_data_t *input, gal_statistics_workspace_t *ws)
+{
+  statistics_number(input, ws->number);
+  return ws->number;
+}
+
+
+
+
+
 /* Return the minimum (non-blank) value of a dataset in the same type as
    the dataset. */
 gal_data_t *
@@ -165,17 +313,14 @@ gal_statistics_sum(gal_data_t *input)
 
 /* Return the mean of the input dataset as a float64 type single-element
    dataset. */
-gal_data_t *
-gal_statistics_mean(gal_data_t *input)
+static void
+statistics_mean(gal_data_t *input, gal_data_t *out)
 {
-  size_t dsize=1, n=0;
-  gal_data_t *out=gal_data_alloc(NULL, GAL_TYPE_FLOAT64, 1, &dsize,
-                                 NULL, 1, -1, 1, NULL, NULL, NULL);
+  size_t n=0;
 
   /* See if the input actually has any elements. */
+  *((double *)(out->array))=0.0f;
   if(input->size)
-    /* Parse the dataset. Note that in 'gal_data_alloc' we set the 'clear'
-       flag to 1, so it will be 0.0f. */
     GAL_TILE_PARSE_OPERATE(input, out, 0, 1, {++n; *o += *i;});
 
   /* Above, we calculated the sum and number, so if there were any elements
@@ -183,6 +328,19 @@ gal_statistics_mean(gal_data_t *input)
      a blank value in the output. */
   if(n) *((double *)(out->array)) /= n;
   else gal_blank_write(out->array, out->type);
+}
+
+
+
+
+
+gal_data_t *
+gal_statistics_mean(gal_data_t *input)
+{
+  size_t dsize=1;
+  gal_data_t *out=gal_data_alloc(NULL, GAL_TYPE_FLOAT64, 1, &dsize,
+                                 NULL, 1, -1, 1, NULL, NULL, NULL);
+  statistics_mean(input, out);
   return out;
 }
 
@@ -190,6 +348,19 @@ gal_statistics_mean(gal_data_t *input)
 
 
 
+/* Similar to 'gal_statistics_mean', but the output is kept in the
+   workspace. */
+gal_data_t *
+gal_statistics_mean_ws(gal_data_t *input, gal_statistics_workspace_t *ws)
+{
+  statistics_mean(input, ws->mean);
+  return ws->mean;
+}
+
+
+
+
+
 /* Calculate the standard deviation from the already measured (after
    parsing) sum and the sum of squares. */
 double
@@ -266,19 +437,15 @@ gal_statistics_std(gal_data_t *input)
 
 
 
-/* Return the mean and standard deviation of a dataset in one run in type
-   float64. The output is a two element data structure, with the first
-   value being the mean and the second value the standard deviation. */
-gal_data_t *
-gal_statistics_mean_std(gal_data_t *input)
+/* Measure the mean and standard deviation of a dataset in one run and put
+   them in the first and second elements of 'o'. */
+static void
+statistics_mean_std(gal_data_t *input, double *o)
 {
-  size_t dsize=2, n=0;
-  double v, *o, s=0.0f, s2=0.0f;
-  gal_data_t *out=gal_data_alloc(NULL, GAL_TYPE_FLOAT64, 1, &dsize,
-                                 NULL, 1, -1, 1, NULL, NULL, NULL);
+  size_t n=0;
+  double v, s=0.0f, s2=0.0f;
 
   /* See if the input actually has any elements. */
-  o=out->array;
   switch(input->size)
     {
     /* No inputs. */
@@ -288,7 +455,7 @@ gal_statistics_mean_std(gal_data_t *input)
        deviation should be 0. But due to floating-point errors, it will
        probably not be. So we'll manually set it to zero. */
     case 1:
-      GAL_TILE_PARSE_OPERATE(input, out, 0, 1, {s+=*i;});
+      GAL_TILE_PARSE_OPERATE(input, NULL, 0, 1, {s+=*i;});
       o[0]=s; o[1]=0;
       break;
 
@@ -299,7 +466,7 @@ gal_statistics_mean_std(gal_data_t *input)
          type variable ('v') before multiplying (for 's2') because the
          multiplication of integer types close to their limits will cause
          overflow and thus an unreasonable output). */
-      GAL_TILE_PARSE_OPERATE(input, out, 0, 1,
+      GAL_TILE_PARSE_OPERATE(input, NULL, 0, 1,
                              {++n; v=*i; s+=v; s2+=v*v;});
 
       /* Write the mean */
@@ -313,8 +480,22 @@ gal_statistics_mean_std(gal_data_t *input)
       o[1] = gal_statistics_std_from_sums(s, s2, n);
       break;
     }
+}
 
-  /* Return the output dataset. */
+
+
+
+
+/* Return the mean and standard deviation of a dataset in one run in type
+   float64. The output is a two element data structure, with the first
+   value being the mean and the second value the standard deviation. */
+gal_data_t *
+gal_statistics_mean_std(gal_data_t *input)
+{
+  size_t dsize=2;
+  gal_data_t *out=gal_data_alloc(NULL, GAL_TYPE_FLOAT64, 1, &dsize,
+                                 NULL, 1, -1, 1, NULL, NULL, NULL);
+  statistics_mean_std(input, out->array);
   return out;
 }
 
@@ -360,6 +541,40 @@ statistics_median_in_sorted_no_blank(gal_data_t *sorted, void *median)
 
 
 
+/* Similar to 'statistics_median_in_sorted_no_blank', but return the median
+   as a 'double' (to avoid allocating a dataset for it). Note that the
+   median is first found in the input's type (like the function above) and
+   then converted to 'double'. */
+static double
+statistics_median_in_sorted_no_blank_f64(gal_data_t *sorted)
+{
+  int64_t m;                /* Large enough for any numeric type. */
+  statistics_median_in_sorted_no_blank(sorted, &m);
+  switch(sorted->type)
+    {
+    case GAL_TYPE_UINT8:     return *(uint8_t  *)(&m);
+    case GAL_TYPE_INT8:      return *(int8_t   *)(&m);
+    case GAL_TYPE_UINT16:    return *(uint16_t *)(&m);
+    case GAL_TYPE_INT16:     return *(int16_t  *)(&m);
+    case GAL_TYPE_UINT32:    return *(uint32_t *)(&m);
+    case GAL_TYPE_INT32:     return *(int32_t  *)(&m);
+    case GAL_TYPE_UINT64:    return *(uint64_t *)(&m);
+    case GAL_TYPE_INT64:     return *(int64_t  *)(&m);
+    case GAL_TYPE_FLOAT32:   return *(float    *)(&m);
+    case GAL_TYPE_FLOAT64:   return *(double   *)(&m);
+    default:
+      error(EXIT_FAILURE, 0, "%s: type code %d not recognized",
+            __func__, sorted->type);
+    }
+
+  /* Control should not reach here. */
+  return NAN;
+}
+
+
+
+
+
 /* Return the median value of the dataset in the same type as the input as
    a one element dataset. If the 'inplace' flag is set, the input data
    structure will be modified: it will have no blank values and will be
@@ -422,17 +637,13 @@ gal_statistics_quantile_index(size_t size, double quantile)
 
 
 
-/* Return a single element dataset of the same type as input keeping the
-   value that has the given quantile. */
-gal_data_t *
-gal_statistics_quantile(gal_data_t *input, double quantile, int inplace)
+/* Put the value at the given quantile of the (no-blank and sorted) 'nbs'
+   dataset into the single-element 'out' (that has the same type). */
+static void
+statistics_quantile(gal_data_t *nbs, double quantile, gal_data_t *out)
 {
-  void *blank;
   int increasing;
-  size_t dsize=1, index;
-  gal_data_t *nbs=gal_statistics_no_blank_sorted(input, inplace);
-  gal_data_t *out=gal_data_alloc(NULL, nbs->type, 1, &dsize,
-                                 NULL, 1, -1, 1, NULL, NULL, NULL);
+  size_t index;
 
   /* Only continue processing if there are non-blank elements. */
   if(nbs->size)
@@ -450,11 +661,7 @@ gal_statistics_quantile(gal_data_t *input, double quantile, int inplace)
 
       /* Write the value at this index into the output. */
       if(index==GAL_BLANK_SIZE_T)
-        {
-          blank=gal_pointer_allocate(nbs->type, 1, 0, __func__, "blank");
-          memcpy(out->array, blank, gal_type_sizeof(nbs->type));
-          free(blank);
-        }
+        gal_blank_write(out->array, out->type);
       else
         memcpy(out->array,
                gal_pointer_increment(nbs->array, index, nbs->type),
@@ -462,6 +669,24 @@ gal_statistics_quantile(gal_data_t *input, double quantile, int inplace)
     }
   else
     gal_blank_write(out->array, out->type);
+}
+
+
+
+
+
+/* Return a single element dataset of the same type as input keeping the
+   value that has the given quantile. */
+gal_data_t *
+gal_statistics_quantile(gal_data_t *input, double quantile, int inplace)
+{
+  size_t dsize=1;
+  gal_data_t *nbs=gal_statistics_no_blank_sorted(input, inplace);
+  gal_data_t *out=gal_data_alloc(NULL, nbs->type, 1, &dsize,
+                                 NULL, 1, -1, 1, NULL, NULL, NULL);
+
+  /* Find the quantile. */
+  statistics_quantile(nbs, quantile, out);
 
   /* Clean up and return. */
   if(nbs!=input) gal_data_free(nbs);
@@ -472,6 +697,27 @@ gal_statistics_quantile(gal_data_t *input, double quantile, int inplace)
 
 
 
+/* Similar to 'gal_statistics_quantile', but any necessary copy of the
+   input and the output are kept in the workspace. */
+gal_data_t *
+gal_statistics_quantile_ws(gal_data_t *input, double quantile, int inplace,
+                           gal_statistics_workspace_t *ws)
+{
+  gal_data_t *nbs;
+
+  /* Get the no-blank and sorted dataset (within the workspace if
+     necessary), set the output type and find the quantile. */
+  nbs=gal_statistics_no_blank_sorted(statistics_ws_contig(input, inplace,
+                                                          ws), 1);
+  ws->quantile->type=nbs->type;
+  statistics_quantile(nbs, quantile, ws->quantile);
+  return ws->quantile;
+}
+
+
+
+
+
 /* Return the index of the (first) point in the sorted dataset that has the
    closest value to 'value' (which has to be the same type as the 'input'
    dataset). */
@@ -507,22 +753,11 @@ gal_statistics_quantile(gal_data_t *input, double quantile, int inplace)
     /* Set the difference if the value is actually in the range. */     \
     if(parsed && a<af) index = a-r;                                     \
   }
-size_t
-gal_statistics_quantile_function_index(gal_data_t *input,
-                                       gal_data_t *invalue, int inplace)
+static size_t
+statistics_quantile_function_index(gal_data_t *nbs, gal_data_t *value)
 {
   int parsed=0;
-  gal_data_t *value;
   size_t index=GAL_BLANK_SIZE_T;
-  gal_data_t *nbs=gal_statistics_no_blank_sorted(input, inplace);
-
-  /* Make sure the value has the same type. */
-  if(invalue->size>1)
-    error(EXIT_FAILURE, 0, "%s: the 'value' argument must only have "
-          "one element", __func__);
-  value = ( (nbs->type==invalue->type)
-            ? invalue
-            : gal_data_copy_to_new_type(invalue, nbs->type) );
 
   /* Only continue processing if we have non-blank elements. */
   if(nbs->size)
@@ -550,6 +785,56 @@ gal_statistics_quantile_function_index(gal_data_t *input,
       index=GAL_BLANK_SIZE_T;
     }
 
+  /* Return the index. */
+  return index;
+}
+
+
+
+
+
+/* Return the single-element 'invalue' in the given type. If the type is
+   already the same, the input will be returned. Otherwise, when a
+   workspace is given, the converted value will be put in it and when it
+   isn't, a new dataset will be allocated. */
+static gal_data_t *
+statistics_value_in_type(gal_data_t *invalue, uint8_t type,
+                         gal_statistics_workspace_t *ws)
+{
+  /* Sanity check. */
+  if(invalue->size>1)
+    error(EXIT_FAILURE, 0, "%s: the 'value' argument must only have "
+          "one element", __func__);
+
+  /* If the types are the same, there is nothing to do. */
+  if(invalue->type==type) return invalue;
+
+  /* If a workspace isn't given, allocate a new dataset. */
+  if(ws==NULL) return gal_data_copy_to_new_type(invalue, type);
+
+  /* Use the workspace. */
+  ws->value->type=type;
+  ws->value->ndim=ws->value->size=1;
+  gal_data_copy_to_allocated(invalue, ws->value);
+  ws->value->next=NULL;
+  return ws->value;
+}
+
+
+
+
+
+size_t
+gal_statistics_quantile_function_index(gal_data_t *input,
+                                       gal_data_t *invalue, int inplace)
+{
+  size_t index;
+  gal_data_t *nbs=gal_statistics_no_blank_sorted(input, inplace);
+  gal_data_t *value=statistics_value_in_type(invalue, nbs->type, NULL);
+
+  /* Find the index. */
+  index=statistics_quantile_function_index(nbs, value);
+
   /* Clean up and return. */
   if(value!=invalue) gal_data_free(value);
   if(nbs!=input) gal_data_free(nbs);
@@ -572,31 +857,18 @@ gal_statistics_quantile_function_index(gal_data_t *input,
     else                                                                \
       d[0] = v>*a ? INFINITY : -INFINITY;                               \
   }
-gal_data_t *
-gal_statistics_quantile_function(gal_data_t *input, gal_data_t *value,
-                                 int inplace)
+static void
+statistics_quantile_function(gal_data_t *nbs, gal_data_t *value,
+                             gal_data_t *out)
 {
-  double *d;
-  size_t ind, dsize=1;
-  gal_data_t *nbs=gal_statistics_no_blank_sorted(input, inplace);
-  gal_data_t *out=gal_data_alloc(NULL, GAL_TYPE_FLOAT64, 1, &dsize,
-                                 NULL, 1, -1, 1, NULL, NULL, NULL);
-
-  /* Sanity checks. */
-  if(value->size>1)
-    error(EXIT_FAILURE, 0, "%s: the 'value' argument must only have "
-          "one element", __func__);
-
-  /* Calculate the index of the value. */
-  ind=gal_statistics_quantile_function_index(input, value, inplace);
-  //printf("ind: %zu (%zu)\n", ind, input->size);
+  double *d=out->array;
+  size_t ind=statistics_quantile_function_index(nbs, value);
 
   /* Only continue processing if there are non-blank values. */
   if(nbs->size)
     {
       /* Note that counting of the index starts from 0, so for the quantile
          we should divided by (size - 1). */
-      d=out->array;
       if(ind==GAL_BLANK_SIZE_T)
         {
           /* See if the value is larger or smaller than the input's minimum
@@ -623,8 +895,27 @@ gal_statistics_quantile_function(gal_data_t *input, gal_data_t *value,
     }
   else
     gal_blank_write(out->array, out->type);
+}
+
+
+
+
+
+gal_data_t *
+gal_statistics_quantile_function(gal_data_t *input, gal_data_t *invalue,
+                                 int inplace)
+{
+  size_t dsize=1;
+  gal_data_t *nbs=gal_statistics_no_blank_sorted(input, inplace);
+  gal_data_t *value=statistics_value_in_type(invalue, nbs->type, NULL);
+  gal_data_t *out=gal_data_alloc(NULL, GAL_TYPE_FLOAT64, 1, &dsize,
+                                 NULL, 1, -1, 1, NULL, NULL, NULL);
+
+  /* Find the quantile function. */
+  statistics_quantile_function(nbs, value, out);
 
   /* Clean up and return. */
+  if(value!=invalue) gal_data_free(value);
   if(nbs!=input) gal_data_free(nbs);
   return out;
 }
@@ -633,6 +924,28 @@ gal_statistics_quantile_function(gal_data_t *input, gal_data_t *value,
 
 
 
+/* Similar to 'gal_statistics_quantile_function', but any necessary copy of
+   the input, the type-converted value and the output are kept in the
+   workspace. */
+gal_data_t *
+gal_statistics_quantile_function_ws(gal_data_t *input, gal_data_t *invalue,
+                                    int inplace,
+                                    gal_statistics_workspace_t *ws)
+{
+  gal_data_t *nbs, *value;
+
+  /* Prepare the inputs and find the quantile function. */
+  nbs=gal_statistics_no_blank_sorted(statistics_ws_contig(input, inplace,
+                                                          ws), 1);
+  value=statistics_value_in_type(invalue, nbs->type, ws);
+  statistics_quantile_function(nbs, value, ws->qfunc);
+  return ws->qfunc;
+}
+
+
+
+
+
 /* Pull out unique elements */
 #define UNIQUE_BYTYPE(TYPE) {                                           \
     size_t i, j;                                                        \
@@ -2245,19 +2558,18 @@ gal_statistics_cfp(gal_data_t *input, gal_data_t *bins, int normalize)
       while(--b>=bf);                                                   \
   }
 
-gal_data_t *
-gal_statistics_sigma_clip(gal_data_t *input, float multip, float param,
-                          int inplace, int quiet)
+static void
+statistics_sigma_clip(gal_data_t *nbs, float multip, float param,
+                      int quiet, gal_data_t *out)
 {
-  float *oa;
   void *start, *nbs_array;
-  double *med, *mean, *std;
-  uint8_t type=gal_tile_block(input)->type;
+  double meanstd[2], medv;
+  float *oa=out->array;
+  uint8_t type=nbs->type;
+  size_t num=0, size, oldsize;
   uint8_t bytolerance = param>=1.0f ? 0 : 1;
   double oldmed=NAN, oldmean=NAN, oldstd=NAN;
-  size_t num=0, one=1, four=4, size, oldsize;
-  gal_data_t *fcopy, *median_i, *median_d, *out, *meanstd;
-  gal_data_t *nbs=gal_statistics_no_blank_sorted(input, inplace);
+  double *med=&medv, *mean=meanstd, *std=meanstd+1;
   size_t maxnum = param>=1.0f ? param : GAL_STATISTICS_SIG_CLIP_MAX_CONVERGE;
 
   /* Some sanity checks. */
@@ -2281,15 +2593,8 @@ gal_statistics_sigma_clip(gal_data_t *input, float multip, float param,
           "problem. 'nbs' isn't sorted", __func__, PACKAGE_BUGREPORT);
 
 
-  /* Allocate the necessary spaces. */
-  out=gal_data_alloc(NULL, GAL_TYPE_FLOAT32, 1, &four, NULL, 0,
-                     input->minmapsize, input->quietmmap, NULL, NULL, NULL);
-  median_i=gal_data_alloc(NULL, type, 1, &one, NULL, 0, input->minmapsize,
-                          input->quietmmap, NULL, NULL, NULL);
-
-
   /* Only continue processing if we have non-blank elements. */
-  oa=out->array;
+  out->status=0;
   nbs_array=nbs->array;
   switch(nbs->size)
     {
@@ -2306,12 +2611,9 @@ gal_statistics_sigma_clip(gal_data_t *input, float multip, float param,
        definition). */
     case 1:
       /* Write the values. */
-      fcopy=gal_data_copy_to_new_type(nbs, GAL_TYPE_FLOAT32);
       oa[0] = 1;
-      oa[1] = *((float *)(fcopy->array));
-      oa[2] = *((float *)(fcopy->array));
+      oa[1] = oa[2] = statistics_median_in_sorted_no_blank_f64(nbs);
       oa[3] = 0;
-      gal_data_free(fcopy);
 
       /* Print the comments if requested. */
       if(!quiet)
@@ -2353,15 +2655,11 @@ gal_statistics_sigma_clip(gal_data_t *input, float multip, float param,
             }
           */
 
-          /* Find the mean, median and standard deviation. */
-          meanstd=gal_statistics_mean_std(nbs);
-          statistics_median_in_sorted_no_blank(nbs, median_i->array);
-          median_d=gal_data_copy_to_new_type(median_i, GAL_TYPE_FLOAT64);
-
-          /* Put them in usable (with a type) pointers. */
-          mean = meanstd->array;
-          med  = median_d->array;
-          std  = &((double *)(meanstd->array))[1];
+          /* Find the mean, median and standard deviation (without any
+             allocation, they are directly written in 'mean', 'std' and
+             'med'). */
+          statistics_mean_std(nbs, meanstd);
+          *med=statistics_median_in_sorted_no_blank_f64(nbs);
 
           /* If the user wanted to view the steps, show it to them. */
           if(!quiet)
@@ -2382,7 +2680,6 @@ gal_statistics_sigma_clip(gal_data_t *input, float multip, float param,
             if( *std==0 || ((oldstd - *std) / *std) < param )
               {
                 if(*std==0) {oldmed=*med; oldstd=*std; oldmean=*mean;}
-                gal_data_free(meanstd);   gal_data_free(median_d);
                 break;
               }
 
@@ -2412,10 +2709,6 @@ gal_statistics_sigma_clip(gal_data_t *input, float multip, float param,
           oldstd  = *std;
           oldmean = *mean;
           ++num;
-
-          /* Clean up: */
-          gal_data_free(meanstd);
-          gal_data_free(median_d);
         }
 
       /* If we were in tolerance mode and 'num' and 'maxnum' are equal (the
@@ -2432,9 +2725,27 @@ gal_statistics_sigma_clip(gal_data_t *input, float multip, float param,
         }
     }
 
-  /* Clean up and return. */
+  /* Reset the array pointer of the input. */
   nbs->array=nbs_array;
-  gal_data_free(median_i);
+}
+
+
+
+
+
+gal_data_t *
+gal_statistics_sigma_clip(gal_data_t *input, float multip, float param,
+                          int inplace, int quiet)
+{
+  size_t four=4;
+  gal_data_t *out, *nbs=gal_statistics_no_blank_sorted(input, inplace);
+
+  /* Allocate the output and do the clipping. */
+  out=gal_data_alloc(NULL, GAL_TYPE_FLOAT32, 1, &four, NULL, 0,
+                     input->minmapsize, input->quietmmap, NULL, NULL, NULL);
+  statistics_sigma_clip(nbs, multip, param, quiet, out);
+
+  /* Clean up and return. */
   if(nbs!=input) gal_data_free(nbs);
   return out;
 }
@@ -2443,6 +2754,26 @@ gal_statistics_sigma_clip(gal_data_t *input, float multip, float param,
 
 
 
+/* Similar to 'gal_statistics_sigma_clip', but any necessary copy of the
+   input and the output are kept in the workspace. */
+gal_data_t *
+gal_statistics_sigma_clip_ws(gal_data_t *input, float multip, float param,
+                             int inplace, int quiet,
+                             gal_statistics_workspace_t *ws)
+{
+  gal_data_t *nbs;
+
+  /* Prepare the input and do the clipping. */
+  nbs=gal_statistics_no_blank_sorted(statistics_ws_contig(input, inplace,
+                                                          ws), 1);
+  statistics_sigma_clip(nbs, multip, param, quiet, ws->sigclip);
+  return ws->sigclip;
+}
+
+
+
+
+
 /* Find the first outlier in a distribution. */
 #define OUTLIER_BYTYPE(IT) {                                            \
     IT *arr=nbs->array;                                                 \
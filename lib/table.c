@@ -31,8 +31,10 @@ along with Gnuastro. If not, see <http://www.gnu.org/licenses/>.
 
 #include <gnuastro/git.h>
 #include <gnuastro/txt.h>
+#include <gnuastro/type.h>
 #include <gnuastro/blank.h>
 #include <gnuastro/table.h>
+#include <gnuastro/pointer.h>
 
 #include <gnuastro-internal/timing.h>
 #include <gnuastro-internal/checkset.h>
@@ -464,6 +466,314 @@ gal_table_list_of_indexs(gal_list_str_t *cols, gal_data_t *allcols,
 
 
 
+/* Read the columns in 'indexll' with the reader of the table's format
+   (only the rows in 'rowids' when it isn't NULL). Note that after these
+   functions, the 'indexll' will be all freed (each popped element is
+   actually freed). */
+static gal_data_t *
+table_read_format(char *filename, char *hdu, gal_list_str_t *lines,
+                  int tableformat, size_t numrows, gal_data_t *allcols,
+                  gal_list_sizet_t *indexll, gal_data_t *rowids,
+                  size_t numthreads, size_t minmapsize, int quietmmap)
+{
+  gal_data_t *out=NULL;
+
+  switch(tableformat)
+    {
+    case GAL_TABLE_FORMAT_TXT:
+      out=gal_txt_table_read(filename, lines, numrows, allcols, indexll,
+                             rowids, numthreads, minmapsize, quietmmap);
+      break;
+
+    case GAL_TABLE_FORMAT_AFITS:
+    case GAL_TABLE_FORMAT_BFITS:
+      out=gal_fits_tab_read(filename, hdu, numrows, allcols, indexll,
+                            rowids, numthreads, minmapsize, quietmmap);
+      break;
+
+    default:
+      error(EXIT_FAILURE, 0, "%s: table format code %d not recognized for "
+            "'tableformat'", __func__, tableformat);
+    }
+
+  /* Return the columns. */
+  return out;
+}
+
+
+
+
+
+/* Flag (with a value of 1) the rows of 'col' that don't satisfy the
+   predicate 'pred'. Rows with a blank value in 'col' are never
+   selected. */
+static void
+table_read_select_flag(gal_data_t *col, gal_data_t *pred, uint8_t *flag,
+                       char *filename, char *hdu)
+{
+  size_t i, j;
+  double *darr, *varr;
+  char **strarr, **values;
+  uint8_t *u, isequal=pred->status==GAL_TABLE_SELECT_EQUAL;
+  gal_data_t *blank, *f64=NULL, *vf64=NULL;
+
+  /* Flag the blank elements. */
+  blank=gal_blank_flag(col);
+  u=blank->array;
+  for(i=0;i<col->size;++i) if(u[i]) flag[i]=1;
+  gal_data_free(blank);
+
+  /* String columns can only be compared with the given strings. */
+  if(col->type==GAL_TYPE_STRING)
+    {
+      if(pred->status==GAL_TABLE_SELECT_RANGE)
+        error(EXIT_FAILURE, 0, "%s: column '%s' contains strings, so it "
+              "can't be used to select a range of values",
+              gal_fits_name_save_as_string(filename, hdu), pred->name);
+      if(pred->type!=GAL_TYPE_STRING)
+        error(EXIT_FAILURE, 0, "%s: column '%s' contains strings, so the "
+              "values to compare with should also be strings",
+              gal_fits_name_save_as_string(filename, hdu), pred->name);
+
+      /* A match is found when 'j' doesn't reach the number of values. */
+      values=pred->array;
+      strarr=col->array;
+      for(i=0;i<col->size;++i)
+        if(flag[i]==0)
+          {
+            for(j=0;j<pred->size;++j)
+              if( !strcmp(strarr[i], values[j]) ) break;
+            if( isequal != (j<pred->size) ) flag[i]=1;
+          }
+      return;
+    }
+
+  /* For numerical columns, the comparison is done in double precision
+     (irrespective of the column's original type). */
+  f64 = ( col->type==GAL_TYPE_FLOAT64
+          ? col
+          : gal_data_copy_to_new_type(col, GAL_TYPE_FLOAT64) );
+  darr=f64->array;
+
+  /* Read the values to compare with as double precision numbers. */
+  if(pred->type==GAL_TYPE_STRING)
+    {
+      values=pred->array;
+      vf64=gal_data_alloc(NULL, GAL_TYPE_FLOAT64, 1, &pred->size, NULL, 0,
+                          -1, 1, NULL, NULL, NULL);
+      for(j=0;j<pred->size;++j)
+        {
+          varr=&((double *)(vf64->array))[j];
+          if( gal_type_from_string((void **)(&varr), values[j],
+                                   GAL_TYPE_FLOAT64) )
+            error(EXIT_FAILURE, 0, "%s: '%s' (value to compare with "
+                  "column '%s') couldn't be read as a number",
+                  gal_fits_name_save_as_string(filename, hdu), values[j],
+                  pred->name);
+        }
+    }
+  else
+    vf64=gal_data_copy_to_new_type(pred, GAL_TYPE_FLOAT64);
+  varr=vf64->array;
+
+  /* Flag the rows. */
+  switch(pred->status)
+    {
+    case GAL_TABLE_SELECT_RANGE:
+      if(vf64->size!=2)
+        error(EXIT_FAILURE, 0, "%s: a range selection needs two values "
+              "(minimum and maximum), but %zu values are given",
+              __func__, vf64->size);
+      for(i=0;i<col->size;++i)
+        if( flag[i]==0 && (darr[i]<varr[0] || darr[i]>=varr[1]) )
+          flag[i]=1;
+      break;
+
+    case GAL_TABLE_SELECT_EQUAL:
+    case GAL_TABLE_SELECT_NOTEQUAL:
+      for(i=0;i<col->size;++i)
+        if(flag[i]==0)
+          {
+            for(j=0;j<vf64->size;++j)
+              if( darr[i]==varr[j] ) break;
+            if( isequal != (j<vf64->size) ) flag[i]=1;
+          }
+      break;
+
+    default:
+      error(EXIT_FAILURE, 0, "%s: a bug! Please contact us at %s to fix "
+            "the problem. The code %d is not a recognized selection type",
+            __func__, PACKAGE_BUGREPORT, pred->status);
+    }
+
+  /* Clean up. */
+  if(f64!=col) gal_data_free(f64);
+  gal_data_free(vf64);
+}
+
+
+
+
+
+/* Find the index of the column that a predicate applies to. Similar to
+   how Table has always identified the columns of '--range', '--equal'
+   and '--notequal': if 'name' is a number, it is the column number
+   (counting from 1), otherwise it is the first column with the same name
+   (case-insensitive). Regular expressions are not used because a
+   predicate should only correspond to one column. */
+static size_t
+table_read_select_column(char *name, gal_data_t *allcols, size_t numcols,
+                         char *filename, char *hdu)
+{
+  size_t i, ind;
+  void *ptr=&ind;
+
+  /* The column is identified by its number. */
+  if( gal_type_from_string(&ptr, name, GAL_TYPE_SIZE_T)==0 )
+    {
+      if(ind==0 || ind>numcols)
+        error(EXIT_FAILURE, 0, "%s: has %zu columns, but column number "
+              "%zu was requested for row selection (column numbers start "
+              "from 1)", gal_fits_name_save_as_string(filename, hdu),
+              numcols, ind);
+      return ind-1;
+    }
+
+  /* The column is identified by its name. */
+  for(i=0;i<numcols;++i)
+    if( allcols[i].name && !strcasecmp(allcols[i].name, name) )
+      return i;
+
+  /* No column could be found. */
+  error(EXIT_FAILURE, 0, "%s: no column named '%s' (for row selection). "
+        "You can either specify a name or number",
+        gal_fits_name_save_as_string(filename, hdu), name);
+  return GAL_BLANK_SIZE_T;
+}
+
+
+
+
+
+/* Return the (sorted) rows of the table that satisfy all the predicates.
+   Only the columns that are used in the predicates are read here, so the
+   other columns can later be read only for the selected rows. */
+static gal_data_t *
+table_read_select_predicates(char *filename, char *hdu,
+                             gal_list_str_t *lines, int tableformat,
+                             size_t numrows, gal_data_t *allcols,
+                             size_t numcols, gal_data_t *predicates,
+                             size_t numthreads, size_t minmapsize,
+                             int quietmmap)
+{
+  size_t i, *s;
+  uint8_t *flag;
+  gal_data_t *pred;
+  gal_list_sizet_t *indexll=NULL;
+  gal_data_t *rowids, *cols, *col;
+
+  /* Find the index of the column of each predicate. */
+  for(pred=predicates; pred!=NULL; pred=pred->next)
+    {
+      if(pred->name==NULL)
+        error(EXIT_FAILURE, 0, "%s: the 'name' element of each predicate "
+              "should be the column to use", __func__);
+      gal_list_sizet_add(&indexll,
+                         table_read_select_column(pred->name, allcols,
+                                                  numcols, filename, hdu));
+    }
+  gal_list_sizet_reverse(&indexll);
+
+  /* Read the predicate columns and flag the rows to remove. */
+  cols=table_read_format(filename, hdu, lines, tableformat, numrows,
+                         allcols, indexll, NULL, numthreads, minmapsize,
+                         quietmmap);
+  flag=gal_pointer_allocate(GAL_TYPE_UINT8, numrows, 1, __func__, "flag");
+  for(col=cols, pred=predicates; col!=NULL; col=col->next, pred=pred->next)
+    table_read_select_flag(col, pred, flag, filename, hdu);
+
+  /* Keep the indexs of the good rows (the array is allocated for all
+     rows, but only the first 'size' elements will be used). */
+  rowids=gal_data_alloc(NULL, GAL_TYPE_SIZE_T, 1, &numrows, NULL, 0,
+                        minmapsize, quietmmap, NULL, NULL, NULL);
+  s=rowids->array;
+  for(i=0;i<numrows;++i) if(flag[i]==0) *s++=i;
+  rowids->size = rowids->dsize[0] = s - (size_t *)(rowids->array);
+
+  /* Clean up and return. */
+  free(flag);
+  gal_list_data_free(cols);
+  gal_list_sizet_free(indexll);
+  return rowids;
+}
+
+
+
+
+
+/* Select rows based on their position (after any predicate has been
+   applied): 'head' and 'tail' are the number of rows from the top or
+   bottom and 'rowrange' has the first and last rows (counting from
+   zero). If none are requested, the input 'rowids' is returned. */
+static gal_data_t *
+table_read_select_position(gal_data_t *rowids, size_t numrows,
+                           size_t head, size_t tail, size_t *rowrange,
+                           char *filename, char *hdu, size_t minmapsize,
+                           int quietmmap)
+{
+  size_t i, *s, dsize, start, num;
+  size_t n = rowids ? rowids->size : numrows;
+
+  /* Set the range of (selected) rows to keep. Similar to the 'head' and
+     'tail' programs of GNU Coreutils, when the requested number is larger
+     than the number of rows, all the rows will be kept. */
+  if(head!=GAL_BLANK_SIZE_T)
+    { start=0; num = head<n ? head : n; }
+  else if(tail!=GAL_BLANK_SIZE_T)
+    { num = tail<n ? tail : n; start = n - num; }
+  else if(rowrange)
+    {
+      if(rowrange[0]>rowrange[1])
+        error(EXIT_FAILURE, 0, "%s: the first row of the range (%zu) "
+              "should be smaller or equal to the last row (%zu)",
+              __func__, rowrange[0], rowrange[1]);
+      for(i=0;i<2;++i)
+        if(rowrange[i]>=n)
+          error(EXIT_FAILURE, 0, "%s: the %s row of the requested range "
+                "(%zu, counting from 1) is larger than the number of "
+                "%srows (%zu)", gal_fits_name_save_as_string(filename, hdu),
+                i ? "last" : "first", rowrange[i]+1,
+                rowids ? "selected " : "", n);
+      start=rowrange[0];
+      num=rowrange[1]-rowrange[0]+1;
+    }
+  else return rowids;
+
+  /* Keep the desired rows. */
+  if(rowids)
+    {
+      s=rowids->array;
+      memmove(s, s+start, num*sizeof *s);
+      rowids->size = rowids->dsize[0] = num;
+    }
+  else
+    {
+      dsize = num ? num : 1;
+      rowids=gal_data_alloc(NULL, GAL_TYPE_SIZE_T, 1, &dsize, NULL, 0,
+                            minmapsize, quietmmap, NULL, NULL, NULL);
+      s=rowids->array;
+      for(i=0;i<num;++i) s[i]=start+i;
+      rowids->size = rowids->dsize[0] = num;
+    }
+
+  /* Return the row IDs. */
+  return rowids;
+}
+
+
+
+
+
 /* Read the specified columns in a table (named 'filename') into a linked
    list of data structures. If the file is FITS, then 'hdu' will also be
    used, otherwise, 'hdu' is ignored. The information to search for columns
@@ -479,17 +789,25 @@ gal_table_list_of_indexs(gal_list_str_t *cols, gal_data_t *allcols,
    columns, in this case, the order of output columns that correspond to
    that one input, are in order of the table (which column was read first).
    So the first requested column is the first popped data structure and so
-   on. */
+   on.
+
+   Only the rows that satisfy all the 'predicates' are read (each node's
+   'name' is the column and its 'status' is one of the
+   'GAL_TABLE_SELECT_*' macros). Afterwards, only the first 'head' or last
+   'tail' rows, or the rows within 'rowrange' are read. So the columns in
+   the predicates are read first, and the other columns are only read for
+   the selected rows. */
 gal_data_t *
-gal_table_read(char *filename, char *hdu, gal_list_str_t *lines,
-               gal_list_str_t *cols, int searchin, int ignorecase,
-               size_t numthreads, size_t minmapsize, int quietmmap,
-               size_t *colmatch)
+gal_table_read_select(char *filename, char *hdu, gal_list_str_t *lines,
+                      gal_list_str_t *cols, gal_data_t *predicates,
+                      size_t head, size_t tail, size_t *rowrange,
+                      int searchin, int ignorecase, size_t numthreads,
+                      size_t minmapsize, int quietmmap, size_t *colmatch)
 {
   int tableformat;
   gal_list_sizet_t *indexll;
   size_t i, numcols, numrows;
-  gal_data_t *allcols, *out=NULL;
+  gal_data_t *allcols, *rowids=NULL, *out=NULL;
 
   /* First get the information of all the columns. */
   allcols=gal_table_info(filename, hdu, lines, &numcols, &numrows,
@@ -502,31 +820,26 @@ gal_table_read(char *filename, char *hdu, gal_list_str_t *lines,
   indexll=gal_table_list_of_indexs(cols, allcols, numcols, searchin,
                                    ignorecase, filename, hdu, colmatch);
 
-  /* Depending on the table format, read the columns into the output
-     structure. Also note that after these functions, the 'indexll' will be
-     all freed (each popped element is actually freed).*/
-  switch(tableformat)
-    {
-    case GAL_TABLE_FORMAT_TXT:
-      out=gal_txt_table_read(filename, lines, numrows, allcols, indexll,
-                             minmapsize, quietmmap);
-      break;
-
-    case GAL_TABLE_FORMAT_AFITS:
-    case GAL_TABLE_FORMAT_BFITS:
-      out=gal_fits_tab_read(filename, hdu, numrows, allcols, indexll,
-                            numthreads, minmapsize, quietmmap);
-      break;
+  /* Find the rows that should be read. */
+  if(predicates && numrows)
+    rowids=table_read_select_predicates(filename, hdu, lines, tableformat,
+                                        numrows, allcols, numcols,
+                                        predicates, numthreads,
+                                        minmapsize, quietmmap);
+  rowids=table_read_select_position(rowids, numrows, head, tail, rowrange,
+                                    filename, hdu, minmapsize, quietmmap);
 
-    default:
-      error(EXIT_FAILURE, 0, "%s: table format code %d not recognized for "
-            "'tableformat'", __func__, tableformat);
-    }
+  /* Depending on the table format, read the columns into the output
+     structure. */
+  out=table_read_format(filename, hdu, lines, tableformat, numrows,
+                        allcols, indexll, rowids, numthreads, minmapsize,
+                        quietmmap);
 
   /* Clean up. */
   for(i=0;i<numcols;++i)
     gal_data_free_contents(&allcols[i]);
   free(allcols);
+  gal_data_free(rowids);
   gal_list_sizet_free(indexll);
 
   /* Return the final linked list. */
@@ -537,6 +850,23 @@ gal_table_read(char *filename, char *hdu, gal_list_str_t *lines,
 
 
 
+/* Read all the rows of the given columns (see 'gal_table_read_select'). */
+gal_data_t *
+gal_table_read(char *filename, char *hdu, gal_list_str_t *lines,
+               gal_list_str_t *cols, int searchin, int ignorecase,
+               size_t numthreads, size_t minmapsize, int quietmmap,
+               size_t *colmatch)
+{
+  return gal_table_read_select(filename, hdu, lines, cols, NULL,
+                               GAL_BLANK_SIZE_T, GAL_BLANK_SIZE_T, NULL,
+                               searchin, ignorecase, numthreads,
+                               minmapsize, quietmmap, colmatch);
+}
+
+
+
+
+
 
 
 
@@ -591,11 +921,12 @@ gal_table_comments_add_intro(gal_list_str_t **comments, char *program_string,
 
 /* The input is a linked list of data structures and some comments. The
    table will then be written into 'filename' with a format that is
-   specified by 'tableformat'. */
+   specified by 'tableformat'. Plain text tables are formatted in
+   'numthreads' threads. */
 void
 gal_table_write(gal_data_t *cols, struct gal_fits_list_key_t **keylist,
                 gal_list_str_t *comments, int tableformat, char *filename,
-                char *extname, uint8_t colinfoinstdout)
+                char *extname, uint8_t colinfoinstdout, size_t numthreads)
 {
   /* If a filename was given, then the tableformat is relevant and must be
      used. When the filename is empty, a text table must be printed on the
@@ -606,11 +937,13 @@ gal_table_write(gal_data_t *cols, struct gal_fits_list_key_t **keylist,
         gal_fits_tab_write(cols, comments, tableformat, filename, extname,
                            keylist);
       else
-        gal_txt_write(cols, keylist, comments, filename, colinfoinstdout);
+        gal_txt_write(cols, keylist, comments, filename, colinfoinstdout,
+                      numthreads);
     }
   else
     /* Write to standard output. */
-    gal_txt_write(cols, keylist, comments, filename, colinfoinstdout);
+    gal_txt_write(cols, keylist, comments, filename, colinfoinstdout,
+                  numthreads);
 }
 
 
@@ -629,7 +962,7 @@ gal_table_write_log(gal_data_t *logll, char *program_string,
 
   /* Write the log file to disk */
   gal_table_write(logll, NULL, comments, GAL_TABLE_FORMAT_TXT,
-                  filename, "LOG", 0);
+                  filename, "LOG", 0, 1);
 
   /* In verbose mode, print the information. */
   if(!quiet)
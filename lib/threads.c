@@ -265,6 +265,143 @@ gal_threads_attr_barrier_init(pthread_attr_t *attr, pthread_barrier_t *b,
 /*******************************************************************/
 /************     Run a function on multiple threads  **************/
 /*******************************************************************/
+/* Persistent pool of threads. Creating threads is expensive and some
+   programs (like NoiseChisel) call 'gal_threads_spin_off' many times, so
+   the threads that are created for one call are kept waiting for the
+   next. The pool can only be used by one call at a time (while 'busy' is
+   locked). When it is busy (for example when a worker function calls
+   'gal_threads_spin_off' itself or other threads of the program use it
+   at the same time), new threads are created for that call like
+   before. */
+static struct
+{
+  pthread_mutex_t            busy;  /* Locked while a call uses the pool. */
+  pthread_mutex_t            lock;  /* Protect the elements below.        */
+  pthread_cond_t             cond;  /* Signal a new job to the threads.   */
+  size_t               numthreads;  /* Number of threads in the pool.     */
+  size_t               generation;  /* Counter of the jobs given so far.  */
+  size_t                  numjobs;  /* Number of threads in current job.  */
+  void      *(*worker)(void *);     /* Worker function of current job.    */
+  struct gal_threads_params  *prm;  /* Parameters of each thread.         */
+} threads_pool = { PTHREAD_MUTEX_INITIALIZER, PTHREAD_MUTEX_INITIALIZER,
+                   PTHREAD_COND_INITIALIZER, 0, 0, 0, NULL, NULL };
+
+/* Identifier of a pool thread and the last job it has seen (given to the
+   thread when it is created). */
+struct threads_pool_start
+{
+  size_t   id;
+  size_t seen;
+};
+
+
+
+
+
+/* Function that runs on each thread of the pool: wait for a new job and
+   run the worker function if this thread is necessary for it. */
+static void *
+threads_pool_thread(void *in)
+{
+  struct threads_pool_start *start=(struct threads_pool_start *)in;
+  size_t id=start->id, seen=start->seen;
+  struct gal_threads_params *prm;
+  void *(*worker)(void *);
+
+  /* The starting information is no longer necessary. */
+  free(start);
+
+  /* Wait for jobs. */
+  pthread_mutex_lock(&threads_pool.lock);
+  while(1)
+    {
+      /* Wait until a new job is given. */
+      while(threads_pool.generation==seen)
+        pthread_cond_wait(&threads_pool.cond, &threads_pool.lock);
+      seen=threads_pool.generation;
+
+      /* If this thread is necessary for this job, run the worker (which
+         will wait on the barrier when it is done). */
+      if(id<threads_pool.numjobs)
+        {
+          prm=&threads_pool.prm[id];
+          worker=threads_pool.worker;
+          pthread_mutex_unlock(&threads_pool.lock);
+          worker(prm);
+          pthread_mutex_lock(&threads_pool.lock);
+        }
+    }
+
+  /* Control never reaches here. */
+  return NULL;
+}
+
+
+
+
+
+/* Run the job on the threads of the pool (adding threads to the pool if
+   necessary). If the pool is being used by another call, return 0 (so
+   the caller creates its own threads). The parameters of the necessary
+   threads ('prm') should be contiguous and the barrier of the first one
+   is used for all. */
+static int
+threads_pool_run(void *(*worker)(void *), struct gal_threads_params *prm,
+                 size_t numjobs)
+{
+  int err;
+  pthread_t t;
+  pthread_attr_t attr;
+  struct threads_pool_start *start;
+
+  /* If the pool is being used, let the caller take care of this job. */
+  if( pthread_mutex_trylock(&threads_pool.busy) ) return 0;
+
+  /* Add threads to the pool if necessary. */
+  pthread_mutex_lock(&threads_pool.lock);
+  if(threads_pool.numthreads<numjobs)
+    {
+      err=pthread_attr_init(&attr);
+      if(err) error(EXIT_FAILURE, 0, "%s: thread attr not initialized",
+                    __func__);
+      err=pthread_attr_setdetachstate(&attr, PTHREAD_CREATE_DETACHED);
+      if(err) error(EXIT_FAILURE, 0, "%s: thread attr not detached",
+                    __func__);
+      for(; threads_pool.numthreads<numjobs; ++threads_pool.numthreads)
+        {
+          errno=0;
+          start=malloc(sizeof *start);
+          if(start==NULL)
+            error(EXIT_FAILURE, errno, "%s: couldn't allocate %zu bytes",
+                  __func__, sizeof *start);
+          start->id=threads_pool.numthreads;
+          start->seen=threads_pool.generation;
+          err=pthread_create(&t, &attr, threads_pool_thread, start);
+          if(err)
+            error(EXIT_FAILURE, 0, "%s: can't create thread %zu",
+                  __func__, threads_pool.numthreads);
+        }
+      pthread_attr_destroy(&attr);
+    }
+
+  /* Give the job to the threads. */
+  threads_pool.prm=prm;
+  threads_pool.worker=worker;
+  threads_pool.numjobs=numjobs;
+  ++threads_pool.generation;
+  pthread_cond_broadcast(&threads_pool.cond);
+  pthread_mutex_unlock(&threads_pool.lock);
+
+  /* Wait for all the threads to finish. */
+  pthread_barrier_wait(prm[0].b);
+  pthread_mutex_unlock(&threads_pool.busy);
+  return 1;
+}
+
+
+
+
+
 /* Run a given function on the given tiles. The function has to be
    link-able with your final executable and has to have only one 'void *'
    argument and return a 'void *' value. To have access to
@@ -388,7 +525,8 @@ gal_threads_spin_off(void *(*worker)(void *), void *caller_params,
       numbarriers = (numactions<numthreads ? numactions : numthreads) + 1;
       gal_threads_attr_barrier_init(&attr, &b, numbarriers);
 
-      /* Spin off the threads: */
+      /* Set the parameters of the threads that have actions (they are
+         the first 'numbarriers-1' threads). */
       for(i=0;i<numthreads;++i)
         if(indexs[i*thrdcols]!=GAL_BLANK_SIZE_T)
           {
@@ -396,16 +534,25 @@ gal_threads_spin_off(void *(*worker)(void *), void *caller_params,
             prm[i].b=&b;
             prm[i].params=caller_params;
             prm[i].indexs=&indexs[i*thrdcols];
-            err=pthread_create(&t, &attr, worker, &prm[i]);
-            if(err)
-              {
-                fprintf(stderr, "can't create thread %zu", i);
-                exit(EXIT_FAILURE);
-              }
           }
 
-      /* Wait for all threads to finish and free the spaces. */
-      pthread_barrier_wait(&b);
+      /* Run the worker on the persistent threads. If they are already in
+         use, spin off new threads. */
+      if( threads_pool_run(worker, prm, numbarriers-1)==0 )
+        {
+          for(i=0;i<numbarriers-1;++i)
+            {
+              err=pthread_create(&t, &attr, worker, &prm[i]);
+              if(err)
+                {
+                  fprintf(stderr, "can't create thread %zu", i);
+                  exit(EXIT_FAILURE);
+                }
+            }
+          pthread_barrier_wait(&b);
+        }
+
+      /* Free the spaces. */
       pthread_attr_destroy(&attr);
       pthread_barrier_destroy(&b);
     }
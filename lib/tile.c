@@ -1100,17 +1100,12 @@ gal_tile_full_permutation(struct gal_tile_two_layer_params *tl)
 
 
 
-/* Write one value for each tile into a file.
-
-   IMPORTANT: it is assumed that the values are in the same order as the
-   tiles.
-
-                      tile[i]  -->   tilevalues[i]                       */
-void
-gal_tile_full_values_write(gal_data_t *tilevalues,
-                           struct gal_tile_two_layer_params *tl,
-                           int withblank, char *filename,
-                           gal_fits_list_key_t *keys, char *program_string)
+/* Build the full-sized image (or permuted tile values) that should be
+   written for the given tile values. The output may be 'tilevalues'
+   itself, so it should only be freed when it is different. */
+static gal_data_t *
+tile_full_values_disp(gal_data_t *tilevalues,
+                      struct gal_tile_two_layer_params *tl, int withblank)
 {
   gal_data_t *disp;
 
@@ -1137,6 +1132,28 @@ gal_tile_full_values_write(gal_data_t *tilevalues,
     disp=gal_tile_block_write_const_value(tilevalues, tl->tiles,
                                           withblank, 0);
 
+  /* Return the dataset to write. */
+  return disp;
+}
+
+
+
+
+
+/* Write one value for each tile into a file.
+
+   IMPORTANT: it is assumed that the values are in the same order as the
+   tiles.
+
+                      tile[i]  -->   tilevalues[i]                       */
+void
+gal_tile_full_values_write(gal_data_t *tilevalues,
+                           struct gal_tile_two_layer_params *tl,
+                           int withblank, char *filename,
+                           gal_fits_list_key_t *keys, char *program_string)
+{
+  gal_data_t *disp=tile_full_values_disp(tilevalues, tl, withblank);
+
   /* Write the array as a file and then clean up (if necessary). */
   gal_fits_img_write(disp, filename, keys, program_string);
   if(disp!=tilevalues) gal_data_free(disp);
@@ -1146,6 +1163,24 @@ gal_tile_full_values_write(gal_data_t *tilevalues,
 
 
 
+/* Similar to 'gal_tile_full_values_write', but the writing is done in the
+   background with 'gal_fits_img_write_async'. */
+void
+gal_tile_full_values_write_async(gal_data_t *tilevalues,
+                                 struct gal_tile_two_layer_params *tl,
+                                 int withblank, char *filename,
+                                 gal_fits_list_key_t *keys,
+                                 char *program_string)
+{
+  gal_data_t *disp=tile_full_values_disp(tilevalues, tl, withblank);
+  gal_fits_img_write_async(disp, filename, keys, program_string,
+                           disp!=tilevalues);
+}
+
+
+
+
+
 /* Smooth the given values with a flat kernel of the given width. */
 gal_data_t *
 gal_tile_full_values_smooth(gal_data_t *tilevalues,
@@ -24,12 +24,16 @@ along with Gnuastro. If not, see <http://www.gnu.org/licenses/>.
 
 #include <math.h>
 #include <ctype.h>
+#include <float.h>
 #include <stdio.h>
 #include <errno.h>
 #include <error.h>
+#include <fcntl.h>
 #include <unistd.h>
 #include <string.h>
 #include <stdlib.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
 
 #include <gnuastro/txt.h>
 #include <gnuastro/list.h>
@@ -37,6 +41,7 @@ along with Gnuastro. If not, see <http://www.gnu.org/licenses/>.
 #include <gnuastro/blank.h>
 #include <gnuastro/table.h>
 #include <gnuastro/pointer.h>
+#include <gnuastro/threads.h>
 
 #include <gnuastro-internal/checkset.h>
 #include <gnuastro-internal/tableintern.h>
@@ -765,6 +770,82 @@ gal_txt_image_info(char *filename, gal_list_str_t *lines, size_t *numimg,
 /************************************************************************/
 /***************             Read a txt table             ***************/
 /************************************************************************/
+/* Parse a floating point number: this is the most common type of token in
+   astronomical tables and 'strtod' is relatively slow because it has to
+   account for all possible situations. When the full token is a simple
+   decimal number ('[+-]digits[.digits][(e|E)[+-]digits]') with at most
+   15 significant digits and a small exponent, both the significand and
+   the power of ten are exactly representable in double precision, so a
+   single multiplication or division gives the correctly rounded result
+   (same as 'strtod'). In any other case (for example 'nan', hexadecimal
+   numbers, more digits or '_h_m_s' coordinates), this function falls back
+   to 'strtod'. */
+static double
+txt_read_token_float(char *token, char **tailptr)
+{
+  static const double pow10[]={1e0,  1e1,  1e2,  1e3,  1e4,  1e5,  1e6,
+                               1e7,  1e8,  1e9,  1e10, 1e11, 1e12, 1e13,
+                               1e14, 1e15, 1e16, 1e17, 1e18, 1e19, 1e20,
+                               1e21, 1e22};
+  char *c=token;
+  double out;
+  uint64_t mant=0;
+  long exp10=0, e=0;
+  int neg=0, eneg=0;
+  size_t ndigits=0, nsig=0;
+
+#if FLT_EVAL_METHOD == 0
+  /* Sign. */
+  if(*c=='-' || *c=='+') neg = *c++=='-';
+
+  /* Integer part (leading zeros are not significant). */
+  for(; isdigit(*c); ++c, ++ndigits)
+    if(nsig || *c!='0')
+      {
+        if(++nsig<=15) mant=mant*10+(*c-'0');
+        else           ++exp10;
+      }
+
+  /* Fraction. */
+  if(*c=='.')
+    for(++c; isdigit(*c); ++c, ++ndigits)
+      {
+        if(nsig || *c!='0')
+          { if(++nsig<=15) { mant=mant*10+(*c-'0'); --exp10; } }
+        else --exp10;
+      }
+
+  /* Exponent. */
+  if( ndigits && (*c=='e' || *c=='E') )
+    {
+      ++c;
+      if(*c=='-' || *c=='+') eneg = *c++=='-';
+      if( !isdigit(*c) ) ndigits=0;
+      for(; isdigit(*c) && e<10000; ++c) e=e*10+(*c-'0');
+      exp10 += eneg ? -e : e;
+    }
+
+  /* Use the result if it was exact (for zero, the exponent is
+     irrelevant). */
+  if(mant==0) exp10=0;
+  if( ndigits && *c=='\0' && nsig<=15 && exp10>=-22 && exp10<=22 )
+    {
+      out = ( exp10<0
+              ? (double)mant / pow10[-exp10]
+              : (double)mant * pow10[exp10] );
+      *tailptr=c;
+      return neg ? -out : out;
+    }
+#endif
+
+  /* Not a simple number, use the C library. */
+  return strtod(token, tailptr);
+}
+
+
+
+
+
 static void
 txt_read_token(gal_data_t *data, gal_data_t *info, char *token,
                size_t i, char *filename, size_t lineno, size_t colnum)
@@ -879,7 +960,7 @@ txt_read_token(gal_data_t *data, gal_data_t *info, char *token,
              condition check (even '=='). If it isn't NaN, then we can
              compare the values. */
         case GAL_TYPE_FLOAT32:
-          f[i]=strtod(token, &tailptr);
+          f[i]=txt_read_token_float(token, &tailptr);
           if( (*tailptr=='h' || *tailptr=='d') && isdigit(*(tailptr+1)) )
             {
               f[i] = ( *tailptr=='h'
@@ -897,7 +978,7 @@ txt_read_token(gal_data_t *data, gal_data_t *info, char *token,
            in these cases, they are actually coordinates (RA for first, Dec
            for second). */
         case GAL_TYPE_FLOAT64:
-          d[i]=strtod(token, &tailptr);
+          d[i]=txt_read_token_float(token, &tailptr);
           if( (*tailptr=='h' || *tailptr=='d') && isdigit(*(tailptr+1)) )
             {
               d[i] = ( *tailptr=='h'
@@ -1028,9 +1109,10 @@ txt_fill(char *in_line, char **tokens, size_t maxcolnum,
       else
         {
           /* If we have reached the end of the line, then 'strtok_r' will
-             return a NULL pointer. */
-          tmpstr=strtok_r(n==1?line:NULL, GAL_TXT_DELIMITERS, &line);
-          gal_checkset_allocate_copy(tmpstr, &tokens[n]);
+             return a NULL pointer. Since 'strtok_r' has already put a
+             '\0' after the token, there is no need to copy it (the line
+             is a writable copy in any case). */
+          tokens[n]=strtok_r(n==1?line:NULL, GAL_TXT_DELIMITERS, &line);
           if(tokens[n]==NULL) {notenoughcols=1; break;}
         }
     }
@@ -1072,10 +1154,17 @@ txt_fill(char *in_line, char **tokens, size_t maxcolnum,
             "datasets acceptable", __func__);
     }
 
-  /* Clean up the strings of each token within the tokens array, and set
-     the freed pointers to NULL. */
-  for(i=0;i<maxcolnum+1;++i)
-    if(tokens[i]) {free(tokens[i]); tokens[i]=NULL;}
+  /* Clean up the strings of each token within the tokens array (only
+     string tokens are allocated, the rest point within the line), and set
+     the pointers to NULL. */
+  for(i=1;i<maxcolnum+1;++i)
+    if(tokens[i])
+      {
+        if(colinfo[format==TXT_FORMAT_TABLE ? i-1 : 0].type
+           == GAL_TYPE_STRING)
+          free(tokens[i]);
+        tokens[i]=NULL;
+      }
 
   /* Clean up. */
   if(inplace==0) free(aline);
@@ -1085,20 +1174,253 @@ txt_fill(char *in_line, char **tokens, size_t maxcolnum,
 
 
 
+/* Text tables are read in parallel: the file (memory-mapped) or list of
+   lines (from the standard input) is divided into contiguous chunks of
+   lines (chunks are aligned with new-line characters), and each thread
+   parses its chunks directly into the pre-allocated output columns. This
+   is done in two passes: in the first, each thread only counts the number
+   of lines and data rows of its chunk. This gives the line number (for
+   error messages) and output row of the first line in each chunk, used in
+   the second pass. */
+struct txt_read_params
+{
+  char          *filename;  /* Name of input file (or NULL).          */
+  char               *map;  /* Memory-mapped contents of the file.    */
+  size_t          *bstart;  /* Start byte of each chunk in 'map'.     */
+  gal_list_str_t **lstart;  /* First node of each chunk in 'lines'.   */
+  size_t        numchunks;  /* Number of chunks.                      */
+  gal_data_t        *info;  /* Information of all columns.            */
+  gal_data_t         *out;  /* Output dataset(s).                     */
+  size_t        maxcolnum;  /* Largest column number to read.         */
+  gal_data_t      *rowids;  /* Data rows to read (or NULL).           */
+  int              format;  /* Table or image.                        */
+  int               count;  /* ==1: Only count lines and data rows.   */
+  size_t         *numline;  /* Number of lines in each chunk.         */
+  size_t          *numrow;  /* Number of data rows in each chunk.     */
+};
+
+
+
+
+
+/* Index of the first element in the sorted 'rowids' that is larger or
+   equal to 'row'. */
+static size_t
+txt_read_rowids_start(gal_data_t *rowids, size_t row)
+{
+  size_t *r=rowids->array, low=0, high=rowids->size, mid;
+  while(low<high)
+    {
+      mid=low+(high-low)/2;
+      if(r[mid]<row) low=mid+1; else high=mid;
+    }
+  return low;
+}
+
+
+
+
+
+/* Put the next line of the memory-mapped file (within 'end') into 'buf'
+   as a string that always finishes with a new-line character (it may not
+   exist on the last line of a file), and return the start of the next
+   line. */
+static char *
+txt_read_line_from_map(char *start, char *end, char **buf, size_t *buflen)
+{
+  char *nl=memchr(start, '\n', end-start);
+  size_t len = nl ? nl-start+1 : end-start;
+
+  /* Make sure the buffer is large enough (+2 for a possibly added
+     new-line and '\0'). */
+  if(len+2>*buflen)
+    {
+      *buflen=len+2;
+      free(*buf);
+      *buf=gal_pointer_allocate(GAL_TYPE_UINT8, *buflen, 0, __func__,
+                                "buf");
+    }
+
+  /* Copy the line. */
+  memcpy(*buf, start, len);
+  if(nl==NULL) (*buf)[len++]='\n';
+  (*buf)[len]='\0';
+  return nl ? nl+1 : end;
+}
+
+
+
+
+
+static void *
+txt_read_worker(void *in_prm)
+{
+  /* Low-level definitions to be done first. */
+  struct gal_threads_params *tprm=(struct gal_threads_params *)in_prm;
+  struct txt_read_params *p=(struct txt_read_params *)tprm->params;
+
+  /* Subsequent definitions. */
+  gal_list_str_t *node;
+  char *line, *pos, *end, *buf=NULL, **tokens;
+  size_t i, c, n, buflen=0, lineno, datarow, rowind;
+  size_t *rows = p->rowids ? p->rowids->array : NULL;
+
+  /* Allocate the space to keep the pointers to each token in the line
+     (only necessary for reading). Note that the column numbers are
+     counted from one (unlike indexes that are counted from zero), so we
+     need 'maxcolnum+1' elements in the array of tokens. */
+  tokens=NULL;
+  if(p->count==0)
+    {
+      errno=0;
+      tokens=calloc(p->maxcolnum+1, sizeof *tokens);
+      if(tokens==NULL)
+        error(EXIT_FAILURE, errno, "%s: allocating %zu bytes for 'tokens'",
+              __func__, (p->maxcolnum+1)*sizeof *tokens);
+    }
+
+  /* Go over all the chunks of this thread. */
+  for(i=0; tprm->indexs[i]!=GAL_BLANK_SIZE_T; ++i)
+    {
+      /* Initialize the counters of this chunk. In the first pass,
+         'numline' and 'numrow' keep the number of lines/rows before each
+         chunk. */
+      c=tprm->indexs[i];
+      lineno  = p->count ? 0 : p->numline[c];
+      datarow = p->count ? 0 : p->numrow[c];
+      rowind  = ( p->rowids
+                  ? txt_read_rowids_start(p->rowids, datarow)
+                  : datarow );
+
+      /* Parse the lines of this chunk. */
+      n=0;
+      node = p->map ? NULL : p->lstart[c];
+      pos  = p->map ? p->map+p->bstart[c]   : NULL;
+      end  = p->map ? p->map+p->bstart[c+1] : NULL;
+      while( p->map ? pos<end : node!=p->lstart[c+1] )
+        {
+          /* Get the line. */
+          if(p->map) pos=txt_read_line_from_map(pos, end, &buf, &buflen);
+          line = p->map ? buf : node->v;
+          if(node) node=node->next;
+          ++lineno;
+
+          /* Only data rows are relevant. */
+          if( gal_txt_line_stat(line) != GAL_TXT_LINESTAT_DATAROW )
+            continue;
+
+          /* Read the line into the output (if necessary). */
+          if(p->count==0)
+            {
+              if( p->rowids && rowind==p->rowids->size ) break;
+              if( p->rowids==NULL || rows[rowind]==datarow )
+                txt_fill(line, tokens, p->maxcolnum, p->info, p->out,
+                         rowind++, p->filename, lineno, p->map!=NULL,
+                         p->format);
+            }
+          ++datarow;
+          ++n;
+        }
+
+      /* Keep the number of lines and rows when counting. */
+      if(p->count)
+        {
+          p->numline[c]=lineno;
+          p->numrow[c]=n;
+        }
+    }
+
+  /* Clean up, wait for all threads to finish and return. */
+  free(buf);
+  free(tokens);
+  if(tprm->b) pthread_barrier_wait(tprm->b);
+  return NULL;
+}
+
+
+
+
+
+/* Prepare the chunks within a memory-mapped file. Each chunk starts after
+   a new-line character. */
+static void
+txt_read_chunks_map(struct txt_read_params *p, size_t size,
+                    size_t numthreads)
+{
+  char *nl;
+  size_t c, b;
+
+  /* Don't use threads for small files (with less than 64KB in each
+     chunk). */
+  p->numchunks = size/65536+1 < numthreads ? size/65536+1 : numthreads;
+  p->bstart=gal_pointer_allocate(GAL_TYPE_SIZE_T, p->numchunks+1, 0,
+                                 __func__, "p->bstart");
+
+  /* Set the starting byte of each chunk. */
+  p->bstart[0]=0;
+  p->bstart[p->numchunks]=size;
+  for(c=1;c<p->numchunks;++c)
+    {
+      b = c*(size/p->numchunks);
+      if(b<p->bstart[c-1]) b=p->bstart[c-1];
+      else if(p->map[b-1]!='\n')
+        {
+          nl=memchr(p->map+b, '\n', size-b);
+          b = nl ? nl-p->map+1 : size;
+        }
+      p->bstart[c]=b;
+    }
+}
+
+
+
+
+
+/* Prepare the chunks within the list of lines. */
+static void
+txt_read_chunks_lines(struct txt_read_params *p, gal_list_str_t *lines,
+                      size_t numthreads)
+{
+  size_t c, i, num;
+  gal_list_str_t *tmp=lines;
+
+  /* Set the number of chunks. */
+  num=gal_list_str_number(lines);
+  p->numchunks = num/1000+1 < numthreads ? num/1000+1 : numthreads;
+  errno=0;
+  p->lstart=malloc( (p->numchunks+1) * sizeof *p->lstart );
+  if(p->lstart==NULL)
+    error(EXIT_FAILURE, errno, "%s: allocating %zu bytes for "
+          "'p->lstart'", __func__, (p->numchunks+1) * sizeof *p->lstart);
+
+  /* Set the first node of each chunk (the last element is NULL, the
+     'next' of the last node). */
+  for(c=0, i=0; c<p->numchunks; ++c)
+    {
+      for(; i<c*(num/p->numchunks); ++i) tmp=tmp->next;
+      p->lstart[c]=tmp;
+    }
+  p->lstart[p->numchunks]=NULL;
+}
+
+
+
+
+
+/* When 'rowids!=NULL', only the data rows within it (sorted and counting
+   from zero) will be read. */
 static gal_data_t *
 txt_read(char *filename, gal_list_str_t *lines, size_t *dsize,
-         gal_data_t *info, gal_list_sizet_t *indexll, size_t minmapsize,
-         int quietmmap, int format)
+         gal_data_t *info, gal_list_sizet_t *indexll, gal_data_t *rowids,
+         size_t numthreads, size_t minmapsize, int quietmmap, int format)
 {
-  FILE *fp;
-  int test;
-  char *line;
-  char **tokens;
-  gal_list_str_t *tmp;
-  gal_data_t *out=NULL;
+  int fd, test;
+  struct stat st;
+  size_t c, tmp, numline, numrow, ndim;
   gal_list_sizet_t *ind;
-  size_t one=1, maxcolnum=0, rowind=0, lineno=0, ndim;
-  size_t linelen=10;        /* 'linelen' will be increased by 'getline'. */
+  gal_data_t *out=NULL;
+  struct txt_read_params p={0};
+  size_t one=1, maxcolnum=0;
 
   /* 'filename' and 'lines' cannot both be non-NULL. */
   test = (filename!=NULL) + (lines!=NULL);
@@ -1107,15 +1429,6 @@ txt_read(char *filename, gal_list_str_t *lines, size_t *dsize,
           "arguments must be NULL, but they are both %s", __func__,
           test==2 ? "non-NULL" : "NULL");
 
-  /* Allocate the space necessary to keep a copy of each line as we parse
-     it. Note that 'getline' is going to later 'realloc' this space to fit
-     the line length. */
-  errno=0;
-  line=malloc(linelen*sizeof *line);
-  if(line==NULL)
-    error(EXIT_FAILURE, errno, "%s: allocating %zu bytes for 'line'",
-          __func__, linelen*sizeof *line);
-
   /* Allocate all the desired columns for output. We will be reading the
      text file line by line, and writing in the necessary values of each
      row individually. */
@@ -1171,53 +1484,81 @@ txt_read(char *filename, gal_list_str_t *lines, size_t *dsize,
             __func__, format);
     }
 
-  /* Allocate the space to keep the pointers to each token in the
-     line. This is done here to avoid having to allocate/free this array
-     for each line in 'txt_fill_columns'. Note that the column numbers are
-     counted from one (unlike indexes that are counted from zero), so we
-     need 'maxcolnum+1' elements in the array of tokens.*/
-  errno=0;
-  tokens=calloc(maxcolnum+1, sizeof *tokens);
-  if(tokens==NULL)
-    error(EXIT_FAILURE, errno, "%s: allocating %zu bytes for 'tokens'",
-          __func__, (maxcolnum+1)*sizeof *tokens);
-
+  /* Prepare the chunks of the input. */
   if(filename)
     {
-      /* Open the file. */
+      /* Open the file and map it into memory. */
       errno=0;
-      fp=fopen(filename, "r");
-      if(fp==NULL)
+      fd=open(filename, O_RDONLY);
+      if(fd==-1)
         error(EXIT_FAILURE, errno, "%s: couldn't open to read as a text "
               "table in %s", filename, __func__);
+      if( fstat(fd, &st) )
+        error(EXIT_FAILURE, errno, "%s: couldn't get the size in %s",
+              filename, __func__);
+      if(st.st_size)
+        {
+          p.map=mmap(NULL, st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+          if(p.map==MAP_FAILED)
+            error(EXIT_FAILURE, errno, "%s: couldn't be memory-mapped "
+                  "in %s", filename, __func__);
+          txt_read_chunks_map(&p, st.st_size, numthreads);
+        }
+      if( close(fd) )
+        error(EXIT_FAILURE, errno, "%s: couldn't close file after "
+              "memory-mapping in %s", filename, __func__);
+    }
+  else
+    txt_read_chunks_lines(&p, lines, numthreads);
 
-      /* Read the data columns. */
-      while( getline(&line, &linelen, fp) != -1 )
+  /* Read the data (if there is any). */
+  if(p.numchunks)
+    {
+      /* Parameters for the threads. */
+      p.out=out;
+      p.info=info;
+      p.format=format;
+      p.rowids=rowids;
+      p.filename=filename;
+      p.maxcolnum=maxcolnum;
+      p.numrow=gal_pointer_allocate(GAL_TYPE_SIZE_T, p.numchunks, 0,
+                                    __func__, "p.numrow");
+      p.numline=gal_pointer_allocate(GAL_TYPE_SIZE_T, p.numchunks, 0,
+                                     __func__, "p.numline");
+
+      /* First pass: count the lines and rows in each chunk (not needed
+         when there is only one chunk). */
+      if(p.numchunks>1)
         {
-          ++lineno;
-          if( gal_txt_line_stat(line) == GAL_TXT_LINESTAT_DATAROW )
-            txt_fill(line, tokens, maxcolnum, info, out, rowind++,
-                     filename, lineno, 1, format);
+          p.count=1;
+          gal_threads_spin_off(txt_read_worker, &p, p.numchunks,
+                               numthreads, minmapsize, quietmmap);
         }
+      else p.numline[0]=p.numrow[0]=0;
 
-      /* Clean up and close the file. */
-      errno=0;
-      if(fclose(fp))
-        error(EXIT_FAILURE, errno, "%s: couldn't close file after reading "
-              "ASCII table information in %s", filename, __func__);
-      free(line);
+      /* Change the counters to the number of lines and rows before each
+         chunk. */
+      numline=numrow=0;
+      for(c=0;c<p.numchunks;++c)
+        {
+          tmp=p.numline[c]; p.numline[c]=numline; numline+=tmp;
+          tmp=p.numrow[c];  p.numrow[c]=numrow;   numrow+=tmp;
+        }
+
+      /* Second pass: read the rows. */
+      p.count=0;
+      gal_threads_spin_off(txt_read_worker, &p, p.numchunks, numthreads,
+                           minmapsize, quietmmap);
+
+      /* Clean up. */
+      free(p.numrow);
+      free(p.numline);
     }
-  else
-    for(tmp=lines; tmp!=NULL; tmp=tmp->next)
-      {
-        ++lineno;
-        if( gal_txt_line_stat(tmp->v) == GAL_TXT_LINESTAT_DATAROW )
-          txt_fill(tmp->v, tokens, maxcolnum, info, out, rowind++,
-                   filename, lineno, 0, format);
-      }
 
   /* Clean up and return. */
-  free(tokens);
+  if(p.map) munmap(p.map, st.st_size);
+  if(p.bstart) free(p.bstart);
+  if(p.lstart) free(p.lstart);
   return out;
 }
 
@@ -1228,10 +1569,22 @@ txt_read(char *filename, gal_list_str_t *lines, size_t *dsize,
 gal_data_t *
 gal_txt_table_read(char *filename, gal_list_str_t *lines, size_t numrows,
                    gal_data_t *colinfo, gal_list_sizet_t *indexll,
+                   gal_data_t *rowids, size_t numthreads,
                    size_t minmapsize, int quietmmap)
 {
-  return txt_read(filename, lines, &numrows, colinfo, indexll, minmapsize,
-                  quietmmap, TXT_FORMAT_TABLE);
+  /* If only some rows are requested, the output will only have those
+     rows. */
+  if(rowids)
+    {
+      if(rowids->type!=GAL_TYPE_SIZE_T)
+        error(EXIT_FAILURE, 0, "%s: 'rowids' should have a type of "
+              "'size_t' (GAL_TYPE_SIZE_T)", __func__);
+      numrows=rowids->size;
+    }
+
+  /* Read the table. */
+  return txt_read(filename, lines, &numrows, colinfo, indexll, rowids,
+                  numthreads, minmapsize, quietmmap, TXT_FORMAT_TABLE);
 }
 
 
@@ -1250,8 +1603,8 @@ gal_txt_image_read(char *filename, gal_list_str_t *lines, size_t minmapsize,
   imginfo=gal_txt_image_info(filename, lines, &numimg, dsize);
 
   /* Read the table. */
-  img=txt_read(filename, lines, dsize, imginfo, indexll, minmapsize,
-               quietmmap, TXT_FORMAT_IMAGE);
+  img=txt_read(filename, lines, dsize, imginfo, indexll, NULL, 1,
+               minmapsize, quietmmap, TXT_FORMAT_IMAGE);
 
   /* Clean up and return. */
   gal_data_free(imginfo);
@@ -1481,35 +1834,336 @@ make_fmts_for_printf(gal_data_t *datall, int leftadjust, size_t *len)
 
 
 
+/* Plain-text tables are written in blocks of rows: each block is printed
+   into its own (re-usable) buffer and the buffers are then written to the
+   output in order. The blocks of each round are formatted in parallel, so
+   a round has (at most) one block for each thread.*/
+#define TXT_WRITE_BLOCKROWS 10000
+struct txt_write_buf
+{
+  char                 *s;  /* Allocated buffer.                      */
+  size_t              len;  /* Number of used bytes.                  */
+  size_t             size;  /* Number of allocated bytes.             */
+};
+
+struct txt_write_params
+{
+  gal_data_t       *input;  /* Input dataset(s).                      */
+  size_t          numcols;  /* Number of printed columns in a row.    */
+  char             **fmts;  /* Printf formats of each column.         */
+  uint8_t           *fast;  /* 0: printf, 1: fast, 2: fast with space.*/
+  size_t           *width;  /* Width of fast columns.                 */
+  size_t         firstrow;  /* First row of this round.               */
+  size_t          numrows;  /* Total number of rows.                  */
+  struct txt_write_buf *buf; /* Buffer for each block of the round.  */
+};
+
+
+
+
+
+/* Make sure there are at least 'need' free bytes in the buffer. */
 static void
-txt_print_value(FILE *fp, void *array, int type, size_t ind, char *fmt)
+txt_write_buf_ensure(struct txt_write_buf *b, size_t need)
 {
-  switch(type)
+  if(b->len+need<=b->size) return;
+  b->size = 2*(b->len+need) > 4096 ? 2*(b->len+need) : 4096;
+  errno=0;
+  b->s=realloc(b->s, b->size);
+  if(b->s==NULL)
+    error(EXIT_FAILURE, errno, "%s: allocating %zu bytes for buffer",
+          __func__, b->size);
+}
+
+
+
+
+
+/* Integer columns with a plain decimal format and strings (without a
+   precision) don't need the generality of 'printf': their value can be
+   directly copied into the buffer with the same left-adjusted padding. */
+static uint8_t
+txt_write_is_fast(gal_data_t *data, char *fmt)
+{
+  char conv;
+
+  /* The precision will add zeros (or truncate the string). */
+  if( strchr(fmt, '.') ) return 0;
+
+  switch(data->type)
     {
-      /* Numerical types. */
-    case GAL_TYPE_UINT8:   fprintf(fp, fmt, ((uint8_t *) array)[ind]); break;
-    case GAL_TYPE_INT8:    fprintf(fp, fmt, ((int8_t *)  array)[ind]); break;
-    case GAL_TYPE_UINT16:  fprintf(fp, fmt, ((uint16_t *)array)[ind]); break;
-    case GAL_TYPE_INT16:   fprintf(fp, fmt, ((int16_t *) array)[ind]); break;
-    case GAL_TYPE_UINT32:  fprintf(fp, fmt, ((uint32_t *)array)[ind]); break;
-    case GAL_TYPE_INT32:   fprintf(fp, fmt, ((int32_t *) array)[ind]); break;
-    case GAL_TYPE_UINT64:  fprintf(fp, fmt, ((uint64_t *)array)[ind]); break;
-    case GAL_TYPE_INT64:   fprintf(fp, fmt, ((int64_t *) array)[ind]); break;
-    case GAL_TYPE_FLOAT32: fprintf(fp, fmt, ((float *)   array)[ind]); break;
-    case GAL_TYPE_FLOAT64: fprintf(fp, fmt, ((double *)  array)[ind]); break;
-
-      /* Special consideration for strings. */
+    case GAL_TYPE_UINT8:  case GAL_TYPE_INT8:
+    case GAL_TYPE_UINT16: case GAL_TYPE_INT16:
+    case GAL_TYPE_UINT32: case GAL_TYPE_INT32:
+    case GAL_TYPE_UINT64: case GAL_TYPE_INT64:
+      conv=fmt[ strcspn(fmt, "duoxX") ];
+      return conv=='d' || conv=='u';
     case GAL_TYPE_STRING:
-      if( !strcmp( ((char **)array)[ind], GAL_BLANK_STRING ) )
-        fprintf(fp, fmt, GAL_BLANK_STRING);
-      else
-        fprintf(fp, fmt, ((char **)array)[ind]);
-      break;
-
+      return 1;
     default:
-      error(EXIT_FAILURE, 0, "%s: type code %d not recognized",
-            __func__, type);
+      return 0;
+    }
+}
+
+
+
+
+
+/* Put the given string (with length 'len') into the buffer, left-adjusted
+   within the given width and followed by a space if necessary (all but
+   the last column, which has no width and no trailing space). */
+static void
+txt_write_fast_str(struct txt_write_buf *b, char *str, size_t len,
+                   size_t width, uint8_t space)
+{
+  size_t full = len>width ? len : width;
+
+  txt_write_buf_ensure(b, full+space+1);
+  memcpy(b->s+b->len, str, len);
+  if(full>len) memset(b->s+b->len+len, ' ', full-len);
+  b->len+=full;
+  if(space) b->s[b->len++]=' ';
+}
+
+
+
+
+
+/* Write an integer into the buffer (identical to 'printf' with a '%-Nd',
+   '%-Nu', '%d' or '%u' format). */
+static void
+txt_write_fast_int(struct txt_write_buf *b, uint64_t mag, int negative,
+                   size_t width, uint8_t space)
+{
+  char tmp[24], *p=tmp+sizeof tmp;
+
+  do { *--p = '0' + mag%10; mag/=10; } while(mag);
+  if(negative) *--p='-';
+  txt_write_fast_str(b, p, tmp+sizeof tmp-p, width, space);
+}
+
+
+
+
+
+/* Signed integers: the magnitude is found in unsigned arithmetic so the
+   most negative 64-bit integer is also written correctly. */
+static void
+txt_write_fast_sint(struct txt_write_buf *b, int64_t v, size_t width,
+                    uint8_t space)
+{
+  txt_write_fast_int(b, v<0 ? -(uint64_t)v : (uint64_t)v, v<0, width,
+                     space);
+}
+
+
+
+
+
+/* Print one value into the buffer. */
+static void
+txt_write_value(struct txt_write_buf *b, void *array, int type, size_t ind,
+                char *fmt, uint8_t fast, size_t width)
+{
+  int n=0;
+  char *str;
+  size_t avail;
+  uint8_t space = fast==2;
+
+  /* Fast integers and strings. */
+  if(fast && !( type==GAL_TYPE_STRING && ((char **)array)[ind]==NULL ))
+    switch(type)
+      {
+      case GAL_TYPE_UINT8:
+        txt_write_fast_int(b, ((uint8_t  *)array)[ind], 0, width, space);
+        return;
+      case GAL_TYPE_UINT16:
+        txt_write_fast_int(b, ((uint16_t *)array)[ind], 0, width, space);
+        return;
+      case GAL_TYPE_UINT32:
+        txt_write_fast_int(b, ((uint32_t *)array)[ind], 0, width, space);
+        return;
+      case GAL_TYPE_UINT64:
+        txt_write_fast_int(b, ((uint64_t *)array)[ind], 0, width, space);
+        return;
+      case GAL_TYPE_INT8:
+        txt_write_fast_sint(b, ((int8_t  *)array)[ind], width, space);
+        return;
+      case GAL_TYPE_INT16:
+        txt_write_fast_sint(b, ((int16_t *)array)[ind], width, space);
+        return;
+      case GAL_TYPE_INT32:
+        txt_write_fast_sint(b, ((int32_t *)array)[ind], width, space);
+        return;
+      case GAL_TYPE_INT64:
+        txt_write_fast_sint(b, ((int64_t *)array)[ind], width, space);
+        return;
+      case GAL_TYPE_STRING:
+        str=((char **)array)[ind];
+        txt_write_fast_str(b, str, strlen(str), width, space);
+        return;
+      default:
+        error(EXIT_FAILURE, 0, "%s: a bug! Please contact us at %s to "
+              "fix the problem. Type code %d is not recognized for the "
+              "fast path", __func__, PACKAGE_BUGREPORT, type);
+      }
+  /* All other formats go through 'snprintf'. If the buffer isn't large
+     enough, it will be enlarged and the value printed again. */
+  txt_write_buf_ensure(b, 64);
+  do
+    {
+      avail=b->size-b->len;
+      str=b->s+b->len;
+      switch(type)
+        {
+        case GAL_TYPE_UINT8:
+          n=snprintf(str, avail, fmt, ((uint8_t *) array)[ind]); break;
+        case GAL_TYPE_INT8:
+          n=snprintf(str, avail, fmt, ((int8_t *)  array)[ind]); break;
+        case GAL_TYPE_UINT16:
+          n=snprintf(str, avail, fmt, ((uint16_t *)array)[ind]); break;
+        case GAL_TYPE_INT16:
+          n=snprintf(str, avail, fmt, ((int16_t *) array)[ind]); break;
+        case GAL_TYPE_UINT32:
+          n=snprintf(str, avail, fmt, ((uint32_t *)array)[ind]); break;
+        case GAL_TYPE_INT32:
+          n=snprintf(str, avail, fmt, ((int32_t *) array)[ind]); break;
+        case GAL_TYPE_UINT64:
+          n=snprintf(str, avail, fmt, ((uint64_t *)array)[ind]); break;
+        case GAL_TYPE_INT64:
+          n=snprintf(str, avail, fmt, ((int64_t *) array)[ind]); break;
+        case GAL_TYPE_FLOAT32:
+          n=snprintf(str, avail, fmt, ((float *)   array)[ind]); break;
+        case GAL_TYPE_FLOAT64:
+          n=snprintf(str, avail, fmt, ((double *)  array)[ind]); break;
+        case GAL_TYPE_STRING:
+          n=snprintf(str, avail, fmt, ((char **)   array)[ind]); break;
+        default:
+          error(EXIT_FAILURE, 0, "%s: type code %d not recognized",
+                __func__, type);
+        }
+      if(n<0)
+        error(EXIT_FAILURE, errno, "%s: printing value %zu", __func__,
+              ind);
+      if((size_t)n>=avail) txt_write_buf_ensure(b, n+1);
     }
+  while((size_t)n>=avail);
+  b->len+=n;
+}
+
+
+
+
+
+/* Format the rows of each block into its buffer. */
+static void *
+txt_write_worker(void *in_prm)
+{
+  /* Low-level definitions to be done first. */
+  struct gal_threads_params *tprm=(struct gal_threads_params *)in_prm;
+  struct txt_write_params *p=(struct txt_write_params *)tprm->params;
+
+  /* Subsequent definitions. */
+  gal_data_t *data;
+  struct txt_write_buf *b;
+  size_t i, j, c, r, start, end;
+  gal_data_t *in=p->input;
+
+  /* Go over all the blocks of this thread. */
+  for(i=0; tprm->indexs[i]!=GAL_BLANK_SIZE_T; ++i)
+    {
+      /* Rows of this block (the buffer is re-used between rounds). */
+      b=&p->buf[ tprm->indexs[i] ];
+      b->len=0;
+      start = p->firstrow + tprm->indexs[i]*TXT_WRITE_BLOCKROWS;
+      end = ( start+TXT_WRITE_BLOCKROWS < p->numrows
+              ? start+TXT_WRITE_BLOCKROWS : p->numrows );
+
+      /* Print the rows. */
+      for(r=start;r<end;++r)
+        {
+          if(in->ndim==1)
+            for(c=0, data=in; data!=NULL; data=data->next, ++c)
+              txt_write_value(b, data->array, data->type, r,
+                              p->fmts[c*FMTS_COLS], p->fast[c],
+                              p->width[c]);
+          else
+            for(j=0;j<p->numcols;++j)
+              txt_write_value(b, in->array, in->type, r*p->numcols+j,
+                              p->fmts[0], p->fast[0], 0);
+          txt_write_buf_ensure(b, 1);
+          b->s[b->len++]='\n';
+        }
+    }
+
+  /* Wait for all threads to finish and return. */
+  if(tprm->b) pthread_barrier_wait(tprm->b);
+  return NULL;
+}
+
+
+
+
+
+/* Print all the rows of the dataset into the output stream. */
+static void
+txt_write_rows(FILE *fp, gal_data_t *input, char **fmts, size_t num,
+               size_t numthreads)
+{
+  gal_data_t *data;
+  size_t c, i, numblocks, nb;
+  struct txt_write_params p;
+
+  /* Basic settings. */
+  p.fmts=fmts;
+  p.input=input;
+  p.numrows = input->ndim==1 ? input->size : input->dsize[0];
+  p.numcols = input->ndim==1 ? num : input->dsize[1];
+  numblocks = ( p.numrows + TXT_WRITE_BLOCKROWS - 1 ) / TXT_WRITE_BLOCKROWS;
+  if(numthreads==0) numthreads=1;
+  nb = numthreads<numblocks ? numthreads : numblocks;
+  if(nb==0) return;
+
+  /* See which columns can be printed without 'printf'. The format of the
+     last column has no width (and a 2D dataset only has one format). */
+  p.fast=gal_pointer_allocate(GAL_TYPE_UINT8, num, 0, __func__, "p.fast");
+  p.width=gal_pointer_allocate(GAL_TYPE_SIZE_T, num, 0, __func__,
+                               "p.width");
+  for(c=0, data=input; data!=NULL; data=data->next, ++c)
+    {
+      p.fast[c] = ( txt_write_is_fast(data, fmts[c*FMTS_COLS])
+                    ? (data->next ? 2 : 1) : 0 );
+      p.width[c] = data->next ? data->disp_width : 0;
+    }
+
+  /* Buffers of each block in a round. */
+  errno=0;
+  p.buf=calloc(nb, sizeof *p.buf);
+  if(p.buf==NULL)
+    error(EXIT_FAILURE, errno, "%s: allocating %zu bytes for 'p.buf'",
+          __func__, nb*sizeof *p.buf);
+
+  /* Format each round in parallel and write its buffers in order. */
+  for(p.firstrow=0; p.firstrow<p.numrows;
+      p.firstrow+=nb*TXT_WRITE_BLOCKROWS)
+    {
+      numblocks = ( p.numrows - p.firstrow + TXT_WRITE_BLOCKROWS - 1 )
+                  / TXT_WRITE_BLOCKROWS;
+      if(numblocks>nb) numblocks=nb;
+      gal_threads_spin_off(txt_write_worker, &p, numblocks,
+                           numthreads<numblocks ? numthreads : numblocks,
+                           input->minmapsize, input->quietmmap);
+      for(i=0;i<numblocks;++i)
+        if( fwrite(p.buf[i].s, 1, p.buf[i].len, fp)!=p.buf[i].len )
+          error(EXIT_FAILURE, errno, "%s: couldn't write %zu bytes",
+                __func__, p.buf[i].len);
+    }
+
+  /* Clean up. */
+  for(i=0;i<nb;++i) free(p.buf[i].s);
+  free(p.width);
+  free(p.fast);
+  free(p.buf);
 }
 
 
@@ -1659,12 +2313,12 @@ txt_write_keys(FILE *fp, struct gal_fits_list_key_t **keylist)
 void
 gal_txt_write(gal_data_t *input, struct gal_fits_list_key_t **keylist,
               gal_list_str_t *comment, char *filename,
-              uint8_t colinfoinstdout)
+              uint8_t colinfoinstdout, size_t numthreads)
 {
   FILE *fp;
   char **fmts;
   gal_list_str_t *strt;
-  size_t i, j, num=0, fmtlen;
+  size_t i, num=0, fmtlen;
   gal_data_t *data, *next2d=NULL;
 
   /* Make sure input is valid. */
@@ -1741,36 +2395,8 @@ gal_txt_write(gal_data_t *input, struct gal_fits_list_key_t **keylist,
   if(filename ? 1 : colinfoinstdout)
     txt_write_metadata(fp, input, fmts);
 
-  /* Print the dataset */
-  switch(input->ndim)
-    {
-    case 1:
-      for(i=0;i<input->size;++i)                        /* Row.    */
-        {
-          j=0;
-          for(data=input;data!=NULL;data=data->next)    /* Column. */
-            txt_print_value(fp, data->array, data->type, i,
-                            fmts[j++ * FMTS_COLS]);
-          fprintf(fp, "\n");
-        }
-      break;
-
-
-    case 2:
-      for(i=0;i<input->dsize[0];++i)
-        {
-          for(j=0;j<input->dsize[1];++j)
-            txt_print_value(fp, input->array, input->type,
-                            i*input->dsize[1]+j, fmts[0]);
-          fprintf(fp, "\n");
-        }
-      break;
-
-
-    default:
-      error(EXIT_FAILURE, 0, "%s: a bug! input->ndim=%zu is not recognized",
-            __func__, input->ndim);
-    }
+  /* Print the dataset. */
+  txt_write_rows(fp, input, fmts, num, numthreads);
 
 
   /* Clean up. */
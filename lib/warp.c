@@ -153,7 +153,7 @@ warp_wcsalign_init_output_from_params(gal_warp_wcsalign_t *wa)
 
   /* Calculate the outer boundary of the input. */
   pcrn=warp_alloc_perimeter(input);
-  converted=gal_wcs_img_to_world(pcrn, iwcs, 0);
+  converted=gal_wcs_img_to_world(pcrn, iwcs, 0, 1);
 
   /* Get the minimum/maximum of the outer boundary. */
   x=converted->array; y=converted->next->array;
@@ -181,7 +181,7 @@ warp_wcsalign_init_output_from_params(gal_warp_wcsalign_t *wa)
   xkcoords[4]=center[0];  ykcoords[4]=center[1];  /* Image center */
 
   /* Convert to pixel coords */
-  gal_wcs_world_to_img(kcoords, rwcs, 1);
+  gal_wcs_world_to_img(kcoords, rwcs, 1, 1);
 
   /* Determine output image size */
   if( wa->widthinpix )
@@ -764,8 +764,8 @@ warp_wcsalign_init_convert(void *in_prm)
   gal_list_data_reverse(&vertices); /* '_add' is last-in-first-out. */
 
   /* Convert the coordinates. */
-  gal_wcs_img_to_world(vertices, owcs, 1);
-  gal_wcs_world_to_img(vertices, iwcs,  1);
+  gal_wcs_img_to_world(vertices, owcs, 1, 1);
+  gal_wcs_world_to_img(vertices, iwcs,  1, 1);
 
   /* Clean up: since the 'array' pointer is within a larger allocated
      array, we shouldn't free it when freeing the table, so we'll set it to
@@ -1175,7 +1175,7 @@ gal_warp_pixelarea(gal_warp_wcsalign_t *wa)
   /* Create the vertices based on the edgesampling value. */
   warp_wcsalign_init_vertices(wa);
   warp_wcsalign_init_internals(wa);
-  gal_wcs_img_to_world(wa->vertices, input->wcs, 1);
+  gal_wcs_img_to_world(wa->vertices, input->wcs, 1, wa->numthreads);
 
   /* Calculate pixel area on WCS and write to output. */
   gal_threads_spin_off(warp_pixelarea_onthread, wa, wa->output->size,
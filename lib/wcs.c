@@ -39,11 +39,13 @@ along with Gnuastro. If not, see <http://www.gnu.org/licenses/>.
 #include <gnuastro/tile.h>
 #include <gnuastro/fits.h>
 #include <gnuastro/pointer.h>
+#include <gnuastro/threads.h>
 #include <gnuastro/dimension.h>
 #include <gnuastro/statistics.h>
 #include <gnuastro/permutation.h>
 
 #include <gnuastro-internal/checkset.h>
+#include <gnuastro-internal/server.h>
 
 #if GAL_CONFIG_HAVE_WCSLIB_DIS_H
 #include <wcslib/dis.h>
@@ -142,33 +144,43 @@ wcs_use_cd_for_distortion(struct wcsprm *wcs)
 
 
 
-/* Read the WCS information from the header. Unfortunately, WCS lib is
-   not thread safe, so it needs a mutex. In case you are not using
-   multiple threads, just pass a NULL pointer as the mutex.
+/* Read all the header keywords of the current HDU into one string. In
+   case the user has asked to limit the HDU keyword cards to use for WCS
+   reading, also count comment/history/empty lines (so the lines here
+   correspond to the output of 'astfits image.fits -h1'). But if no
+   limitation is requested, avoid those lines to make the processing
+   easier for WCSLIB. */
+static char *
+wcs_read_header(fitsfile *fptr, size_t hstartwcs, size_t hendwcs,
+                int *nkeys)
+{
+  int status=0;
+  char *fullheader;
+  int nocomments = hendwcs>hstartwcs ? 0 : 1;
 
-   After you finish with this WCS, you should free the space with:
+  /* CFITSIO function: */
+  if( fits_hdr2str(fptr, nocomments, NULL, 0, &fullheader,
+                   nkeys, &status) )
+    gal_fits_io_error(status, NULL);
+  return fullheader;
+}
 
-   status = wcsvfree(&nwcs,&wcs);
 
-   If the WCS structure is not recognized, then this function will
-   return a NULL pointer for the wcsprm structure and a zero for
-   nwcs. It will also report the fact to the user in stderr.
 
-   ===================================
-   WARNING: wcspih IS NOT THREAD SAFE!
-   ===================================
-   Don't call this function within a thread or use a mutex.
-*/
-struct wcsprm *
-gal_wcs_read_fitsptr(fitsfile *fptr, int linearmatrix, size_t hstartwcs,
-                     size_t hendwcs, int *nwcs)
+
+
+/* Parse the header string (from 'wcs_read_header') into the WCS
+   structure. Note that the string may be modified. */
+static struct wcsprm *
+wcs_read_from_header(char *fullheader, int nkeys, int linearmatrix,
+                     size_t hstartwcs, size_t hendwcs, int *nwcs)
 {
   /* Declaratins: */
+  int status;
   size_t i, fulllen;
-  int nkeys=0, status=0;
-  int sumcheck, nocomments;
+  int sumcheck;
   struct wcsprm *wcs=NULL;
-  char *fullheader, *to, *from;
+  char *to, *from;
   int fixstatus[NWCSFIX]={0};/* For the various wcsfix checks.          */
   int relax    = WCSHDR_all; /* Macro: use all informal WCS extensions. */
   int ctrl     = 0;          /* Don't report why a keyword wasn't used. */
@@ -177,18 +189,6 @@ gal_wcs_read_fitsptr(fitsfile *fptr, int linearmatrix, size_t hstartwcs,
   void *fixnaxis = NULL;     /* For now disable cylfix() with this      */
                              /* (because it depends on image size).     */
 
-  /* In case the user has asked to limit the HDU keyword cards to use for
-     WCS reading, also count comment/history/empty lines (so the lines here
-     correspond to the output of 'astfits image.fits -h1'). But if no
-     limitation is requested, avoid those lines to make the processing
-     easier for WCSLIB. */
-  nocomments = hendwcs>hstartwcs ? 0 : 1;
-
-  /* CFITSIO function: */
-  if( fits_hdr2str(fptr, nocomments, NULL, 0, &fullheader,
-                   &nkeys, &status) )
-    gal_fits_io_error(status, NULL);
-
   /* Only consider the header keywords in the current range: */
   if(hendwcs>hstartwcs)
     {
@@ -389,8 +389,45 @@ gal_wcs_read_fitsptr(fitsfile *fptr, int linearmatrix, size_t hstartwcs,
     gal_wcs_to_cd(wcs);
   else gal_wcs_decompose_pc_cdelt(wcs);
 
+  /* Return the WCS structure. */
+  return wcs;
+}
+
+
+
+
+
+/* Read the WCS information from the header. Unfortunately, WCS lib is
+   not thread safe, so it needs a mutex. In case you are not using
+   multiple threads, just pass a NULL pointer as the mutex.
+
+   After you finish with this WCS, you should free the space with:
+
+   status = wcsvfree(&nwcs,&wcs);
+
+   If the WCS structure is not recognized, then this function will
+   return a NULL pointer for the wcsprm structure and a zero for
+   nwcs. It will also report the fact to the user in stderr.
+
+   ===================================
+   WARNING: wcspih IS NOT THREAD SAFE!
+   ===================================
+   Don't call this function within a thread or use a mutex.
+*/
+struct wcsprm *
+gal_wcs_read_fitsptr(fitsfile *fptr, int linearmatrix, size_t hstartwcs,
+                     size_t hendwcs, int *nwcs)
+{
+  int nkeys=0, status=0;
+  struct wcsprm *wcs;
+  char *fullheader;
+
+  /* Read the header keywords and parse them. */
+  fullheader=wcs_read_header(fptr, hstartwcs, hendwcs, &nkeys);
+  wcs=wcs_read_from_header(fullheader, nkeys, linearmatrix, hstartwcs,
+                           hendwcs, nwcs);
+
   /* Clean up and return. */
-  status=0;
   if (fits_free_memory(fullheader, &status) )
     gal_fits_io_error(status, "problem in freeing the memory used to "
                       "keep all the headers");
@@ -405,24 +442,55 @@ struct wcsprm *
 gal_wcs_read(char *filename, char *hdu, int linearmatrix,
              size_t hstartwcs, size_t hendwcs, int *nwcs)
 {
-  int status=0;
+  size_t size;
   fitsfile *fptr;
   struct wcsprm *wcs;
+  int nkeys=0, status=0;
+  char *kind, *cached, *fullheader;
 
   /* Make sure we are dealing with a FITS file. */
   if( gal_fits_file_recognized(filename) == 0 )
     return NULL;
 
-  /* Check HDU for realistic conditions: */
+  /* When running under a server, the header may already be cached (the
+     number of keywords is kept before the string). */
+  kind = hendwcs>hstartwcs ? "wcs-header-full" : "wcs-header";
+  cached=gal_server_cache_find(kind, filename, hdu, &size);
+  if(cached)
+    {
+      memcpy(&nkeys, cached, sizeof nkeys);
+      wcs=wcs_read_from_header(cached+sizeof nkeys, nkeys, linearmatrix,
+                               hstartwcs, hendwcs, nwcs);
+      free(cached);
+      return wcs;
+    }
+
+  /* Check HDU for realistic conditions and read its keywords. */
   fptr=gal_fits_hdu_open_format(filename, hdu, 0);
+  fullheader=wcs_read_header(fptr, hstartwcs, hendwcs, &nkeys);
+  fits_close_file(fptr, &status);
+  gal_fits_io_error(status, NULL);
+
+  /* Keep the header for the next programs of the server (if any). */
+  if( gal_server_served() )
+    {
+      size=sizeof nkeys+strlen(fullheader)+1;
+      cached=gal_pointer_allocate(GAL_TYPE_UINT8, size, 0, __func__,
+                                  "cached");
+      memcpy(cached, &nkeys, sizeof nkeys);
+      strcpy(cached+sizeof nkeys, fullheader);
+      gal_server_cache_add(kind, filename, hdu, cached, size);
+      free(cached);
+    }
 
   /* Read the WCS information: */
-  wcs=gal_wcs_read_fitsptr(fptr, linearmatrix, hstartwcs,
+  wcs=wcs_read_from_header(fullheader, nkeys, linearmatrix, hstartwcs,
                            hendwcs, nwcs);
 
-  /* Close the FITS file and return. */
-  fits_close_file(fptr, &status);
-  gal_fits_io_error(status, NULL);
+  /* Clean up and return. */
+  if (fits_free_memory(fullheader, &status) )
+    gal_fits_io_error(status, "problem in freeing the memory used to "
+                      "keep all the headers");
   return wcs;
 }
 
@@ -2133,7 +2201,7 @@ gal_wcs_coverage(char *filename, char *hdu, size_t *ondim,
   */
 
   /* Convert to the world coordinate system. */
-  gal_wcs_img_to_world(coords, wcs, 1);
+  gal_wcs_img_to_world(coords, wcs, 1, 1);
 
   /* For a check:
   printf("\nWORLD COORDINATES:\n");
@@ -2261,13 +2329,11 @@ gal_wcs_coverage(char *filename, char *hdu, size_t *ondim,
 /**************************************************************/
 /* Some sanity checks for the WCS conversion functions. */
 static void
-wcs_convert_sanity_check_alloc(gal_data_t *coords, struct wcsprm *wcs,
-                               const char *func, int **stat, double **phi,
-                               double **theta, double **world,
-                               double **pixcrd, double **imgcrd)
+wcs_convert_sanity_check(gal_data_t *coords, struct wcsprm *wcs,
+                         const char *func)
 {
   gal_data_t *tmp;
-  size_t ndim=0, firstsize=0, size=coords->size;
+  size_t ndim=0, firstsize=0;
 
   /* Make sure a WCS structure is actually given. */
   if(wcs==NULL)
@@ -2305,52 +2371,6 @@ wcs_convert_sanity_check_alloc(gal_data_t *coords, struct wcsprm *wcs,
     error(EXIT_FAILURE, 0, "%s: the number of input coordinates (%zu) does "
           "not match the dimensions of the input WCS structure (%d)", func,
           ndim, wcs->naxis);
-
-  /* Allocate all the necessary arrays. */
-  *phi    = gal_pointer_allocate( GAL_TYPE_FLOAT64, size,      0, __func__,
-                                  "phi");
-  *stat   = gal_pointer_allocate( GAL_TYPE_INT,     size,      1, __func__,
-                                  "stat");
-  *theta  = gal_pointer_allocate( GAL_TYPE_FLOAT64, size,      0, __func__,
-                                  "theta");
-  *world  = gal_pointer_allocate( GAL_TYPE_FLOAT64, ndim*size, 0, __func__,
-                                  "world");
-  *imgcrd = gal_pointer_allocate( GAL_TYPE_FLOAT64, ndim*size, 0, __func__,
-                                  "imgcrd");
-  *pixcrd = gal_pointer_allocate( GAL_TYPE_FLOAT64, ndim*size, 0, __func__,
-                                  "pixcrd");
-}
-
-
-
-
-
-/* In Gnuastro, each column (coordinate for WCS conversion) is treated as a
-   separate array in a 'gal_data_t' that are linked through a linked
-   list. But in WCSLIB, the input is a single array (with multiple
-   columns). This function will convert between the two. */
-static void
-wcs_convert_list_to_from_array(gal_data_t *list, double *array, int *stat,
-                               size_t ndim, int to0from1)
-{
-  size_t i, d=0;
-  gal_data_t *tmp;
-
-  for(tmp=list; tmp!=NULL; tmp=tmp->next)
-    {
-      /* Put all this coordinate's values into the single array that is
-         input into or output from WCSLIB. */
-      for(i=0;i<list->size;++i)
-        {
-          if(to0from1)
-            ((double *)(tmp->array))[i] = stat[i] ? NAN : array[i*ndim+d];
-          else
-            array[i*ndim+d] = ((double *)(tmp->array))[i];
-        }
-
-      /* Increment the dimension. */
-      ++d;
-    }
 }
 
 
@@ -2379,152 +2399,373 @@ wcs_convert_prepare_out(gal_data_t *coords, struct wcsprm *wcs, int inplace)
 
 
 
-/* Convert world coordinates to image coordinates given the input WCS
-   structure. The input must be a linked list of data structures of float64
-   ('double') type. The top element of the linked list must be the first
-   coordinate and etc. If 'inplace' is non-zero, then the output will be
-   written into the input's allocated space. */
-gal_data_t *
-gal_wcs_world_to_img(gal_data_t *coords, struct wcsprm *wcs, int inplace)
+/* Parameters of the (threaded) conversion. The coordinates are converted
+   in blocks of 'WCS_CONVERT_BLOCK' coordinates, so the temporary arrays
+   that WCSLIB needs are never larger than one block (in each thread). */
+#define WCS_CONVERT_BLOCK 4096
+struct wcs_convert_params
 {
-  gal_data_t *out;
-  int *stat=NULL, ncoord=coords->size, nelem;
-  double *phi=NULL, *theta=NULL, *world=NULL, *pixcrd=NULL, *imgcrd=NULL;
-
-  /* It can happen that the input datasets are empty. In this case, simply
-     return them. */
-  if(coords->size==0 || coords->array==NULL)
+  int            toimg;  /* ==1: world to image, ==0: image to world. */
+  size_t          ndim;  /* Number of dimensions.                     */
+  size_t          size;  /* Number of coordinates.                    */
+  double          **in;  /* Array of each input coordinate.           */
+  double         **out;  /* Array of each output coordinate.          */
+  struct wcsprm  **wcs;  /* WCS structure for each thread.            */
+
+  /* For the fast TAN conversion (see 'wcs_convert_tan_check'). */
+  int          fasttan;  /* ==1: Use the fast TAN conversion.         */
+  size_t      lng, lat;  /* Celestial axes (longitude and latitude).  */
+  double      crpix[2];  /* Reference pixel (in order of lng, lat).   */
+  double     matrix[4];  /* Pixel to intermediate ('CDELTi * PCi_j'). */
+  double    inverse[4];  /* Inverse of 'matrix'.                      */
+  double      euler[5];  /* Euler angles of the celestial rotation.   */
+  double            r0;  /* Radius of the generating sphere.          */
+  int           bounds;  /* Bounds checking of the projection.        */
+};
+
+
+
+
+
+/* Undistorted 2D celestial WCS with the gnomonic (TAN) projection is the
+   most common case in astronomical imaging. In this case, the conversion
+   only needs a 2x2 linear transformation, the projection and a spherical
+   rotation; so it can be done directly (within each coordinate's loop),
+   without the generic machinery of WCSLIB (and its temporary arrays). The
+   formulae are the same as WCSLIB's 'linp2x', 'tanx2s' and 'sphx2s' (and
+   their inverses), using the parameters that 'wcsset' has already
+   calculated. */
+static void
+wcs_convert_tan_check(struct wcsprm *wcs, struct wcs_convert_params *cp)
+{
+  size_t i, j, ax[2];
+  double det, *pc=wcs->pc, *cdelt=wcs->cdelt;
+
+  /* Check if the WCS is suitable. */
+  cp->fasttan=0;
+  if( wcs->naxis!=2 || wcs->lng<0 || wcs->lat<0
+      || wcs->lin.dispre || wcs->lin.disseq
+      || wcs->cel.offset || wcs->cel.prj.x0!=0.0 || wcs->cel.prj.y0!=0.0
+      || strcmp(wcs->cel.prj.code, "TAN") )
+    return;
+
+  /* The linear transformation (for the celestial axes in order of
+     longitude and latitude) and its inverse. */
+  ax[0]=cp->lng=wcs->lng;
+  ax[1]=cp->lat=wcs->lat;
+  for(i=0;i<2;++i)
     {
-      if(inplace) return coords;
-      else error(EXIT_FAILURE, 0, "%s: a bug! Please contact us at "
-                 "'%s' to fix the problem. The input has no data and "
-                 "'inplace' is not called", __func__, PACKAGE_BUGREPORT);
+      cp->crpix[i]=wcs->crpix[ax[i]];
+      for(j=0;j<2;++j)
+        cp->matrix[i*2+j] = cdelt[ax[i]] * pc[ ax[i]*2 + ax[j] ];
     }
+  det = cp->matrix[0]*cp->matrix[3] - cp->matrix[1]*cp->matrix[2];
+  if(det==0.0) return;
+  cp->inverse[0] =  cp->matrix[3]/det;
+  cp->inverse[1] = -cp->matrix[1]/det;
+  cp->inverse[2] = -cp->matrix[2]/det;
+  cp->inverse[3] =  cp->matrix[0]/det;
+
+  /* Parameters of the projection and celestial rotation. */
+  for(i=0;i<5;++i) cp->euler[i]=wcs->cel.euler[i];
+  cp->bounds=wcs->cel.prj.bounds;
+  cp->r0=wcs->cel.prj.r0;
+  cp->fasttan=1;
+}
 
 
-  /* Some sanity checks. */
-  wcs_convert_sanity_check_alloc(coords, wcs, __func__, &stat, &phi,
-                                 &theta, &world, &pixcrd, &imgcrd);
-  nelem=wcs->naxis; /* We have to make sure a WCS is given first. */
-
-
-  /* Write the values from the input list of separate columns into a single
-     array (WCSLIB input). */
-  wcs_convert_list_to_from_array(coords, world, stat, wcs->naxis, 0);
-
-
-  /* Use WCSLIB's wcss2p for the conversion. We are ignoring the over-all
-     status here, because later we will use the 'stat' array to set all bad
-     coordinates to NaN. */
-  wcss2p(wcs, ncoord, nelem, world, phi, theta, imgcrd, pixcrd, stat);
-
-
-  /* For a sanity check.
-  {
-    size_t i;
-    printf("\n\n%s sanity check:\n", __func__);
-    for(i=0;i<coords->size;++i)
-      printf("(%g, %g) --> phi:%g, theta: %g --> (%g, %g) --> (%g, %g) "
-             "[stat: %d]\n",
-             world[i*2],  world[i*2+1],
-             phi[i*2],    theta[i*2],
-             imgcrd[i*2], imgcrd[i*2+1],
-             pixcrd[i*2], pixcrd[i*2+1], stat[i]);
-    printf("stat: %d\n", stat[4]);
-  }
-  */
 
 
-  /* Allocate the output arrays if they were not already allocated. */
-  out=wcs_convert_prepare_out(coords, wcs, inplace);
 
+/* Fast TAN conversion of coordinates 'first' to 'first+num-1' (see
+   'wcs_convert_tan_check'). All angles are in degrees, like WCSLIB. */
+static void
+wcs_convert_tan(struct wcs_convert_params *cp, size_t first, size_t num)
+{
+  size_t i;
+  double *e=cp->euler, d2r=M_PI/180.0;
+  double *ilng=cp->in[cp->lng],  *ilat=cp->in[cp->lat];
+  double *olng=cp->out[cp->lng], *olat=cp->out[cp->lat];
+  double x, y, r, s, c, phi, theta, dphi, lng, lat, sinlat, coslat;
 
-  /* Write the output from a single array (WCSLIB output) into the output
-     list of this function. */
-  wcs_convert_list_to_from_array(out, pixcrd, stat, wcs->naxis, 1);
+  for(i=first;i<first+num;++i)
+    if(cp->toimg)
+      {
+        /* Celestial to native spherical coordinates. */
+        lng=ilng[i]; lat=ilat[i];
+        dphi=(lng-e[0])*d2r;
+        sinlat=sin(lat*d2r);
+        coslat=cos(lat*d2r);
+        x = sinlat*e[4] - coslat*e[3]*cos(dphi);
+        y = -coslat*sin(dphi);
+        phi = e[2]*d2r + atan2(y, x);
+        s = sinlat*e[3] + coslat*e[4]*cos(dphi);  /* sin(theta) */
+
+        /* Native spherical to projection plane (intermediate world
+           coordinates); 'cos(theta)' is found from 'x' and 'y' (the
+           projection of the unit vector on the plane). */
+        if( s==0.0 || ( s<0.0 && (cp->bounds&1) ) || isnan(s) )
+          { olng[i]=olat[i]=NAN; continue; }
+        r = cp->r0*sqrt(x*x+y*y)/s;
+        x =  r*sin(phi);
+        y = -r*cos(phi);
+
+        /* Intermediate world coordinates to pixels. */
+        olng[i] = cp->inverse[0]*x + cp->inverse[1]*y + cp->crpix[0];
+        olat[i] = cp->inverse[2]*x + cp->inverse[3]*y + cp->crpix[1];
+      }
+    else
+      {
+        /* Pixels to intermediate world coordinates. */
+        lng=ilng[i]-cp->crpix[0];
+        lat=ilat[i]-cp->crpix[1];
+        x = cp->matrix[0]*lng + cp->matrix[1]*lat;
+        y = cp->matrix[2]*lng + cp->matrix[3]*lat;
+
+        /* Projection plane to native spherical coordinates. */
+        r = sqrt(x*x+y*y);
+        phi = r==0.0 ? 0.0 : atan2(x, -y);
+        theta = atan2(cp->r0, r);
+
+        /* Native spherical to celestial coordinates. */
+        dphi = phi - e[2]*d2r;
+        s=sin(theta);
+        c=cos(theta);
+        x = s*e[4] - c*e[3]*cos(dphi);
+        y = -c*sin(dphi);
+        lng = e[0] + atan2(y, x)/d2r;
+        lat = asin(s*e[3] + c*e[4]*cos(dphi))/d2r;
+
+        /* Normalize the longitude like WCSLIB's 'sphx2s'. */
+        if(e[0]>=0.0) { if(lng<0.0) lng+=360.0; }
+        else          { if(lng>0.0) lng-=360.0; }
+        if     (lng> 360.0) lng-=360.0;
+        else if(lng<-360.0) lng+=360.0;
+        olng[i]=lng;
+        olat[i]=lat;
+      }
+}
 
 
-  /* Clean up. */
+
+
+
+/* Convert the coordinates in the blocks that are assigned to this
+   thread. */
+static void *
+wcs_convert_worker(void *in_prm)
+{
+  struct gal_threads_params *tprm=(struct gal_threads_params *)in_prm;
+  struct wcs_convert_params *cp=(struct wcs_convert_params *)tprm->params;
+
+  int *stat=NULL;
+  struct wcsprm *wcs=cp->wcs[tprm->id];
+  size_t b, d, i, j, first, num, ndim=cp->ndim;
+  double *phi=NULL, *theta=NULL, *world=NULL, *pixcrd=NULL, *imgcrd=NULL;
+  double *input, *output;
+
+  /* Allocate the temporary arrays of WCSLIB (only for one block). */
+  if(cp->fasttan==0)
+    {
+      phi    = gal_pointer_allocate(GAL_TYPE_FLOAT64, WCS_CONVERT_BLOCK, 0,
+                                    __func__, "phi");
+      stat   = gal_pointer_allocate(GAL_TYPE_INT, WCS_CONVERT_BLOCK, 1,
+                                    __func__, "stat");
+      theta  = gal_pointer_allocate(GAL_TYPE_FLOAT64, WCS_CONVERT_BLOCK, 0,
+                                    __func__, "theta");
+      world  = gal_pointer_allocate(GAL_TYPE_FLOAT64,
+                                    ndim*WCS_CONVERT_BLOCK, 0, __func__,
+                                    "world");
+      imgcrd = gal_pointer_allocate(GAL_TYPE_FLOAT64,
+                                    ndim*WCS_CONVERT_BLOCK, 0, __func__,
+                                    "imgcrd");
+      pixcrd = gal_pointer_allocate(GAL_TYPE_FLOAT64,
+                                    ndim*WCS_CONVERT_BLOCK, 0, __func__,
+                                    "pixcrd");
+    }
+  input  = cp->toimg ? world  : pixcrd;
+  output = cp->toimg ? pixcrd : world;
+
+  /* Go over all the blocks that are assigned to this thread. */
+  for(b=0; tprm->indexs[b]!=GAL_BLANK_SIZE_T; ++b)
+    {
+      /* Range of this block. */
+      first=tprm->indexs[b]*WCS_CONVERT_BLOCK;
+      num = ( first+WCS_CONVERT_BLOCK>cp->size
+              ? cp->size-first : WCS_CONVERT_BLOCK );
+
+      /* The fast TAN conversion works directly on the coordinate
+         arrays. */
+      if(cp->fasttan) { wcs_convert_tan(cp, first, num); continue; }
+
+      /* In Gnuastro, each coordinate is a separate array, but WCSLIB's
+         input is a single array (with multiple columns). */
+      for(d=0;d<ndim;++d)
+        for(i=0,j=first;i<num;++i,++j)
+          input[i*ndim+d]=cp->in[d][j];
+
+      /* Use WCSLIB for the conversion. We are ignoring the over-all
+         status here, because later we will use the 'stat' array to set
+         all bad coordinates to NaN. */
+      if(cp->toimg)
+        wcss2p(wcs, num, ndim, world, phi, theta, imgcrd, pixcrd, stat);
+      else
+        wcsp2s(wcs, num, ndim, pixcrd, imgcrd, phi, theta, world, stat);
+
+      /* Write the output (bad coordinates are NaN). */
+      for(d=0;d<ndim;++d)
+        for(i=0,j=first;i<num;++i,++j)
+          cp->out[d][j] = stat[i] ? NAN : output[i*ndim+d];
+    }
+
+  /* Clean up and wait for the other threads to finish, then return. */
   free(phi);
   free(stat);
   free(theta);
   free(world);
   free(imgcrd);
   free(pixcrd);
-
-  /* Return the output list of coordinates. */
-  return out;
+  if(tprm->b) pthread_barrier_wait(tprm->b);
+  return NULL;
 }
 
 
 
 
 
-/* Similar to 'gal_wcs_world_to_img'. */
-gal_data_t *
-gal_wcs_img_to_world(gal_data_t *coords, struct wcsprm *wcs, int inplace)
+/* Convert the coordinates in 'coords' into 'out' (that may be the same)
+   on 'numthreads' threads. Since WCSLIB's conversion functions use the
+   internal (work) arrays of the WCS structure, each thread uses its own
+   copy of 'wcs'. */
+static void
+wcs_convert(gal_data_t *coords, gal_data_t *out, struct wcsprm *wcs,
+            int toimg, size_t numthreads)
 {
-  gal_data_t *out;
-  int *stat=NULL, ncoord=coords->size, nelem;
-  double *phi=NULL, *theta=NULL, *world=NULL, *pixcrd=NULL, *imgcrd=NULL;
+  int status;
+  gal_data_t *tmp;
+  size_t i, nt, numblocks;
+  struct wcs_convert_params cp;
+
+  /* Make sure all the internal parameters of the WCS are set. Similar to
+     WCSLIB's own conversion functions, this is only done when they
+     aren't already set: the same 'wcs' may be used by many threads of
+     the caller (for example in Crop), so it shouldn't be written into
+     when it is ready. */
+  if(wcs->flag!=WCSSET)
+    {
+      status=wcsset(wcs);
+      if(status)
+        error(EXIT_FAILURE, 0, "%s: wcsset error %d: %s", __func__,
+              status, wcs_errmsg[status]);
+    }
 
-  /* Some sanity checks. */
-  wcs_convert_sanity_check_alloc(coords, wcs, __func__, &stat, &phi, &theta,
-                                 &world, &pixcrd, &imgcrd);
-  nelem=wcs->naxis; /* We have to make sure a WCS is given first. */
+  /* Set the basic parameters. */
+  cp.toimg=toimg;
+  cp.ndim=wcs->naxis;
+  cp.size=coords->size;
+  errno=0;
+  cp.in=malloc(cp.ndim * sizeof *cp.in);
+  if(cp.in==NULL)
+    error(EXIT_FAILURE, errno, "%s: %zu bytes for 'cp.in'", __func__,
+          cp.ndim * sizeof *cp.in);
+  errno=0;
+  cp.out=malloc(cp.ndim * sizeof *cp.out);
+  if(cp.out==NULL)
+    error(EXIT_FAILURE, errno, "%s: %zu bytes for 'cp.out'", __func__,
+          cp.ndim * sizeof *cp.out);
+  for(i=0, tmp=coords; tmp!=NULL; tmp=tmp->next) cp.in[i++]=tmp->array;
+  for(i=0, tmp=out;    tmp!=NULL; tmp=tmp->next) cp.out[i++]=tmp->array;
+  wcs_convert_tan_check(wcs, &cp);
+
+  /* Set the number of threads (there is no need for more threads than
+     the number of blocks). */
+  numblocks = cp.size/WCS_CONVERT_BLOCK + (cp.size%WCS_CONVERT_BLOCK>0);
+  nt = numthreads>numblocks ? numblocks : numthreads;
+  if(nt==0) nt=1;
+
+  /* Each thread needs its own WCS structure (when WCSLIB is used). The
+     first thread can use the input. The copies are set here (not in the
+     threads), because 'wcsset' is not guaranteed to be thread-safe. */
+  errno=0;
+  cp.wcs=malloc(nt * sizeof *cp.wcs);
+  if(cp.wcs==NULL)
+    error(EXIT_FAILURE, errno, "%s: %zu bytes for 'cp.wcs'", __func__,
+          nt * sizeof *cp.wcs);
+  cp.wcs[0]=wcs;
+  for(i=1;i<nt;++i)
+    {
+      cp.wcs[i] = cp.fasttan ? wcs : gal_wcs_copy(wcs);
+      if( cp.fasttan==0 && (status=wcsset(cp.wcs[i])) )
+        error(EXIT_FAILURE, 0, "%s: wcsset error %d: %s", __func__,
+              status, wcs_errmsg[status]);
+    }
 
+  /* Do the conversion. */
+  gal_threads_spin_off(wcs_convert_worker, &cp, numblocks, nt,
+                       coords->minmapsize, coords->quietmmap);
 
-  /* Write the values from the input list of separate columns into a single
-     array (WCSLIB input). */
-  wcs_convert_list_to_from_array(coords, pixcrd, stat, wcs->naxis, 0);
+  /* Clean up. */
+  if(cp.fasttan==0)
+    for(i=1;i<nt;++i) gal_wcs_free(cp.wcs[i]);
+  free(cp.wcs);
+  free(cp.out);
+  free(cp.in);
+}
 
 
-  /* Use WCSLIB's wcsp2s for the conversion. We are ignoring the over-all
-     status here, because later we will use the 'stat' array to set all bad
-     coordinates to NaN.*/
-  wcsp2s(wcs, ncoord, nelem, pixcrd, imgcrd, phi, theta, world, stat);
 
 
-  /* For a check.
-  {
-    size_t i;
-    printf("\n\n%s sanity check (%d dimensions):\n", __func__, nelem);
-    for(i=0;i<coords->size;++i)
-      switch(nelem)
-        {
-        case 2:
-          printf("(%-10g %-10g) --> (%-10g %-10g), [stat: %d]\n",
-                 pixcrd[i*2], pixcrd[i*2+1],
-                 world[i*2],  world[i*2+1], stat[i]);
-          break;
-        case 3:
-          printf("(%g, %g, %g) --> (%g, %g, %g), [stat: %d]\n",
-                 pixcrd[i*3], pixcrd[i*3+1], pixcrd[i*3+2],
-                 world[i*3],  world[i*3+1],  world[i*3+2], stat[i]);
-          break;
-        }
-  }
-  */
 
+/* Convert world coordinates to image coordinates given the input WCS
+   structure. The input must be a linked list of data structures of float64
+   ('double') type. The top element of the linked list must be the first
+   coordinate and etc. If 'inplace' is non-zero, then the output will be
+   written into the input's allocated space. */
+gal_data_t *
+gal_wcs_world_to_img(gal_data_t *coords, struct wcsprm *wcs, int inplace,
+                     size_t numthreads)
+{
+  gal_data_t *out;
+
+  /* It can happen that the input datasets are empty. In this case, simply
+     return them. */
+  if(coords->size==0 || coords->array==NULL)
+    {
+      if(inplace) return coords;
+      else error(EXIT_FAILURE, 0, "%s: a bug! Please contact us at "
+                 "'%s' to fix the problem. The input has no data and "
+                 "'inplace' is not called", __func__, PACKAGE_BUGREPORT);
+    }
+
+  /* Some sanity checks. */
+  wcs_convert_sanity_check(coords, wcs, __func__);
 
   /* Allocate the output arrays if they were not already allocated. */
   out=wcs_convert_prepare_out(coords, wcs, inplace);
 
+  /* Do the conversion and return the output list of coordinates. */
+  wcs_convert(coords, out, wcs, 1, numthreads);
+  return out;
+}
+
 
-  /* Write the output from a single array (WCSLIB output) into the output
-     list of this function. */
-  wcs_convert_list_to_from_array(out, world, stat, wcs->naxis, 1);
 
 
-  /* Clean up. */
-  free(phi);
-  free(stat);
-  free(theta);
-  free(world);
-  free(imgcrd);
-  free(pixcrd);
 
+/* Similar to 'gal_wcs_world_to_img'. */
+gal_data_t *
+gal_wcs_img_to_world(gal_data_t *coords, struct wcsprm *wcs, int inplace,
+                     size_t numthreads)
+{
+  gal_data_t *out;
+
+  /* Some sanity checks. */
+  wcs_convert_sanity_check(coords, wcs, __func__);
+
+  /* Allocate the output arrays if they were not already allocated. */
+  out=wcs_convert_prepare_out(coords, wcs, inplace);
 
-  /* Return the output list of coordinates. */
+  /* Do the conversion and return the output list of coordinates. */
+  wcs_convert(coords, out, wcs, 0, numthreads);
   return out;
 }
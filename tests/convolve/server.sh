@@ -0,0 +1,100 @@
+# Convolve an image through a resident server.
+#
+# See the Tests subsection of the manual for a complete explanation
+# (in the Installing gnuastro section).
+#
+# Original author:
+#     Mohammad Akhlaghi <mohammad@akhlaghi.org>
+# Contributing author(s):
+# Copyright (C) 2022 Free Software Foundation, Inc.
+#
+# Copying and distribution of this file, with or without modification,
+# are permitted in any medium without royalty provided the copyright
+# notice and this notice are preserved.  This file is offered as-is,
+# without any warranty.
+
+
+
+
+
+# Preliminaries
+# =============
+#
+# Set the variables (The executable is in the build tree). Do the
+# basic checks to see if the executable is made or if the defaults
+# file exists (basicchecks.sh is in the source tree).
+psf=psf.fits
+prog=convolve
+img=mkprofcat1.fits
+execname=../bin/$prog/ast$prog
+convertt=../bin/convertt/astconvertt
+
+
+
+
+
+# Skip?
+# =====
+#
+# If the dependencies of the test don't exist, then skip it. There are two
+# types of dependencies:
+#
+#   - The executable was not made (for example due to a configure option),
+#
+#   - The input data was not made (for example the test that created the
+#     data file failed).
+if [ ! -f $execname ]; then echo "$execname not created."; exit 77; fi
+if [ ! -f $convertt ]; then echo "$convertt not created."; exit 77; fi
+if [ ! -f $img      ]; then echo "$img does not exist.";   exit 77; fi
+if [ ! -f $psf      ]; then echo "$psf does not exist.";   exit 77; fi
+
+
+
+
+
+# Actual test script
+# ==================
+#
+# Start a server for Convolve (with its socket in a temporary directory)
+# and convolve the image twice through it: the second time, the kernel is
+# taken from the server's cache. The outputs should be identical to
+# convolving without the server. The pixel values are compared as plain
+# text (the headers contain the date).
+GNUASTRO_SERVER=$(mktemp -d)
+export GNUASTRO_SERVER
+$execname --server &
+server=$!
+for i in 1 2 3 4 5 6 7 8 9 10; do
+    if [ -S $GNUASTRO_SERVER/ast$prog.sock ]; then break; fi
+    sleep 1
+done
+if [ ! -S $GNUASTRO_SERVER/ast$prog.sock ]; then
+    echo "server didn't start."; kill $server; exit 1
+fi
+
+# 'check_with_program' can be something like Valgrind or an empty
+# string. Such programs will execute the command if present and help in
+# debugging when the developer doesn't have access to the user's system.
+for n in 1 2; do
+    $check_with_program $execname $img --kernel=$psf --domain=spatial \
+                        --output=convolve_server_$n.fits
+    status=$?
+    if [ $status != 0 ]; then kill $server; exit $status; fi
+done
+
+# Stop the server (its socket should be removed) and convolve without it.
+kill $server
+wait $server
+if [ -S $GNUASTRO_SERVER/ast$prog.sock ]; then
+    echo "server socket not removed."; exit 1
+fi
+rmdir $GNUASTRO_SERVER
+unset GNUASTRO_SERVER
+$execname $img --kernel=$psf --domain=spatial --output=convolve_server_0.fits
+
+# Compare the outputs.
+for n in 0 1 2; do
+    $convertt convolve_server_$n.fits --output=convolve_server_$n.txt
+done
+cmp convolve_server_0.txt convolve_server_1.txt \
+    && cmp convolve_server_0.txt convolve_server_2.txt
@@ -0,0 +1,115 @@
+# Crop all the catalog rows into a single file (cube or HDUs).
+#
+# See the Tests subsection of the manual for a complete explanation
+# (in the Installing gnuastro section).
+#
+# Original author:
+#     Mohammad Akhlaghi <mohammad@akhlaghi.org>
+# Contributing author(s):
+# Copyright (C) 2015-2022 Free Software Foundation, Inc.
+#
+# Copying and distribution of this file, with or without modification,
+# are permitted in any medium without royalty provided the copyright
+# notice and this notice are preserved.  This file is offered as-is,
+# without any warranty.
+
+
+
+
+
+# Preliminaries
+# =============
+#
+# Set the variables (The executable is in the build tree). Do the
+# basic checks to see if the executable is made or if the defaults
+# file exists (basicchecks.sh is in the source tree).
+prog=crop
+img=mkprofcat1.fits
+execname=../bin/$prog/ast$prog
+fits=../bin/fits/astfits
+table=../bin/table/asttable
+convertt=../bin/convertt/astconvertt
+arithmetic=../bin/arithmetic/astarithmetic
+
+
+
+
+
+# Skip?
+# =====
+#
+# If the dependencies of the test don't exist, then skip it. There are two
+# types of dependencies:
+#
+#   - The executable was not made (for example due to a configure option),
+#
+#   - The input data was not made (for example the test that created the
+#     data file failed).
+if [ ! -f $execname   ]; then echo "$execname not created.";   exit 77; fi
+if [ ! -f $fits       ]; then echo "$fits not created.";       exit 77; fi
+if [ ! -f $table      ]; then echo "$table not created.";      exit 77; fi
+if [ ! -f $convertt   ]; then echo "$convertt not created.";   exit 77; fi
+if [ ! -f $arithmetic ]; then echo "$arithmetic not created."; exit 77; fi
+if [ ! -f $img        ]; then echo "$img does not exist.";     exit 77; fi
+
+
+
+
+
+# Actual test script
+# ==================
+#
+# The catalog is cropped three times: once into one file per crop (the
+# default), once into the slices of a cube and once into the HDUs of a
+# single file. Slice/HDU 'i' of the single files should have the same
+# pixels as the 'i'-th crop of the default run (compared as text), and
+# the 'OFFSET_n' columns of the 'CROP-INDEX' table should be the position
+# of the crop's first pixel (crops are 201 pixels wide, so 101 pixels
+# before the center) minus one. With 'set -e', the test fails as soon as
+# any of the commands or comparisons fails.
+#
+# The number of threads is one so if CFITSIO does is not configured to
+# enable multithreaded access to files, the tests pass. It is the
+# users choice to enable this feature.
+#
+# 'check_with_program' can be something like 'Valgrind' or an empty
+# string. Such programs will execute the command if present and help in
+# debugging when the developer doesn't have access to the user's system.
+set -e
+cat=$topsrc/tests/$prog/cat.txt
+opts="--catalog=$cat --numthreads=1 --zeroisnotblank --mode=img \
+      --coordcol=X_CENTER --coordcol=Y_CENTER --namecol=NAME --width=201"
+$check_with_program $execname $img $opts --suffix=_singlefile.fits
+$check_with_program $execname $img $opts --singlefile=cube \
+                              --output=singlefile-cube.fits
+$check_with_program $execname $img $opts --singlefile=hdus \
+                              --output=singlefile-hdus.fits
+
+# Number of HDUs (including the empty first HDU) and slices.
+test $($fits singlefile-cube.fits --numhdus) = 3
+test $($fits singlefile-hdus.fits --numhdus) = 4
+test $($fits singlefile-cube.fits -h1 --keyvalue=NAXIS3 --quiet) = 2
+
+# Pixels of each slice/HDU.
+i=1
+for name in $(awk '!/^#/{print $1}' $cat); do
+    $convertt $name"_singlefile.fits" --output=singlefile-$i.txt
+    $convertt singlefile-hdus.fits --hdu=$name \
+              --output=singlefile-hdus-$i.txt
+    $execname singlefile-cube.fits --mode=img --section=1:201,1:201,$i:$i \
+              --output=singlefile-slice-$i.fits
+    $arithmetic singlefile-slice-$i.fits 3 collapse-max \
+                --output=singlefile-slice-2d-$i.fits
+    $convertt singlefile-slice-2d-$i.fits --output=singlefile-cube-$i.txt
+    cmp singlefile-$i.txt singlefile-hdus-$i.txt
+    cmp singlefile-$i.txt singlefile-cube-$i.txt
+    i=$((i+1))
+done
+
+# Offsets of the crops.
+awk '!/^#/{print $2-101, $3-101}' $cat > singlefile-offset.txt
+for f in singlefile-cube.fits singlefile-hdus.fits; do
+    $table $f --hdu=CROP-INDEX -cOFFSET_1,OFFSET_2 \
+        | awk '{print $1, $2}' > singlefile-offset-out.txt
+    cmp singlefile-offset.txt singlefile-offset-out.txt
+done
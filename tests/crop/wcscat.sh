@@ -26,6 +26,7 @@
 prog=crop
 img=mkprofcat*.fits
 execname=../bin/$prog/ast$prog
+convertt=../bin/convertt/astconvertt
 
 
 
@@ -56,11 +57,38 @@ done
 # enable multithreaded access to files, the tests pass. It is the
 # users choice to enable this feature.
 #
+# The crops are done a second time with '--cacheinput' (where the pixels
+# are copied from the inputs in memory, not read from the files). The
+# pixels of the two sets of crops should be identical (they are compared
+# as text, because the headers contain the options and the date). With
+# 'set -e', the test fails as soon as any of the commands or comparisons
+# fails.
+#
 # 'check_with_program' can be something like Valgrind or an empty
 # string. Such programs will execute the command if present and help in
 # debugging when the developer doesn't have access to the user's system.
+set -e
 cat=$topsrc/tests/$prog/cat.txt
 $check_with_program $execname $img --catalog=$cat --suffix=_wcscat.fits  \
                               --zeroisnotblank --coordcol=4 --mode=wcs   \
                               --coordcol=DEC_CENTER --numthreads=1       \
                               --width=3/3600
+$check_with_program $execname $img --catalog=$cat --zeroisnotblank       \
+                              --suffix=_wcscat-cache.fits --coordcol=4   \
+                              --mode=wcs --coordcol=DEC_CENTER           \
+                              --numthreads=1 --width=3/3600 --cacheinput
+
+# Compare the pixels of each crop (if ConvertType is built). A crop that
+# isn't made in one run (for example its center is blank) shouldn't be
+# made in the other either.
+if [ -f $convertt ]; then
+    for name in $(awk '!/^#/{print $1}' $cat); do
+        def=$name"_wcscat"
+        cache=$name"_wcscat-cache"
+        if [ -f $def.fits ] || [ -f $cache.fits ]; then
+            $convertt $def.fits   --output=$def.txt
+            $convertt $cache.fits --output=$cache.txt
+            cmp $def.txt $cache.txt
+        fi
+    done
+fi
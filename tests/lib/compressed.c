@@ -0,0 +1,119 @@
+/*********************************************************************
+A test program for writing tile-compressed images in parallel.
+
+Original author:
+     Mohammad Akhlaghi <mohammad@akhlaghi.org>
+Contributing author(s):
+Copyright (C) 2022 Free Software Foundation, Inc.
+
+Gnuastro is free software: you can redistribute it and/or modify it
+under the terms of the GNU General Public License as published by the
+Free Software Foundation, either version 3 of the License, or (at your
+option) any later version.
+
+Gnuastro is distributed in the hope that it will be useful, but
+WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with Gnuastro. If not, see <http://www.gnu.org/licenses/>.
+**********************************************************************/
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "gnuastro/fits.h"
+#include "gnuastro/type.h"
+#include "gnuastro/threads.h"
+
+
+
+
+/* Write the dataset as a compressed image with the given number of
+   threads, and read it back. */
+gal_data_t *
+write_read(gal_data_t *data, uint8_t comptype, size_t numthreads)
+{
+  char *filename="compressed-lib.fits";
+
+  remove(filename);
+  gal_fits_img_write_compressed(data, filename, NULL, "compressed",
+                                comptype, numthreads);
+  return gal_fits_img_read(filename, "1", numthreads, -1, 1);
+}
+
+
+
+
+
+/* Return non-zero if the two datasets differ in size or elements. */
+int
+different(gal_data_t *a, gal_data_t *b)
+{
+  size_t i;
+
+  if( a->type!=b->type || a->ndim!=b->ndim ) return 1;
+  for(i=0;i<a->ndim;++i) if(a->dsize[i]!=b->dsize[i]) return 1;
+  return memcmp(a->array, b->array, a->size*gal_type_sizeof(a->type));
+}
+
+
+
+
+
+/* Write 1D, 2D and 3D datasets as compressed images (in parallel) and
+   check them after reading them back: integers are compressed without
+   loss, so they should be identical to the input. Floating point pixels
+   are quantized, so they are compared with the serial compression (which
+   should be identical). */
+int
+main(void)
+{
+  size_t i, d;
+  int failed=0;
+  gal_data_t *data, *serial, *parallel;
+  size_t dsizes[3][3]={ {1001, 0, 0}, {37, 53, 0}, {9, 11, 13} };
+  uint8_t types[2]={GAL_TYPE_INT32, GAL_TYPE_FLOAT32};
+  uint8_t comps[2]={GAL_FITS_COMPRESS_RICE, GAL_FITS_COMPRESS_GZIP};
+  size_t t, c, numthreads=gal_threads_number()<4 ? 4 : gal_threads_number();
+
+  for(d=0;d<3;++d)
+    for(t=0;t<2;++t)
+      for(c=0;c<2;++c)
+        {
+          /* Build the dataset. */
+          data=gal_data_alloc(NULL, types[t], d+1, dsizes[d], NULL, 0,
+                              -1, 1, NULL, NULL, NULL);
+          for(i=0;i<data->size;++i)
+            if(types[t]==GAL_TYPE_INT32)
+              ((int32_t *)(data->array))[i]=(int32_t)((i*7919)%1000)-300;
+            else
+              ((float *)(data->array))[i]=(i*7919)%1000/7.0f-30;
+
+          /* Write it on multiple threads and read it back. */
+          parallel=write_read(data, comps[c], numthreads);
+          if(types[t]==GAL_TYPE_FLOAT32)
+            {
+              serial=write_read(data, comps[c], 1);
+              gal_data_free(data);
+              data=serial;
+            }
+
+          /* Compare. */
+          if( different(data, parallel) )
+            {
+              fprintf(stderr, "%zuD %s image with compression %u is not "
+                      "written correctly on %zu threads.\n", d+1,
+                      gal_type_name(types[t], 1), comps[c], numthreads);
+              failed=1;
+            }
+
+          /* Clean up. */
+          gal_data_free(data);
+          gal_data_free(parallel);
+        }
+
+  /* Return. */
+  return failed ? EXIT_FAILURE : EXIT_SUCCESS;
+}
@@ -34,6 +34,23 @@ struct params
 };
 
 
+/* For checking repeated, nested and simultaneous calls to
+   'gal_threads_spin_off' (where the threads are re-used). */
+struct sumparams
+{
+  size_t numthreads;            /* Number of threads for nested calls.  */
+  size_t   numinner;            /* Actions of nested calls (0: none).   */
+  size_t      *sums;            /* Output value of each action.         */
+};
+
+/* For calling 'gal_threads_spin_off' from another thread. */
+struct concurrent
+{
+  size_t numthreads;            /* Number of threads for each call.     */
+  int        failed;            /* ==1 if any call failed.              */
+};
+
+
 
 
 /* This is the main worker function which will be called by the different
@@ -74,6 +91,87 @@ worker_on_thread(void *in_prm)
 
 
 
+
+/* Worker function to check the re-using of threads: the output of each
+   action is its index plus one. With nested calls, each action calls
+   'gal_threads_spin_off' itself and its output is the sum of the outputs
+   of its inner actions. */
+void *
+worker_sum(void *in_prm)
+{
+  struct gal_threads_params *tprm=(struct gal_threads_params *)in_prm;
+  struct sumparams *p=(struct sumparams *)tprm->params;
+  size_t i, j, index;
+  struct sumparams inner;
+
+  for(i=0; tprm->indexs[i] != GAL_BLANK_SIZE_T; ++i)
+    {
+      index = tprm->indexs[i];
+      if(p->numinner)
+        {
+          inner.numinner=0;
+          inner.numthreads=p->numthreads;
+          inner.sums=calloc(p->numinner, sizeof *inner.sums);
+          gal_threads_spin_off(worker_sum, &inner, p->numinner,
+                               p->numthreads, -1, 1);
+          p->sums[index]=0;
+          for(j=0;j<p->numinner;++j) p->sums[index]+=inner.sums[j];
+          free(inner.sums);
+        }
+      else
+        p->sums[index]=index+1;
+    }
+
+  if(tprm->b) pthread_barrier_wait(tprm->b);
+  return NULL;
+}
+
+
+
+
+/* Spin-off 'numactions' actions and return 0 if all have the expected
+   output. */
+int
+check_sums(size_t numactions, size_t numinner, size_t numthreads)
+{
+  size_t i;
+  int out=0;
+  struct sumparams p;
+
+  /* Run the actions. */
+  p.numinner=numinner;
+  p.numthreads=numthreads;
+  p.sums=calloc(numactions, sizeof *p.sums);
+  gal_threads_spin_off(worker_sum, &p, numactions, numthreads, -1, 1);
+
+  /* Check the outputs. */
+  for(i=0;i<numactions;++i)
+    if( p.sums[i] != (numinner ? numinner*(numinner+1)/2 : i+1) )
+      out=1;
+
+  /* Clean up and return. */
+  free(p.sums);
+  return out;
+}
+
+
+
+
+/* Call 'gal_threads_spin_off' many times from a separate thread. */
+void *
+concurrent_calls(void *in)
+{
+  size_t i;
+  struct concurrent *c=(struct concurrent *)in;
+
+  for(i=0;i<100;++i)
+    if( check_sums(50, 0, c->numthreads) ) c->failed=1;
+  return NULL;
+}
+
+
+
+
 /* A simple program to open a FITS image, distributes its pixels between
    different threads and print the value of each pixel and the thread it
    was assigned to, this will test both the opening of a FITS file and also
@@ -89,7 +187,11 @@ worker_on_thread(void *in_prm)
 int
 main(void)
 {
+  size_t i;
+  pthread_t t;
+  int failed;
   struct params p;
+  struct concurrent c;
   int quietmmap=1;
   size_t minmapsize=-1;
   char *filename="psf.fits", *hdu="1";
@@ -98,7 +200,7 @@ main(void)
 
   /* Read the image into memory as a float32 data type. */
   p.image=gal_fits_img_read_to_type(filename, hdu, GAL_TYPE_FLOAT32,
-                                    minmapsize, quietmmap);
+                                    numthreads, minmapsize, quietmmap);
 
 
   /* Print some basic information before the actual contents: */
@@ -121,6 +223,29 @@ main(void)
                        minmapsize, quietmmap);
 
 
+  /* The threads are re-used between calls (when they aren't busy). So
+     check many repeated calls, calls from within the worker functions
+     and calls from another thread at the same time. */
+  failed=0;
+  c.failed=0;
+  c.numthreads=numthreads;
+  for(i=0;i<100;++i) failed |= check_sums(50, 0, numthreads);
+  failed |= check_sums(20, 30, numthreads);
+  if( pthread_create(&t, NULL, concurrent_calls, &c) )
+    {
+      fprintf(stderr, "couldn't create thread.");
+      exit(EXIT_FAILURE);
+    }
+  for(i=0;i<100;++i) failed |= check_sums(50, 10, numthreads);
+  pthread_join(t, NULL);
+  if(failed || c.failed)
+    {
+      fprintf(stderr, "wrong output from repeated, nested or "
+              "simultaneous calls to 'gal_threads_spin_off'.");
+      exit(EXIT_FAILURE);
+    }
+
+
   /* Clean up and return. */
   gal_data_free(p.image);
   return EXIT_SUCCESS;
@@ -0,0 +1,75 @@
+# Make sure the '--singlepass' catalog is the same as the default one.
+#
+# See the Tests subsection of the manual for a complete explanation
+# (in the Installing gnuastro section).
+#
+# Original author:
+#     Mohammad Akhlaghi <mohammad@akhlaghi.org>
+# Contributing author(s):
+# Copyright (C) 2015-2022 Free Software Foundation, Inc.
+#
+# Copying and distribution of this file, with or without modification,
+# are permitted in any medium without royalty provided the copyright
+# notice and this notice are preserved.  This file is offered as-is,
+# without any warranty.
+
+
+
+
+
+# Preliminaries
+# =============
+#
+# Set the variables (The executable is in the build tree). Do the
+# basic checks to see if the executable is made or if the defaults
+# file exists (basicchecks.sh is in the source tree).
+prog=mkcatalog
+execname=../bin/$prog/ast$prog
+img=convolve_spatial_noised_detected_segmented.fits
+
+
+
+
+
+# Skip?
+# =====
+#
+# If the dependencies of the test don't exist, then skip it. There are two
+# types of dependencies:
+#
+#   - The executable was not made (for example due to a configure option),
+#
+#   - The input data was not made (for example the test that created the
+#     data file failed).
+if [ ! -f $execname ]; then echo "$execname not created."; exit 77; fi
+if [ ! -f $img      ]; then echo "$img does not exist.";   exit 77; fi
+
+
+
+
+
+# Actual test script
+# ==================
+#
+# With '--singlepass', each thread measures the objects over a band of
+# rows and the bands are merged afterwards. So the columns below include
+# the positions of the extrema (that need the row of each band) and the
+# second order moments (that are merged from all the bands). Several
+# threads are used so there are several bands even on a single-core
+# system. Only the rows of the two catalogs are compared (the metadata
+# contain the options).
+#
+# 'check_with_program' can be something like 'Valgrind' or an empty
+# string. Such programs will execute the command if present and help in
+# debugging when the developer doesn't have access to the user's system.
+cols="--ids --x --y --geox --geoy --minx --maxx --miny --maxy --minvx \
+      --maxvx --minvy --maxvy --area --brightness --maximum --mean    \
+      --median --numclumps --semimajor --semiminor --axisratio        \
+      --positionangle --geosemimajor --geosemiminor --geopositionangle"
+$check_with_program $execname $img $cols --numthreads=4 --tableformat=txt \
+                              --output=singlepass-default.txt
+$check_with_program $execname $img $cols --numthreads=4 --tableformat=txt \
+                              --singlepass --output=singlepass-single.txt
+grep -v '^#' singlepass-default.txt > singlepass-default-rows.txt
+grep -v '^#' singlepass-single.txt  > singlepass-single-rows.txt
+cmp singlepass-default-rows.txt singlepass-single-rows.txt
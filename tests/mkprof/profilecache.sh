@@ -0,0 +1,105 @@
+# Build repeated profiles with and without '--profilecache'.
+#
+# See the Tests subsection of the manual for a complete explanation
+# (in the Installing gnuastro section).
+#
+# Original author:
+#     Mohammad Akhlaghi <mohammad@akhlaghi.org>
+# Contributing author(s):
+# Copyright (C) 2015-2022 Free Software Foundation, Inc.
+#
+# Copying and distribution of this file, with or without modification,
+# are permitted in any medium without royalty provided the copyright
+# notice and this notice are preserved.  This file is offered as-is,
+# without any warranty.
+
+
+
+
+
+# Preliminaries
+# =============
+#
+# Set the variables (The executable is in the build tree). Do the
+# basic checks to see if the executable is made or if the defaults
+# file exists (basicchecks.sh is in the source tree).
+prog=mkprof
+execname=../bin/$prog/ast$prog
+convertt=../bin/convertt/astconvertt
+statistics=../bin/statistics/aststatistics
+
+
+
+
+
+# Skip?
+# =====
+#
+# If the dependencies of the test don't exist, then skip it. There are two
+# types of dependencies:
+#
+#   - The executable was not made (for example due to a configure option).
+if [ ! -f $execname   ]; then echo "$execname not created.";   exit 77; fi
+if [ ! -f $convertt   ]; then echo "$convertt not created.";   exit 77; fi
+if [ ! -f $statistics ]; then echo "$statistics not created."; exit 77; fi
+
+
+
+
+
+# Actual test script
+# ==================
+#
+# Two catalogs of 16 Sersic, Moffat and Gaussian profiles (with only three
+# different shapes, that don't overlap) are built with and without
+# '--profilecache':
+#
+#   - In the first, all the centers are on multiples of 1/2 pixels, so with
+#     '--profilecache=2' the centers are not changed. With '--envseed',
+#     the random numbers of the Monte Carlo integration are the same for
+#     all profiles, so the re-used profiles should be identical to the
+#     ones that are built again.
+#
+#   - In the second, most centers are not on multiples of 1/4 pixels, so
+#     with '--profilecache=4' the profiles are slightly shifted. But each
+#     profile is still scaled to its magnitude (all the profiles are within
+#     the image), so the total flux of the two images should be the same
+#     (to within the floating point errors).
+#
+# With 'set -e', the test fails as soon as any of the commands or
+# comparisons fails.
+#
+# 'check_with_program' can be something like Valgrind or an empty
+# string. Such programs will execute the command if present and help in
+# debugging when the developer doesn't have access to the user's system.
+set -e
+export GSL_RNG_SEED=1
+export GSL_RNG_TYPE=ranlxs2
+for c in 2 4; do
+    awk -v c=$c 'BEGIN{ split("sersic moffat gaussian", f, " ");
+                        for(i=0;i<16;++i)
+                          {
+                            if(c==2) { dx=(i%2)/2;    dy=(int(i/2)%2)/2; }
+                            else     { dx=(i%7)*0.13; dy=(i%5)*0.17;     }
+                            printf "%d %g %g %s 3 2.5 30 0.7 -6 5\n", i+1,
+                                   20+(i%4)*35+dx, 20+int(i/4)*35+dy,
+                                   f[i%3+1];
+                          } }' > profilecache-$c.txt
+    $check_with_program $execname profilecache-$c.txt --oversample=1 \
+                                  --mergedsize=150,150 --envseed     \
+                                  --output=profilecache-$c.fits
+    $check_with_program $execname profilecache-$c.txt --oversample=1 \
+                                  --mergedsize=150,150 --envseed     \
+                                  --profilecache=$c                  \
+                                  --output=profilecache-$c-cache.fits
+done
+
+# Profiles on the sub-pixel grid: identical pixels.
+$convertt profilecache-2.fits --output=profilecache-2-pix.txt
+$convertt profilecache-2-cache.fits --output=profilecache-2-cache-pix.txt
+cmp profilecache-2-pix.txt profilecache-2-cache-pix.txt
+
+# Shifted profiles: same total flux.
+s=$($statistics profilecache-4.fits --sum)
+sc=$($statistics profilecache-4-cache.fits --sum)
+echo "$s $sc" | awk '{d=$1-$2; if(d<0) d=-d; exit (d>1e-4*$1 ? 1 : 0)}'
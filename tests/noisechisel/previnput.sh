@@ -0,0 +1,85 @@
+# Make sure '--previnput' gives the same result as detecting from scratch.
+#
+# See the Tests subsection of the manual for a complete explanation
+# (in the Installing gnuastro section).
+#
+# Original author:
+#     Mohammad Akhlaghi <mohammad@akhlaghi.org>
+# Contributing author(s):
+# Copyright (C) 2015-2022 Free Software Foundation, Inc.
+#
+# Copying and distribution of this file, with or without modification,
+# are permitted in any medium without royalty provided the copyright
+# notice and this notice are preserved.  This file is offered as-is,
+# without any warranty.
+
+
+
+
+
+# Preliminaries
+# =============
+#
+# Set the variables (The executable is in the build tree). Do the
+# basic checks to see if the executable is made or if the defaults
+# file exists (basicchecks.sh is in the source tree).
+prog=noisechisel
+execname=../bin/$prog/ast$prog
+mkprof=../bin/mkprof/astmkprof
+convertt=../bin/convertt/astconvertt
+img=convolve_spatial_noised.fits
+
+
+
+
+
+# Skip?
+# =====
+#
+# If the dependencies of the test don't exist, then skip it. There are two
+# types of dependencies:
+#
+#   - The executable was not made (for example due to a configure option),
+#
+#   - The input data was not made (for example the test that created the
+#     data file failed).
+if [ ! -f $execname ]; then echo "$execname not created."; exit 77; fi
+if [ ! -f $mkprof   ]; then echo "$mkprof not created.";   exit 77; fi
+if [ ! -f $convertt ]; then echo "$convertt not created."; exit 77; fi
+if [ ! -f $img      ]; then echo "$img does not exist.";   exit 77; fi
+
+
+
+
+
+# Actual test script
+# ==================
+#
+# A small flat patch is added over the input image, then the changed
+# image is detected twice: once from scratch and once with the convolved
+# image of the original input (with '--previnput', so only the tiles
+# around the patch are convolved again). The convolved images and the
+# detection maps of the two runs should be identical.
+#
+# 'check_with_program' can be something like Valgrind or an empty
+# string. Such programs will execute the command if present and help in
+# debugging when the developer doesn't have access to the user's system.
+opts="--detgrowquant=0.7 --cleangrowndet --checkdetection --continueaftercheck"
+echo "1 40 60 flat 3 1 0 1 500 1" > previnput-cat.txt
+$mkprof previnput-cat.txt --background=$img --mforflatpix \
+        --output=previnput-changed.fits
+$check_with_program $execname $img $opts --output=previnput-orig.fits
+$check_with_program $execname previnput-changed.fits $opts \
+                              --output=previnput-scratch.fits
+$check_with_program $execname previnput-changed.fits $opts \
+                              --convolved=previnput-orig_detcheck.fits \
+                              --chdu=CONVOLVED --previnput=$img --prevhdu=1 \
+                              --output=previnput-update.fits
+for run in scratch update; do
+    $convertt previnput-$run"_detcheck.fits" --hdu=CONVOLVED \
+              --output=previnput-$run-conv.txt
+    $convertt previnput-$run.fits --hdu=DETECTIONS \
+              --output=previnput-$run-det.txt
+done
+cmp previnput-scratch-conv.txt previnput-update-conv.txt \
+    && cmp previnput-scratch-det.txt previnput-update-det.txt
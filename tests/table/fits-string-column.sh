@@ -0,0 +1,71 @@
+# Read a string column from FITS binary and ASCII tables.
+#
+# See the Tests subsection of the manual for a complete explanation
+# (in the Installing gnuastro section).
+#
+# Original author:
+#     Mohammad Akhlaghi <mohammad@akhlaghi.org>
+# Contributing author(s):
+# Copyright (C) 2015-2022 Free Software Foundation, Inc.
+#
+# Copying and distribution of this file, with or without modification,
+# are permitted in any medium without royalty provided the copyright
+# notice and this notice are preserved.  This file is offered as-is,
+# without any warranty.
+
+
+
+
+
+# Preliminaries
+# =============
+#
+# Set the variables (The executable is in the build tree). Do the
+# basic checks to see if the executable is made or if the defaults
+# file exists (basicchecks.sh is in the source tree).
+prog=table
+binary=binary-table.fits
+ascii=ascii-table.fits
+execname=../bin/$prog/ast$prog
+table=$topsrc/tests/$prog/table.txt
+
+
+
+
+
+# Skip?
+# =====
+#
+# If the dependencies of the test don't exist, then skip it. There are two
+# types of dependencies:
+#
+#   - The executable was not made (for example due to a configure option),
+#
+#   - The input data was not made (for example the test that created the
+#     data file failed).
+if [ ! -f $execname ]; then echo "$execname not created."; exit 77; fi
+if [ ! -f $table    ]; then echo "$table does not exist."; exit 77; fi
+if [ ! -f $binary   ]; then echo "$binary doesn't exist."; exit 77; fi
+if [ ! -f $ascii    ]; then echo "$ascii doesn't exist.";  exit 77; fi
+
+
+
+
+
+# Actual test script
+# ==================
+#
+# The strings of a FITS table's string column are read into one
+# allocation (see 'gal_data_string_arena'). The third column of the test
+# table contains strings (with spaces and blank values), so it is read
+# from both FITS tables (and the original plain-text table) and the
+# outputs are compared.
+#
+# 'check_with_program' can be something like 'Valgrind' or an empty
+# string. Such programs will execute the command if present and help in
+# debugging when the developer doesn't have access to the user's system.
+$check_with_program $execname $table  -c3 > string-column-txt.txt
+$check_with_program $execname $binary -c3 > string-column-binary.txt
+$check_with_program $execname $ascii  -c3 > string-column-ascii.txt
+cmp string-column-txt.txt string-column-binary.txt \
+    && cmp string-column-txt.txt string-column-ascii.txt
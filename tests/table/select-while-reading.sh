@@ -0,0 +1,87 @@
+# Row selection while reading must give the same rows as after reading.
+#
+# See the Tests subsection of the manual for a complete explanation
+# (in the Installing gnuastro section).
+#
+# Original author:
+#     Mohammad Akhlaghi <mohammad@akhlaghi.org>
+# Contributing author(s):
+# Copyright (C) 2015-2022 Free Software Foundation, Inc.
+#
+# Copying and distribution of this file, with or without modification,
+# are permitted in any medium without royalty provided the copyright
+# notice and this notice are preserved.  This file is offered as-is,
+# without any warranty.
+
+
+
+
+
+# Preliminaries
+# =============
+#
+# Set the variables (The executable is in the build tree). Do the
+# basic checks to see if the executable is made or if the defaults
+# file exists (basicchecks.sh is in the source tree).
+prog=table
+execname=../bin/$prog/ast$prog
+txt=$topsrc/tests/$prog/table.txt
+fits=binary-table.fits
+
+
+
+
+
+# Skip?
+# =====
+#
+# If the dependencies of the test don't exist, then skip it. There are two
+# types of dependencies:
+#
+#   - The executable was not made (for example due to a configure option),
+#
+#   - The input data was not made (for example the test that created the
+#     data file failed).
+if [ ! -f $execname ]; then echo "$execname not created."; exit 77; fi
+if [ ! -f $txt      ]; then echo "$txt doesn't exist.";    exit 77; fi
+if [ ! -f $fits     ]; then echo "$fits doesn't exist.";   exit 77; fi
+
+
+
+
+
+# Actual test script
+# ==================
+#
+# When possible, Table gives '--range', '--equal', '--notequal', '--head',
+# '--tail' and '--rowrange' to the table readers, so the rows that aren't
+# selected are never read. These selections are not given to the readers
+# when the input has to be fully read anyway: with '--noblank' for the
+# value-based selections and with '--sort' for the position-based ones.
+# Column 11 of the test table has no blank values and is already sorted
+# (it is the row counter), so '--noblank=11 --sort=11' doesn't change the
+# selected rows: it just forces them to be selected after a full read of
+# the table. The two outputs must be identical.
+#
+# The selections include a blank value (row 5 of column 1), the lower
+# (inclusive) and upper (exclusive) limits of a range and combinations of
+# value and position-based selections. With 'set -e', the test fails as
+# soon as any of the commands or comparisons fails.
+#
+# 'check_with_program' can be something like 'Valgrind' or an empty
+# string. Such programs will execute the command if present and help in
+# debugging when the developer doesn't have access to the user's system.
+set -e
+for input in $txt $fits; do
+    for select in "--range=1,3:10" "--range=INT32,4,9 --range=1,2:12"   \
+                  "--equal=1,5,7" "--equal=INT16,-3467,-20822"          \
+                  "--notequal=1,2,255" "--head=4" "--tail=3"            \
+                  "--rowrange=3,8" "--range=1,3:10 --head=2"            \
+                  "--notequal=1,4 --tail=2"; do
+        $check_with_program $execname $input $select \
+                            > select-while-reading.txt
+        $execname $input $select --noblank=11 --sort=11 \
+                  > select-after-reading.txt
+        cmp select-while-reading.txt select-after-reading.txt
+    done
+done
@@ -0,0 +1,71 @@
+# Make sure the tile-compressed output doesn't depend on the threads.
+#
+# See the Tests subsection of the manual for a complete explanation
+# (in the Installing gnuastro section).
+#
+# Original author:
+#     Mohammad Akhlaghi <mohammad@akhlaghi.org>
+# Contributing author(s):
+# Copyright (C) 2015-2022 Free Software Foundation, Inc.
+#
+# Copying and distribution of this file, with or without modification,
+# are permitted in any medium without royalty provided the copyright
+# notice and this notice are preserved.  This file is offered as-is,
+# without any warranty.
+
+
+
+
+
+# Preliminaries
+# =============
+#
+# Set the variables (The executable is in the build tree). Do the
+# basic checks to see if the executable is made or if the defaults
+# file exists (basicchecks.sh is in the source tree).
+prog=warp
+img=convolve_spatial.fits
+execname=../bin/$prog/ast$prog
+convertt=../bin/convertt/astconvertt
+
+
+
+
+
+# Skip?
+# =====
+#
+# If the dependencies of the test don't exist, then skip it. There are two
+# types of dependencies:
+#
+#   - The executable was not made (for example due to a configure option),
+#
+#   - The input data was not made (for example the test that created the
+#     data file failed).
+if [ ! -f $execname ]; then echo "$execname not created."; exit 77; fi
+if [ ! -f $convertt ]; then echo "$convertt not created."; exit 77; fi
+if [ ! -f $img      ]; then echo "$img does not exist.";   exit 77; fi
+
+
+
+
+
+# Actual test script
+# ==================
+#
+# An output name ending in '.fz' is tile-compressed. With several threads,
+# blocks of tiles are compressed in parallel, but the (quantized) pixel
+# values should be identical to the compression on a single thread. The
+# pixel values of the two outputs are compared as plain text.
+#
+# 'check_with_program' can be something like Valgrind or an empty
+# string. Such programs will execute the command if present and help in
+# debugging when the developer doesn't have access to the user's system.
+rm -f compressed-1.fits.fz compressed-4.fits.fz
+$check_with_program $execname $img --scale=1/5 --centeroncorner \
+                              --numthreads=1 --output=compressed-1.fits.fz
+$check_with_program $execname $img --scale=1/5 --centeroncorner \
+                              --numthreads=4 --output=compressed-4.fits.fz
+$convertt compressed-1.fits.fz -h1 --output=compressed-1.txt
+$convertt compressed-4.fits.fz -h1 --output=compressed-4.txt
+cmp compressed-1.txt compressed-4.txt